@@ -14,6 +14,7 @@
 #include <linux/module.h>
 #include <linux/random.h>
 
+#include "esdm_es_mgr.h"
 #include "esdm_es_mgr_cb.h"
 #include "esdm_es_irq.h"
 #include "esdm_es_timer_common.h"
@@ -609,8 +610,10 @@ static void esdm_time_process_common(u32 time, void (*add_time)(u32 data))
 	if (health_test > esdm_health_fail_use)
 		return;
 
-	if (health_test == esdm_health_pass)
-		atomic_inc_return(this_cpu_ptr(&esdm_irq_array_irqs));
+	if (health_test == esdm_health_pass &&
+	    unlikely(esdm_data_notify(
+		    atomic_inc_return(this_cpu_ptr(&esdm_irq_array_irqs)))))
+		esdm_es_mgr_notify();
 
 	add_time(time);
 }
@@ -11,7 +11,9 @@
 #include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/fs.h>
+#include <linux/irq_work.h>
 #include <linux/module.h>
+#include <linux/poll.h>
 #include <linux/version.h>
 
 #include "esdm_es_ioctl.h"
@@ -38,6 +40,10 @@ static struct class *esdm_es_class;
 static struct cdev esdm_cdev;
 static DEFINE_MUTEX(esdm_cdev_lock);
 
+/* Readiness notification of the entropy sources for user space */
+static DECLARE_WAIT_QUEUE_HEAD(esdm_es_wait);
+static atomic_t esdm_es_events = ATOMIC_INIT(0);
+
 /********************************** Helper ***********************************/
 
 bool esdm_enforce_panic_on_permanent_health_failure(void)
@@ -54,20 +60,79 @@ void esdm_reset_state(enum esdm_internal_es es)
 	pr_debug("reset ESDM ES %u\n", es);
 }
 
+static void esdm_es_mgr_notify_work(struct irq_work *work)
+{
+	wake_up_interruptible(&esdm_es_wait);
+}
+
+static DEFINE_IRQ_WORK(esdm_es_notify_irq_work, esdm_es_mgr_notify_work);
+
+/*
+ * Notify user space waiting in poll() on the device file that an entropy
+ * source collected new entropy. The entropy sources call this function from
+ * interrupt and scheduler context where a wake up is not allowed, so it is
+ * deferred to an IRQ work item.
+ */
+void esdm_es_mgr_notify(void)
+{
+	atomic_inc(&esdm_es_events);
+	if (wq_has_sleeper(&esdm_es_wait))
+		irq_work_queue(&esdm_es_notify_irq_work);
+}
+
 /* Module init: allocate memory, register the device file */
 static int esdm_cdev_open(struct inode *inode, struct file *file)
 {
 	unsigned m = iminor(inode);
-	/* optionally set file->private_data here */
 
 	if (!capable(CAP_SYS_ADMIN))
 		return -EPERM;
 
 	if (m >= ESDM_MAX_MINORS)
 		return -EINVAL;
+
+	/* Notification events seen by this file */
+	file->private_data =
+		(void *)(unsigned long)atomic_read(&esdm_es_events);
+
 	return nonseekable_open(inode, file);
 }
 
+/*
+ * The device file is readable when an entropy source notified new entropy
+ * since the last read of the file.
+ */
+static __poll_t esdm_cdev_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &esdm_es_wait, wait);
+
+	if ((unsigned int)atomic_read(&esdm_es_events) !=
+	    (unsigned int)(unsigned long)file->private_data)
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+/*
+ * Acknowledge the notifications: return the event counter as u32 and mark all
+ * events as seen. The read never blocks.
+ */
+static ssize_t esdm_cdev_read(struct file *file, char __user *buf,
+			      size_t nbytes, loff_t *ppos)
+{
+	u32 events = (u32)atomic_read(&esdm_es_events);
+
+	if (nbytes < sizeof(events))
+		return -EINVAL;
+
+	file->private_data = (void *)(unsigned long)events;
+
+	if (copy_to_user(buf, &events, sizeof(events)))
+		return -EFAULT;
+
+	return sizeof(events);
+}
+
 static int esdm_cdev_release(struct inode *inode, struct file *file)
 {
 	return 0;
@@ -115,6 +180,8 @@ static const struct file_operations esdm_cdev_fops = {
 	.owner = THIS_MODULE,
 	.open = esdm_cdev_open,
 	.release = esdm_cdev_release,
+	.read = esdm_cdev_read,
+	.poll = esdm_cdev_poll,
 	.unlocked_ioctl = esdm_cdev_ioctl,
 	.llseek = no_llseek,
 };
@@ -222,6 +289,7 @@ static void __exit esdm_es_mgr_exit(void)
 	esdm_test_exit();
 	esdm_es_mgr_sched_exit();
 	esdm_es_mgr_irq_exit();
+	irq_work_sync(&esdm_es_notify_irq_work);
 }
 
 module_init(esdm_es_mgr_init);
@@ -21,5 +21,6 @@
 #define ESDM_ES_MGR_H
 
 bool esdm_enforce_panic_on_permanent_health_failure(void);
+void esdm_es_mgr_notify(void);
 
 #endif /* ESDM_ES_MGR_H */
@@ -109,6 +109,18 @@ bool esdm_highres_timer(void);
 #define ESDM_DATA_SLOTS_MASK (ESDM_DATA_SLOTS_PER_UINT - 1)
 #define ESDM_DATA_ARRAY_SIZE (ESDM_DATA_NUM_VALUES / ESDM_DATA_SLOTS_PER_UINT)
 
+/*
+ * A waiter on /dev/esdm_es is notified each time a CPU collected a quarter of
+ * its time stamp array since the last read of the entropy pool.
+ */
+#define ESDM_DATA_NOTIFY_MASK ((ESDM_DATA_NUM_VALUES >> 2) - 1)
+
+static inline bool esdm_data_notify(u32 events)
+{
+	return !(events & ESDM_DATA_NOTIFY_MASK) &&
+	       events <= ESDM_DATA_NUM_VALUES;
+}
+
 /* Starting bit index of slot */
 static inline unsigned int esdm_data_slot2bitindex(unsigned int slot)
 {
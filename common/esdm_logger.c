@@ -18,19 +18,26 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <sys/types.h>
 #include <syslog.h>
 #include <time.h>
 
+#include "atomic.h"
+#include "atomic_bool.h"
 #include "build_bug_on.h"
 #include "constructor.h"
 #include "helper.h"
 #include "esdm_logger.h"
+#include "math_helper.h"
 #include "term_colors.h"
 #include "threading_support.h"
 #include "visibility.h"
@@ -167,37 +174,23 @@ static void log_syslog(int severity, const char *format, ...)
 	vsyslog(log_prio, format, args);
 }
 
-DSO_PUBLIC
-void _esdm_logger(const enum esdm_logger_verbosity severity,
-		  const enum esdm_logger_class class, const char *file,
-		  const char *func, const uint32_t line, const char *fmt, ...)
+static void esdm_logger_print(const enum esdm_logger_verbosity severity,
+			      const enum esdm_logger_class class,
+			      const char *file, const char *func,
+			      const uint32_t line, const char *thread_name,
+			      time_t now, const char *msg)
 {
-	time_t now;
 	struct tm now_detail;
-	va_list args;
 	int (*fprintf_color)(FILE *stream, const char *format, ...) = &fprintf;
 	int ret;
-	char msg[4096];
 	char sev[10];
 	char c[30];
-	char thread_name[ESDM_THREAD_MAX_NAMELEN];
-
-	if (!esdm_logger_stream)
-		esdm_logger_stream = stderr;
-
-	if (severity > esdm_logger_verbosity_level)
-		return;
-
-	va_start(args, fmt);
-	vsnprintf(msg, sizeof(msg), fmt, args);
-	va_end(args);
 
 	esdm_logger_severity(severity, sev, sizeof(sev));
 	ret = esdm_logger_class(class, c, sizeof(c));
 	if (ret)
 		return;
 
-	now = time(NULL);
 	localtime_r(&now, &now_detail);
 
 	switch (severity) {
@@ -225,8 +218,6 @@ void _esdm_logger(const enum esdm_logger_verbosity severity,
 		fprintf_color = &fprintf;
 	}
 
-	thread_get_name(thread_name, sizeof(thread_name));
-
 	switch (esdm_logger_verbosity_level) {
 	case LOGGER_DEBUG2:
 	case LOGGER_DEBUG:
@@ -267,8 +258,751 @@ void _esdm_logger(const enum esdm_logger_verbosity severity,
 	}
 }
 
+/******************************************************************************
+ * Asynchronous logging
+ *
+ * Each thread records its log events into its own ring buffer without taking
+ * any lock. An event holds the pointer to the format string and the raw
+ * arguments. The drain thread collects the events of all threads in time
+ * order and performs the formatting and the output.
+ *
+ * Only messages with severity LOGGER_VERBOSE and higher are logged
+ * asynchronously. Status, error and warning messages are logged directly
+ * to ensure they are visible immediately.
+ ******************************************************************************/
+
+#define ESDM_LOGGER_RING_ENTRIES 128 /* Must be a power of 2 */
+#define ESDM_LOGGER_EVENT_ARGS 8
+#define ESDM_LOGGER_EVENT_STRLEN 512
+#define ESDM_LOGGER_SPEC_MAXLEN 32
+#define ESDM_LOGGER_DRAIN_INTERVAL_MS 100
+
+enum esdm_logger_arg_type {
+	esdm_logger_arg_none,
+	esdm_logger_arg_int,
+	esdm_logger_arg_long,
+	esdm_logger_arg_llong,
+	esdm_logger_arg_uint,
+	esdm_logger_arg_ulong,
+	esdm_logger_arg_ullong,
+	esdm_logger_arg_size,
+	esdm_logger_arg_ssize,
+	esdm_logger_arg_intmax,
+	esdm_logger_arg_uintmax,
+	esdm_logger_arg_ptrdiff,
+	esdm_logger_arg_double,
+	esdm_logger_arg_ldouble,
+	esdm_logger_arg_ptr,
+	esdm_logger_arg_str,
+};
+
+union esdm_logger_arg {
+	int i;
+	long l;
+	long long ll;
+	unsigned int u;
+	unsigned long ul;
+	unsigned long long ull;
+	size_t z;
+	ssize_t sz;
+	intmax_t j;
+	uintmax_t uj;
+	ptrdiff_t t;
+	double d;
+	long double ld;
+	const void *p;
+	uint32_t str_off;
+};
+
+struct esdm_logger_spec {
+	const char *start; /* Start of conversion specification */
+	size_t len; /* Length of conversion specification */
+	unsigned int stars; /* Number of '*' width / precision arguments */
+	enum esdm_logger_arg_type type;
+};
+
+struct esdm_logger_event {
+	struct timespec ts;
+	const char *fmt; /* NULL: str contains the formatted message */
+	const char *file;
+	const char *func;
+	uint32_t line;
+	enum esdm_logger_verbosity severity;
+	enum esdm_logger_class class;
+	uint32_t nargs;
+	uint32_t strlen;
+	union esdm_logger_arg args[ESDM_LOGGER_EVENT_ARGS];
+	char thread_name[ESDM_THREAD_MAX_NAMELEN];
+	char str[ESDM_LOGGER_EVENT_STRLEN];
+};
+
+struct esdm_logger_ring {
+	struct esdm_logger_ring *next;
+	atomic_t head; /* Written by owning thread only */
+	atomic_t tail; /* Written by drain thread only */
+	atomic_t dropped;
+	atomic_bool_t orphaned; /* Owning thread terminated */
+	struct esdm_logger_event events[ESDM_LOGGER_RING_ENTRIES];
+};
+
+static atomic_bool_t esdm_logger_async = ATOMIC_BOOL_INIT(false);
+static bool esdm_logger_async_stop = false;
+/* Drain thread waits for the first event without timeout */
+static atomic_bool_t esdm_logger_drain_idle = ATOMIC_BOOL_INIT(false);
+static pthread_t esdm_logger_drain_thread;
+static pthread_mutex_t esdm_logger_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t esdm_logger_drain_cv = PTHREAD_COND_INITIALIZER;
+static struct esdm_logger_ring *esdm_logger_rings = NULL;
+static pthread_key_t esdm_logger_ring_key;
+static __thread struct esdm_logger_ring *esdm_logger_ring_curr = NULL;
+
+/*
+ * Parse the next conversion specification of the format string.
+ *
+ * Return 1 if a specification was found, 0 if the end of the string was
+ * reached and < 0 if the specification cannot be handled asynchronously.
+ */
+static int esdm_logger_fmt_next(const char **fmt, struct esdm_logger_spec *spec)
+{
+	const char *p = *fmt;
+	bool is_long_double = false;
+	unsigned int len_mod = 0;
+	char modifier = 0;
+
+	while (*p && *p != '%')
+		p++;
+	if (!*p) {
+		*fmt = p;
+		return 0;
+	}
+
+	spec->start = p;
+	spec->stars = 0;
+	spec->type = esdm_logger_arg_none;
+	p++;
+
+	if (*p == '%') {
+		p++;
+		goto out;
+	}
+
+	/* Flags */
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+
+	/* Width */
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	/* Precision */
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			p++;
+		} else {
+			while (*p >= '0' && *p <= '9')
+				p++;
+		}
+	}
+
+	/* Length modifier */
+	while (*p && strchr("hlLqjzt", *p)) {
+		if (*p == 'L')
+			is_long_double = true;
+		modifier = *p;
+		len_mod++;
+		p++;
+	}
+	if (len_mod > 2)
+		return -EINVAL;
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+		if (modifier == 'l')
+			spec->type = (len_mod == 2) ? esdm_logger_arg_llong :
+						      esdm_logger_arg_long;
+		else if (modifier == 'q')
+			spec->type = esdm_logger_arg_llong;
+		else if (modifier == 'z')
+			spec->type = esdm_logger_arg_ssize;
+		else if (modifier == 'j')
+			spec->type = esdm_logger_arg_intmax;
+		else if (modifier == 't')
+			spec->type = esdm_logger_arg_ptrdiff;
+		else
+			spec->type = esdm_logger_arg_int;
+		break;
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		if (modifier == 'l')
+			spec->type = (len_mod == 2) ? esdm_logger_arg_ullong :
+						      esdm_logger_arg_ulong;
+		else if (modifier == 'q')
+			spec->type = esdm_logger_arg_ullong;
+		else if (modifier == 'z')
+			spec->type = esdm_logger_arg_size;
+		else if (modifier == 'j')
+			spec->type = esdm_logger_arg_uintmax;
+		else if (modifier == 't')
+			spec->type = esdm_logger_arg_ptrdiff;
+		else
+			spec->type = esdm_logger_arg_uint;
+		break;
+	case 'c':
+		/* Wide characters are not supported */
+		if (len_mod)
+			return -EINVAL;
+		spec->type = esdm_logger_arg_int;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->type = is_long_double ? esdm_logger_arg_ldouble :
+					      esdm_logger_arg_double;
+		break;
+	case 'p':
+		spec->type = esdm_logger_arg_ptr;
+		break;
+	case 's':
+		/* Wide character strings are not supported */
+		if (len_mod)
+			return -EINVAL;
+		spec->type = esdm_logger_arg_str;
+		break;
+	default:
+		/* %n, %m and unknown conversions */
+		return -EINVAL;
+	}
+	p++;
+
+out:
+	spec->len = (size_t)(p - spec->start);
+	if (spec->len >= ESDM_LOGGER_SPEC_MAXLEN)
+		return -EINVAL;
+
+	*fmt = p;
+	return 1;
+}
+
+/* Record the arguments of the log message - returns < 0 if not possible */
+static int esdm_logger_event_args(struct esdm_logger_event *ev,
+				  const char *fmt, va_list args)
+{
+	struct esdm_logger_spec spec;
+	int ret;
+
+	ev->nargs = 0;
+	ev->strlen = 0;
+
+	while ((ret = esdm_logger_fmt_next(&fmt, &spec)) > 0) {
+		union esdm_logger_arg *arg;
+		unsigned int i;
+
+		if (spec.type == esdm_logger_arg_none)
+			continue;
+
+		if (ev->nargs + spec.stars + 1 > ESDM_LOGGER_EVENT_ARGS)
+			return -E2BIG;
+
+		for (i = 0; i < spec.stars; i++)
+			ev->args[ev->nargs++].i = va_arg(args, int);
+
+		arg = &ev->args[ev->nargs++];
+
+		switch (spec.type) {
+		case esdm_logger_arg_int:
+			arg->i = va_arg(args, int);
+			break;
+		case esdm_logger_arg_long:
+			arg->l = va_arg(args, long);
+			break;
+		case esdm_logger_arg_llong:
+			arg->ll = va_arg(args, long long);
+			break;
+		case esdm_logger_arg_uint:
+			arg->u = va_arg(args, unsigned int);
+			break;
+		case esdm_logger_arg_ulong:
+			arg->ul = va_arg(args, unsigned long);
+			break;
+		case esdm_logger_arg_ullong:
+			arg->ull = va_arg(args, unsigned long long);
+			break;
+		case esdm_logger_arg_size:
+			arg->z = va_arg(args, size_t);
+			break;
+		case esdm_logger_arg_ssize:
+			arg->sz = va_arg(args, ssize_t);
+			break;
+		case esdm_logger_arg_intmax:
+			arg->j = va_arg(args, intmax_t);
+			break;
+		case esdm_logger_arg_uintmax:
+			arg->uj = va_arg(args, uintmax_t);
+			break;
+		case esdm_logger_arg_ptrdiff:
+			arg->t = va_arg(args, ptrdiff_t);
+			break;
+		case esdm_logger_arg_double:
+			arg->d = va_arg(args, double);
+			break;
+		case esdm_logger_arg_ldouble:
+			arg->ld = va_arg(args, long double);
+			break;
+		case esdm_logger_arg_ptr:
+			arg->p = va_arg(args, const void *);
+			break;
+		case esdm_logger_arg_str: {
+			/* The string may be gone when the event is formatted */
+			const char *str = va_arg(args, const char *);
+			size_t len, avail = sizeof(ev->str) - ev->strlen;
+
+			if (!str)
+				str = "(null)";
+			if (!avail)
+				return -E2BIG;
+
+			len = strnlen(str, avail - 1);
+			memcpy(ev->str + ev->strlen, str, len);
+			ev->str[ev->strlen + len] = '\0';
+			arg->str_off = ev->strlen;
+			ev->strlen += (uint32_t)len + 1;
+			break;
+		}
+		case esdm_logger_arg_none:
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return ret;
+}
+
+static void esdm_logger_ring_release(void *data)
+{
+	struct esdm_logger_ring *ring = data;
+
+	/* The drain thread frees the ring once it is empty */
+	if (ring)
+		atomic_bool_set_true(&ring->orphaned);
+}
+
+static struct esdm_logger_ring *esdm_logger_ring_get(void)
+{
+	struct esdm_logger_ring *ring = esdm_logger_ring_curr;
+
+	if (ring)
+		return ring;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	pthread_mutex_lock(&esdm_logger_drain_lock);
+	ring->next = esdm_logger_rings;
+	esdm_logger_rings = ring;
+	pthread_mutex_unlock(&esdm_logger_drain_lock);
+
+	pthread_setspecific(esdm_logger_ring_key, ring);
+	esdm_logger_ring_curr = ring;
+
+	return ring;
+}
+
+/* Returns 0 if the event was recorded, < 0 if it must be logged directly */
+static int esdm_logger_async_record(const enum esdm_logger_verbosity severity,
+				    const enum esdm_logger_class class,
+				    const char *file, const char *func,
+				    const uint32_t line, const char *fmt,
+				    va_list args)
+{
+	struct esdm_logger_ring *ring = esdm_logger_ring_get();
+	struct esdm_logger_event *ev;
+	unsigned int head, tail;
+	va_list args_copy;
+	int ret;
+
+	if (!ring)
+		return -ENOMEM;
+
+	head = (unsigned int)atomic_read(&ring->head);
+	tail = (unsigned int)atomic_read(&ring->tail);
+	if (head - tail >= ESDM_LOGGER_RING_ENTRIES) {
+		atomic_inc(&ring->dropped);
+		pthread_cond_signal(&esdm_logger_drain_cv);
+		return 0;
+	}
+
+	ev = &ring->events[head & (ESDM_LOGGER_RING_ENTRIES - 1)];
+	clock_gettime(CLOCK_REALTIME, &ev->ts);
+	ev->fmt = fmt;
+	ev->file = file;
+	ev->func = func;
+	ev->line = line;
+	ev->severity = severity;
+	ev->class = class;
+
+	va_copy(args_copy, args);
+	ret = esdm_logger_event_args(ev, fmt, args_copy);
+	va_end(args_copy);
+
+	/* Fall back to formatting the message in the caller's context */
+	if (ret < 0) {
+		ev->fmt = NULL;
+		vsnprintf(ev->str, sizeof(ev->str), fmt, args);
+	}
+
+	thread_get_name(ev->thread_name, sizeof(ev->thread_name));
+
+	atomic_set(&ring->head, (int)(head + 1));
+
+	/*
+	 * Wake the drain thread if it is idle - the lock ensures that the
+	 * wakeup is not lost between its check for events and its wait. Kick
+	 * it early if the ring fills up.
+	 */
+	if (atomic_bool_read(&esdm_logger_drain_idle)) {
+		pthread_mutex_lock(&esdm_logger_drain_lock);
+		pthread_cond_signal(&esdm_logger_drain_cv);
+		pthread_mutex_unlock(&esdm_logger_drain_lock);
+	} else if (head - tail == ESDM_LOGGER_RING_ENTRIES / 2) {
+		pthread_cond_signal(&esdm_logger_drain_cv);
+	}
+
+	return 0;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#define ESDM_LOGGER_SNPRINTF(val)                                              \
+	(spec->stars == 2 ? snprintf(out, outlen, specbuf, star[0], star[1],   \
+				     val) :                                    \
+	 spec->stars == 1 ? snprintf(out, outlen, specbuf, star[0], val) :     \
+			    snprintf(out, outlen, specbuf, val))
+
+static int esdm_logger_format_arg(char *out, size_t outlen,
+				  const struct esdm_logger_spec *spec,
+				  const int *star,
+				  const union esdm_logger_arg *arg,
+				  const struct esdm_logger_event *ev)
+{
+	char specbuf[ESDM_LOGGER_SPEC_MAXLEN];
+
+	memcpy(specbuf, spec->start, spec->len);
+	specbuf[spec->len] = '\0';
+
+	switch (spec->type) {
+	case esdm_logger_arg_none:
+		/* Only "%%" has no argument */
+		return snprintf(out, outlen, "%%");
+	case esdm_logger_arg_int:
+		return ESDM_LOGGER_SNPRINTF(arg->i);
+	case esdm_logger_arg_long:
+		return ESDM_LOGGER_SNPRINTF(arg->l);
+	case esdm_logger_arg_llong:
+		return ESDM_LOGGER_SNPRINTF(arg->ll);
+	case esdm_logger_arg_uint:
+		return ESDM_LOGGER_SNPRINTF(arg->u);
+	case esdm_logger_arg_ulong:
+		return ESDM_LOGGER_SNPRINTF(arg->ul);
+	case esdm_logger_arg_ullong:
+		return ESDM_LOGGER_SNPRINTF(arg->ull);
+	case esdm_logger_arg_size:
+		return ESDM_LOGGER_SNPRINTF(arg->z);
+	case esdm_logger_arg_ssize:
+		return ESDM_LOGGER_SNPRINTF(arg->sz);
+	case esdm_logger_arg_intmax:
+		return ESDM_LOGGER_SNPRINTF(arg->j);
+	case esdm_logger_arg_uintmax:
+		return ESDM_LOGGER_SNPRINTF(arg->uj);
+	case esdm_logger_arg_ptrdiff:
+		return ESDM_LOGGER_SNPRINTF(arg->t);
+	case esdm_logger_arg_double:
+		return ESDM_LOGGER_SNPRINTF(arg->d);
+	case esdm_logger_arg_ldouble:
+		return ESDM_LOGGER_SNPRINTF(arg->ld);
+	case esdm_logger_arg_ptr:
+		return ESDM_LOGGER_SNPRINTF(arg->p);
+	case esdm_logger_arg_str:
+		return ESDM_LOGGER_SNPRINTF(ev->str + arg->str_off);
+	default:
+		return 0;
+	}
+}
+#undef ESDM_LOGGER_SNPRINTF
+#pragma GCC diagnostic pop
+
+static void esdm_logger_event_format(const struct esdm_logger_event *ev,
+				     char *msg, size_t msglen)
+{
+	struct esdm_logger_spec spec;
+	const char *fmt = ev->fmt, *literal = ev->fmt;
+	size_t pos = 0;
+	uint32_t argidx = 0;
+
+	if (!fmt) {
+		snprintf(msg, msglen, "%s", ev->str);
+		return;
+	}
+
+	while (pos < msglen - 1) {
+		int star[2] = { 0, 0 }, ret;
+		unsigned int i;
+		size_t len;
+
+		ret = esdm_logger_fmt_next(&fmt, &spec);
+
+		/* Copy the literal text preceding the specification */
+		len = (size_t)((ret > 0 ? spec.start : fmt) - literal);
+		len = min_size(len, msglen - 1 - pos);
+		memcpy(msg + pos, literal, len);
+		pos += len;
+		literal = fmt;
+
+		if (ret <= 0)
+			break;
+
+		for (i = 0; i < spec.stars; i++)
+			star[i] = ev->args[argidx++].i;
+
+		ret = esdm_logger_format_arg(msg + pos, msglen - pos, &spec,
+					     star, &ev->args[argidx], ev);
+		if (spec.type != esdm_logger_arg_none)
+			argidx++;
+		if (ret > 0)
+			pos = min_size(pos + (size_t)ret, msglen - 1);
+	}
+
+	msg[pos] = '\0';
+}
+
+/* Output the events of all rings in time order */
+static void esdm_logger_drain(void)
+{
+	struct esdm_logger_ring *ring, **prev;
+	char msg[4096];
+
+	for (;;) {
+		struct esdm_logger_ring *oldest = NULL;
+		struct esdm_logger_event *oldest_ev = NULL;
+
+		for (ring = esdm_logger_rings; ring; ring = ring->next) {
+			unsigned int tail = (unsigned int)atomic_read(&ring->tail);
+			struct esdm_logger_event *ev;
+			int dropped;
+
+			dropped = atomic_xchg(&ring->dropped, 0);
+			if (dropped) {
+				fprintf(esdm_logger_stream,
+					"ESDM: %d log messages dropped\n",
+					dropped);
+			}
+
+			if (tail == (unsigned int)atomic_read(&ring->head))
+				continue;
+
+			ev = &ring->events[tail &
+					   (ESDM_LOGGER_RING_ENTRIES - 1)];
+			if (!oldest_ev ||
+			    ev->ts.tv_sec < oldest_ev->ts.tv_sec ||
+			    (ev->ts.tv_sec == oldest_ev->ts.tv_sec &&
+			     ev->ts.tv_nsec < oldest_ev->ts.tv_nsec)) {
+				oldest = ring;
+				oldest_ev = ev;
+			}
+		}
+
+		if (!oldest)
+			break;
+
+		esdm_logger_event_format(oldest_ev, msg, sizeof(msg));
+		esdm_logger_print(oldest_ev->severity, oldest_ev->class,
+				  oldest_ev->file, oldest_ev->func,
+				  oldest_ev->line, oldest_ev->thread_name,
+				  oldest_ev->ts.tv_sec, msg);
+
+		atomic_inc(&oldest->tail);
+	}
+
+	if (!use_syslog)
+		fflush(esdm_logger_stream);
+
+	/* Release the rings of terminated threads */
+	prev = &esdm_logger_rings;
+	while ((ring = *prev)) {
+		if (atomic_bool_read(&ring->orphaned) &&
+		    atomic_read(&ring->tail) == atomic_read(&ring->head)) {
+			*prev = ring->next;
+			free(ring);
+			continue;
+		}
+		prev = &ring->next;
+	}
+}
+
+/* Are all rings empty? - caller must hold the drain lock */
+static bool esdm_logger_rings_empty(void)
+{
+	struct esdm_logger_ring *ring;
+
+	for (ring = esdm_logger_rings; ring; ring = ring->next) {
+		if (atomic_read(&ring->tail) != atomic_read(&ring->head) ||
+		    atomic_read(&ring->dropped))
+			return false;
+	}
+
+	return true;
+}
+
+static void *esdm_logger_drain_thread_func(void *unused)
+{
+	(void)unused;
+
+	pthread_setname_np(pthread_self(), "ESDM logger");
+
+	pthread_mutex_lock(&esdm_logger_drain_lock);
+	while (!esdm_logger_async_stop) {
+		struct timespec ts;
+
+		/*
+		 * Without pending events, sleep until the next event is
+		 * recorded. Announce the idle state before checking the rings
+		 * again to not miss an event recorded in between.
+		 */
+		if (esdm_logger_rings_empty()) {
+			atomic_bool_set_true(&esdm_logger_drain_idle);
+			if (esdm_logger_rings_empty() && !esdm_logger_async_stop)
+				pthread_cond_wait(&esdm_logger_drain_cv,
+						  &esdm_logger_drain_lock);
+			atomic_bool_set_false(&esdm_logger_drain_idle);
+			esdm_logger_drain();
+			continue;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += ESDM_LOGGER_DRAIN_INTERVAL_MS * 1000 * 1000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&esdm_logger_drain_cv,
+				       &esdm_logger_drain_lock, &ts);
+
+		esdm_logger_drain();
+	}
+
+	/* Final flush */
+	esdm_logger_drain();
+	pthread_mutex_unlock(&esdm_logger_drain_lock);
+
+	return NULL;
+}
+
+DSO_PUBLIC
+int esdm_logger_enable_async(void)
+{
+	static bool key_initialized = false;
+	int ret;
+
+	if (atomic_bool_read(&esdm_logger_async))
+		return 0;
+
+	if (!key_initialized) {
+		ret = -pthread_key_create(&esdm_logger_ring_key,
+					  esdm_logger_ring_release);
+		if (ret)
+			return ret;
+		key_initialized = true;
+	}
+
+	esdm_logger_async_stop = false;
+	ret = -pthread_create(&esdm_logger_drain_thread, NULL,
+			      esdm_logger_drain_thread_func, NULL);
+	if (ret)
+		return ret;
+
+	atomic_bool_set_true(&esdm_logger_async);
+
+	return 0;
+}
+
+DSO_PUBLIC
+void esdm_logger_disable_async(void)
+{
+	if (!atomic_bool_cmpxchg(&esdm_logger_async, true, false))
+		return;
+
+	pthread_mutex_lock(&esdm_logger_drain_lock);
+	esdm_logger_async_stop = true;
+	pthread_cond_signal(&esdm_logger_drain_cv);
+	pthread_mutex_unlock(&esdm_logger_drain_lock);
+
+	pthread_join(esdm_logger_drain_thread, NULL);
+}
+
+DSO_PUBLIC
+void _esdm_logger(const enum esdm_logger_verbosity severity,
+		  const enum esdm_logger_class class, const char *file,
+		  const char *func, const uint32_t line, const char *fmt, ...)
+{
+	time_t now;
+	va_list args;
+	unsigned int idx;
+	char msg[4096];
+	char thread_name[ESDM_THREAD_MAX_NAMELEN];
+
+	if (!esdm_logger_stream)
+		esdm_logger_stream = stderr;
+
+	if (severity > esdm_logger_verbosity_level)
+		return;
+
+	/* Filtered class - do not spend any effort on it */
+	if (esdm_logger_class_idx(class, &idx))
+		return;
+
+	if (severity >= LOGGER_VERBOSE &&
+	    atomic_bool_read(&esdm_logger_async)) {
+		int ret;
+
+		va_start(args, fmt);
+		ret = esdm_logger_async_record(severity, class, file, func,
+					       line, fmt, args);
+		va_end(args);
+
+		if (!ret)
+			return;
+	}
+
+	va_start(args, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, args);
+	va_end(args);
+
+	now = time(NULL);
+	thread_get_name(thread_name, sizeof(thread_name));
+
+	esdm_logger_print(severity, class, file, func, line, thread_name, now,
+			  msg);
+}
+
 static void esdm_logger_destructor(void)
 {
+	esdm_logger_disable_async();
+
 	if (esdm_logger_stream && esdm_logger_stream != stderr)
 		fclose(esdm_logger_stream);
 
@@ -63,6 +63,16 @@ void _esdm_logger_binary(const enum esdm_logger_verbosity severity,
 			 const char *str, const char *file, const char *func,
 			 const uint32_t line);
 
+/*
+ * When compiling with ESDM_LOGGER_NO_DEBUG, all log messages with the severity
+ * LOGGER_DEBUG and LOGGER_DEBUG2 are removed at compile time.
+ */
+#ifdef ESDM_LOGGER_NO_DEBUG
+#define ESDM_LOGGER_MAX_COMPILED_LEVEL LOGGER_VERBOSE
+#else
+#define ESDM_LOGGER_MAX_COMPILED_LEVEL LOGGER_MAX_LEVEL
+#endif
+
 /**
  * logger - log string with given severity
  * @param severity maximum severity level that causes the log entry to be logged
@@ -80,8 +90,11 @@ void _esdm_logger_binary(const enum esdm_logger_verbosity severity,
 	do {                                                                   \
 		_Pragma("GCC diagnostic push")                                 \
 			_Pragma("GCC diagnostic ignored \"-Wpedantic\"")       \
-				_esdm_logger(severity, class_, __FILE__,       \
-					     __FUNCTION__, __LINE__, ##fmt);   \
+				if ((severity) <=                              \
+				    ESDM_LOGGER_MAX_COMPILED_LEVEL)            \
+					_esdm_logger(severity, class_,         \
+						     __FILE__, __FUNCTION__,   \
+						     __LINE__, ##fmt);         \
 		_Pragma("GCC diagnostic pop")                                  \
 	} while (0);
 #pragma GCC diagnostic pop
@@ -144,6 +157,27 @@ int esdm_logger_set_file(const char *pathname);
  */
 FILE *esdm_logger_log_stream(void);
 
+/**
+ * Enable asynchronous logging
+ *
+ * Log messages with severity LOGGER_VERBOSE and higher are recorded into a
+ * ring buffer of the calling thread and formatted and written by a separate
+ * thread. This reduces the overhead for the caller when using debug logging.
+ * If the ring buffer of a thread is full, messages are dropped and the number
+ * of dropped messages is logged.
+ *
+ * Note: call this function after a potential fork as the log thread is not
+ *	 available in a child process.
+ *
+ * @return 0 on success, < 0 on error
+ */
+int esdm_logger_enable_async(void);
+
+/**
+ * Write all pending log messages and disable asynchronous logging
+ */
+void esdm_logger_disable_async(void);
+
 /**
  * enable logging to syslog instead of stderr
  * @param [in] daemon_name may be null (then ESDM)
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "rcu.h"
+
+__thread struct rcu_reader rcu_reader_self = {
+	.gp = 0, .nesting = 0, .registered = false, .next = NULL, .prev = NULL
+};
+
+/* Grace period counter - 0 marks a quiescent reader */
+volatile uint64_t rcu_gp_ctr = 1;
+
+/* List of registered readers, also serializes the updaters */
+static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct rcu_reader *rcu_readers = NULL;
+
+static pthread_once_t rcu_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rcu_key;
+
+/* Remove the reader of a terminating thread from the registry */
+static void rcu_unregister_thread(void *arg)
+{
+	struct rcu_reader *r = arg;
+
+	pthread_mutex_lock(&rcu_registry_lock);
+	if (r->prev)
+		r->prev->next = r->next;
+	else
+		rcu_readers = r->next;
+	if (r->next)
+		r->next->prev = r->prev;
+	r->next = NULL;
+	r->prev = NULL;
+	r->registered = false;
+	pthread_mutex_unlock(&rcu_registry_lock);
+}
+
+static void rcu_key_init(void)
+{
+	pthread_key_create(&rcu_key, rcu_unregister_thread);
+}
+
+void rcu_register_thread(void)
+{
+	struct rcu_reader *r = &rcu_reader_self;
+
+	pthread_once(&rcu_key_once, rcu_key_init);
+
+	pthread_mutex_lock(&rcu_registry_lock);
+	r->prev = NULL;
+	r->next = rcu_readers;
+	if (rcu_readers)
+		rcu_readers->prev = r;
+	rcu_readers = r;
+	r->registered = true;
+	pthread_mutex_unlock(&rcu_registry_lock);
+
+	/* Unregister when the thread terminates */
+	pthread_setspecific(rcu_key, r);
+}
+
+void synchronize_rcu(void)
+{
+	/*
+	 * Updates are rare, sleep instead of spinning to not compete with the
+	 * readers for the CPU.
+	 */
+	static const struct timespec rcu_poll = { .tv_sec = 0,
+						  .tv_nsec = 100000 };
+	struct rcu_reader *r;
+	uint64_t gp;
+
+	/* Order the pointer update before the grace period update */
+	__sync_synchronize();
+
+	pthread_mutex_lock(&rcu_registry_lock);
+
+	gp = __sync_add_and_fetch(&rcu_gp_ctr, 1);
+
+	/*
+	 * Wait for all readers which entered their critical section before
+	 * the new grace period started. Readers entering afterwards see the
+	 * new pointer.
+	 */
+	for (r = rcu_readers; r; r = r->next) {
+		for (;;) {
+			uint64_t reader_gp =
+				__atomic_load_n(&r->gp, __ATOMIC_ACQUIRE);
+
+			if (!reader_gp || reader_gp >= gp)
+				break;
+
+			nanosleep(&rcu_poll, NULL);
+		}
+	}
+
+	pthread_mutex_unlock(&rcu_registry_lock);
+}
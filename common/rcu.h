@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef _RCU_H
+#define _RCU_H
+
+#include <stdint.h>
+
+#include "bool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read-copy-update equivalent to the Linux kernel API.
+ *
+ * Every thread entering a read-side critical section owns a reader record on
+ * its own cache line. The reader records the current grace period on entry
+ * and clears it on exit - the read side therefore never writes to memory
+ * shared with other readers.
+ *
+ * An updater publishes the new pointer with rcu_assign_pointer, calls
+ * synchronize_rcu to wait until all readers that may still see the old
+ * pointer left their critical section and then releases the old state.
+ */
+struct rcu_reader {
+	volatile uint64_t gp; /* Grace period at entry, 0 when quiescent */
+	unsigned int nesting;
+	bool registered;
+	struct rcu_reader *next;
+	struct rcu_reader *prev;
+} __attribute__((aligned(64)));
+
+extern __thread struct rcu_reader rcu_reader_self;
+extern volatile uint64_t rcu_gp_ctr;
+
+void rcu_register_thread(void);
+
+/**
+ * @brief Enter a read-side critical section
+ *
+ * Read-side critical sections may be nested. The caller must not call
+ * synchronize_rcu within a read-side critical section.
+ */
+static inline void rcu_read_lock(void)
+{
+	struct rcu_reader *r = &rcu_reader_self;
+
+	if (r->nesting++)
+		return;
+
+	if (!r->registered)
+		rcu_register_thread();
+
+	r->gp = rcu_gp_ctr;
+	/* Pairs with the barrier in synchronize_rcu */
+	__sync_synchronize();
+}
+
+/**
+ * @brief Leave a read-side critical section
+ */
+static inline void rcu_read_unlock(void)
+{
+	struct rcu_reader *r = &rcu_reader_self;
+
+	if (--r->nesting)
+		return;
+
+	__atomic_store_n(&r->gp, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Wait until all read-side critical sections which were active at the
+ *	  time of the call are completed.
+ *
+ * After this call returns, the state unpublished before this call can be
+ * released.
+ */
+void synchronize_rcu(void);
+
+/**
+ * @brief Obtain an RCU-protected pointer within a read-side critical section
+ */
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+/**
+ * @brief Publish a new value of an RCU-protected pointer
+ */
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RCU_H */
@@ -468,6 +468,9 @@ int thread_wait(void)
 	return ret;
 }
 
+/* Cache of the thread name to avoid a system call for each log message */
+static __thread char thread_name_cache[ESDM_THREAD_MAX_NAMELEN];
+
 DSO_PUBLIC
 int thread_set_name(enum esdm_request_type type, uint32_t id)
 {
@@ -492,11 +495,25 @@ int thread_set_name(enum esdm_request_type type, uint32_t id)
 	case es_kernel_feeder:
 		snprintf(name, sizeof(name), "ESDM krnl_feed");
 		break;
+	case get_seed_producer:
+		snprintf(name, sizeof(name), "ESDM seed");
+		break;
+	case es_hwrand_collector:
+		snprintf(name, sizeof(name), "ESDM hwrand");
+		break;
+	case seed_file_saver:
+		snprintf(name, sizeof(name), "ESDM seed file");
+		break;
+	case fips_post_integrity_test:
+		snprintf(name, sizeof(name), "ESDM FIPS POST");
+		break;
 	default:
 		snprintf(name, sizeof(name), "ESDM %u", id);
 		break;
 	}
 
+	memcpy(thread_name_cache, name, sizeof(thread_name_cache));
+
 #ifdef __APPLE__
 	return -pthread_setname_np(name);
 #else
@@ -507,6 +524,11 @@ int thread_set_name(enum esdm_request_type type, uint32_t id)
 DSO_PUBLIC
 int thread_get_name(char *name, size_t len)
 {
+	if (thread_name_cache[0]) {
+		snprintf(name, len, "%s", thread_name_cache);
+		return 0;
+	}
+
 	return -pthread_getname_np(pthread_self(), name, len);
 }
 
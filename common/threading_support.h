@@ -66,7 +66,10 @@ extern "C" {
 #define ESDM_THREAD_CUSE_POLL_GROUP ((uint32_t)-1)
 #define ESDM_THREAD_ES_MONITOR ((uint32_t)-2)
 #define ESDM_THREAD_RPC_UNPRIV_GROUP ((uint32_t)-3)
-#define ESDM_THREAD_MAX_SPECIAL_GROUPS 3
+#define ESDM_THREAD_GET_SEED ((uint32_t)-4)
+#define ESDM_THREAD_ES_HWRAND ((uint32_t)-5)
+#define ESDM_THREAD_SEED_FILE ((uint32_t)-6)
+#define ESDM_THREAD_MAX_SPECIAL_GROUPS 6
 
 enum esdm_request_type {
 	es_monitor,
@@ -75,6 +78,10 @@ enum esdm_request_type {
 	rpc_priv_server,
 	rpc_handler,
 	cuse_poll,
+	get_seed_producer,
+	es_hwrand_collector,
+	seed_file_saver,
+	fips_post_integrity_test,
 };
 
 /**
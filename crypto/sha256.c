@@ -20,7 +20,14 @@
 
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define LC_SHA256_SHANI
+#endif
+
 #include "bitshift_be.h"
+#include "bool.h"
 #include "lc_sha256.h"
 #include "memset_secure.h"
 #include "visibility.h"
@@ -45,20 +52,6 @@ static const uint32_t sha256_K[] = {
 	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
 };
 
-static void sha256_init(struct lc_hash_state *ctx)
-{
-	ctx->H[0] = 0x6a09e667;
-	ctx->H[1] = 0xbb67ae85;
-	ctx->H[2] = 0x3c6ef372;
-	ctx->H[3] = 0xa54ff53a;
-	ctx->H[4] = 0x510e527f;
-	ctx->H[5] = 0x9b05688c;
-	ctx->H[6] = 0x1f83d9ab;
-	ctx->H[7] = 0x5be0cd19;
-
-	ctx->msg_len = 0;
-}
-
 static inline uint32_t ror(uint32_t x, int n)
 {
 	return ((x >> (n & (32 - 1))) | (x << ((32 - n) & (32 - 1))));
@@ -123,6 +116,131 @@ static inline void sha256_transform(struct lc_hash_state *ctx,
 		W[i] = 0;
 }
 
+static void sha256_transform_c(struct lc_hash_state *ctx, const uint8_t *in,
+			       size_t blocks)
+{
+	for (; blocks; blocks--, in += LC_SHA256_SIZE_BLOCK)
+		sha256_transform(ctx, in);
+}
+
+#ifdef LC_SHA256_SHANI
+/*
+ * SHA-256 using the Intel SHA extensions - the state is kept in the ABEF /
+ * CDGH register layout required by SHA256RNDS2 while processing all blocks.
+ */
+__attribute__((target("sha,sse4.1"))) static void
+sha256_transform_shani(struct lc_hash_state *ctx, const uint8_t *in,
+		       size_t blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, msg, tmp, w[4];
+	unsigned int i;
+
+	tmp = _mm_loadu_si128((const __m128i *)&ctx->H[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&ctx->H[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1); /* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B); /* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8); /* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0); /* CDGH */
+
+	for (; blocks; blocks--, in += LC_SHA256_SIZE_BLOCK) {
+		abef = state0;
+		cdgh = state1;
+
+		/* Four rounds per iteration, the schedule is kept in w[] */
+		for (i = 0; i < 16; i++) {
+			const __m128i *k = (const __m128i *)&sha256_K[4 * i];
+
+			if (i < 4) {
+				msg = _mm_loadu_si128(
+					(const __m128i *)(in + 16 * i));
+				w[i] = _mm_shuffle_epi8(msg, mask);
+			} else {
+				__m128i w2 = w[(i + 2) & 3];
+				__m128i w3 = w[(i + 3) & 3];
+
+				tmp = _mm_sha256msg1_epu32(w[i & 3],
+							   w[(i + 1) & 3]);
+				tmp = _mm_add_epi32(tmp,
+						    _mm_alignr_epi8(w3, w2, 4));
+				w[i & 3] = _mm_sha256msg2_epu32(tmp, w3);
+			}
+
+			msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128(k));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B); /* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1); /* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0); /* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8); /* HGFE */
+
+	_mm_storeu_si128((__m128i *)&ctx->H[0], state0);
+	_mm_storeu_si128((__m128i *)&ctx->H[4], state1);
+
+	/* Zeroization of the message schedule */
+	memset_secure(w, 0, sizeof(w));
+}
+
+static bool sha256_shani_available(void)
+{
+	unsigned int a, b, c, d;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d))
+		return false;
+	/* SSSE3 and SSE4.1 */
+	if (!(c & (1U << 9)) || !(c & (1U << 19)))
+		return false;
+
+	if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+		return false;
+	/* SHA extensions */
+	return !!(b & (1U << 29));
+}
+#endif
+
+static void (*sha256_transform_blocks)(struct lc_hash_state *ctx,
+				       const uint8_t *in,
+				       size_t blocks) = NULL;
+
+/* Select the fastest available implementation once */
+static void sha256_select(void)
+{
+	void (*impl)(struct lc_hash_state *ctx, const uint8_t *in,
+		     size_t blocks) = sha256_transform_c;
+
+#ifdef LC_SHA256_SHANI
+	if (sha256_shani_available())
+		impl = sha256_transform_shani;
+#endif
+
+	__atomic_store_n(&sha256_transform_blocks, impl, __ATOMIC_RELEASE);
+}
+
+static void sha256_init(struct lc_hash_state *ctx)
+{
+	if (!__atomic_load_n(&sha256_transform_blocks, __ATOMIC_ACQUIRE))
+		sha256_select();
+
+	ctx->H[0] = 0x6a09e667;
+	ctx->H[1] = 0xbb67ae85;
+	ctx->H[2] = 0x3c6ef372;
+	ctx->H[3] = 0xa54ff53a;
+	ctx->H[4] = 0x510e527f;
+	ctx->H[5] = 0x9b05688c;
+	ctx->H[6] = 0x1f83d9ab;
+	ctx->H[7] = 0x5be0cd19;
+
+	ctx->msg_len = 0;
+}
+
 static void sha256_update(struct lc_hash_state *ctx, const uint8_t *in,
 			  size_t inlen)
 {
@@ -151,13 +269,17 @@ static void sha256_update(struct lc_hash_state *ctx, const uint8_t *in,
 		inlen -= todo;
 		in += todo;
 
-		sha256_transform(ctx, ctx->partial);
+		sha256_transform_blocks(ctx, ctx->partial, 1);
 	}
 
 	/* Perform a transformation of full block-size messages */
-	for (; inlen >= LC_SHA256_SIZE_BLOCK;
-	     inlen -= LC_SHA256_SIZE_BLOCK, in += LC_SHA256_SIZE_BLOCK)
-		sha256_transform(ctx, in);
+	if (inlen >= LC_SHA256_SIZE_BLOCK) {
+		size_t blocks = inlen / LC_SHA256_SIZE_BLOCK;
+
+		sha256_transform_blocks(ctx, in, blocks);
+		inlen -= blocks * LC_SHA256_SIZE_BLOCK;
+		in += blocks * LC_SHA256_SIZE_BLOCK;
+	}
 
 	/* If we have data left, copy it into the partial block buffer */
 	memcpy(ctx->partial, in, inlen);
@@ -183,7 +305,7 @@ static void sha256_final(struct lc_hash_state *ctx, uint8_t *digest)
 		memset(ctx->partial + partial, 0,
 		       LC_SHA256_SIZE_BLOCK - partial);
 		partial = 0;
-		sha256_transform(ctx, ctx->partial);
+		sha256_transform_blocks(ctx, ctx->partial, 1);
 	}
 
 	/* Fill the unused part of the partial buffer with zeros */
@@ -194,7 +316,7 @@ static void sha256_final(struct lc_hash_state *ctx, uint8_t *digest)
 	be64_to_ptr(ctx->partial + (LC_SHA256_SIZE_BLOCK - 8), ctx->msg_len);
 
 	/* Final transformation */
-	sha256_transform(ctx, ctx->partial);
+	sha256_transform_blocks(ctx, ctx->partial, 1);
 
 	memset_secure(ctx->partial, 0, LC_SHA256_SIZE_BLOCK);
 
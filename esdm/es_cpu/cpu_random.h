@@ -43,4 +43,31 @@ static inline unsigned int cpu_es_multiplier(void)
 
 #endif
 
+/*
+ * Fill the buffer with nwords values from the CPU entropy source. The values
+ * are obtained one after another, the loop is only unrolled to check the
+ * result once per four values.
+ */
+static inline bool cpu_es_get_bulk(unsigned long *buf, unsigned int nwords)
+{
+	unsigned int i;
+	bool ok = true;
+
+	for (i = 0; i + 4 <= nwords; i += 4) {
+		ok &= cpu_es_get(buf + i);
+		ok &= cpu_es_get(buf + i + 1);
+		ok &= cpu_es_get(buf + i + 2);
+		ok &= cpu_es_get(buf + i + 3);
+		if (!ok)
+			return false;
+	}
+
+	for (; i < nwords; i++) {
+		if (!cpu_es_get(buf + i))
+			return false;
+	}
+
+	return true;
+}
+
 #endif /* _CPU_RANDOM */
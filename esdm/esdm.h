@@ -52,7 +52,8 @@ int esdm_reinit(void);
  * This call is intended to be invoked from a thread to monitor the ES
  * for arrival of new entropy when not yet all DRNGs are initialized.
  * Yet, it is also permissible to call it in the current thread if one
- * wants to synchronously wait until all DRNGs are initialized.
+ * wants to synchronously wait until all DRNGs are initialized. The seed file
+ * is maintained by the process invoking this call.
  *
  * @param [in] priv_init_completion Optional function pointer that is called
  *				    when privileged initialization is complete
@@ -118,12 +119,56 @@ ssize_t esdm_get_random_bytes_full(uint8_t *buf, size_t nbytes);
 ssize_t esdm_get_random_bytes_full_timeout(uint8_t *buf, size_t nbytes,
 					   struct timespec *ts);
 
+/**
+ * @brief esdm_get_random_bytes_full_deadline - Provider of cryptographic strong
+ * random numbers from a fully initialized ESDM within a deadline.
+ *
+ * Contrary to esdm_get_random_bytes_full_timeout, the time budget covers the
+ * entire request, i.e. the waiting for the fully seeded ESDM as well as the
+ * generation of the random bytes. The request is never chosen to perform a
+ * synchronous reseed of the DRNG - a due reseed is left to other requests
+ * and the seeding thread - and it is served before regular requests when the
+ * DRNG is contended.
+ *
+ * @param [out] buf buffer to store the random bytes
+ * @param [in] nbytes size of the buffer
+ * @param [in] ts time budget of the request
+ * @param [out] deadline_met set to 1 if the random bytes were generated within
+ *			     the time budget, 0 otherwise (may be NULL)
+ *
+ * @return: positive number indicates amount of generated bytes, < 0 on error,
+ * -ETIMEDOUT if the ESDM was not fully seeded within the time budget
+ */
+ssize_t esdm_get_random_bytes_full_deadline(uint8_t *buf, size_t nbytes,
+					    const struct timespec *ts,
+					    int *deadline_met);
+
 /**
  * @brief see esdm_get_random_bytes_full except that in case of blocking,
  * it returns -EAGAIN.
  */
 ssize_t esdm_get_random_bytes_full_noblock(uint8_t *buf, size_t nbytes);
 
+/**
+ * @brief esdm_drng_tenant_set - Select the tenant of the calling thread
+ *
+ * When tenant DRNGs are enabled with esdm_config_drng_tenant_idle_set, the
+ * requests of the calling thread other than prediction resistance requests
+ * are served by a DRNG instance owned by the tenant. It is seeded from the
+ * DRNG of the node and released when the tenant did not use it for the
+ * configured idle period. If tenant DRNGs are disabled or the maximum number
+ * of tenants is reached, the requests are served by the DRNG of the node.
+ *
+ * @param [in] tenant Identifier of the tenant
+ */
+void esdm_drng_tenant_set(uint64_t tenant);
+
+/**
+ * @brief esdm_drng_tenant_unset - Serve the calling thread with the DRNG of
+ * the node again
+ */
+void esdm_drng_tenant_unset(void);
+
 /**
  * @brief esdm_get_random_bytes_min() - Provider of cryptographic strong
  * random numbers from at least a minimally seeded ESDM, which is not
@@ -18,6 +18,15 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atomic.h"
 #include "build_bug_on.h"
 #include "config.h"
 #include "esdm_config.h"
@@ -47,6 +56,18 @@ struct esdm_config {
 	bool esdm_es_irq_retry;
 	bool esdm_es_sched_retry;
 	bool esdm_jent_entropy_async_enable;
+	bool esdm_krng_reservoir_enable;
+	bool esdm_hwrand_async_enable;
+
+	uint32_t esdm_seed_file_entropy_bits;
+	char esdm_seed_file[PATH_MAX];
+
+	enum esdm_config_rpc_client_id esdm_rpc_client_id;
+	uint32_t esdm_rpc_rate_limit;
+	uint32_t esdm_rpc_rate_burst;
+	uint32_t esdm_rpc_fair_slots;
+
+	uint32_t esdm_drng_tenant_idle;
 };
 
 static struct esdm_config esdm_config = {
@@ -119,8 +140,48 @@ static struct esdm_config esdm_config = {
 
 	/* Enable the Jitter RNG buffer filling */
 	.esdm_jent_entropy_async_enable = true,
+
+	/* Prefetch the kernel RNG data into a reservoir */
+	.esdm_krng_reservoir_enable = false,
+
+	/* Enable the /dev/hwrng buffer filling */
+	.esdm_hwrand_async_enable = true,
+
+	/*
+	 * The seed file is disabled by default. When enabled, its content is
+	 * not credited with entropy unless configured otherwise as the ESDM
+	 * cannot verify that the file was not read or altered while the
+	 * system was down.
+	 */
+	.esdm_seed_file_entropy_bits = 0,
+	.esdm_seed_file = { 0 },
+
+	/* No per-client limits of the RPC server */
+	.esdm_rpc_client_id = esdm_config_rpc_client_uid,
+	.esdm_rpc_rate_limit = 0,
+	.esdm_rpc_rate_burst = 0,
+	.esdm_rpc_fair_slots = 0,
+
+	/* All clients share the DRNG of their node */
+	.esdm_drng_tenant_idle = 0,
 };
 
+/* CPU affinity of the ESDM thread classes */
+struct esdm_config_affinity_state {
+	cpu_set_t cpus;
+	uint32_t ncpus; /* Number of CPUs in set - 0 means not configured */
+	atomic_t next; /* Round-robin selector for pinning to one CPU */
+};
+
+static struct esdm_config_affinity_state
+	esdm_config_affinity[esdm_config_affinity_last];
+
+/* Affinity of the calling thread before it was pinned */
+static __thread cpu_set_t esdm_config_affinity_orig;
+
+/* Affinity class the calling thread is already pinned to */
+static __thread int esdm_config_affinity_curr = -1;
+
 static uint32_t esdm_config_entropy_rate_max(uint32_t val)
 {
 	return min_uint32(ESDM_DRNG_SECURITY_STRENGTH_BITS, val);
@@ -217,6 +278,18 @@ void esdm_config_es_krng_entropy_rate_set(uint32_t ent)
 	esdm_es_add_entropy();
 }
 
+DSO_PUBLIC
+uint32_t esdm_config_es_krng_reservoir_enabled(void)
+{
+	return esdm_config.esdm_krng_reservoir_enable;
+}
+
+DSO_PUBLIC
+void esdm_config_es_krng_reservoir_enabled_set(int setting)
+{
+	esdm_config.esdm_krng_reservoir_enable = !!setting;
+}
+
 DSO_PUBLIC
 uint32_t esdm_config_es_sched_entropy_rate(void)
 {
@@ -266,6 +339,116 @@ void esdm_config_es_hwrand_entropy_rate_set(uint32_t ent)
 	esdm_es_add_entropy();
 }
 
+DSO_PUBLIC
+uint32_t esdm_config_es_hwrand_async_enabled(void)
+{
+	return esdm_config.esdm_hwrand_async_enable;
+}
+
+DSO_PUBLIC
+void esdm_config_es_hwrand_async_enabled_set(int setting)
+{
+	esdm_config.esdm_hwrand_async_enable = !!setting;
+}
+
+DSO_PUBLIC
+const char *esdm_config_seed_file(void)
+{
+	return esdm_config.esdm_seed_file[0] ? esdm_config.esdm_seed_file :
+					       NULL;
+}
+
+DSO_PUBLIC
+int esdm_config_seed_file_set(const char *path)
+{
+	size_t len;
+
+	if (!path) {
+		esdm_config.esdm_seed_file[0] = '\0';
+		return 0;
+	}
+
+	len = strlen(path);
+	if (len >= sizeof(esdm_config.esdm_seed_file))
+		return -ENAMETOOLONG;
+
+	memcpy(esdm_config.esdm_seed_file, path, len + 1);
+	return 0;
+}
+
+DSO_PUBLIC
+uint32_t esdm_config_seed_file_entropy(void)
+{
+	return esdm_config.esdm_seed_file_entropy_bits;
+}
+
+DSO_PUBLIC
+void esdm_config_seed_file_entropy_set(uint32_t ent)
+{
+	esdm_config.esdm_seed_file_entropy_bits =
+		esdm_config_entropy_rate_max(ent);
+}
+
+DSO_PUBLIC
+enum esdm_config_rpc_client_id esdm_config_rpc_client_id(void)
+{
+	return esdm_config.esdm_rpc_client_id;
+}
+
+DSO_PUBLIC
+void esdm_config_rpc_client_id_set(enum esdm_config_rpc_client_id id)
+{
+	esdm_config.esdm_rpc_client_id = id;
+}
+
+DSO_PUBLIC
+uint32_t esdm_config_rpc_rate_limit(void)
+{
+	return esdm_config.esdm_rpc_rate_limit;
+}
+
+DSO_PUBLIC
+void esdm_config_rpc_rate_limit_set(uint32_t rate)
+{
+	esdm_config.esdm_rpc_rate_limit = rate;
+}
+
+DSO_PUBLIC
+uint32_t esdm_config_rpc_rate_burst(void)
+{
+	return esdm_config.esdm_rpc_rate_burst;
+}
+
+DSO_PUBLIC
+void esdm_config_rpc_rate_burst_set(uint32_t burst)
+{
+	esdm_config.esdm_rpc_rate_burst = burst;
+}
+
+DSO_PUBLIC
+uint32_t esdm_config_rpc_fair_slots(void)
+{
+	return esdm_config.esdm_rpc_fair_slots;
+}
+
+DSO_PUBLIC
+void esdm_config_rpc_fair_slots_set(uint32_t slots)
+{
+	esdm_config.esdm_rpc_fair_slots = slots;
+}
+
+DSO_PUBLIC
+uint32_t esdm_config_drng_tenant_idle(void)
+{
+	return esdm_config.esdm_drng_tenant_idle;
+}
+
+DSO_PUBLIC
+void esdm_config_drng_tenant_idle_set(uint32_t seconds)
+{
+	esdm_config.esdm_drng_tenant_idle = seconds;
+}
+
 DSO_PUBLIC
 uint32_t esdm_config_es_jent_kernel_entropy_rate(void)
 {
@@ -368,6 +551,191 @@ uint32_t esdm_config_curr_node(void)
 	return esdm_curr_node() % esdm_config_max_nodes();
 }
 
+/* Parse a CPU list like "0-3,8,10-11" */
+static int esdm_config_parse_cpulist(const char *cpulist, cpu_set_t *cpus,
+				     uint32_t *ncpus)
+{
+	const char *p = cpulist;
+
+	CPU_ZERO(cpus);
+	*ncpus = 0;
+
+	while (*p) {
+		unsigned long start, end;
+		char *endp;
+
+		if (!isdigit((unsigned char)*p))
+			return -EINVAL;
+		start = strtoul(p, &endp, 10);
+		end = start;
+		p = endp;
+
+		if (*p == '-') {
+			p++;
+			if (!isdigit((unsigned char)*p))
+				return -EINVAL;
+			end = strtoul(p, &endp, 10);
+			p = endp;
+		}
+
+		if (end < start || end >= CPU_SETSIZE)
+			return -EINVAL;
+
+		for (; start <= end; start++) {
+			if (!CPU_ISSET(start, cpus))
+				(*ncpus)++;
+			CPU_SET(start, cpus);
+		}
+
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+DSO_PUBLIC
+int esdm_config_affinity_set(enum esdm_config_affinity type,
+			     const char *cpulist)
+{
+	struct esdm_config_affinity_state *aff;
+	cpu_set_t cpus;
+	uint32_t ncpus;
+	int ret;
+
+	if (type >= esdm_config_affinity_last)
+		return -EINVAL;
+	aff = &esdm_config_affinity[type];
+
+	if (!cpulist || !*cpulist) {
+		aff->ncpus = 0;
+		return 0;
+	}
+
+	ret = esdm_config_parse_cpulist(cpulist, &cpus, &ncpus);
+	if (ret) {
+		esdm_logger(LOGGER_ERR, LOGGER_C_ANY,
+			    "Invalid CPU list \"%s\"\n", cpulist);
+		return ret;
+	}
+
+	aff->cpus = cpus;
+	aff->ncpus = ncpus;
+	atomic_set(&aff->next, 0);
+
+	return 0;
+}
+
+uint32_t esdm_config_affinity_ncpus(enum esdm_config_affinity type)
+{
+	if (type >= esdm_config_affinity_last)
+		return 0;
+	return esdm_config_affinity[type].ncpus;
+}
+
+bool esdm_config_affinity_isset(enum esdm_config_affinity type, uint32_t cpu)
+{
+	if (type >= esdm_config_affinity_last || cpu >= CPU_SETSIZE)
+		return false;
+	return !!CPU_ISSET(cpu, &esdm_config_affinity[type].cpus);
+}
+
+DSO_PUBLIC
+int esdm_config_affinity_apply(enum esdm_config_affinity type)
+{
+	struct esdm_config_affinity_state *aff;
+	cpu_set_t cpus;
+	uint32_t slot, i = 0;
+	int ret;
+
+	if (type >= esdm_config_affinity_last)
+		return -EINVAL;
+	aff = &esdm_config_affinity[type];
+
+	if (esdm_config_affinity_curr == (int)type)
+		return 0;
+
+	/* Thread was pinned for another class, release it again */
+	if (!aff->ncpus)
+		return esdm_config_affinity_release();
+
+	if (type != esdm_config_affinity_rpc) {
+		cpus = aff->cpus;
+		goto set;
+	}
+
+	/*
+	 * Pin the RPC worker to exactly one CPU of the set. The worker keeps
+	 * the pinning until it releases it after serving its connection and
+	 * thus services all requests of the connection with the same node
+	 * DRNG.
+	 */
+	slot = (uint32_t)atomic_inc(&aff->next) % aff->ncpus;
+	CPU_ZERO(&cpus);
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (!CPU_ISSET(i, &aff->cpus))
+			continue;
+		if (!slot) {
+			CPU_SET(i, &cpus);
+			break;
+		}
+		slot--;
+	}
+
+set:
+	/* Remember the affinity the thread had before it was pinned */
+	if (esdm_config_affinity_curr < 0 &&
+	    sched_getaffinity(0, sizeof(esdm_config_affinity_orig),
+			      &esdm_config_affinity_orig) < 0) {
+		ret = -errno;
+		esdm_logger(LOGGER_WARN, LOGGER_C_THREADING,
+			    "Getting CPU affinity failed: %s\n",
+			    strerror(-ret));
+		return ret;
+	}
+
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+		ret = -errno;
+		esdm_logger(LOGGER_WARN, LOGGER_C_THREADING,
+			    "Setting CPU affinity failed: %s\n",
+			    strerror(-ret));
+		return ret;
+	}
+
+	esdm_config_affinity_curr = (int)type;
+	if (type == esdm_config_affinity_rpc) {
+		esdm_logger(LOGGER_DEBUG, LOGGER_C_THREADING,
+			    "RPC worker pinned to CPU %u serviced by DRNG node %u\n",
+			    i, esdm_config_curr_node());
+	}
+
+	return 0;
+}
+
+DSO_PUBLIC
+int esdm_config_affinity_release(void)
+{
+	int ret;
+
+	if (esdm_config_affinity_curr < 0)
+		return 0;
+
+	if (sched_setaffinity(0, sizeof(esdm_config_affinity_orig),
+			      &esdm_config_affinity_orig) < 0) {
+		ret = -errno;
+		esdm_logger(LOGGER_WARN, LOGGER_C_THREADING,
+			    "Restoring CPU affinity failed: %s\n",
+			    strerror(-ret));
+		return ret;
+	}
+
+	esdm_config_affinity_curr = -1;
+
+	return 0;
+}
+
 int esdm_config_init(void)
 {
 	uint32_t complete_entropy_rate = 0;
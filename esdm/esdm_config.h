@@ -131,6 +131,25 @@ void esdm_config_es_krng_entropy_rate_set(uint32_t ent);
  */
 uint32_t esdm_config_es_krng_entropy_rate(void);
 
+/**
+ * @brief Obtain setting about the kernel RNG reservoir
+ *
+ * @return Boolean indicating whether the kernel RNG reservoir is enabled
+ */
+uint32_t esdm_config_es_krng_reservoir_enabled(void);
+
+/**
+ * @brief Enable or disable the kernel RNG reservoir
+ *
+ * When enabled, the ES monitor prefetches data from the kernel RNG into a
+ * bounded and locked memory buffer. Reseeds obtain the kernel RNG data from
+ * this reservoir instead of invoking the getrandom system call. The setting
+ * must be applied before the ESDM is initialized.
+ *
+ * @param [in] setting Boolean to enable the behavior
+ */
+void esdm_config_es_krng_reservoir_enabled_set(int setting);
+
 /**
  * @brief Scheduler ES configuration: set the entropy rate
  *
@@ -181,6 +200,176 @@ void esdm_config_es_hwrand_entropy_rate_set(uint32_t ent);
  */
 uint32_t esdm_config_es_hwrand_entropy_rate(void);
 
+/**
+ * @brief Obtain setting about /dev/hwrng async block filling
+ *
+ * @return Boolean indicating whether /dev/hwrng block filling is enabled
+ */
+uint32_t esdm_config_es_hwrand_async_enabled(void);
+
+/**
+ * @brief Enable or disable the /dev/hwrng async block filling
+ *
+ * When enabled, a collector thread reads /dev/hwrng in the background and
+ * reseeds obtain the data from the collected blocks. The setting must be
+ * applied before the ESDM is initialized.
+ *
+ * @param [in] setting Boolean to enable the behavior
+ */
+void esdm_config_es_hwrand_async_enabled_set(int setting);
+
+/**
+ * @brief Obtain the path of the seed file
+ *
+ * @return Path of the seed file or NULL if no seed file is used
+ */
+const char *esdm_config_seed_file(void);
+
+/**
+ * @brief Set the path of the seed file
+ *
+ * When a seed file is configured, its content is inserted into the auxiliary
+ * pool during initialization, and the file is rewritten with fresh data once
+ * the ESDM is fully seeded, periodically during runtime and at shutdown. This
+ * shortens the time until the ESDM is operational after a reboot. The path
+ * is copied. The setting must be applied before the ESDM is initialized.
+ *
+ * @param [in] path Path of the seed file, NULL disables the seed file
+ *
+ * @return 0 on success, < 0 on error
+ */
+int esdm_config_seed_file_set(const char *path);
+
+/**
+ * @brief Obtain the entropy credited to the seed file content
+ *
+ * @return Entropy in bits
+ */
+uint32_t esdm_config_seed_file_entropy(void);
+
+/**
+ * @brief Set the entropy credited to the seed file content
+ *
+ * The default is 0 bits as the ESDM cannot verify that the seed file was not
+ * read or modified while the system was down. Entropy is only credited if
+ * the seed file is a regular file owned by the ESDM user without access for
+ * anybody else and if it could be truncated after reading it.
+ *
+ * NOTE: The ESDM ensures that the entropy cannot be set to a value larger
+ *	 than the security strength of the the applied DRNG.
+ *
+ * @param [in] ent Entropy in bits
+ */
+void esdm_config_seed_file_entropy_set(uint32_t ent);
+
+/* Identity of an RPC client used for the per-client accounting */
+enum esdm_config_rpc_client_id {
+	/** Clients are identified by their user ID */
+	esdm_config_rpc_client_uid,
+	/** Clients are identified by their process ID */
+	esdm_config_rpc_client_pid,
+	/** Clients are identified by their control group */
+	esdm_config_rpc_client_cgroup,
+};
+
+/**
+ * @brief RPC server configuration: obtain the identity of RPC clients
+ *
+ * @return Identity used for the per-client accounting
+ */
+enum esdm_config_rpc_client_id esdm_config_rpc_client_id(void);
+
+/**
+ * @brief RPC server configuration: set the identity of RPC clients
+ *
+ * The unprivileged RPC server accounts the expensive requests per client,
+ * i.e. per UID, PID or control group of the peer of the connection as
+ * reported by SO_PEERCRED. The setting must be applied before the RPC server
+ * is started.
+ *
+ * @param [in] id Identity used for the per-client accounting
+ */
+void esdm_config_rpc_client_id_set(enum esdm_config_rpc_client_id id);
+
+/**
+ * @brief RPC server configuration: obtain the per-client rate limit
+ *
+ * @return Rate limit in bytes per second, 0 if unlimited
+ */
+uint32_t esdm_config_rpc_rate_limit(void);
+
+/**
+ * @brief RPC server configuration: set the per-client rate limit
+ *
+ * Expensive requests of the unprivileged RPC interface - get_seed,
+ * get_random_bytes_pr and large get_random_bytes_full requests - are subject
+ * to a token bucket per client refilled with the given rate. A client
+ * exceeding its rate receives -EAGAIN which the ESDM RPC client library
+ * handles by retrying the request. The setting must be applied before the
+ * RPC server is started.
+ *
+ * @param [in] rate Rate limit in bytes per second, 0 disables the limit
+ */
+void esdm_config_rpc_rate_limit_set(uint32_t rate);
+
+/**
+ * @brief RPC server configuration: obtain the per-client burst size
+ *
+ * @return Size of the token bucket in bytes, 0 if derived from the rate
+ */
+uint32_t esdm_config_rpc_rate_burst(void);
+
+/**
+ * @brief RPC server configuration: set the per-client burst size
+ *
+ * @param [in] burst Size of the token bucket in bytes, 0 uses the rate limit
+ *		     but at least the maximum size of one RPC request
+ */
+void esdm_config_rpc_rate_burst_set(uint32_t burst);
+
+/**
+ * @brief RPC server configuration: obtain the number of fair queuing slots
+ *
+ * @return Number of concurrently served expensive requests, 0 if fair
+ *	   queuing is disabled
+ */
+uint32_t esdm_config_rpc_fair_slots(void);
+
+/**
+ * @brief RPC server configuration: set the number of fair queuing slots
+ *
+ * When set, at most the given number of expensive requests of the
+ * unprivileged RPC interface are served concurrently. Further requests wait
+ * and are admitted round-robin across the clients instead of in their order
+ * of arrival. A request not admitted within the receive timeout of the client
+ * or its time budget receives -EBUSY which the ESDM RPC client library
+ * retries immediately. The setting must be applied before the RPC server is
+ * started.
+ *
+ * @param [in] slots Number of concurrently served expensive requests, 0
+ *		     disables fair queuing
+ */
+void esdm_config_rpc_fair_slots_set(uint32_t slots);
+
+/**
+ * @brief DRNG Manager configuration: obtain the idle period of tenant DRNGs
+ *
+ * @return Idle period in seconds, 0 if tenant DRNGs are disabled
+ */
+uint32_t esdm_config_drng_tenant_idle(void);
+
+/**
+ * @brief DRNG Manager configuration: enable tenant DRNGs
+ *
+ * When set, each tenant selected with esdm_drng_tenant_set - the RPC server
+ * uses the client identity configured with esdm_config_rpc_client_id_set -
+ * obtains its own DRNG instance. The tenant DRNG is seeded from the DRNG of
+ * the node and released after it was not used for the given idle period.
+ *
+ * @param [in] seconds Idle period in seconds, 0 disables tenant DRNGs
+ */
+void esdm_config_drng_tenant_idle_set(uint32_t seconds);
+
 /**
  * @brief JENT Kernel ES configuration: set the entropy rate
  *
@@ -289,6 +478,62 @@ uint32_t esdm_config_online_nodes(void);
  */
 uint32_t esdm_config_curr_node(void);
 
+/* Thread classes whose CPU affinity can be configured */
+enum esdm_config_affinity {
+	/** RPC worker threads - each worker is pinned to one CPU of the set */
+	esdm_config_affinity_rpc,
+	/** Entropy source monitor thread - may float within the CPU set */
+	esdm_config_affinity_es_monitor,
+	/** Jitter RNG block collection - may float within the CPU set */
+	esdm_config_affinity_jent,
+	esdm_config_affinity_last, /* Must be last entry */
+};
+
+/**
+ * @brief Affinity configuration: set the CPUs a thread class may execute on
+ *
+ * The CPU list uses the format known from taskset(1) and the Linux kernel,
+ * e.g. "0-3,8,10-11". An empty string or NULL clears the setting which
+ * implies that the threads are not pinned.
+ *
+ * RPC worker threads are each pinned to exactly one CPU out of the set in a
+ * round-robin fashion. As the DRNG node serving a request is derived from the
+ * CPU executing the worker, all requests of one connection use the same node
+ * DRNG.
+ *
+ * NOTE: This call must be invoked before the threads are started.
+ *
+ * @param [in] type Thread class to configure
+ * @param [in] cpulist CPU list
+ *
+ * @return 0 on success, < 0 on error
+ */
+int esdm_config_affinity_set(enum esdm_config_affinity type,
+			     const char *cpulist);
+
+/**
+ * @brief Affinity configuration: apply the affinity to the calling thread
+ *
+ * If no CPU set is configured for the given thread class, the call is a noop.
+ *
+ * @param [in] type Thread class the calling thread belongs to
+ *
+ * @return 0 on success, < 0 on error
+ */
+int esdm_config_affinity_apply(enum esdm_config_affinity type);
+
+/**
+ * @brief Affinity configuration: release the pinning of the calling thread
+ *
+ * The calling thread gets the affinity back it had before
+ * esdm_config_affinity_apply pinned it. If the thread is not pinned, the call
+ * is a noop. A thread that is reused for other work, e.g. by a thread pool,
+ * must release its pinning before.
+ *
+ * @return 0 on success, < 0 on error
+ */
+int esdm_config_affinity_release(void);
+
 int esdm_config_init(void);
 int esdm_config_reinit(void);
 
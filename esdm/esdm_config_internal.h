@@ -20,12 +20,20 @@
 #ifndef _ESDM_CONFIG_INTERNAL
 #define _ESDM_CONFIG_INTERNAL
 
+#include "bool.h"
 #include "config.h"
+#include "esdm_config.h"
 
 /* Initialization */
 int esdm_config_init(void);
 int esdm_config_reinit(void);
 
+/* Number of CPUs configured for the thread class, 0 if not configured */
+uint32_t esdm_config_affinity_ncpus(enum esdm_config_affinity type);
+
+/* Is the CPU part of the configured CPU set of the thread class? */
+bool esdm_config_affinity_isset(enum esdm_config_affinity type, uint32_t cpu);
+
 #ifdef ESDM_TESTMODE
 void esdm_config_drng_max_wo_reseed_set(uint32_t val);
 void esdm_config_drng_max_wo_reseed_bits_set(uint32_t val);
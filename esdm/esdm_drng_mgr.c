@@ -19,11 +19,15 @@
  * DAMAGE.
  */
 
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE
 #include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "atomic_bool.h"
 #include "build_bug_on.h"
 #include "config.h"
 #include "esdm.h"
@@ -41,9 +45,12 @@
 #include "esdm_leancrypto.h"
 #include "esdm_node.h"
 #include "esdm_openssl.h"
+#include "esdm_tenant.h"
+#include "fips.h"
 #include "helper.h"
 #include "queue.h"
 #include "ret_checkers.h"
+#include "threading_support.h"
 #include "visibility.h"
 
 /*
@@ -202,14 +209,14 @@ static int esdm_drng_mgr_selftest(void)
 	int ret = 0;
 
 	/* Perform selftest of current crypto implementations */
-	mutex_reader_lock(&drng->hash_lock);
-	hash_cb = drng->hash_cb;
+	rcu_read_lock();
+	hash_cb = rcu_dereference(drng->hash_cb);
 	if (hash_cb->hash_selftest)
 		ret = hash_cb->hash_selftest();
 	else
 		esdm_logger(LOGGER_WARN, LOGGER_C_DRNG,
 			    "Hash self test missing\n");
-	mutex_reader_unlock(&drng->hash_lock);
+	rcu_read_unlock();
 	CKINT_LOG(ret, "Hash self test failed: %d\n", ret);
 	esdm_logger(LOGGER_DEBUG, LOGGER_C_DRNG,
 		    "Hash self test passed successfully\n");
@@ -287,9 +294,17 @@ out:
 	return ret;
 }
 
+static void esdm_get_seed_producer_stop(void);
+static void esdm_drng_reseed_sched_fini(void);
+
 void esdm_drng_mgr_finalize(void)
 {
 	atomic_set(&esdm_drng_mgr_terminate, 1);
+	/* Release a seed producer waiting for the DRNGs to be seeded */
+	thread_wake_all(&esdm_init_wait);
+	esdm_get_seed_producer_stop();
+	esdm_drng_reseed_sched_fini();
+	esdm_drng_tenant_fini();
 	esdm_drng_dealloc_common(esdm_drng_init_instance());
 	esdm_drng_dealloc_common(&esdm_drng_pr);
 }
@@ -402,6 +417,7 @@ void esdm_drng_inject(struct esdm_drng *drng, const uint8_t *inbuf,
 			atomic_add(&drng->requests_since_fully_seeded, gc);
 
 		clock_gettime(CLOCK_MONOTONIC, &drng->last_seeded);
+		atomic_inc(&drng->seed_gen);
 		atomic_set(&drng->requests, ESDM_DRNG_RESEED_THRESH);
 		drng->force_reseed = false;
 
@@ -610,6 +626,316 @@ void esdm_drng_seed_work(void)
 	esdm_pool_unlock();
 }
 
+/*
+ * Seed a node DRNG allocated after startup. The seeding state of all nodes
+ * only covers the DRNGs allocated at startup and is left untouched: a node
+ * used the first time at runtime neither lets esdm_get_seed wait nor changes
+ * the operation of the entropy sources. Until the DRNG is fully seeded, the
+ * requests of its node are served by the initial DRNG.
+ */
+void esdm_drng_seed_node(struct esdm_drng *drng, uint32_t node)
+{
+	if (drng->fully_seeded)
+		return;
+
+	/* The seeding of the DRNGs allocated at startup covers this one */
+	if (!esdm_pool_all_nodes_seeded_get()) {
+		esdm_es_add_entropy();
+		return;
+	}
+
+	if (!esdm_es_seed_avail() || !esdm_pool_trylock())
+		return;
+
+	esdm_drng_seed_work_one(drng, node);
+	esdm_pool_unlock();
+}
+
+/****************************** Reseed scheduler ******************************/
+
+/*
+ * DRNGs which must be reseeded are not reseeded by the caller that detected
+ * the need. They are queued in a priority queue ordered by the reseed
+ * deadline and, for identical deadlines, by the number of generate calls
+ * served since the last reseed. Each generate call then performs at most one
+ * reseed of the most urgent DRNG, if it can obtain the entropy pool.
+ *
+ * The entropy drawn for reseeds is metered with a budget that is refilled
+ * to allow ESDM_RESEED_SCHED_RATE reseeds per second. Thus, if all DRNGs
+ * need a reseed at once, e.g. after a resume from suspend or an outage of
+ * the entropy sources, they are reseeded one after the other. In the mean
+ * time, the DRNGs continue to serve requests from their still valid state.
+ * DRNGs which are not fully seeded are not subject to the budget.
+ */
+#define ESDM_RESEED_SCHED_RATE 4
+
+static struct esdm_reseed_sched {
+	mutex_w_t lock;
+	struct esdm_drng **heap;
+	uint32_t heap_len;
+	uint32_t heap_size;
+	atomic_t pending; /* Copy of heap_len which may be read without lock */
+	uint64_t budget; /* Available entropy budget in bits */
+	struct timespec budget_refill; /* Last budget refill */
+	uint64_t reseeds; /* Reseeds performed by the scheduler */
+	uint64_t deferred; /* Reseeds delayed due to missing budget */
+	uint64_t stalled; /* Requests served while a reseed was pending */
+} esdm_reseed_sched = {
+	.lock = MUTEX_W_UNLOCKED,
+	.heap = NULL,
+	.heap_len = 0,
+	.heap_size = 0,
+	.pending = ATOMIC_INIT(0),
+	.budget = 0,
+	.budget_refill = { 0 },
+	.reseeds = 0,
+	.deferred = 0,
+	.stalled = 0,
+};
+
+/* Does DRNG a have a higher reseed priority than DRNG b? */
+static bool esdm_reseed_sched_before(const struct esdm_drng *a,
+				     const struct esdm_drng *b)
+{
+	if (a->reseed_due != b->reseed_due)
+		return a->reseed_due < b->reseed_due;
+	return a->reseed_usage > b->reseed_usage;
+}
+
+static void esdm_reseed_sched_swap(struct esdm_drng **heap, uint32_t a,
+				   uint32_t b)
+{
+	struct esdm_drng *tmp = heap[a];
+
+	heap[a] = heap[b];
+	heap[b] = tmp;
+}
+
+/* Caller must hold the reseed scheduler lock */
+static int esdm_reseed_sched_push(struct esdm_reseed_sched *sched,
+				  struct esdm_drng *drng)
+{
+	uint32_t i;
+
+	if (sched->heap_len == sched->heap_size) {
+		uint32_t size = sched->heap_size ? sched->heap_size << 1 :
+						   esdm_config_online_nodes() + 2;
+		struct esdm_drng **heap =
+			realloc(sched->heap, size * sizeof(*heap));
+
+		if (!heap)
+			return -ENOMEM;
+		sched->heap = heap;
+		sched->heap_size = size;
+	}
+
+	i = sched->heap_len++;
+	atomic_inc(&sched->pending);
+	sched->heap[i] = drng;
+	while (i) {
+		uint32_t parent = (i - 1) >> 1;
+
+		if (!esdm_reseed_sched_before(sched->heap[i],
+					      sched->heap[parent]))
+			break;
+		esdm_reseed_sched_swap(sched->heap, i, parent);
+		i = parent;
+	}
+
+	return 0;
+}
+
+/* Caller must hold the reseed scheduler lock */
+static struct esdm_drng *esdm_reseed_sched_pop(struct esdm_reseed_sched *sched)
+{
+	struct esdm_drng *drng;
+	uint32_t i = 0;
+
+	if (!sched->heap_len)
+		return NULL;
+
+	drng = sched->heap[0];
+	sched->heap[0] = sched->heap[--sched->heap_len];
+	atomic_dec(&sched->pending);
+
+	for (;;) {
+		uint32_t l = (i << 1) + 1, r = l + 1, min = i;
+
+		if (l < sched->heap_len &&
+		    esdm_reseed_sched_before(sched->heap[l], sched->heap[min]))
+			min = l;
+		if (r < sched->heap_len &&
+		    esdm_reseed_sched_before(sched->heap[r], sched->heap[min]))
+			min = r;
+		if (min == i)
+			break;
+		esdm_reseed_sched_swap(sched->heap, i, min);
+		i = min;
+	}
+
+	return drng;
+}
+
+/* Refill the entropy budget - caller must hold the reseed scheduler lock */
+static void esdm_reseed_sched_refill(struct esdm_reseed_sched *sched)
+{
+	uint64_t max = (uint64_t)ESDM_RESEED_SCHED_RATE *
+		       esdm_security_strength();
+	struct timespec now;
+	uint64_t ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (uint64_t)(now.tv_sec - sched->budget_refill.tv_sec) * 1000 +
+	     (uint64_t)((now.tv_nsec - sched->budget_refill.tv_nsec) /
+			1000000);
+	if (!ms && sched->budget_refill.tv_sec)
+		return;
+
+	sched->budget = min_uint64(max, sched->budget + (ms * max) / 1000);
+	sched->budget_refill = now;
+}
+
+/* Queue the DRNG for reseed unless it is already queued */
+static void esdm_drng_reseed_sched_add(struct esdm_drng *drng)
+{
+	struct esdm_reseed_sched *sched = &esdm_reseed_sched;
+	struct timespec now;
+
+	if (atomic_read(&esdm_drng_mgr_terminate))
+		return;
+
+	mutex_w_lock(&sched->lock);
+	if (atomic_bool_read(&drng->reseed_queued))
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	drng->reseed_seed_gen = atomic_read(&drng->seed_gen);
+	drng->reseed_usage =
+		(uint32_t)(ESDM_DRNG_RESEED_THRESH - atomic_read(&drng->requests));
+
+	/*
+	 * A forced reseed or a DRNG which exhausted its generate calls is due
+	 * now, otherwise the reseed became due when the maximum reseed time
+	 * passed.
+	 */
+	if (drng->force_reseed || !drng->fully_seeded ||
+	    drng->reseed_usage >= ESDM_DRNG_RESEED_THRESH)
+		drng->reseed_due = now.tv_sec;
+	else {
+		time_t due = drng->last_seeded.tv_sec +
+			     (time_t)esdm_drng_reseed_max_time;
+
+		drng->reseed_due = (due < now.tv_sec) ? due : now.tv_sec;
+	}
+
+	if (esdm_reseed_sched_push(sched, drng)) {
+		/* Fall back to retrying with the next request */
+		drng->force_reseed = true;
+		goto out;
+	}
+	atomic_bool_set_true(&drng->reseed_queued);
+
+out:
+	mutex_w_unlock(&sched->lock);
+}
+
+/*
+ * Perform the reseed of the most urgent DRNG if the entropy pool is available
+ * and the budget allows it.
+ */
+static void esdm_drng_reseed_sched_run(void)
+{
+	struct esdm_reseed_sched *sched = &esdm_reseed_sched;
+	struct esdm_drng *drng;
+	uint32_t bits;
+
+	/*
+	 * Do not contend on the entropy pool and the scheduler lock when no
+	 * reseed is pending, which is the common case.
+	 */
+	if (!atomic_read(&sched->pending))
+		return;
+
+	if (!esdm_pool_trylock())
+		return;
+
+	mutex_w_lock(&sched->lock);
+	for (;;) {
+		drng = sched->heap_len ? sched->heap[0] : NULL;
+		if (!drng)
+			goto unlock;
+
+		/*
+		 * Skip DRNGs which were seeded after they were queued. The seed
+		 * generation is compared as last_seeded may be moved into the
+		 * future to prevent a reseed storm.
+		 */
+		if (!drng->force_reseed && drng->fully_seeded &&
+		    atomic_read(&drng->seed_gen) != drng->reseed_seed_gen) {
+			esdm_reseed_sched_pop(sched);
+			atomic_bool_set_false(&drng->reseed_queued);
+			continue;
+		}
+		break;
+	}
+
+	bits = esdm_get_seed_entropy_osr(drng->fully_seeded);
+	if (drng->fully_seeded) {
+		esdm_reseed_sched_refill(sched);
+		if (sched->budget < bits) {
+			sched->deferred++;
+			goto unlock;
+		}
+		sched->budget -= bits;
+	}
+
+	esdm_reseed_sched_pop(sched);
+	atomic_bool_set_false(&drng->reseed_queued);
+	sched->reseeds++;
+	mutex_w_unlock(&sched->lock);
+
+	/* Perform synchronous reseed */
+	esdm_drng_seed(drng);
+	esdm_pool_unlock();
+	return;
+
+unlock:
+	mutex_w_unlock(&sched->lock);
+	esdm_pool_unlock();
+}
+
+static void esdm_drng_reseed_sched_fini(void)
+{
+	struct esdm_reseed_sched *sched = &esdm_reseed_sched;
+
+	mutex_w_lock(&sched->lock);
+	while (sched->heap_len) {
+		struct esdm_drng *drng = esdm_reseed_sched_pop(sched);
+
+		atomic_bool_set_false(&drng->reseed_queued);
+	}
+	free(sched->heap);
+	sched->heap = NULL;
+	sched->heap_size = 0;
+	mutex_w_unlock(&sched->lock);
+}
+
+void esdm_drng_reseed_sched_status(char *buf, size_t buflen)
+{
+	struct esdm_reseed_sched *sched = &esdm_reseed_sched;
+
+	mutex_w_lock(&sched->lock);
+	snprintf(buf, buflen,
+		 "DRNG reseed scheduler:\n"
+		 " Pending reseeds: %u\n"
+		 " Performed reseeds: %" PRIu64 "\n"
+		 " Reseeds deferred by entropy budget: %" PRIu64 "\n"
+		 " Requests stalled waiting for reseed: %" PRIu64 "\n",
+		 sched->heap_len, sched->reseeds, sched->deferred,
+		 sched->stalled);
+	mutex_w_unlock(&sched->lock);
+}
+
 /**
  * @brief Check if DRNG has to be temporarily disabled because of failed seedings
  *
@@ -665,6 +991,7 @@ void esdm_drng_force_reseed(void)
 	esdm_drng_atomic_force_reseed();
 
 out:
+	esdm_drng_tenants_force_reseed();
 	esdm_drng_put_instances();
 }
 
@@ -682,22 +1009,53 @@ static bool esdm_drng_must_reseed(struct esdm_drng *drng)
 		esdm_time_after_now(&check_time));
 }
 
+/*
+ * Requests with a deadline are served first when the DRNG lock is contended:
+ * they announce themselves while waiting for the lock and a regular request
+ * obtaining the lock in the meantime hands it over. The hand-over is bounded
+ * to not starve regular requests.
+ */
+#define ESDM_DRNG_DEADLINE_YIELD_MAX 64
+
+static void esdm_drng_lock(struct esdm_drng *drng, bool deadline)
+{
+	unsigned int i;
+
+	if (deadline) {
+		atomic_inc(&drng->deadline_waiters);
+		mutex_w_lock(&drng->lock);
+		atomic_dec(&drng->deadline_waiters);
+		return;
+	}
+
+	for (i = 0;; i++) {
+		mutex_w_lock(&drng->lock);
+		if (!atomic_read(&drng->deadline_waiters) ||
+		    i >= ESDM_DRNG_DEADLINE_YIELD_MAX)
+			return;
+		mutex_w_unlock(&drng->lock);
+		sched_yield();
+	}
+}
+
 /**
  * @brief Get random data out of the DRNG which is reseeded frequently.
  *
  * @param [in] drng DRNG instance
  * @param [in] outbuf buffer for storing random data
  * @param [in] outbuflen length of outbuf
+ * @param [in] deadline request has a deadline: it never performs a
+ *		       synchronous reseed and keeps the DRNG until it is served
  *
  * @return
  * * < 0 in error case (DRNG generation or update failed)
  * * >=0 returning the returned number of bytes
  */
 static ssize_t esdm_drng_get(struct esdm_drng *drng, uint8_t *outbuf,
-			     size_t outbuflen)
+			     size_t outbuflen, bool deadline)
 {
 	ssize_t processed = 0;
-	bool pr = (drng == &esdm_drng_pr) ? true : false;
+	bool pr = (drng == &esdm_drng_pr) ? true : false, locked = false;
 
 	if (!outbuf || !outbuflen)
 		return 0;
@@ -705,6 +1063,9 @@ static ssize_t esdm_drng_get(struct esdm_drng *drng, uint8_t *outbuf,
 	if (!esdm_get_available())
 		return -EOPNOTSUPP;
 
+	/* No output before the integrity of the binary is verified */
+	fips_post_integrity_wait();
+
 	outbuflen = min_size(outbuflen, SSIZE_MAX);
 
 	/*
@@ -713,9 +1074,10 @@ static ssize_t esdm_drng_get(struct esdm_drng *drng, uint8_t *outbuf,
 	 *
 	 * Note a reseed requested by drng->force_reseed or esdm_drng_seed()
 	 * does not imply that sufficient entropy was received to fill the DRNG.
-	 * If this state persists, then the following check applies.
+	 * If this state persists, then the following check applies. Tenant
+	 * DRNGs are checked when they are reseeded from their parent DRNG.
 	 */
-	if (esdm_drng_check_disable_threshold(drng))
+	if (!drng->tenant && esdm_drng_check_disable_threshold(drng))
 		esdm_unset_fully_seeded(drng);
 
 	/* Loop to collect random bits for the caller. */
@@ -724,23 +1086,25 @@ static ssize_t esdm_drng_get(struct esdm_drng *drng, uint8_t *outbuf,
 			min_uint32((uint32_t)outbuflen, ESDM_DRNG_MAX_REQSIZE);
 		ssize_t ret;
 
-		/* In normal operation, check whether to reseed */
-		if (!pr && esdm_drng_must_reseed(drng)) {
-			if (!esdm_pool_trylock()) {
-				/*
-				 * Entropy pool cannot be locked, try to reseed
-				 * next time, but continue to generate random
-				 * bits.
-				 */
-				drng->force_reseed = true;
-			} else {
-				/* Perform synchronous reseed */
-				esdm_drng_seed(drng);
-				esdm_pool_unlock();
-			}
+		/*
+		 * In normal operation, check whether to reseed. The reseed is
+		 * performed by the reseed scheduler, the DRNG continues to
+		 * generate random bits until it is reseeded. A request with a
+		 * deadline is never chosen to perform the reseed. Tenant DRNGs
+		 * are reseeded from their parent DRNG before the request.
+		 */
+		if (!pr && !drng->tenant) {
+			if (atomic_bool_read(&drng->reseed_queued))
+				__sync_add_and_fetch(&esdm_reseed_sched.stalled,
+						     1);
+			else if (esdm_drng_must_reseed(drng))
+				esdm_drng_reseed_sched_add(drng);
+			if (!deadline)
+				esdm_drng_reseed_sched_run();
 		}
 
-		mutex_w_lock(&drng->lock);
+		if (!locked)
+			esdm_drng_lock(drng, deadline);
 
 		/*
 		 * Handle prediction resistance requests.
@@ -787,7 +1151,11 @@ static ssize_t esdm_drng_get(struct esdm_drng *drng, uint8_t *outbuf,
 		/* Now, generate random bits from the properly seeded DRNG. */
 		ret = drng->drng_cb->drng_generate(drng->drng,
 						   outbuf + processed, todo);
-		mutex_w_unlock(&drng->lock);
+
+		/* A request with a deadline keeps the DRNG until it is served */
+		locked = deadline && ret > 0 && outbuflen > (size_t)ret;
+		if (!locked)
+			mutex_w_unlock(&drng->lock);
 		if (ret <= 0) {
 			esdm_logger(
 				LOGGER_WARN, LOGGER_C_DRNG,
@@ -812,25 +1180,70 @@ out:
 	return processed;
 }
 
-static ssize_t esdm_drng_get_sleep(uint8_t *outbuf, size_t outbuflen, bool pr)
+/*
+ * Reseed the tenant DRNG from its parent DRNG, i.e. the DRNG which would serve
+ * the request without tenant DRNGs. The tenant DRNG inherits the seed level of
+ * its parent.
+ */
+static ssize_t esdm_drng_tenant_reseed(struct esdm_drng *tenant,
+				       struct esdm_drng *parent, bool deadline)
+{
+	uint8_t seed[ESDM_DRNG_SECURITY_STRENGTH_BYTES];
+	bool fully_seeded;
+	ssize_t ret;
+
+	if (!esdm_drng_must_reseed(tenant) &&
+	    !esdm_drng_check_disable_threshold(tenant) &&
+	    (tenant->fully_seeded || !parent->fully_seeded))
+		return 0;
+
+	fully_seeded = parent->fully_seeded;
+	ret = esdm_drng_get(parent, seed, sizeof(seed), deadline);
+	if (ret < 0)
+		goto out;
+	if (ret != sizeof(seed)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	esdm_drng_lock(tenant, deadline);
+	esdm_drng_inject(tenant, seed, sizeof(seed), fully_seeded, "tenant");
+	mutex_w_unlock(&tenant->lock);
+	ret = 0;
+
+out:
+	memset_secure(seed, 0, sizeof(seed));
+	return ret;
+}
+
+static ssize_t __esdm_drng_get_sleep(uint8_t *outbuf, size_t outbuflen,
+				     bool pr, bool deadline)
 {
 	struct esdm_drng **esdm_drng = esdm_drng_get_instances();
-	struct esdm_drng *drng = &esdm_drng_init;
+	struct esdm_drng *drng = &esdm_drng_init, *node_drng = NULL,
+			 *tenant = NULL;
 	uint32_t node = esdm_config_curr_node();
 	ssize_t ret;
 
+	/* The node DRNG is allocated when the node is used first */
+	if (!pr && esdm_drng)
+		node_drng = esdm_drng_node_get(esdm_drng, node);
+
+	/* The tenant selected by the caller obtains its own DRNG */
+	if (!pr)
+		tenant = esdm_drng_tenant_get();
+
 	if (pr) {
 		esdm_logger(
 			LOGGER_DEBUG, LOGGER_C_DRNG,
 			"Using prediction resistance DRNG instance to service generate request\n");
 		drng = &esdm_drng_pr;
-	} else if (esdm_drng && esdm_drng[node] &&
-		   esdm_drng[node]->fully_seeded) {
+	} else if (node_drng && node_drng->fully_seeded) {
 		esdm_logger(
 			LOGGER_DEBUG, LOGGER_C_DRNG,
 			"Using DRNG instance on node %u to service generate request\n",
 			node);
-		drng = esdm_drng[node];
+		drng = node_drng;
 	} else {
 		esdm_logger(
 			LOGGER_DEBUG, LOGGER_C_DRNG,
@@ -838,13 +1251,28 @@ static ssize_t esdm_drng_get_sleep(uint8_t *outbuf, size_t outbuflen, bool pr)
 	}
 
 	CKINT(esdm_drng_mgr_initialize());
-	CKINT(esdm_drng_get(drng, outbuf, outbuflen));
+
+	if (tenant) {
+		esdm_logger(
+			LOGGER_DEBUG, LOGGER_C_DRNG,
+			"Using tenant DRNG instance to service generate request\n");
+		CKINT(esdm_drng_tenant_reseed(tenant, drng, deadline));
+		drng = tenant;
+	}
+
+	CKINT(esdm_drng_get(drng, outbuf, outbuflen, deadline));
 
 out:
+	esdm_drng_tenant_put(tenant);
 	esdm_drng_put_instances();
 	return ret;
 }
 
+static ssize_t esdm_drng_get_sleep(uint8_t *outbuf, size_t outbuflen, bool pr)
+{
+	return __esdm_drng_get_sleep(outbuf, outbuflen, pr, false);
+}
+
 /*
  * Reset ESDM such that all existing entropy is gone.
  */
@@ -872,6 +1300,8 @@ void esdm_reset(void)
 
 	esdm_drng_put_instances();
 
+	esdm_drng_tenants_reset();
+
 	mutex_w_lock(&esdm_drng_pr.lock);
 	esdm_drng_reset(&esdm_drng_pr);
 	mutex_w_unlock(&esdm_drng_pr.lock);
@@ -961,33 +1391,90 @@ static int esdm_drng_sleep_while_non_min_seeded(unsigned int nonblock)
 	return 0;
 }
 
-DSO_PUBLIC
-ssize_t esdm_get_seed(uint64_t *buf, size_t nbytes,
-		      enum esdm_get_seed_flags flags)
+/***************************** Seed request queue *****************************/
+
+/*
+ * Callers of esdm_get_seed are queued in FIFO order and served by one seed
+ * producer thread. The producer is started with the first request and
+ * terminates with the DRNG manager. While waiting for entropy, the producer
+ * is woken up when new entropy is added by an entropy source.
+ *
+ * The number of queued callers is limited such that callers waiting for
+ * seed cannot occupy all RPC worker threads.
+ */
+#if (THREADING_MAX_THREADS >= 8)
+#define ESDM_GET_SEED_MAX_QUEUED (THREADING_MAX_THREADS / 4)
+#else
+#define ESDM_GET_SEED_MAX_QUEUED 1
+#endif
+
+struct esdm_get_seed_req {
+	struct esdm_get_seed_req *next;
+	uint64_t *buf;
+	enum esdm_get_seed_flags flags;
+	ssize_t ret;
+	bool done;
+};
+
+static struct esdm_get_seed_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t producer_cv; /* New request or new entropy */
+	pthread_cond_t done_cv; /* Request completed */
+	struct esdm_get_seed_req *head;
+	struct esdm_get_seed_req *tail;
+	uint32_t queued;
+	bool producer_running;
+	bool producer_stop;
+	atomic_bool_t wait_entropy;
+} esdm_get_seed_queue = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.producer_cv = PTHREAD_COND_INITIALIZER,
+	.done_cv = PTHREAD_COND_INITIALIZER,
+	.head = NULL,
+	.tail = NULL,
+	.queued = 0,
+	.producer_running = false,
+	.producer_stop = false,
+	.wait_entropy = ATOMIC_BOOL_INIT(false),
+};
+
+/* Wake up the seed producer if it waits for entropy */
+void esdm_drng_get_seed_wakeup(void)
+{
+	if (atomic_bool_read(&esdm_get_seed_queue.wait_entropy))
+		pthread_cond_signal(&esdm_get_seed_queue.producer_cv);
+}
+
+static void esdm_get_seed_wait_entropy(void)
+{
+	struct esdm_get_seed_queue *q = &esdm_get_seed_queue;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += poll_ts.tv_sec;
+	ts.tv_nsec += poll_ts.tv_nsec;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&q->lock);
+	atomic_bool_set_true(&q->wait_entropy);
+	if (!q->producer_stop)
+		pthread_cond_clockwait(&q->producer_cv, &q->lock,
+				       CLOCK_MONOTONIC, &ts);
+	atomic_bool_set_false(&q->wait_entropy);
+	pthread_mutex_unlock(&q->lock);
+}
+
+static ssize_t esdm_get_seed_fill(uint64_t *buf,
+				  enum esdm_get_seed_flags flags)
 {
-	static DEFINE_MUTEX_W_UNLOCKED(esdm_get_seed_lock);
 	struct entropy_buf *eb = (struct entropy_buf *)(buf + 2);
 	uint64_t buflen = sizeof(struct entropy_buf) + 2 * sizeof(uint64_t);
 	uint64_t collected_bits = 0;
 	int ret;
 
-	/* Ensure buffer is aligned as required */
-	BUILD_BUG_ON(sizeof(buflen) < ESDM_KCAPI_ALIGN);
-	if (nbytes < sizeof(buflen))
-		return -EINVAL;
-
-	/* Write buffer size into first word */
-	buf[0] = buflen;
-	if (nbytes < buflen)
-		return -EMSGSIZE;
-
-	/*
-	 * We only allow ONE caller at any time to prevent a DoS on the RPC
-	 * interface considering this is a slow operation.
-	 */
-	if (!mutex_w_trylock(&esdm_get_seed_lock))
-		return -EAGAIN;
-
 	CKINT(esdm_drng_sleep_while_not_all_nodes_seeded(
 		flags & ESDM_GET_SEED_NONBLOCK));
 
@@ -1002,9 +1489,8 @@ ssize_t esdm_get_seed(uint64_t *buf, size_t nbytes,
 	}
 
 	/*
-	 * Try to get seed data - a rarely used busyloop is cheaper than a wait
-	 * queue that is constantly woken up by the hot code path of
-	 * esdm_init_ops.
+	 * Try to get seed data - the producer is woken up when an entropy
+	 * source adds entropy, and polls otherwise.
 	 */
 	for (;;) {
 		esdm_fill_seed_buffer(
@@ -1024,7 +1510,7 @@ ssize_t esdm_get_seed(uint64_t *buf, size_t nbytes,
 		    (flags & ESDM_GET_SEED_NONBLOCK))
 			break;
 
-		nanosleep(&poll_ts, NULL);
+		esdm_get_seed_wait_entropy();
 	}
 
 	esdm_pool_unlock();
@@ -1033,10 +1519,138 @@ ssize_t esdm_get_seed(uint64_t *buf, size_t nbytes,
 	buf[1] = collected_bits;
 
 out:
-	mutex_w_unlock(&esdm_get_seed_lock);
 	return ret ? ret : (ssize_t)buflen;
 }
 
+static int esdm_get_seed_producer(void __unused *unused)
+{
+	struct esdm_get_seed_queue *q = &esdm_get_seed_queue;
+
+	thread_set_name(get_seed_producer, 0);
+
+	pthread_mutex_lock(&q->lock);
+	while (!q->producer_stop) {
+		struct esdm_get_seed_req *req = q->head;
+		ssize_t ret;
+
+		if (!req) {
+			pthread_cond_wait(&q->producer_cv, &q->lock);
+			continue;
+		}
+
+		/* The request stays queued until it is completed */
+		pthread_mutex_unlock(&q->lock);
+		ret = esdm_get_seed_fill(req->buf, req->flags);
+		pthread_mutex_lock(&q->lock);
+
+		q->head = req->next;
+		if (!q->head)
+			q->tail = NULL;
+		q->queued--;
+
+		req->ret = ret;
+		req->done = true;
+		pthread_cond_broadcast(&q->done_cv);
+	}
+
+	/* Release all waiters */
+	while (q->head) {
+		struct esdm_get_seed_req *req = q->head;
+
+		q->head = req->next;
+		req->ret = -ESHUTDOWN;
+		req->done = true;
+	}
+	q->tail = NULL;
+	q->queued = 0;
+	q->producer_running = false;
+	pthread_cond_broadcast(&q->done_cv);
+	pthread_mutex_unlock(&q->lock);
+
+	return 0;
+}
+
+static void esdm_get_seed_producer_stop(void)
+{
+	struct esdm_get_seed_queue *q = &esdm_get_seed_queue;
+
+	pthread_mutex_lock(&q->lock);
+	q->producer_stop = true;
+	pthread_cond_broadcast(&q->producer_cv);
+
+	/* The producer releases all waiters before it terminates */
+	while (q->producer_running)
+		pthread_cond_wait(&q->done_cv, &q->lock);
+	pthread_mutex_unlock(&q->lock);
+}
+
+DSO_PUBLIC
+ssize_t esdm_get_seed(uint64_t *buf, size_t nbytes,
+		      enum esdm_get_seed_flags flags)
+{
+	struct esdm_get_seed_queue *q = &esdm_get_seed_queue;
+	struct esdm_get_seed_req req = {
+		.next = NULL, .buf = buf, .flags = flags, .ret = 0, .done = false
+	};
+	uint64_t buflen = sizeof(struct entropy_buf) + 2 * sizeof(uint64_t);
+	int ret;
+
+	/* Ensure buffer is aligned as required */
+	BUILD_BUG_ON(sizeof(buflen) < ESDM_KCAPI_ALIGN);
+	if (nbytes < sizeof(buflen))
+		return -EINVAL;
+
+	/* Write buffer size into first word */
+	buf[0] = buflen;
+	if (nbytes < buflen)
+		return -EMSGSIZE;
+
+	if (atomic_read(&esdm_drng_mgr_terminate))
+		return -ESHUTDOWN;
+
+	/* No output before the integrity of the binary is verified */
+	fips_post_integrity_wait();
+
+	pthread_mutex_lock(&q->lock);
+
+	/*
+	 * A non-blocking caller shall not wait for other callers, and the
+	 * queue length is limited to prevent a DoS on the RPC interface
+	 * considering this is a slow operation.
+	 */
+	if (((flags & ESDM_GET_SEED_NONBLOCK) && q->head) ||
+	    q->queued >= ESDM_GET_SEED_MAX_QUEUED) {
+		req.ret = -EAGAIN;
+		goto out;
+	}
+
+	if (!q->producer_running) {
+		q->producer_stop = false;
+		ret = thread_start(esdm_get_seed_producer, NULL,
+				   ESDM_THREAD_GET_SEED, NULL);
+		if (ret) {
+			req.ret = ret;
+			goto out;
+		}
+		q->producer_running = true;
+	}
+
+	if (q->tail)
+		q->tail->next = &req;
+	else
+		q->head = &req;
+	q->tail = &req;
+	q->queued++;
+	pthread_cond_signal(&q->producer_cv);
+
+	while (!req.done)
+		pthread_cond_wait(&q->done_cv, &q->lock);
+
+out:
+	pthread_mutex_unlock(&q->lock);
+	return req.ret;
+}
+
 DSO_PUBLIC
 ssize_t esdm_get_random_bytes_pr(uint8_t *buf, size_t nbytes)
 {
@@ -1097,6 +1711,39 @@ ssize_t esdm_get_random_bytes_full_timeout(uint8_t *buf, size_t nbytes,
 	return esdm_drng_get_sleep(buf, (uint32_t)nbytes, false);
 }
 
+DSO_PUBLIC
+ssize_t esdm_get_random_bytes_full_deadline(uint8_t *buf, size_t nbytes,
+					    const struct timespec *ts,
+					    int *deadline_met)
+{
+	struct timespec deadline, budget, now;
+	ssize_t ret;
+
+	if (deadline_met)
+		*deadline_met = 0;
+
+	CKNULL(ts, -EINVAL);
+
+	CKINT(clock_gettime(CLOCK_MONOTONIC, &deadline));
+	deadline.tv_sec += ts->tv_sec;
+	deadline.tv_nsec += ts->tv_nsec;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec += deadline.tv_nsec / 1000000000;
+		deadline.tv_nsec = deadline.tv_nsec % 1000000000;
+	}
+
+	budget = *ts;
+	CKINT(esdm_drng_sleep_while_nonoperational_timeout(&budget));
+
+	CKINT(__esdm_drng_get_sleep(buf, (uint32_t)nbytes, false, true));
+
+	if (deadline_met && !clock_gettime(CLOCK_MONOTONIC, &now))
+		*deadline_met = !esdm_time_after(&now, &deadline);
+
+out:
+	return ret;
+}
+
 DSO_PUBLIC
 ssize_t esdm_get_random_bytes_min(uint8_t *buf, size_t nbytes)
 {
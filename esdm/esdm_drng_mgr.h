@@ -23,6 +23,7 @@
 #include <sys/types.h>
 #include <time.h>
 
+#include "atomic_bool.h"
 #include "bool.h"
 #include "config.h"
 #include "esdm.h"
@@ -30,17 +31,24 @@
 #include "esdm_definitions.h"
 #include "mutex.h"
 #include "mutex_w.h"
+#include "rcu.h"
 
 extern struct thread_wait_queue esdm_init_wait;
 extern mutex_w_t esdm_crypto_cb_update;
 extern const struct esdm_drng_cb *esdm_default_drng_cb;
 extern const struct esdm_hash_cb *esdm_default_hash_cb;
 
-/* DRNG state handle */
+/*
+ * DRNG state handle
+ *
+ * The hash_cb is RCU protected: readers access it with rcu_dereference within
+ * rcu_read_lock / rcu_read_unlock, an update must be followed by
+ * synchronize_rcu before the old state is released.
+ */
 struct esdm_drng {
 	void *drng; /* DRNG handle */
 	const struct esdm_drng_cb *drng_cb; /* DRNG callbacks */
-	const struct esdm_hash_cb *hash_cb; /* Hash callbacks */
+	const struct esdm_hash_cb *hash_cb; /* Hash callbacks - RCU */
 	atomic_t requests; /* Number of DRNG requests */
 	atomic_t requests_since_fully_seeded; /* Number DRNG requests since
 						 * last fully seeded
@@ -55,10 +63,23 @@ struct esdm_drng {
 	atomic_t request_bits_since_fully_seeded;
 
 	struct timespec last_seeded; /* Last time it was seeded */
+	atomic_t seed_gen; /* Number of successful seeds */
 	bool fully_seeded; /* Is DRNG fully seeded? */
 	bool force_reseed; /* Force a reseed */
 
-	mutex_t hash_lock; /* Lock hash_cb replacement */
+	/*
+	 * Reseed scheduler state - protected by the reseed scheduler lock,
+	 * reseed_queued may be read without the lock.
+	 */
+	atomic_bool_t reseed_queued; /* Reseed is pending */
+	int reseed_seed_gen; /* Seed generation when reseed was scheduled */
+	time_t reseed_due; /* Deadline of the reseed in seconds */
+	uint32_t reseed_usage; /* Generate calls when reseed was scheduled */
+
+	atomic_t deadline_waiters; /* Deadline requests waiting for the lock */
+
+	bool tenant; /* Tenant DRNG seeded from the DRNG of the node */
+
 	/* Lock write operations on DRNG state, DRNG replacement of drng_cb */
 	mutex_w_t lock; /* Non-atomic DRNG operation */
 };
@@ -68,8 +89,10 @@ struct esdm_drng {
 	.requests = ATOMIC_INIT(ESDM_DRNG_RESEED_THRESH),                      \
 	.requests_since_fully_seeded = ATOMIC_INIT(0),                         \
 	.request_bits_since_fully_seeded = ATOMIC_INIT(0),                     \
-	.last_seeded = { 0 }, .fully_seeded = false, .force_reseed = true,     \
-	.hash_lock = MUTEX_UNLOCKED
+	.last_seeded = { 0 }, .seed_gen = ATOMIC_INIT(0),                      \
+	.fully_seeded = false, .force_reseed = true,                           \
+	.reseed_queued = ATOMIC_BOOL_INIT(false),                              \
+	.deadline_waiters = ATOMIC_INIT(0), .tenant = false
 
 struct esdm_drng *esdm_drng_init_instance(void);
 struct esdm_drng *esdm_drng_node_instance(void);
@@ -86,6 +109,9 @@ void esdm_drng_inject(struct esdm_drng *drng, const uint8_t *inbuf,
 		      size_t inbuflen, bool fully_seeded,
 		      const char *drng_type);
 void esdm_drng_seed_work(void);
+void esdm_drng_seed_node(struct esdm_drng *drng, uint32_t node);
+void esdm_drng_get_seed_wakeup(void);
+void esdm_drng_reseed_sched_status(char *buf, size_t buflen);
 void esdm_force_fully_seeded(void);
 void esdm_force_fully_seeded_all_drbgs(void);
 
@@ -35,6 +35,9 @@
 #include "ret_checkers.h"
 #include "visibility.h"
 
+/* Maximum number of aux pool shards - must be a power of 2 */
+#define ESDM_AUX_POOL_SHARDS_MAX 16
+
 /*
  * This is the auxiliary pool
  *
@@ -43,34 +46,120 @@
  * accelerated implementations, we need an alignment to avoid a realignment
  * which involves memcpy(). The alignment to 8 bytes should satisfy all crypto
  * implementations.
+ *
+ * The aux pool is sharded to allow concurrent inserts: an insert only locks
+ * the shard of the CPU it executes on. Each shard maintains its own hash state
+ * and entropy counter capped by the digest size. Reading the aux pool folds
+ * the digests of all shards into shard 0 and credits at most the digest size.
  */
-struct esdm_pool {
+struct esdm_aux_shard {
 	void *aux_pool; /* Aux pool: digest state */
 	atomic_t aux_entropy_bits;
-	atomic_t digestsize; /* Digest size of used hash */
 	bool initialized; /* Aux pool initialized? */
 
 	/* Serialize read of entropy pool and update of aux pool */
 	mutex_w_t lock;
+} __aligned(64);
+
+struct esdm_pool {
+	struct esdm_aux_shard shard[ESDM_AUX_POOL_SHARDS_MAX];
+	uint32_t shards; /* Number of used shards - power of 2 */
+	uint32_t shards_init; /* Number of shards with initialized lock */
+	atomic_t digestsize; /* Digest size of used hash */
 };
 
+#define ESDM_AUX_SHARD_INIT                                                    \
+	{                                                                      \
+		.aux_pool = NULL, .aux_entropy_bits = ATOMIC_INIT(0),          \
+		.initialized = false, .lock = MUTEX_W_UNLOCKED,                \
+	}
+
 static struct esdm_pool esdm_pool __aligned(ESDM_KCAPI_ALIGN) = {
-	.aux_pool = NULL,
-	.aux_entropy_bits = ATOMIC_INIT(0),
+	.shard = { [0] = ESDM_AUX_SHARD_INIT },
+	.shards = 1,
+	.shards_init = 1,
 	.digestsize = ATOMIC_INIT(ESDM_MAX_DIGESTSIZE),
-	.initialized = false,
-	.lock = MUTEX_W_UNLOCKED,
 };
 
+#define for_each_aux_shard(pool, shard)                                        \
+	for ((shard) = (pool)->shard; (shard) < (pool)->shard + (pool)->shards; \
+	     (shard)++)
+
 /********************************** Helper ***********************************/
 
+/*
+ * Lock the shard serving the calling CPU. The number of shards only changes
+ * while all shards are locked, so it is stable once a used shard is locked.
+ */
+static struct esdm_aux_shard *esdm_aux_lock_curr_shard(void)
+{
+	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *shard;
+	uint32_t idx, shards;
+
+	for (;;) {
+		shards = __atomic_load_n(&pool->shards, __ATOMIC_ACQUIRE);
+		idx = esdm_curr_node() & (shards - 1);
+		shard = &pool->shard[idx];
+		mutex_w_lock(&shard->lock);
+
+		/* The shard was removed while waiting for its lock */
+		if (idx < pool->shards)
+			return shard;
+		mutex_w_unlock(&shard->lock);
+	}
+}
+
+/* Lock the given number of shards - always lock in ascending order */
+static void esdm_aux_lock_shards(uint32_t shards)
+{
+	struct esdm_pool *pool = &esdm_pool;
+	uint32_t i;
+
+	for (i = 0; i < shards; i++)
+		mutex_w_lock(&pool->shard[i].lock);
+}
+
+static void esdm_aux_unlock_shards(uint32_t shards)
+{
+	struct esdm_pool *pool = &esdm_pool;
+
+	while (shards--)
+		mutex_w_unlock(&pool->shard[shards].lock);
+}
+
+/*
+ * Lock all used shards. The lock of shard 0 is always needed to change the
+ * number of shards, so holding it keeps the number stable.
+ */
+static void esdm_aux_lock_all(void)
+{
+	struct esdm_pool *pool = &esdm_pool;
+	uint32_t i;
+
+	mutex_w_lock(&pool->shard[0].lock);
+	for (i = 1; i < pool->shards; i++)
+		mutex_w_lock(&pool->shard[i].lock);
+}
+
+static void esdm_aux_unlock_all(void)
+{
+	esdm_aux_unlock_shards(esdm_pool.shards);
+}
+
 /* Entropy in bits present in aux pool */
 static uint32_t esdm_aux_avail_entropy(uint32_t __unused u)
 {
-	/* Cap available entropy with max entropy */
-	uint32_t avail_bits =
-		min_uint32(esdm_get_digestsize(),
-			   atomic_read_u32(&esdm_pool.aux_entropy_bits));
+	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *shard;
+	uint32_t digestsize = esdm_get_digestsize(), avail_bits = 0;
+
+	/* Cap available entropy of each shard and the pool with max entropy */
+	for_each_aux_shard (pool, shard) {
+		avail_bits += min_uint32(
+			digestsize, atomic_read_u32(&shard->aux_entropy_bits));
+	}
+	avail_bits = min_uint32(digestsize, avail_bits);
 
 	/* Consider oversampling rate due to aux pool conditioning */
 	return esdm_reduce_by_osr(avail_bits);
@@ -86,8 +175,8 @@ uint32_t esdm_get_aux_ent(void)
 static void esdm_set_digestsize(uint32_t digestsize)
 {
 	struct esdm_pool *pool = &esdm_pool;
-	uint32_t ent_bits = (uint32_t)atomic_xchg(&pool->aux_entropy_bits, 0),
-		 old_digestsize = esdm_get_digestsize();
+	struct esdm_aux_shard *shard;
+	uint32_t old_digestsize = esdm_get_digestsize();
 
 	atomic_set(&esdm_pool.digestsize, (int)digestsize);
 
@@ -102,8 +191,13 @@ static void esdm_set_digestsize(uint32_t digestsize)
 	 * In case the new digest is larger than the old one, cap the available
 	 * entropy to the old message digest used to process the existing data.
 	 */
-	ent_bits = min_uint32(ent_bits, old_digestsize);
-	atomic_add(&pool->aux_entropy_bits, (int)ent_bits);
+	for_each_aux_shard (pool, shard) {
+		uint32_t ent_bits =
+			(uint32_t)atomic_xchg(&shard->aux_entropy_bits, 0);
+
+		ent_bits = min_uint32(ent_bits, old_digestsize);
+		atomic_add(&shard->aux_entropy_bits, (int)ent_bits);
+	}
 }
 
 static void esdm_init_wakeup_bits(void)
@@ -113,19 +207,125 @@ static void esdm_init_wakeup_bits(void)
 	esdm_write_wakeup_bits = digestsize;
 }
 
-static int esdm_aux_init(void)
+static void esdm_aux_fini(void)
 {
 	struct esdm_drng *drng = esdm_drng_init_instance();
 	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *shard;
 	const struct esdm_hash_cb *hash_cb;
-	int ret = 0;
 
-	mutex_lock(&drng->hash_lock);
+	esdm_aux_lock_all();
 	hash_cb = drng->hash_cb;
-	if (hash_cb->hash_alloc)
-		CKINT(hash_cb->hash_alloc(&pool->aux_pool));
-	esdm_logger(LOGGER_VERBOSE, LOGGER_C_ANY, "Aux ES hash allocated\n");
-	pool->initialized = false;
+	for_each_aux_shard (pool, shard) {
+		if (hash_cb->hash_dealloc && shard->aux_pool)
+			hash_cb->hash_dealloc(shard->aux_pool);
+		shard->aux_pool = NULL;
+		shard->initialized = false;
+	}
+	esdm_logger(LOGGER_DEBUG, LOGGER_C_ANY, "Aux ES hash deallocated\n");
+	esdm_aux_unlock_all();
+}
+
+static int64_t esdm_aux_fold_shards(const struct esdm_hash_cb *hash_cb,
+				    uint32_t digestsize_bits);
+
+/*
+ * Remove the shards beyond the given number after moving their data into
+ * shard 0. Caller must hold the locks of all shards.
+ */
+static void esdm_aux_shrink_locked(const struct esdm_hash_cb *hash_cb,
+				   uint32_t shards)
+{
+	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *primary = &pool->shard[0], *shard;
+	uint32_t digestsize_bits;
+	int64_t folded_ent_bits = 0;
+
+	/* The hash states are not allocated after esdm_aux_fini */
+	if (primary->aux_pool) {
+		digestsize_bits = hash_cb->hash_digestsize(primary->aux_pool)
+				  << 3;
+		folded_ent_bits =
+			esdm_aux_fold_shards(hash_cb, digestsize_bits);
+	}
+	if (folded_ent_bits > 0) {
+		atomic_set(&primary->aux_entropy_bits,
+			   (int)min_uint32(
+				   digestsize_bits,
+				   atomic_read_u32(&primary->aux_entropy_bits) +
+					   (uint32_t)folded_ent_bits));
+	}
+
+	for (shard = pool->shard + shards; shard < pool->shard + pool->shards;
+	     shard++) {
+		if (hash_cb->hash_dealloc && shard->aux_pool)
+			hash_cb->hash_dealloc(shard->aux_pool);
+		shard->aux_pool = NULL;
+		shard->initialized = false;
+		atomic_set(&shard->aux_entropy_bits, 0);
+	}
+}
+
+static int esdm_aux_init(void)
+{
+	struct esdm_drng *drng = esdm_drng_init_instance();
+	struct esdm_pool *pool = &esdm_pool;
+	const struct esdm_hash_cb *hash_cb = drng->hash_cb;
+	void *nhash[ESDM_AUX_POOL_SHARDS_MAX] = { NULL };
+	uint32_t i, shards = 1, locked;
+	int ret = 0;
+
+	/*
+	 * One shard per CPU up to the maximum. Without a hash context
+	 * allocation only one hash state exists.
+	 */
+	if (hash_cb->hash_alloc) {
+		uint32_t cpus = min_uint32(esdm_online_nodes(),
+					   ESDM_AUX_POOL_SHARDS_MAX);
+
+		while ((shards << 1) <= cpus)
+			shards <<= 1;
+	}
+
+	/*
+	 * A re-initialization keeps the hash states of the shards in use.
+	 * Allocate only the missing ones before the pool is touched.
+	 */
+	if (hash_cb->hash_alloc) {
+		for (i = 0; i < shards; i++) {
+			if (i < pool->shards && pool->shard[i].aux_pool)
+				continue;
+			CKINT(hash_cb->hash_alloc(&nhash[i]));
+		}
+	}
+
+	/* The other shards are only used after they are set up here */
+	for (; pool->shards_init < shards; pool->shards_init++)
+		mutex_w_init(&pool->shard[pool->shards_init].lock, 0, 0);
+
+	/*
+	 * Hold the locks of the used and the added shards. Only this function
+	 * changes the number of shards, so it can be read before locking.
+	 */
+	locked = max_uint32(pool->shards, shards);
+	esdm_aux_lock_shards(locked);
+
+	if (shards < pool->shards)
+		esdm_aux_shrink_locked(hash_cb, shards);
+
+	for (i = 0; i < shards; i++) {
+		if (!nhash[i])
+			continue;
+		pool->shard[i].aux_pool = nhash[i];
+		pool->shard[i].initialized = false;
+		nhash[i] = NULL;
+	}
+	__atomic_store_n(&pool->shards, shards, __ATOMIC_RELEASE);
+
+	esdm_aux_unlock_shards(locked);
+
+	esdm_logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+		    "Aux ES hash allocated for %u shards\n", shards);
 
 	esdm_init_wakeup_bits();
 
@@ -136,25 +336,13 @@ static int esdm_aux_init(void)
 	esdm_shm_status_set_need_entropy();
 
 out:
-	mutex_unlock(&drng->hash_lock);
+	for (i = 0; i < ESDM_AUX_POOL_SHARDS_MAX; i++) {
+		if (nhash[i])
+			hash_cb->hash_dealloc(nhash[i]);
+	}
 	return ret;
 }
 
-static void esdm_aux_fini(void)
-{
-	struct esdm_drng *drng = esdm_drng_init_instance();
-	struct esdm_pool *pool = &esdm_pool;
-	const struct esdm_hash_cb *hash_cb;
-
-	mutex_lock(&drng->hash_lock);
-	hash_cb = drng->hash_cb;
-	if (hash_cb->hash_dealloc)
-		hash_cb->hash_dealloc(pool->aux_pool);
-	pool->aux_pool = NULL;
-	esdm_logger(LOGGER_DEBUG, LOGGER_C_ANY, "Aux ES hash deallocated\n");
-	mutex_unlock(&drng->hash_lock);
-}
-
 /* Obtain the digest size provided by the used hash in bits */
 DSO_PUBLIC
 uint32_t esdm_get_digestsize(void)
@@ -166,7 +354,13 @@ uint32_t esdm_get_digestsize(void)
 DSO_PUBLIC
 void esdm_pool_set_entropy(uint32_t entropy_bits)
 {
-	atomic_set(&esdm_pool.aux_entropy_bits, (int)entropy_bits);
+	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *shard;
+
+	/* The entropy content is maintained by shard 0 */
+	for_each_aux_shard (pool, shard)
+		atomic_set(&shard->aux_entropy_bits, 0);
+	atomic_set(&pool->shard[0].aux_entropy_bits, (int)entropy_bits);
 
 	/*
 	 * As the DRNG is newly seeded, maybe the need entropy flag can be
@@ -180,32 +374,18 @@ static void esdm_aux_reset(void)
 	esdm_pool_set_entropy(0);
 }
 
-/*
- * Replace old with new hash for auxiliary pool handling
- *
- * Assumption: the caller must guarantee that the new_cb is available during the
- * entire operation (e.g. it must hold the write lock against pointer updating).
- */
-static int esdm_aux_switch_hash(struct esdm_drng *drng, int __unused u,
-				const struct esdm_hash_cb *new_cb,
-				const struct esdm_hash_cb *old_cb)
+#ifdef ESDM_CRYPTO_SWITCH
+/* Replace old with new hash for one aux pool shard */
+static int esdm_aux_switch_hash_shard(struct esdm_aux_shard *shard,
+				      const struct esdm_hash_cb *new_cb,
+				      const struct esdm_hash_cb *old_cb)
 {
-#ifndef ESDM_CRYPTO_SWITCH
-	return -EOPNOTSUPP;
-#endif
-
-	struct esdm_drng *init_drng = esdm_drng_init_instance();
-	struct esdm_pool *pool = &esdm_pool;
-	void *shash = pool->aux_pool;
+	void *shash = shard->aux_pool;
 	void *nhash = NULL;
 	uint8_t digest[ESDM_MAX_DIGESTSIZE];
 	int ret;
 
-	if (!pool->initialized)
-		return 0;
-
-	/* We only switch if the processed DRNG is the initial DRNG. */
-	if (init_drng != drng)
+	if (!shard->initialized)
 		return 0;
 
 	CKINT(new_cb->hash_alloc(&nhash));
@@ -223,41 +403,76 @@ static int esdm_aux_switch_hash(struct esdm_drng *drng, int __unused u,
 	CKINT(new_cb->hash_update(nhash, digest, sizeof(digest)));
 
 	/* Switch the hash state */
-	pool->aux_pool = nhash;
+	shard->aux_pool = nhash;
 	nhash = NULL;
 	old_cb->hash_dealloc(shash);
 
-	esdm_set_digestsize(new_cb->hash_digestsize(pool->aux_pool));
+out:
+	new_cb->hash_dealloc(nhash);
+	memset_secure(digest, 0, sizeof(digest));
+	return ret;
+}
+#endif
+
+/*
+ * Replace old with new hash for auxiliary pool handling
+ *
+ * Assumption: the caller must guarantee that the new_cb is available during the
+ * entire operation (e.g. it must hold the write lock against pointer updating).
+ */
+static int esdm_aux_switch_hash(struct esdm_drng *drng, int __unused u,
+				const struct esdm_hash_cb *new_cb,
+				const struct esdm_hash_cb *old_cb)
+{
+#ifndef ESDM_CRYPTO_SWITCH
+	(void)drng;
+	(void)new_cb;
+	(void)old_cb;
+	return -EOPNOTSUPP;
+#else
+
+	struct esdm_drng *init_drng = esdm_drng_init_instance();
+	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *shard;
+	int ret = 0;
+
+	/* We only switch if the processed DRNG is the initial DRNG. */
+	if (init_drng != drng)
+		return 0;
+
+	for_each_aux_shard (pool, shard)
+		CKINT(esdm_aux_switch_hash_shard(shard, new_cb, old_cb));
+
+	esdm_set_digestsize(new_cb->hash_digestsize(pool->shard[0].aux_pool));
 	esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
 		    "Re-initialize aux entropy pool with hash %s\n",
 		    new_cb->hash_name());
 
 out:
-	new_cb->hash_dealloc(nhash);
-	memset_secure(digest, 0, sizeof(digest));
 	return ret;
+#endif
 }
 
 /* Insert data into auxiliary pool by using the hash update function. */
-static int esdm_aux_pool_insert_locked(const uint8_t *inbuf, size_t inbuflen,
+static int esdm_aux_pool_insert_locked(struct esdm_aux_shard *shard,
+				       const uint8_t *inbuf, size_t inbuflen,
 				       uint32_t entropy_bits)
 {
-	struct esdm_pool *pool = &esdm_pool;
-	struct hash_ctx *shash = (struct hash_ctx *)pool->aux_pool;
+	void *shash = shard->aux_pool;
 	struct esdm_drng *drng = esdm_drng_init_instance();
 	const struct esdm_hash_cb *hash_cb;
 	int ret;
 
 	entropy_bits = min_uint32(entropy_bits, (uint32_t)(inbuflen << 3));
 
-	mutex_reader_lock(&drng->hash_lock);
-	hash_cb = drng->hash_cb;
+	rcu_read_lock();
+	hash_cb = rcu_dereference(drng->hash_cb);
 
-	if (!pool->initialized) {
+	if (!shard->initialized) {
 		ret = hash_cb->hash_init(shash);
 		if (ret)
 			goto out;
-		pool->initialized = true;
+		shard->initialized = true;
 	}
 
 	ret = hash_cb->hash_update(shash, inbuf, inbuflen);
@@ -268,12 +483,13 @@ static int esdm_aux_pool_insert_locked(const uint8_t *inbuf, size_t inbuflen,
 	 * Cap the available entropy to the hash output size compliant to
 	 * SP800-90B section 3.1.5.1 table 1.
 	 */
-	entropy_bits += atomic_read_u32(&pool->aux_entropy_bits);
-	esdm_pool_set_entropy(
-		min_uint32(entropy_bits, hash_cb->hash_digestsize(shash) << 3));
+	entropy_bits += atomic_read_u32(&shard->aux_entropy_bits);
+	atomic_set(&shard->aux_entropy_bits,
+		   (int)min_uint32(entropy_bits,
+				   hash_cb->hash_digestsize(shash) << 3));
 
 out:
-	mutex_reader_unlock(&drng->hash_lock);
+	rcu_read_unlock();
 	return ret;
 }
 
@@ -281,12 +497,15 @@ DSO_PUBLIC
 int esdm_pool_insert_aux(const uint8_t *inbuf, size_t inbuflen,
 			 uint32_t entropy_bits)
 {
-	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *shard = esdm_aux_lock_curr_shard();
 	int ret;
 
-	mutex_w_lock(&pool->lock);
-	ret = esdm_aux_pool_insert_locked(inbuf, inbuflen, entropy_bits);
-	mutex_w_unlock(&pool->lock);
+	ret = esdm_aux_pool_insert_locked(shard, inbuf, inbuflen, entropy_bits);
+	mutex_w_unlock(&shard->lock);
+
+	/* Let the ES monitor seed the DRNGs with the new entropy */
+	if (!ret && entropy_bits && !esdm_pool_all_nodes_seeded_get())
+		esdm_es_mgr_monitor_wakeup();
 
 	/*
 	 * As the DRNG is newly seeded, maybe the need entropy flag can be
@@ -299,9 +518,64 @@ int esdm_pool_insert_aux(const uint8_t *inbuf, size_t inbuflen,
 
 /************************* Get data from entropy pool *************************/
 
+/*
+ * Fold the digests of all other shards into shard 0 and collect their entropy.
+ * Caller must hold the locks of all shards.
+ * @hash_cb: hash callbacks of the aux pool
+ * @digestsize_bits: digest size of the hash in bits
+ * @return: collected entropy in bits, < 0 on error
+ */
+static int64_t esdm_aux_fold_shards(const struct esdm_hash_cb *hash_cb,
+				    uint32_t digestsize_bits)
+{
+	struct esdm_pool *pool = &esdm_pool;
+	struct esdm_aux_shard *primary = &pool->shard[0], *shard;
+	uint8_t digest[ESDM_MAX_DIGESTSIZE];
+	uint64_t collected_ent_bits = 0;
+	int64_t ret = 0;
+
+	for_each_aux_shard (pool, shard) {
+		if (shard == primary || !shard->initialized)
+			continue;
+
+		if (!primary->initialized) {
+			ret = hash_cb->hash_init(primary->aux_pool);
+			if (ret)
+				goto out;
+			primary->initialized = true;
+		}
+
+		/*
+		 * Finalize the shard, re-initialize it and move its digest
+		 * into shard 0. The hash state of the shard is not credited
+		 * with entropy any more.
+		 */
+		ret = hash_cb->hash_final(shard->aux_pool, digest);
+		if (ret)
+			goto out;
+		ret = hash_cb->hash_init(shard->aux_pool);
+		if (ret)
+			goto out;
+		ret = hash_cb->hash_update(primary->aux_pool, digest,
+					   digestsize_bits >> 3);
+		if (ret)
+			goto out;
+
+		collected_ent_bits += min_uint32(
+			digestsize_bits,
+			(uint32_t)atomic_xchg(&shard->aux_entropy_bits, 0));
+	}
+
+	ret = (int64_t)collected_ent_bits;
+
+out:
+	memset_secure(digest, 0, sizeof(digest));
+	return ret;
+}
+
 /*
  * Get auxiliary entropy pool and its entropy content for seed buffer.
- * Caller must hold esdm_pool.pool->lock.
+ * Caller must hold the locks of all shards.
  * @outbuf: buffer to store data in with size requested_bits
  * @requested_bits: Requested amount of entropy
  * @return: amount of entropy in outbuf in bits.
@@ -309,23 +583,28 @@ int esdm_pool_insert_aux(const uint8_t *inbuf, size_t inbuflen,
 static uint32_t esdm_aux_get_pool(uint8_t *outbuf, uint32_t requested_bits)
 {
 	struct esdm_pool *pool = &esdm_pool;
-	struct hash_ctx *shash = (struct hash_ctx *)pool->aux_pool;
+	struct esdm_aux_shard *primary = &pool->shard[0];
 	struct esdm_drng *drng = esdm_drng_init_instance();
 	const struct esdm_hash_cb *hash_cb;
 	uint32_t collected_ent_bits, returned_ent_bits,
 		unused_bits = 0, digestsize, digestsize_bits,
 		requested_bits_osr;
 	uint8_t aux_output[ESDM_MAX_DIGESTSIZE];
+	int64_t folded_ent_bits;
 
-	if (!pool->initialized)
-		return 0;
+	rcu_read_lock();
 
-	mutex_reader_lock(&drng->hash_lock);
-
-	hash_cb = drng->hash_cb;
-	digestsize = hash_cb->hash_digestsize(shash);
+	hash_cb = rcu_dereference(drng->hash_cb);
+	digestsize = hash_cb->hash_digestsize(primary->aux_pool);
 	digestsize_bits = digestsize << 3;
 
+	/* Move the data of all shards into shard 0 */
+	folded_ent_bits = esdm_aux_fold_shards(hash_cb, digestsize_bits);
+	if (folded_ent_bits < 0 || !primary->initialized) {
+		rcu_read_unlock();
+		return 0;
+	}
+
 	/* Cap to maximum entropy that can ever be generated with given hash */
 	esdm_cap_requested(digestsize_bits, requested_bits);
 
@@ -334,16 +613,19 @@ static uint32_t esdm_aux_get_pool(uint8_t *outbuf, uint32_t requested_bits)
 	requested_bits_osr = requested_bits + esdm_compress_osr();
 
 	/* Cap entropy with entropy counter from aux pool and the used digest */
-	collected_ent_bits =
+	collected_ent_bits = min_uint32(
+		digestsize_bits,
 		min_uint32(digestsize_bits,
-			   (uint32_t)atomic_xchg(&pool->aux_entropy_bits, 0));
+			   (uint32_t)atomic_xchg(&primary->aux_entropy_bits,
+						 0)) +
+			(uint32_t)folded_ent_bits);
 
 	/* We collected too much entropy and put the overflow back */
 	if (collected_ent_bits > requested_bits_osr) {
 		/* Amount of bits we collected too much */
 		unused_bits = collected_ent_bits - requested_bits_osr;
 		/* Put entropy back */
-		atomic_add(&pool->aux_entropy_bits, (int)unused_bits);
+		atomic_add(&primary->aux_entropy_bits, (int)unused_bits);
 		/* Fix collected entropy */
 		collected_ent_bits = requested_bits_osr;
 	}
@@ -357,13 +639,13 @@ static uint32_t esdm_aux_get_pool(uint8_t *outbuf, uint32_t requested_bits)
 		returned_ent_bits, collected_ent_bits, unused_bits);
 
 	/* Get the digest for the aux pool to be returned to the caller ... */
-	if (hash_cb->hash_final(shash, aux_output) ||
+	if (hash_cb->hash_final(primary->aux_pool, aux_output) ||
 	    /*
 	     * ... and re-initialize the aux state. Do not add the aux pool
 	     * digest for backward secrecy as it will be added with the
 	     * insertion of the complete seed buffer after it has been filled.
 	     */
-	    hash_cb->hash_init(shash)) {
+	    hash_cb->hash_init(primary->aux_pool)) {
 		returned_ent_bits = 0;
 	} else {
 		/*
@@ -374,7 +656,7 @@ static uint32_t esdm_aux_get_pool(uint8_t *outbuf, uint32_t requested_bits)
 		memcpy(outbuf, aux_output, requested_bits >> 3);
 	}
 
-	mutex_reader_unlock(&drng->hash_lock);
+	rcu_read_unlock();
 	memset_secure(aux_output, 0, digestsize);
 	return returned_ent_bits;
 }
@@ -385,17 +667,17 @@ static void esdm_aux_get_backtrack(struct entropy_es *eb_es,
 	struct esdm_pool *pool = &esdm_pool;
 
 	/* Ensure aux pool extraction and backtracking op are atomic */
-	mutex_w_lock(&pool->lock);
+	esdm_aux_lock_all();
 
 	eb_es->e_bits = esdm_aux_get_pool(eb_es->e, requested_bits);
 
 	/* Mix the extracted data back into pool for backtracking resistance */
-	if (esdm_aux_pool_insert_locked((uint8_t *)eb_es,
+	if (esdm_aux_pool_insert_locked(&pool->shard[0], (uint8_t *)eb_es,
 					sizeof(struct entropy_es), 0))
 		esdm_logger(LOGGER_WARN, LOGGER_C_ES,
 			    "Backtracking resistance operation failed\n");
 
-	mutex_w_unlock(&pool->lock);
+	esdm_aux_unlock_all();
 }
 
 static void esdm_aux_es_state(char *buf, size_t buflen)
@@ -405,9 +687,10 @@ static void esdm_aux_es_state(char *buf, size_t buflen)
 	/* Assume the esdm_drng_init lock is taken by caller */
 	snprintf((char *)buf, buflen,
 		 " Hash for operating entropy pool: %s\n"
-		 " Available entropy: %u\n",
+		 " Available entropy: %u\n"
+		 " Pool shards: %u\n",
 		 esdm_drng_init->hash_cb->hash_name(),
-		 esdm_aux_avail_entropy(0));
+		 esdm_aux_avail_entropy(0), esdm_pool.shards);
 }
 
 static bool esdm_aux_active(void)
@@ -420,6 +703,8 @@ struct esdm_es_cb esdm_es_aux = {
 	.init = esdm_aux_init,
 	.fini = esdm_aux_fini,
 	.monitor_es = NULL,
+	.monitor_fd = NULL,
+	.monitor_notify = true,
 	.get_ent = esdm_aux_get_backtrack,
 	.curr_entropy = esdm_aux_avail_entropy,
 	.max_entropy = esdm_get_digestsize,
@@ -19,6 +19,7 @@
  * DAMAGE.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 
 #include "build_bug_on.h"
@@ -32,12 +33,108 @@
 #include "esdm_node.h"
 #include "helper.h"
 #include "mutex.h"
+#include "mutex_w.h"
 #include "ret_checkers.h"
 
+/* Number of CPU ES values hashed with one update */
+#define ESDM_CPU_BULK_WORDS 64
+#define ESDM_CPU_WORD_BITS ((uint32_t)(sizeof(unsigned long) << 3))
+
 static uint32_t esdm_cpu_data_multiplier = 0;
 
+#if !defined(ESDM_HASH_SHA512) && !defined(ESDM_HASH_SHA3_512)
+#define ESDM_CPU_HASH_CTX_PREALLOC
+
+/*
+ * Conditioning hash contexts for the CPU ES are allocated once per node and
+ * kept for all subsequent reseeds. The context records the hash it was
+ * allocated with to detect a switch of the hash.
+ */
+#define ESDM_CPU_HASH_CTX_MAX 64
+
+struct esdm_cpu_hash_ctx {
+	void *shash;
+	const struct esdm_hash_cb *hash_cb;
+	mutex_w_t lock;
+} __aligned(64);
+
+static struct esdm_cpu_hash_ctx esdm_cpu_hash_ctx[ESDM_CPU_HASH_CTX_MAX];
+static pthread_once_t esdm_cpu_hash_ctx_once = PTHREAD_ONCE_INIT;
+
+/* The locks are set up once as the ES may be reinitialized while in use */
+static void esdm_cpu_hash_ctx_init(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ESDM_CPU_HASH_CTX_MAX; i++) {
+		esdm_cpu_hash_ctx[i].shash = NULL;
+		esdm_cpu_hash_ctx[i].hash_cb = NULL;
+		mutex_w_init(&esdm_cpu_hash_ctx[i].lock, 0, 0);
+	}
+}
+
+/* Free the hash context, the caller must hold the lock */
+static void esdm_cpu_hash_ctx_free(struct esdm_cpu_hash_ctx *ctx)
+{
+	if (ctx->hash_cb && ctx->shash)
+		ctx->hash_cb->hash_dealloc(ctx->shash);
+	ctx->shash = NULL;
+	ctx->hash_cb = NULL;
+}
+
+/*
+ * Claim the hash context of the current node. If it is in use by another
+ * thread of the node, NULL is returned and the caller must use its own
+ * context.
+ */
+static struct esdm_cpu_hash_ctx *
+esdm_cpu_hash_ctx_get(const struct esdm_hash_cb *hash_cb)
+{
+	struct esdm_cpu_hash_ctx *ctx =
+		&esdm_cpu_hash_ctx[esdm_curr_node() % ESDM_CPU_HASH_CTX_MAX];
+
+	if (!mutex_w_trylock(&ctx->lock))
+		return NULL;
+
+	if (ctx->hash_cb == hash_cb)
+		return ctx;
+
+	esdm_cpu_hash_ctx_free(ctx);
+	if (hash_cb->hash_alloc && hash_cb->hash_alloc(&ctx->shash)) {
+		ctx->shash = NULL;
+		mutex_w_unlock(&ctx->lock);
+		return NULL;
+	}
+	ctx->hash_cb = hash_cb;
+
+	return ctx;
+}
+
+static void esdm_cpu_hash_ctx_put(struct esdm_cpu_hash_ctx *ctx)
+{
+	if (ctx)
+		mutex_w_unlock(&ctx->lock);
+}
+
+static void esdm_cpu_fini(void)
+{
+	unsigned int i;
+
+	pthread_once(&esdm_cpu_hash_ctx_once, esdm_cpu_hash_ctx_init);
+
+	for (i = 0; i < ESDM_CPU_HASH_CTX_MAX; i++) {
+		mutex_w_lock(&esdm_cpu_hash_ctx[i].lock);
+		esdm_cpu_hash_ctx_free(&esdm_cpu_hash_ctx[i]);
+		mutex_w_unlock(&esdm_cpu_hash_ctx[i].lock);
+	}
+}
+#endif /* ESDM_CPU_HASH_CTX_PREALLOC */
+
 static int esdm_cpu_init(void)
 {
+#ifdef ESDM_CPU_HASH_CTX_PREALLOC
+	pthread_once(&esdm_cpu_hash_ctx_once, esdm_cpu_hash_ctx_init);
+#endif
 	esdm_cpu_data_multiplier = 0;
 	return 0;
 }
@@ -55,26 +152,25 @@ static uint32_t esdm_cpu_poolsize(void)
 
 static uint32_t esdm_get_cpu_data(uint8_t *outbuf, uint32_t requested_bits)
 {
-	uint32_t i;
-
 	/* operate on full blocks */
 	BUILD_BUG_ON(ESDM_DRNG_SECURITY_STRENGTH_BYTES % sizeof(unsigned long));
 	BUILD_BUG_ON(ESDM_SEED_BUFFER_INIT_ADD_BITS % sizeof(unsigned long));
 	/* ensure we have aligned buffers */
 	BUILD_BUG_ON(ESDM_KCAPI_ALIGN % sizeof(unsigned long));
 
-	for (i = 0; i < (requested_bits >> 3); i += sizeof(unsigned long)) {
-		/*
-		 * The cast is appropriate as the thread local heap is aligned
-		 * to ESDM_KCAPI_ALIGN bits
-		 */
+	/*
+	 * The cast is appropriate as the thread local heap is aligned
+	 * to ESDM_KCAPI_ALIGN bits
+	 */
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-align"
-		if (!cpu_es_get((unsigned long *)(outbuf + i))) {
+	if (!cpu_es_get_bulk((unsigned long *)outbuf,
+			     (unsigned int)(((requested_bits >> 3) +
+					     sizeof(unsigned long) - 1) /
+					    sizeof(unsigned long)))) {
 #pragma GCC diagnostic pop
-			esdm_config_es_cpu_entropy_rate_set(0);
-			return 0;
-		}
+		esdm_config_es_cpu_entropy_rate_set(0);
+		return 0;
 	}
 
 	return requested_bits;
@@ -91,16 +187,26 @@ static uint32_t esdm_get_cpu_data_compress(uint8_t *outbuf,
 	LC_HASH_CTX_ON_STACK(shash, lc_sha3_512);
 	bool shash_free = false;
 #else
+	struct esdm_cpu_hash_ctx *ctx;
 	void *shash = NULL;
 	bool shash_free = true;
 #endif
+	unsigned long bulk[ESDM_CPU_BULK_WORDS];
 	const struct esdm_hash_cb *hash_cb;
-	struct esdm_drng *drng = esdm_drng_node_instance();
-	uint32_t ent_bits = 0, i, partial_bits = 0, digestsize, digestsize_bits,
-		 full_bits;
-
-	mutex_reader_lock(&drng->hash_lock);
-	hash_cb = drng->hash_cb;
+	struct esdm_drng *drng;
+	uint32_t ent_bits = 0, digestsize, digestsize_bits, full_bits, words;
+
+	rcu_read_lock();
+	drng = esdm_drng_node_instance();
+	hash_cb = rcu_dereference(drng->hash_cb);
+
+#ifdef ESDM_CPU_HASH_CTX_PREALLOC
+	ctx = esdm_cpu_hash_ctx_get(hash_cb);
+	if (ctx) {
+		shash = ctx->shash;
+		shash_free = false;
+	}
+#endif
 
 	if (shash_free) {
 		if (hash_cb->hash_alloc) {
@@ -116,32 +222,28 @@ static uint32_t esdm_get_cpu_data_compress(uint8_t *outbuf,
 	full_bits = requested_bits * multiplier;
 
 	/* Calculate oversampling for SP800-90C */
-	if (esdm_sp80090c_compliant()) {
-		/* Complete amount of bits to be pulled */
+	if (esdm_sp80090c_compliant())
 		full_bits += ESDM_OVERSAMPLE_ES_BITS * multiplier;
-		/* Full blocks that will be pulled */
-		multiplier = full_bits / requested_bits;
-		/* Partial block in bits to be pulled */
-		partial_bits = full_bits - (multiplier * requested_bits);
-	}
 
 	if (hash_cb->hash_init(shash))
 		goto out;
 
-	/* Hash all data from the CPU entropy source */
-	for (i = 0; i < multiplier; i++) {
-		ent_bits = esdm_get_cpu_data(outbuf, requested_bits);
-		if (!ent_bits)
+	/* Hash all data from the CPU entropy source in batches */
+	words = (full_bits + ESDM_CPU_WORD_BITS - 1) / ESDM_CPU_WORD_BITS;
+	while (words) {
+		uint32_t todo = min_uint32(words, ESDM_CPU_BULK_WORDS);
+
+		if (!cpu_es_get_bulk(bulk, todo)) {
+			esdm_config_es_cpu_entropy_rate_set(0);
 			goto out;
+		}
 
-		if (hash_cb->hash_update(shash, outbuf, ent_bits >> 3))
+		if (hash_cb->hash_update(shash, (uint8_t *)bulk,
+					 todo * sizeof(unsigned long)))
 			goto err;
-	}
 
-	/* Hash partial block, if applicable */
-	ent_bits = esdm_get_cpu_data(outbuf, partial_bits);
-	if (ent_bits && hash_cb->hash_update(shash, outbuf, ent_bits >> 3))
-		goto err;
+		words -= todo;
+	}
 
 	esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
 		    "pulled %u bits from CPU RNG entropy source\n", full_bits);
@@ -163,11 +265,15 @@ static uint32_t esdm_get_cpu_data_compress(uint8_t *outbuf,
 	}
 
 out:
+	memset_secure(bulk, 0, sizeof(bulk));
 	if (shash)
 		hash_cb->hash_desc_zero(shash);
 	if (shash_free && shash)
 		hash_cb->hash_dealloc(shash);
-	mutex_reader_unlock(&drng->hash_lock);
+#ifdef ESDM_CPU_HASH_CTX_PREALLOC
+	esdm_cpu_hash_ctx_put(ctx);
+#endif
+	rcu_read_unlock();
 	esdm_drng_put_instances();
 	return ent_bits;
 
@@ -279,8 +385,14 @@ static bool esdm_cpu_active(void)
 struct esdm_es_cb esdm_es_cpu = {
 	.name = "CPU",
 	.init = esdm_cpu_init,
+#ifdef ESDM_CPU_HASH_CTX_PREALLOC
+	.fini = esdm_cpu_fini,
+#else
 	.fini = NULL,
+#endif
 	.monitor_es = NULL,
+	.monitor_fd = NULL,
+	.monitor_notify = false,
 	.get_ent = esdm_cpu_get,
 	.curr_entropy = esdm_cpu_entropylevel,
 	.max_entropy = esdm_cpu_poolsize,
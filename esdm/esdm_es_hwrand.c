@@ -19,9 +19,12 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "build_bug_on.h"
@@ -32,15 +35,226 @@
 #include "esdm_es_hwrand.h"
 #include "esdm_node.h"
 #include "helper.h"
+#include "memset_secure.h"
 #include "mutex.h"
+#include "threading_support.h"
 
 #define ESDM_ES_HWRAND_AVAIL "/sys/devices/virtual/misc/hw_random/rng_available"
 #define ESDM_ES_HWRAND_IF "/dev/hwrng"
 
 static int esdm_hwrand_fd = -1;
 
+/*
+ * Asynchronous collection of /dev/hwrng data
+ *
+ * Hardware RNGs like TPMs or virtio-rng may need tens of milliseconds per
+ * read. A collector thread keeps a ring of blocks with /dev/hwrng data of the
+ * size of an initial seed filled, reseeds only copy a filled block. If no
+ * block is filled, /dev/hwrng is read synchronously as before.
+ */
+#define ESDM_HWRAND_ASYNC_BLOCKS 8
+
+struct esdm_hwrand_async {
+	struct entropy_es block[ESDM_HWRAND_ASYNC_BLOCKS];
+	bool filled[ESDM_HWRAND_ASYNC_BLOCKS];
+	unsigned int nfilled;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+	bool running;
+	bool stop;
+
+	/* Statistics of the reads of the collector */
+	uint64_t reads;
+	uint64_t read_errors;
+	uint64_t read_bytes;
+	uint64_t read_ns;
+	uint64_t read_ns_max;
+};
+
+static struct esdm_hwrand_async esdm_hwrand_async = {
+	.nfilled = 0,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cv = PTHREAD_COND_INITIALIZER,
+	.running = false,
+	.stop = false,
+};
+
+static uint64_t esdm_hwrand_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int esdm_hwrand_collector(void __unused *unused)
+{
+	struct esdm_hwrand_async *async = &esdm_hwrand_async;
+
+	thread_set_name(es_hwrand_collector, 0);
+
+	pthread_mutex_lock(&async->lock);
+	while (!async->stop) {
+		struct entropy_es *block;
+		uint64_t start, duration;
+		unsigned int slot;
+		int ret;
+
+		for (slot = 0; slot < ESDM_HWRAND_ASYNC_BLOCKS; slot++) {
+			if (!async->filled[slot])
+				break;
+		}
+
+		if (slot == ESDM_HWRAND_ASYNC_BLOCKS) {
+			pthread_cond_wait(&async->cv, &async->lock);
+			continue;
+		}
+
+		/* Only the collector accesses a block that is not filled */
+		block = &async->block[slot];
+		pthread_mutex_unlock(&async->lock);
+
+		start = esdm_hwrand_ns();
+		ret = esdm_safe_read(esdm_hwrand_fd, block->e,
+				     ESDM_DRNG_INIT_SEED_SIZE_BYTES);
+		duration = esdm_hwrand_ns() - start;
+
+		pthread_mutex_lock(&async->lock);
+
+		if (ret) {
+			struct timespec ts;
+
+			async->read_errors++;
+			esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
+				    "Reading %s failed: %d\n",
+				    ESDM_ES_HWRAND_IF, ret);
+
+			/* Do not spin on a failing device */
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			ts.tv_sec++;
+			if (!async->stop)
+				pthread_cond_clockwait(&async->cv, &async->lock,
+						       CLOCK_MONOTONIC, &ts);
+			continue;
+		}
+
+		async->reads++;
+		async->read_bytes += ESDM_DRNG_INIT_SEED_SIZE_BYTES;
+		async->read_ns += duration;
+		if (duration > async->read_ns_max)
+			async->read_ns_max = duration;
+
+		async->filled[slot] = true;
+		async->nfilled++;
+	}
+	async->running = false;
+	pthread_cond_broadcast(&async->cv);
+	pthread_mutex_unlock(&async->lock);
+
+	return 0;
+}
+
+static void esdm_hwrand_async_stop(void)
+{
+	struct esdm_hwrand_async *async = &esdm_hwrand_async;
+
+	pthread_mutex_lock(&async->lock);
+	async->stop = true;
+	pthread_cond_broadcast(&async->cv);
+
+	/* Wait for the collector to terminate */
+	while (async->running)
+		pthread_cond_wait(&async->cv, &async->lock);
+
+	memset_secure(async->block, 0, sizeof(async->block));
+	memset(async->filled, 0, sizeof(async->filled));
+	async->nfilled = 0;
+	pthread_mutex_unlock(&async->lock);
+}
+
+static void esdm_hwrand_async_start(void)
+{
+	struct esdm_hwrand_async *async = &esdm_hwrand_async;
+	int ret;
+
+	pthread_mutex_lock(&async->lock);
+	if (async->running || async->stop)
+		goto out;
+
+	async->reads = 0;
+	async->read_errors = 0;
+	async->read_bytes = 0;
+	async->read_ns = 0;
+	async->read_ns_max = 0;
+
+	ret = thread_start(esdm_hwrand_collector, NULL, ESDM_THREAD_ES_HWRAND,
+			   NULL);
+	if (ret) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_ES,
+			    "Starting /dev/hwrng collector failed: %d\n", ret);
+		/* Serve the requests synchronously, do not retry */
+		async->stop = true;
+	} else {
+		async->running = true;
+	}
+
+out:
+	pthread_mutex_unlock(&async->lock);
+}
+
+/*
+ * ES monitor: start the collector. The monitor executes in the server process
+ * whereas the init callback executes before the server forks - a collector
+ * started there would only exist in the parent.
+ */
+static int esdm_hwrand_monitor(void)
+{
+	if (esdm_hwrand_fd >= 0 && esdm_config_es_hwrand_async_enabled())
+		esdm_hwrand_async_start();
+
+	return 0;
+}
+
+/* Take one filled block if it covers the request */
+static bool esdm_hwrand_async_get(struct entropy_es *eb_es,
+				  uint32_t requested_bits)
+{
+	struct esdm_hwrand_async *async = &esdm_hwrand_async;
+	unsigned int slot;
+	bool found = false;
+
+	if (requested_bits > ESDM_DRNG_INIT_SEED_SIZE_BITS)
+		return false;
+
+	pthread_mutex_lock(&async->lock);
+	if (!async->running || !async->nfilled)
+		goto out;
+
+	for (slot = 0; slot < ESDM_HWRAND_ASYNC_BLOCKS; slot++) {
+		if (async->filled[slot])
+			break;
+	}
+
+	memcpy(eb_es->e, async->block[slot].e, requested_bits >> 3);
+	memset_secure(async->block[slot].e, 0,
+		      sizeof(async->block[slot].e));
+	async->filled[slot] = false;
+	async->nfilled--;
+	found = true;
+
+	/* Refill the block */
+	pthread_cond_signal(&async->cv);
+
+out:
+	pthread_mutex_unlock(&async->lock);
+	return found;
+}
+
 static void esdm_hwrand_finalize(void)
 {
+	esdm_hwrand_async_stop();
+
 	if (esdm_hwrand_fd >= 0)
 		close(esdm_hwrand_fd);
 	esdm_hwrand_fd = -1;
@@ -78,6 +292,11 @@ static int esdm_hwrand_init(void)
 		close(fd);
 	}
 
+	/* Allow the ES monitor to start the collector */
+	pthread_mutex_lock(&esdm_hwrand_async.lock);
+	esdm_hwrand_async.stop = false;
+	pthread_mutex_unlock(&esdm_hwrand_async.lock);
+
 	return 0;
 }
 
@@ -101,17 +320,21 @@ static uint32_t esdm_hwrand_poolsize(void)
 static void esdm_hwrand_get(struct entropy_es *eb_es, uint32_t requested_bits,
 			    bool __unused unsused)
 {
+	bool async;
+
 	if (esdm_hwrand_fd < 0)
 		goto err;
 
-	if (esdm_safe_read(esdm_hwrand_fd, eb_es->e, requested_bits >> 3))
+	async = esdm_hwrand_async_get(eb_es, requested_bits);
+	if (!async &&
+	    esdm_safe_read(esdm_hwrand_fd, eb_es->e, requested_bits >> 3))
 		goto err;
 
 	eb_es->e_bits = esdm_hwrand_entropylevel(requested_bits);
 	esdm_logger(
 		LOGGER_DEBUG, LOGGER_C_ES,
-		"obtained %u bits of entropy from /dev/hwrng RNG entropy source\n",
-		eb_es->e_bits);
+		"obtained %u bits of entropy from %ssynchronous /dev/hwrng RNG entropy source\n",
+		eb_es->e_bits, async ? "a" : "");
 
 	return;
 
@@ -121,11 +344,37 @@ err:
 
 static void esdm_hwrand_es_state(char *buf, size_t buflen)
 {
+	struct esdm_hwrand_async *async = &esdm_hwrand_async;
+	size_t len;
+
 	/* Assume the esdm_drng_init lock is taken by caller */
 	snprintf(buf, buflen,
 		 " Available entropy: %u\n"
 		 " Entropy Rate per 256 data bits: %u\n",
 		 esdm_hwrand_poolsize(), esdm_hwrand_entropylevel(256));
+
+	pthread_mutex_lock(&async->lock);
+	if (async->running) {
+		uint64_t avg_ns = async->reads ? async->read_ns / async->reads :
+						 0;
+		uint64_t throughput =
+			async->read_ns ? async->read_bytes * 1000000000ULL /
+						 async->read_ns :
+					 0;
+
+		len = strlen(buf);
+		snprintf(buf + len, buflen - len,
+			 " Async blocks filled: %u of %u\n"
+			 " Read latency (us): avg %lu, max %lu\n"
+			 " Read throughput (bytes/s): %lu\n"
+			 " Read errors: %lu\n",
+			 async->nfilled, ESDM_HWRAND_ASYNC_BLOCKS,
+			 (unsigned long)(avg_ns / 1000),
+			 (unsigned long)(async->read_ns_max / 1000),
+			 (unsigned long)throughput,
+			 (unsigned long)async->read_errors);
+	}
+	pthread_mutex_unlock(&async->lock);
 }
 
 static bool esdm_hwrand_active(void)
@@ -137,7 +386,9 @@ struct esdm_es_cb esdm_es_hwrand = {
 	.name = "LinuxHWRand",
 	.init = esdm_hwrand_init,
 	.fini = esdm_hwrand_finalize,
-	.monitor_es = NULL,
+	.monitor_es = esdm_hwrand_monitor,
+	.monitor_fd = NULL,
+	.monitor_notify = true,
 	.get_ent = esdm_hwrand_get,
 	.curr_entropy = esdm_hwrand_entropylevel,
 	.max_entropy = esdm_hwrand_poolsize,
@@ -38,12 +38,14 @@
 static int esdm_irq_entropy_fd = -1;
 static uint32_t esdm_irq_requested_bits_set = 0;
 static enum esdm_es_data_size esdm_irq_data_size = esdm_es_data_equal;
+static bool esdm_irq_notify = false;
 
 static void esdm_irq_finalize(void)
 {
 	if (esdm_irq_entropy_fd >= 0)
 		close(esdm_irq_entropy_fd);
 	esdm_irq_entropy_fd = -1;
+	esdm_irq_notify = false;
 }
 
 bool esdm_irq_enabled(void)
@@ -169,6 +171,9 @@ static int esdm_irq_initialize(void)
 
 	esdm_irq_entropy_fd = fd;
 
+	/* Kernel supports the readiness notification of the ES */
+	esdm_irq_notify = !esdm_kernel_notify_ack(fd);
+
 	/*
 	 * The presence of the interrupt entropy source implies that the main
          * entropy source of the kernel random.c is being taken away.
@@ -212,6 +217,9 @@ static int esdm_irq_seed_monitor(void)
 	if (esdm_irq_entropy_fd < 0)
 		return 0;
 
+	if (esdm_irq_notify)
+		esdm_kernel_notify_ack(esdm_irq_entropy_fd);
+
 	ent = esdm_irq_entropylevel(esdm_security_strength());
 
 	if (!esdm_config_es_irq_entropy_rate())
@@ -227,6 +235,14 @@ static int esdm_irq_seed_monitor(void)
 	return 0;
 }
 
+static int esdm_irq_monitor_fd(void)
+{
+	if (!esdm_irq_notify)
+		return -EOPNOTSUPP;
+
+	return esdm_irq_entropy_fd;
+}
+
 static uint32_t esdm_irq_poolsize(void)
 {
 	return esdm_irq_entropylevel(esdm_security_strength());
@@ -322,6 +338,8 @@ struct esdm_es_cb esdm_es_irq = {
 	.name = "Interrupt",
 	.init = esdm_irq_initialize,
 	.monitor_es = esdm_irq_seed_monitor,
+	.monitor_fd = esdm_irq_monitor_fd,
+	.monitor_notify = false,
 	.fini = esdm_irq_finalize,
 	.get_ent = esdm_irq_get,
 	.curr_entropy = esdm_irq_entropylevel,
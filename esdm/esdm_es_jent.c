@@ -25,6 +25,7 @@
 #include "build_bug_on.h"
 #include "config.h"
 #include "esdm_config.h"
+#include "esdm_config_internal.h"
 #include "esdm_definitions.h"
 #include "esdm_es_aux.h"
 #include "esdm_es_jent.h"
@@ -128,6 +129,7 @@ err:
 static int esdm_jent_async_monitor(void)
 {
 	unsigned int i, requested_bits = esdm_get_seed_entropy_osr(true);
+	bool pin;
 
 	if (!esdm_config_es_jent_async_enabled())
 		return 0;
@@ -135,6 +137,14 @@ static int esdm_jent_async_monitor(void)
 	esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
 		    "Jitter RNG block filling started\n");
 
+	/*
+	 * Collect the Jitter RNG blocks on the CPUs dedicated to it. Without
+	 * such CPUs, the monitor thread keeps its affinity.
+	 */
+	pin = !!esdm_config_affinity_ncpus(esdm_config_affinity_jent);
+	if (pin)
+		esdm_config_affinity_apply(esdm_config_affinity_jent);
+
 	for (i = 0; i < ESDM_JENT_ENTROPY_BLOCKS; i++) {
 		if (__sync_val_compare_and_swap(&esdm_jent_async_set[i],
 						buffer_empty,
@@ -156,6 +166,9 @@ static int esdm_jent_async_monitor(void)
 			i, requested_bits);
 	}
 
+	if (pin)
+		esdm_config_affinity_apply(esdm_config_affinity_es_monitor);
+
 	esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
 		    "Jitter RNG block filling completed\n");
 
@@ -341,8 +354,12 @@ struct esdm_es_cb esdm_es_jent = {
 	.fini = esdm_jent_finalize,
 #if (ESDM_JENT_ENTROPY_BLOCKS != 0)
 	.monitor_es = esdm_jent_async_monitor,
+	.monitor_fd = NULL,
+	.monitor_notify = true,
 #else
 	.monitor_es = NULL,
+	.monitor_fd = NULL,
+	.monitor_notify = false,
 #endif
 	.get_ent = esdm_jent_get_check,
 	.curr_entropy = esdm_jent_entropylevel,
@@ -135,6 +135,8 @@ struct esdm_es_cb esdm_es_jent_kernel = {
 	.init = esdm_jent_kernel_init,
 	.fini = esdm_jent_kernel_finalize,
 	.monitor_es = NULL,
+	.monitor_fd = NULL,
+	.monitor_notify = false,
 	.get_ent = esdm_jent_kernel_get,
 	.curr_entropy = esdm_jent_kernel_entropylevel,
 	.max_entropy = esdm_jent_kernel_poolsize,
@@ -22,6 +22,7 @@
 #define _DEFAULT_SOURCE
 #include <errno.h>
 #include <limits.h>
+#include <sys/mman.h>
 #include <sys/random.h>
 #include <sys/select.h>
 #include <sys/stat.h>
@@ -34,9 +35,190 @@
 #include "esdm_config.h"
 #include "esdm_es_aux.h"
 #include "esdm_es_krng.h"
+#include "esdm_es_mgr.h"
 #include "esdm_es_sched.h"
 #include "helper.h"
 #include "esdm_logger.h"
+#include "memset_secure.h"
+#include "mutex_w.h"
+
+static inline ssize_t __getrandom(uint8_t *buffer, size_t bufferlen,
+				  unsigned int flags)
+{
+	ssize_t ret, totallen = 0;
+
+	if (bufferlen > INT_MAX)
+		return -EINVAL;
+
+	do {
+#ifdef USE_GLIBC_GETRANDOM
+		ret = getrandom(buffer, bufferlen, flags);
+#else
+		ret = syscall(__NR_getrandom, buffer, bufferlen, flags);
+#endif
+		if (ret > 0) {
+			bufferlen -= (size_t)ret;
+			buffer += ret;
+			totallen += ret;
+		}
+	} while ((ret > 0 || errno == EINTR) && bufferlen);
+
+	return ((ret < 0) ? -errno : totallen);
+}
+
+/*
+ * Kernel RNG reservoir
+ *
+ * When enabled, the ES monitor prefetches kernel RNG data into the reservoir
+ * and reseeds take their data from memory instead of issuing the getrandom
+ * system call. The reservoir is locked into memory and every byte is wiped
+ * when it is handed out, i.e. each byte is used for exactly one seed. Data is
+ * only prefetched once the kernel RNG is initialized. If the reservoir cannot
+ * serve a request completely, the kernel RNG is invoked directly.
+ */
+#define ESDM_KRNG_RESERVOIR_SIZE 1024
+
+struct esdm_krng_reservoir {
+	uint8_t buf[ESDM_KRNG_RESERVOIR_SIZE];
+	uint32_t fill; /* Bytes of data at the beginning of buf */
+	bool locked; /* Is buf locked into memory? */
+	mutex_w_t lock;
+};
+
+static struct esdm_krng_reservoir esdm_krng_reservoir __aligned(64) = {
+	.fill = 0,
+	.locked = false,
+	.lock = MUTEX_W_UNLOCKED,
+};
+
+static void esdm_krng_reservoir_init(void)
+{
+	struct esdm_krng_reservoir *res = &esdm_krng_reservoir;
+
+	if (!esdm_config_es_krng_reservoir_enabled())
+		return;
+
+	mutex_w_lock(&res->lock);
+	if (!res->locked) {
+		if (mlock(res->buf, sizeof(res->buf))) {
+			esdm_logger(
+				LOGGER_WARN, LOGGER_C_ES,
+				"Kernel RNG reservoir cannot be locked into memory: %s\n",
+				strerror(errno));
+		} else {
+			res->locked = true;
+		}
+	}
+	mutex_w_unlock(&res->lock);
+
+	/* Trigger the initial filling if the ES monitor already runs */
+	esdm_es_mgr_monitor_wakeup();
+}
+
+static void esdm_krng_reservoir_fini(void)
+{
+	struct esdm_krng_reservoir *res = &esdm_krng_reservoir;
+
+	mutex_w_lock(&res->lock);
+	memset_secure(res->buf, 0, sizeof(res->buf));
+	res->fill = 0;
+	if (res->locked) {
+		munlock(res->buf, sizeof(res->buf));
+		res->locked = false;
+	}
+	mutex_w_unlock(&res->lock);
+}
+
+/* Take len bytes from the reservoir - all or nothing */
+static bool esdm_krng_reservoir_get(uint8_t *outbuf, uint32_t len)
+{
+	struct esdm_krng_reservoir *res = &esdm_krng_reservoir;
+	bool refill;
+
+	if (!esdm_config_es_krng_reservoir_enabled())
+		return false;
+
+	mutex_w_lock(&res->lock);
+	if (res->fill < len) {
+		mutex_w_unlock(&res->lock);
+		esdm_es_mgr_monitor_wakeup();
+		return false;
+	}
+
+	res->fill -= len;
+	memcpy(outbuf, res->buf + res->fill, len);
+	memset_secure(res->buf + res->fill, 0, len);
+	refill = res->fill < (ESDM_KRNG_RESERVOIR_SIZE >> 1);
+	mutex_w_unlock(&res->lock);
+
+	if (refill)
+		esdm_es_mgr_monitor_wakeup();
+
+	return true;
+}
+
+/* ES monitor: top up the reservoir */
+static int esdm_krng_monitor(void)
+{
+	struct esdm_krng_reservoir *res = &esdm_krng_reservoir;
+	uint8_t tmp[ESDM_KRNG_RESERVOIR_SIZE];
+	uint32_t space;
+	ssize_t ret;
+
+	/*
+	 * Only fetch data if the reservoir is used and the ES delivers
+	 * entropy, i.e. it is not disabled with an entropy rate of zero.
+	 */
+	if (!esdm_config_es_krng_reservoir_enabled() ||
+	    !esdm_config_es_krng_entropy_rate())
+		return 0;
+
+	mutex_w_lock(&res->lock);
+	space = ESDM_KRNG_RESERVOIR_SIZE - res->fill;
+	mutex_w_unlock(&res->lock);
+
+	if (!space)
+		return 0;
+
+	/* Do not hold the lock during the system call */
+	ret = __getrandom(tmp, space, GRND_NONBLOCK);
+	if (ret < 0) {
+		/*
+		 * The kernel RNG is not yet initialized - its data must not
+		 * enter the reservoir. Let the monitor retry periodically.
+		 * Note, -EAGAIN would block the privileged initialization.
+		 */
+		if (ret == -EAGAIN)
+			return -EINPROGRESS;
+		return (int)ret;
+	}
+
+	mutex_w_lock(&res->lock);
+	space = min_uint32(ESDM_KRNG_RESERVOIR_SIZE - res->fill,
+			   (uint32_t)ret);
+	memcpy(res->buf + res->fill, tmp, space);
+	res->fill += space;
+	mutex_w_unlock(&res->lock);
+
+	memset_secure(tmp, 0, sizeof(tmp));
+
+	esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
+		    "Kernel RNG reservoir filled with %u bytes\n", space);
+
+	return 0;
+}
+
+static uint32_t esdm_krng_reservoir_fill(void)
+{
+	struct esdm_krng_reservoir *res = &esdm_krng_reservoir;
+	uint32_t fill;
+
+	mutex_w_lock(&res->lock);
+	fill = res->fill;
+	mutex_w_unlock(&res->lock);
+
+	return fill;
+}
 
 /*
  * Shall we use select() to wait for an initialization of the kernel RNG or
@@ -124,12 +306,14 @@ static int esdm_krng_init(void)
 	} while (errno == EINTR);
 
 	close(fd);
+	esdm_krng_reservoir_init();
 	return 0;
 }
 
 static void esdm_krng_fini(void)
 {
 	atomic_set(&esdm_krng_cancel, 1);
+	esdm_krng_reservoir_fini();
 }
 
 #else /* ESDM_KRNG_ES_SELECT */
@@ -138,12 +322,14 @@ static uint32_t krng_entropy = ESDM_KERNEL_RNG_ENTROPY_RATE;
 
 static void esdm_krng_fini(void)
 {
+	esdm_krng_reservoir_fini();
 }
 
 static int esdm_krng_init(void)
 {
 	/* Allow the init function to be called multiple times */
 	esdm_krng_fini();
+	esdm_krng_reservoir_init();
 
 	/* Do not trigger a reseed if the DRNG manger is not available */
 	if (!esdm_get_available())
@@ -195,30 +381,6 @@ static uint32_t esdm_krng_poolsize(void)
 	return esdm_krng_entropylevel(esdm_security_strength());
 }
 
-static inline ssize_t __getrandom(uint8_t *buffer, size_t bufferlen,
-				  unsigned int flags)
-{
-	ssize_t ret, totallen = 0;
-
-	if (bufferlen > INT_MAX)
-		return -EINVAL;
-
-	do {
-#ifdef USE_GLIBC_GETRANDOM
-		ret = getrandom(buffer, bufferlen, flags);
-#else
-		ret = syscall(__NR_getrandom, buffer, bufferlen, flags);
-#endif
-		if (ret > 0) {
-			bufferlen -= (size_t)ret;
-			buffer += ret;
-			totallen += ret;
-		}
-	} while ((ret > 0 || errno == EINTR) && bufferlen);
-
-	return ((ret < 0) ? -errno : totallen);
-}
-
 /*
  * esdm_krng_get() - Get kernel RNG entropy
  *
@@ -229,8 +391,22 @@ static void esdm_krng_get(struct entropy_es *eb_es, uint32_t requested_bits,
 			  bool __unused unused)
 {
 	uint32_t ent_bits = esdm_krng_entropylevel(requested_bits);
-	ssize_t ret = __getrandom(eb_es->e, requested_bits >> 3, GRND_NONBLOCK);
+	ssize_t ret;
+
+	/*
+	 * The reservoir only holds data of the initialized kernel RNG and
+	 * every byte is credited once with the regular entropy rate.
+	 */
+	if (esdm_krng_reservoir_get(eb_es->e, requested_bits >> 3)) {
+		esdm_logger(
+			LOGGER_DEBUG, LOGGER_C_ES,
+			"obtained %u bits of entropy from kernel RNG reservoir\n",
+			ent_bits);
+		eb_es->e_bits = ent_bits;
+		return;
+	}
 
+	ret = __getrandom(eb_es->e, requested_bits >> 3, GRND_NONBLOCK);
 	if (ret < 0) {
 		if (ret == -EAGAIN) {
 			esdm_logger(
@@ -254,10 +430,20 @@ static void esdm_krng_get(struct entropy_es *eb_es, uint32_t requested_bits,
 
 static void esdm_krng_es_state(char *buf, size_t buflen)
 {
+	size_t len;
+
 	snprintf(buf, buflen,
 		 " Available entropy: %u\n"
 		 " Entropy Rate per 256 data bits: %u\n",
 		 esdm_krng_poolsize(), esdm_krng_entropylevel(256));
+
+	if (!esdm_config_es_krng_reservoir_enabled())
+		return;
+
+	len = strlen(buf);
+	snprintf(buf + len, buflen - len,
+		 " Reservoir fill level: %u of %u bytes\n",
+		 esdm_krng_reservoir_fill(), ESDM_KRNG_RESERVOIR_SIZE);
 }
 
 static bool esdm_krng_active(void)
@@ -269,7 +455,9 @@ struct esdm_es_cb esdm_es_krng = {
 	.name = "KernelRNG",
 	.init = esdm_krng_init,
 	.fini = esdm_krng_fini,
-	.monitor_es = NULL,
+	.monitor_es = esdm_krng_monitor,
+	.monitor_fd = NULL,
+	.monitor_notify = true,
 	.get_ent = esdm_krng_get,
 	.curr_entropy = esdm_krng_entropylevel,
 	.max_entropy = esdm_krng_poolsize,
@@ -21,7 +21,9 @@
 
 #define _POSIX_C_SOURCE 200112L
 #include <errno.h>
+#include <poll.h>
 #include <stdint.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <time.h>
 #include <unistd.h>
@@ -39,6 +41,7 @@
 #include "esdm_es_krng.h"
 #include "esdm_es_mgr.h"
 #include "esdm_es_sched.h"
+#include "esdm_seed_file.h"
 #include "esdm_interface_dev_common.h"
 #include "esdm_shm_status.h"
 #include "helper.h"
@@ -87,8 +90,14 @@ uint32_t esdm_write_wakeup_bits = (ESDM_WRITE_WAKEUP_ENTROPY << 3);
 
 static atomic_t esdm_es_mgr_terminate = ATOMIC_INIT(0);
 
-/* Wait queue to wait until the ESDM is not initialized. */
-static DECLARE_WAIT_QUEUE(esdm_monitor_wait);
+/*
+ * Wake up event of the ES monitor. The eventfd is kept open for the lifetime
+ * of the process as the ES may raise a wakeup from any thread at any time.
+ */
+static int esdm_monitor_efd = -1;
+
+/* Poll interval of ES which do not offer a readiness notification */
+#define ESDM_ES_MONITOR_POLL_MS 500
 
 /*
  * The entries must be in the same order as defined by enum esdm_internal_es and
@@ -124,19 +133,84 @@ struct esdm_es_cb *esdm_es[] = {
 /* Restart the ES monitor if it is sleeping */
 void esdm_es_mgr_monitor_wakeup(void)
 {
-	thread_wake_all(&esdm_monitor_wait);
+	static const uint64_t one = 1;
+	int fd = esdm_monitor_efd;
+	ssize_t rc;
+
+	if (fd < 0)
+		return;
+
+	/* A failure implies that a wakeup is already pending */
+	rc = write(fd, &one, sizeof(one));
+	(void)rc;
+}
+
+/*
+ * Sleep until an ES notifies the availability of new entropy or the monitor
+ * is woken up. While not all DRNGs are seeded, the readiness notification of
+ * the ES is waited for and ES without notification are polled periodically.
+ */
+static void esdm_es_mgr_monitor_wait(bool periodic)
+{
+	struct pollfd fds[esdm_ext_es_last + 1];
+	uint64_t events;
+	unsigned int i;
+	nfds_t nfds = 0;
+	ssize_t rc;
+
+	if (esdm_monitor_efd >= 0) {
+		fds[nfds].fd = esdm_monitor_efd;
+		fds[nfds].events = POLLIN;
+		nfds++;
+	} else {
+		periodic = true;
+	}
+
+	if (!esdm_pool_all_nodes_seeded_get()) {
+		for_each_esdm_es (i) {
+			const struct esdm_es_cb *es = esdm_es[i];
+			int fd = -EOPNOTSUPP;
+
+			if (!es->monitor_es || es->monitor_notify ||
+			    !es->active())
+				continue;
+
+			if (es->monitor_fd)
+				fd = es->monitor_fd();
+			if (fd < 0) {
+				periodic = true;
+				continue;
+			}
+
+			fds[nfds].fd = fd;
+			fds[nfds].events = POLLIN;
+			nfds++;
+		}
+	}
+
+	if (poll(fds, nfds, periodic ? ESDM_ES_MONITOR_POLL_MS : -1) < 0 &&
+	    errno != EINTR) {
+		esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
+			    "Entropy monitor wait failed: %d\n", -errno);
+	}
+
+	/* Consume the wakeups */
+	if (esdm_monitor_efd >= 0) {
+		rc = read(esdm_monitor_efd, &events, sizeof(events));
+		(void)rc;
+	}
 }
 
 /* ES monitor worker loop */
 int esdm_es_mgr_monitor_initialize(void (*priv_init_completion)(void))
 {
-	struct timespec ts = { .tv_sec = 0, .tv_nsec = 1U << 29 };
 	unsigned int i, avail = 0;
 	bool priv_init_completed = false;
 
 	for_each_esdm_es (i) {
 		if (esdm_es[i]->active())
-			avail += !!esdm_es[i]->monitor_es;
+			avail += !!(esdm_es[i]->monitor_es ||
+				    esdm_es[i]->monitor_notify);
 	}
 
 	if (!avail) {
@@ -149,6 +223,16 @@ int esdm_es_mgr_monitor_initialize(void (*priv_init_completion)(void))
 		return 0;
 	}
 
+	if (esdm_monitor_efd < 0) {
+		esdm_monitor_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (esdm_monitor_efd < 0) {
+			esdm_logger(
+				LOGGER_WARN, LOGGER_C_ES,
+				"Entropy monitor wakeup not available, polling entropy sources: %d\n",
+				-errno);
+		}
+	}
+
 	esdm_logger(LOGGER_DEBUG, LOGGER_C_ES,
 		    "Full entropy monitor started\n");
 
@@ -178,11 +262,12 @@ int esdm_es_mgr_monitor_initialize(void (*priv_init_completion)(void))
 			priv_init_completed = true;
 		}
 
-		if (!ret && esdm_pool_all_nodes_seeded_get()) {
-			thread_wait_no_event(&esdm_monitor_wait);
-		} else {
-			nanosleep(&ts, NULL);
-		}
+		/* Seed the DRNGs with the entropy an ES notified */
+		if (!esdm_pool_all_nodes_seeded_get())
+			esdm_es_add_entropy();
+
+		/* Errors are retried periodically */
+		esdm_es_mgr_monitor_wait(!!ret);
 	}
 
 	if (!priv_init_completed && priv_init_completion)
@@ -194,6 +279,32 @@ int esdm_es_mgr_monitor_initialize(void (*priv_init_completion)(void))
 
 /******************************** Read Helper *********************************/
 
+/**
+ * Acknowledge the readiness notification of the kernel entropy sources such
+ * as IRQ / Sched ES.
+ *
+ * @param [in] fd file descriptor to the entropy source
+ *
+ * @return 0 on success, < 0 if the kernel does not offer the notification
+ */
+int esdm_kernel_notify_ack(int fd)
+{
+	uint32_t events;
+	ssize_t rc;
+
+	if (fd < 0)
+		return -EBADF;
+
+	/* The read never blocks */
+	rc = read(fd, &events, sizeof(events));
+	if (rc < 0)
+		return -errno;
+	if (rc != sizeof(events))
+		return -EOPNOTSUPP;
+
+	return 0;
+}
+
 /**
  * Common read function to obtain data from the kernel entropy sources
  * such as IRQ / Sched ES.
@@ -706,6 +817,9 @@ int esdm_es_mgr_initialize(void)
 	esdm_pool_insert_aux((uint8_t *)&seed, sizeof(seed), 0);
 	memset_secure(&seed, 0, sizeof(seed));
 
+	/* Insert the seed file left behind by the previous instance */
+	esdm_seed_file_load();
+
 	esdm_logger(LOGGER_VERBOSE, LOGGER_C_ES,
 		    "Force fully seeding of all DRBGs\n");
 	esdm_force_fully_seeded_all_drbgs();
@@ -728,12 +842,19 @@ void esdm_es_mgr_finalize(void)
 	}
 }
 
-bool esdm_es_reseed_wanted(void)
+bool esdm_es_seed_avail(void)
 {
 	/* If the ESDM is not yet available, skip */
 	if (!esdm_get_available())
 		return false;
 
+	/* Only trigger the DRNG reseed if we have collected entropy. */
+	return esdm_avail_entropy() >=
+	       atomic_read_u32(&esdm_state.boot_entropy_thresh);
+}
+
+bool esdm_es_reseed_wanted(void)
+{
 	/*
 	 * Once all DRNGs are fully seeded, the system-triggered arrival of
 	 * entropy will not cause any reseeding any more.
@@ -741,17 +862,15 @@ bool esdm_es_reseed_wanted(void)
 	if (esdm_state.all_online_nodes_seeded)
 		return false;
 
-	/* Only trigger the DRNG reseed if we have collected entropy. */
-	if (esdm_avail_entropy() <
-	    atomic_read_u32(&esdm_state.boot_entropy_thresh))
-		return false;
-
-	return true;
+	return esdm_es_seed_avail();
 }
 
 /* Interface requesting a reseed of the DRNG */
 void esdm_es_add_entropy(void)
 {
+	/* A caller of esdm_get_seed may wait for this entropy */
+	esdm_drng_get_seed_wakeup();
+
 	if (!esdm_es_reseed_wanted())
 		return;
 
@@ -98,6 +98,13 @@ struct entropy_buf {
  * @name: Name of the entropy source.
  * @init: Initialize the entropy source - may be NULL
  * @monitor_es: Check the ES for new entropy - may be NULL
+ * @monitor_fd: Readiness notification of the ES: return a file descriptor
+ *		that turns readable when the ES collected new entropy or a
+ *		negative error if the ES currently offers none. The
+ *		monitor_es callback acknowledges the notification.
+ *		This callback may be NULL.
+ * @monitor_notify: The ES invokes esdm_es_mgr_monitor_wakeup when it
+ *		    collected new entropy or requires the monitor_es callback.
  * @fini: Deinitialize the entropy source - may be NULL
  * @get_ent: Fetch entropy into the entropy_buf. The ES shall only deliver
  *	     data if its internal initialization is complete, including any
@@ -116,6 +123,8 @@ struct esdm_es_cb {
 	const char *name;
 	int (*init)(void);
 	int (*monitor_es)(void);
+	int (*monitor_fd)(void);
+	bool monitor_notify;
 	void (*fini)(void);
 	void (*get_ent)(struct entropy_es *eb, uint32_t requested_bits,
 			bool fully_seeded);
@@ -129,12 +138,18 @@ struct esdm_es_cb {
 			   const struct esdm_hash_cb *old_cb);
 };
 
+/* Sufficient entropy is collected to seed a DRNG */
+bool esdm_es_seed_avail(void);
+
 /* Reseed is desired */
 bool esdm_es_reseed_wanted(void);
 
 /* Allow entropy sources to tell the ES manager that new entropy is there */
 void esdm_es_add_entropy(void);
 
+/* Acknowledge the readiness notification of the in-kernel entropy sources */
+int esdm_kernel_notify_ack(int fd);
+
 /* Read entropy from in-kernel entroy sources */
 void esdm_kernel_read(struct entropy_es *eb_es, int fd, unsigned int ioctl_cmd,
 		      enum esdm_es_data_size data_size, const char *name);
@@ -37,12 +37,14 @@
 static int esdm_sched_entropy_fd = -1;
 static uint32_t esdm_sched_requested_bits_set = 0;
 static enum esdm_es_data_size esdm_sched_data_size = esdm_es_data_equal;
+static bool esdm_sched_notify = false;
 
 static void esdm_sched_finalize(void)
 {
 	if (esdm_sched_entropy_fd >= 0)
 		close(esdm_sched_entropy_fd);
 	esdm_sched_entropy_fd = -1;
+	esdm_sched_notify = false;
 }
 
 bool esdm_sched_enabled(void)
@@ -169,6 +171,9 @@ static int esdm_sched_initialize(void)
 
 	esdm_sched_entropy_fd = fd;
 
+	/* Kernel supports the readiness notification of the ES */
+	esdm_sched_notify = !esdm_kernel_notify_ack(fd);
+
 	return 0;
 }
 
@@ -203,6 +208,9 @@ static int esdm_sched_seed_monitor(void)
 	if (esdm_sched_entropy_fd < 0)
 		return 0;
 
+	if (esdm_sched_notify)
+		esdm_kernel_notify_ack(esdm_sched_entropy_fd);
+
 	ent = esdm_sched_entropylevel(esdm_security_strength());
 
 	if (!esdm_config_es_sched_entropy_rate())
@@ -218,6 +226,14 @@ static int esdm_sched_seed_monitor(void)
 	return 0;
 }
 
+static int esdm_sched_monitor_fd(void)
+{
+	if (!esdm_sched_notify)
+		return -EOPNOTSUPP;
+
+	return esdm_sched_entropy_fd;
+}
+
 static uint32_t esdm_sched_poolsize(void)
 {
 	return esdm_sched_entropylevel(esdm_security_strength());
@@ -314,6 +330,8 @@ struct esdm_es_cb esdm_es_sched = {
 	.init = esdm_sched_initialize,
 	.fini = esdm_sched_finalize,
 	.monitor_es = esdm_sched_seed_monitor,
+	.monitor_fd = esdm_sched_monitor_fd,
+	.monitor_notify = false,
 	.get_ent = esdm_sched_get,
 	.curr_entropy = esdm_sched_entropylevel,
 	.max_entropy = esdm_sched_poolsize,
@@ -28,6 +28,7 @@
 #include "esdm_es_sched.h"
 #include "esdm_info.h"
 #include "esdm_logger.h"
+#include "esdm_tenant.h"
 #include "test_pertubation.h"
 #include "visibility.h"
 
@@ -42,7 +43,7 @@ static inline size_t esdm_remaining_buf_len(char *buf, size_t buflen)
 
 void esdm_pool_inc_node_node(void)
 {
-	esdm_nodes++;
+	__sync_add_and_fetch(&esdm_nodes, 1);
 }
 
 DSO_PUBLIC
@@ -85,6 +86,12 @@ void esdm_status(char *buf, size_t buflen)
 		 esdm_state_fully_seeded() ? "true" : "false",
 		 esdm_avail_entropy());
 
+	len = esdm_remaining_buf_len(buf, buflen);
+	esdm_drng_reseed_sched_status(buf + len, buflen - len);
+
+	len = esdm_remaining_buf_len(buf, buflen);
+	esdm_drng_tenant_status(buf + len, buflen - len);
+
 	/* Concatenate the output of the entropy sources. */
 	for_each_esdm_es (i) {
 		len = esdm_remaining_buf_len(buf, buflen);
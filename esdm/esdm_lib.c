@@ -23,8 +23,11 @@
 #include "esdm_crypto.h"
 #include "esdm_es_mgr.h"
 #include "esdm_node.h"
+#include "esdm_seed_file.h"
 #include "esdm_shm_status.h"
+#include "fips.h"
 #include "ret_checkers.h"
+#include "threading_support.h"
 #include "visibility.h"
 
 DSO_PUBLIC
@@ -41,6 +44,9 @@ int esdm_init(void)
 	/* Initialize configuration subsystem */
 	CKINT(esdm_config_init());
 
+	/* The background threads of the ESDM are taken from the thread pool */
+	CKINT(thread_init(1));
+
 	/*
 	 * Initialize the DRNG manager: the DRNG should be ready before the
 	 * entropy manager as the entropy manager may try to immediately
@@ -51,6 +57,12 @@ int esdm_init(void)
 	/* Initialize the entropy source manager */
 	CKINT(esdm_es_mgr_initialize());
 
+	/*
+	 * The integrity test of the binary ran concurrently to the
+	 * initialization of the entropy sources, its result is needed now.
+	 */
+	fips_post_integrity_wait();
+
 	/* Initialize all nodes */
 	esdm_drngs_node_alloc();
 
@@ -88,6 +100,9 @@ void esdm_fini(void)
 	/* Clear up the SHM information */
 	esdm_shm_status_exit();
 
+	/* Write the seed file while the DRNGs are still available */
+	esdm_seed_file_fini();
+
 	/* Finalize the entropy source manager and all its entropy sources. */
 	esdm_es_mgr_finalize();
 
@@ -101,5 +116,11 @@ void esdm_fini(void)
 DSO_PUBLIC
 int esdm_init_monitor(void (*priv_init_completion)(void))
 {
+	/*
+	 * Maintain the seed file for the next start in the process executing
+	 * the monitor - a server forks after esdm_init.
+	 */
+	esdm_seed_file_start();
+
 	return esdm_es_mgr_monitor_initialize(priv_init_completion);
 }
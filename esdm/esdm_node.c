@@ -19,9 +19,11 @@
  * DAMAGE.
  */
 
+#include <errno.h>
 #include <stdlib.h>
 
 #include "atomic.h"
+#include "esdm_config_internal.h"
 #include "esdm_crypto.h"
 #include "esdm_drng_mgr.h"
 #include "esdm_es_irq.h"
@@ -29,6 +31,7 @@
 #include "esdm_info.h"
 #include "esdm_node.h"
 #include "esdm_logger.h"
+#include "helper.h"
 #include "mutex.h"
 
 static struct esdm_drng **esdm_drng = NULL;
@@ -78,13 +81,128 @@ static void esdm_drngs_node_dealloc(struct esdm_drng **drngs)
 	free(drngs);
 }
 
+/*
+ * Allocate the DRNG of one node - the caller must hold esdm_crypto_cb_update.
+ *
+ * The DRNG is not seeded here. It is seeded by the regular seeding operation
+ * which is triggered when the DRNG is published. Until it is fully seeded,
+ * requests for this node are served by the initial DRNG.
+ */
+static int __esdm_drng_node_alloc_one(struct esdm_drng **drngs, uint32_t node)
+{
+	struct esdm_drng *esdm_drng_init = esdm_drng_init_instance();
+	struct esdm_drng *drng;
+	int ret;
+
+	if (drngs[node])
+		return 0;
+
+	drng = calloc(1, sizeof(struct esdm_drng));
+	if (!drng)
+		return -ENOMEM;
+
+	ret = esdm_drng_alloc_common(drng, esdm_drng_init->drng_cb);
+	if (ret) {
+		free(drng);
+		return ret;
+	}
+
+	drng->hash_cb = esdm_drng_init->hash_cb;
+
+	mutex_w_init(&drng->lock, 0, 1);
+
+	/*
+	 * No reseeding of node DRNGs from previous DRNGs as this
+	 * would complicate the code. Let it simply reseed.
+	 */
+	__sync_synchronize();
+	drngs[node] = drng;
+
+	esdm_pool_inc_node_node();
+	esdm_logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+		    "DRNG and entropy pool read hash for node %d allocated\n",
+		    node);
+
+	return 0;
+}
+
+/* Trigger the seeding of the node DRNGs allocated at startup */
+static void esdm_drng_node_seed(void)
+{
+	esdm_pool_all_nodes_seeded(false);
+	esdm_es_add_entropy();
+}
+
+/*
+ * Return the DRNG of the node, allocate it when the node is used first. A
+ * DRNG allocated here is seeded on its own once entropy is available.
+ */
+struct esdm_drng *esdm_drng_node_get(struct esdm_drng **drngs, uint32_t node)
+{
+	struct esdm_drng *drng = drngs[node];
+	int ret;
+
+	if (drng) {
+		if (!drng->fully_seeded && drng != esdm_drng_init_instance())
+			esdm_drng_seed_node(drng, node);
+		return drng;
+	}
+
+	mutex_w_lock(&esdm_crypto_cb_update);
+	ret = __esdm_drng_node_alloc_one(drngs, node);
+	mutex_w_unlock(&esdm_crypto_cb_update);
+
+	if (ret) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_ANY,
+			    "Allocation of DRNG for node %u failed: %d\n", node,
+			    ret);
+		return NULL;
+	}
+
+	drng = drngs[node];
+	esdm_drng_seed_node(drng, node);
+
+	return drng;
+}
+
+/*
+ * Nodes allocated during startup: the nodes serving the pinned RPC workers
+ * are the ones used most, otherwise the node of the initializing thread is
+ * taken. All other nodes are allocated when they are used first.
+ */
+#define ESDM_NODE_WARMUP_MAX 8
+
+static void esdm_drngs_node_warmup(struct esdm_drng **drngs)
+{
+	uint32_t cpu, node, ncpus, warm = 0;
+
+	ncpus = esdm_config_affinity_ncpus(esdm_config_affinity_rpc);
+	if (!ncpus) {
+		__esdm_drng_node_alloc_one(drngs, esdm_config_curr_node());
+		return;
+	}
+
+	for (cpu = 0; ncpus && warm < ESDM_NODE_WARMUP_MAX; cpu++) {
+		if (!esdm_config_affinity_isset(esdm_config_affinity_rpc, cpu))
+			continue;
+		ncpus--;
+
+		/* Node selection of esdm_config_curr_node for this CPU */
+		node = (cpu % esdm_online_nodes()) % esdm_config_max_nodes();
+		if (drngs[node])
+			continue;
+
+		if (__esdm_drng_node_alloc_one(drngs, node))
+			break;
+		warm++;
+	}
+}
+
 /* Allocate the data structures for the per-node DRNGs */
 void esdm_drngs_node_alloc(void)
 {
 	struct esdm_drng **drngs;
 	struct esdm_drng *esdm_drng_init = esdm_drng_init_instance();
-	uint32_t node;
-	bool init_drng_used = false;
 
 	mutex_w_lock(&esdm_crypto_cb_update);
 
@@ -100,48 +218,20 @@ void esdm_drngs_node_alloc(void)
 	if (!drngs)
 		goto unlock;
 
-	for_each_online_node (node) {
-		struct esdm_drng *drng;
-
-		if (!init_drng_used) {
-			drngs[node] = esdm_drng_init;
-			init_drng_used = true;
-			continue;
-		}
-
-		drng = calloc(1, sizeof(struct esdm_drng));
-
-		if (esdm_drng_alloc_common(drng, esdm_drng_init->drng_cb)) {
-			free(drng);
-			goto err;
-		}
-
-		drng->hash_cb = esdm_drng_init->hash_cb;
-
-		mutex_w_init(&drng->lock, 0, 1);
-		mutex_init(&drng->hash_lock, 0);
-
-		/*
-		 * No reseeding of node DRNGs from previous DRNGs as this
-		 * would complicate the code. Let it simply reseed.
-		 */
-		drngs[node] = drng;
-
-		esdm_pool_inc_node_node();
-		esdm_logger(
-			LOGGER_VERBOSE, LOGGER_C_ANY,
-			"DRNG and entropy pool read hash for node %d allocated\n",
-			node);
-	}
+	/*
+	 * The first node uses the initial DRNG. The DRNGs of the other nodes
+	 * are allocated and seeded on demand to not let all of them compete
+	 * for the initial entropy, except a small warm-up set.
+	 */
+	drngs[0] = esdm_drng_init;
+	esdm_drngs_node_warmup(drngs);
 
 	/* counterpart to memory barrier in esdm_drng_get_instances */
 	if (!__sync_val_compare_and_swap(&esdm_drng, NULL, drngs)) {
-		esdm_pool_all_nodes_seeded(false);
-		esdm_es_add_entropy();
+		esdm_drng_node_seed();
 		goto unlock;
 	}
 
-err:
 	esdm_drngs_node_dealloc(drngs);
 
 unlock:
@@ -154,6 +244,8 @@ void esdm_node_fini(void)
 
 	mutex_lock(&esdm_node_cleanup_lock);
 	drngs = __atomic_exchange_n(&esdm_drng, NULL, __ATOMIC_ACQUIRE);
+	/* Wait for readers of the per-node hash callbacks */
+	synchronize_rcu();
 	esdm_drngs_node_dealloc(drngs);
 	mutex_unlock(&esdm_node_cleanup_lock);
 }
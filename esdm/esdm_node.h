@@ -29,6 +29,7 @@
 struct esdm_drng **esdm_drng_get_instances(void);
 void esdm_drng_put_instances(void);
 void esdm_drngs_node_alloc(void);
+struct esdm_drng *esdm_drng_node_get(struct esdm_drng **drngs, uint32_t node);
 void esdm_node_fini(void);
 
 #define for_each_online_node(cpu)                                              \
@@ -45,6 +46,13 @@ static inline void esdm_drng_put_instances(void)
 static inline void esdm_drngs_node_alloc(void)
 {
 }
+static inline struct esdm_drng *esdm_drng_node_get(struct esdm_drng **drngs,
+						   uint32_t node)
+{
+	(void)drngs;
+	(void)node;
+	return NULL;
+}
 static inline void esdm_node_fini(void)
 {
 }
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bool.h"
+#include "esdm.h"
+#include "esdm_config.h"
+#include "esdm_logger.h"
+#include "esdm_seed_file.h"
+#include "memset_secure.h"
+#include "threading_support.h"
+
+/*
+ * Persistent seed file
+ *
+ * Like the random-seed file of systemd, the seed file carries random data
+ * across reboots: the content is inserted into the auxiliary pool during
+ * initialization and the file is rewritten with fresh data once the ESDM is
+ * fully seeded, periodically and at shutdown. The file is truncated right
+ * after it was read to ensure that its content is never used twice, e.g.
+ * when the system crashes before the file is rewritten.
+ *
+ * The file is opened during initialization and kept open: it is rewritten
+ * by the process executing the ES monitor, i.e. the server process which
+ * permanently dropped its privileges after the fork. Other processes, such as
+ * the parent of the server, do not write the seed file.
+ */
+#define ESDM_SEED_FILE_SIZE 512
+#define ESDM_SEED_FILE_RETRY_SEC 1
+#define ESDM_SEED_FILE_INTERVAL_SEC 3600
+
+struct esdm_seed_file_saver {
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+	int fd;
+	pid_t owner;
+	bool running;
+	bool stop;
+};
+
+static struct esdm_seed_file_saver esdm_seed_file_saver = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cv = PTHREAD_COND_INITIALIZER,
+	.fd = -1,
+	.owner = -1,
+};
+
+/*
+ * Entropy is only credited to a file that cannot have been read or altered
+ * by anybody other than the ESDM user.
+ */
+static uint32_t esdm_seed_file_credit(const struct stat *sb, size_t len)
+{
+	uint32_t ent = esdm_config_seed_file_entropy();
+
+	if (!ent)
+		return 0;
+
+	if (!S_ISREG(sb->st_mode) || (sb->st_mode & (S_IRWXG | S_IRWXO)) ||
+	    sb->st_uid != geteuid()) {
+		esdm_logger(
+			LOGGER_WARN, LOGGER_C_ES,
+			"Seed file is accessible by other users, no entropy credited\n");
+		return 0;
+	}
+
+	if (ent > len << 3)
+		ent = (uint32_t)(len << 3);
+
+	return ent;
+}
+
+void esdm_seed_file_load(void)
+{
+	struct esdm_seed_file_saver *s = &esdm_seed_file_saver;
+	uint8_t buf[ESDM_SEED_FILE_SIZE];
+	const char *path = esdm_config_seed_file();
+	struct stat sb;
+	size_t len = 0;
+	uint32_t ent;
+	int fd;
+	bool truncated = true;
+
+	if (!path)
+		return;
+
+	fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC,
+		  S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_ES,
+			    "Cannot open seed file %s: %s\n", path,
+			    strerror(errno));
+		return;
+	}
+
+	if (fstat(fd, &sb) < 0) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_ES,
+			    "Cannot stat seed file %s: %s\n", path,
+			    strerror(errno));
+		goto out;
+	}
+
+	while (len < sizeof(buf)) {
+		ssize_t rc = read(fd, buf + len, sizeof(buf) - len);
+
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			break;
+		len += (size_t)rc;
+	}
+
+	/*
+	 * Never use the content twice: if the file cannot be truncated, the
+	 * same content would be read again at the next start and thus it is
+	 * not credited with entropy.
+	 */
+	if (ftruncate(fd, 0) < 0 || fsync(fd) < 0) {
+		esdm_logger(
+			LOGGER_WARN, LOGGER_C_ES,
+			"Cannot truncate seed file %s: %s - no entropy credited\n",
+			path, strerror(errno));
+		truncated = false;
+	}
+
+	if (!len) {
+		esdm_logger(LOGGER_VERBOSE, LOGGER_C_ES,
+			    "Seed file %s is empty\n", path);
+		goto out;
+	}
+
+	ent = truncated ? esdm_seed_file_credit(&sb, len) : 0;
+	if (esdm_pool_insert_aux(buf, len, ent)) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_ES,
+			    "Cannot insert seed file data\n");
+		goto out;
+	}
+
+	esdm_logger(LOGGER_VERBOSE, LOGGER_C_ES,
+		    "Inserted %zu bytes from seed file %s with %u bits of entropy\n",
+		    len, path, ent);
+
+out:
+	memset_secure(buf, 0, sizeof(buf));
+
+	/* Keep the file open for the unprivileged server process */
+	if (s->fd >= 0)
+		close(s->fd);
+	s->fd = fd;
+}
+
+static int esdm_seed_file_write(int fd, const uint8_t *buf, size_t len)
+{
+	while (len) {
+		ssize_t rc = write(fd, buf, len);
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf += (size_t)rc;
+		len -= (size_t)rc;
+	}
+
+	return 0;
+}
+
+/*
+ * Overwrite the seed file with fresh data. The content is replaced in place
+ * as the server process cannot create files after dropping its privileges.
+ */
+static int esdm_seed_file_save(void)
+{
+	struct esdm_seed_file_saver *s = &esdm_seed_file_saver;
+	uint8_t buf[ESDM_SEED_FILE_SIZE];
+	const char *path = esdm_config_seed_file();
+	ssize_t rc;
+	int ret;
+
+	if (!path || s->fd < 0)
+		return 0;
+
+	if (!esdm_state_fully_seeded())
+		return -EAGAIN;
+
+	/*
+	 * Derive the data from a fresh seed to not write out anything a
+	 * process forked with the same DRNG state may have produced.
+	 */
+	esdm_drng_force_reseed();
+	rc = esdm_get_random_bytes_full_noblock(buf, sizeof(buf));
+	if (rc != (ssize_t)sizeof(buf)) {
+		ret = rc < 0 ? (int)rc : -EAGAIN;
+		goto out;
+	}
+
+	/*
+	 * Overwrite the old content before truncating so that the file is
+	 * never empty if the system crashes in between.
+	 */
+	if (lseek(s->fd, 0, SEEK_SET) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	ret = esdm_seed_file_write(s->fd, buf, sizeof(buf));
+	if (ret)
+		goto out;
+
+	if (ftruncate(s->fd, sizeof(buf)) < 0 || fsync(s->fd) < 0)
+		ret = -errno;
+
+out:
+	memset_secure(buf, 0, sizeof(buf));
+	if (ret && ret != -EAGAIN) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_ES,
+			    "Cannot write seed file %s: %d\n", path, ret);
+	}
+	return ret;
+}
+
+/*
+ * Write the seed file as soon as the ESDM is fully seeded and refresh it
+ * periodically afterwards so that an unclean shutdown still leaves a recent
+ * seed behind.
+ */
+static int esdm_seed_file_saver_thread(void *unused)
+{
+	struct esdm_seed_file_saver *s = &esdm_seed_file_saver;
+	unsigned int interval = ESDM_SEED_FILE_RETRY_SEC;
+
+	(void)unused;
+
+	thread_set_name(seed_file_saver, 0);
+
+	pthread_mutex_lock(&s->lock);
+	while (!s->stop) {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += interval;
+		pthread_cond_timedwait(&s->cv, &s->lock, &ts);
+		if (s->stop)
+			break;
+
+		pthread_mutex_unlock(&s->lock);
+		if (!esdm_seed_file_save())
+			interval = ESDM_SEED_FILE_INTERVAL_SEC;
+		pthread_mutex_lock(&s->lock);
+	}
+	s->running = false;
+	pthread_cond_broadcast(&s->cv);
+	pthread_mutex_unlock(&s->lock);
+
+	return 0;
+}
+
+void esdm_seed_file_start(void)
+{
+	struct esdm_seed_file_saver *s = &esdm_seed_file_saver;
+	int ret;
+
+	if (!esdm_config_seed_file() || s->fd < 0)
+		return;
+
+	pthread_mutex_lock(&s->lock);
+	if (s->running)
+		goto out;
+
+	s->stop = false;
+	s->owner = getpid();
+	ret = thread_start(esdm_seed_file_saver_thread, NULL,
+			   ESDM_THREAD_SEED_FILE, NULL);
+	if (ret) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_ES,
+			    "Starting seed file thread failed: %d\n", ret);
+	} else {
+		s->running = true;
+	}
+
+out:
+	pthread_mutex_unlock(&s->lock);
+}
+
+void esdm_seed_file_fini(void)
+{
+	struct esdm_seed_file_saver *s = &esdm_seed_file_saver;
+
+	/* Only the process executing the saver writes the seed file */
+	if (s->owner != getpid())
+		return;
+
+	pthread_mutex_lock(&s->lock);
+	s->stop = true;
+	pthread_cond_broadcast(&s->cv);
+
+	/* Wait for the saver to terminate */
+	while (s->running)
+		pthread_cond_wait(&s->cv, &s->lock);
+	pthread_mutex_unlock(&s->lock);
+
+	s->owner = -1;
+
+	/* Leave a seed for the next start */
+	esdm_seed_file_save();
+
+	if (s->fd >= 0)
+		close(s->fd);
+	s->fd = -1;
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "atomic.h"
+#include "esdm_config.h"
+#include "esdm_drng_mgr.h"
+#include "esdm_logger.h"
+#include "esdm_tenant.h"
+#include "mutex.h"
+#include "visibility.h"
+
+/*
+ * Tenant DRNGs: each tenant - the RPC server uses the identity of the peer of
+ * the connection - obtains its own DRNG instance. Thus, the load of one tenant
+ * does not contend on the DRNG lock of the node DRNG used by all others. The
+ * tenant DRNG is not seeded from the entropy sources, but from the DRNG that
+ * otherwise would serve the request, which implies that the tenant DRNGs do
+ * not add to the reseed pressure on the entropy sources.
+ *
+ * The table is read-mostly: lookups are performed with the reader lock, the
+ * writer lock is only taken for allocating and reclaiming tenant DRNGs.
+ */
+#define ESDM_DRNG_TENANT_HASH 64
+#define ESDM_DRNG_TENANT_MAX 256
+
+struct esdm_drng_tenant {
+	struct esdm_drng drng; /* Must be first member */
+	struct esdm_drng_tenant *next;
+	uint64_t id;
+	atomic_t users; /* Requests currently served */
+	time_t last_used; /* Monotonic time of the last use in seconds */
+};
+
+static struct esdm_drng_tenant *esdm_drng_tenants[ESDM_DRNG_TENANT_HASH];
+static uint32_t esdm_drng_ntenants = 0;
+static uint64_t esdm_drng_tenants_reclaimed = 0;
+static time_t esdm_drng_tenants_swept = 0;
+static DEFINE_MUTEX_UNLOCKED(esdm_drng_tenant_lock);
+
+/* Tenant selected by the calling thread */
+static __thread uint64_t esdm_drng_tenant_curr;
+static __thread bool esdm_drng_tenant_curr_set = false;
+
+DSO_PUBLIC
+void esdm_drng_tenant_set(uint64_t tenant)
+{
+	esdm_drng_tenant_curr = tenant;
+	esdm_drng_tenant_curr_set = true;
+}
+
+DSO_PUBLIC
+void esdm_drng_tenant_unset(void)
+{
+	esdm_drng_tenant_curr_set = false;
+}
+
+static time_t esdm_drng_tenant_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+static uint32_t esdm_drng_tenant_hash(uint64_t id)
+{
+	id ^= id >> 33;
+	id *= 0xff51afd7ed558ccdULL;
+	id ^= id >> 33;
+
+	return (uint32_t)id & (ESDM_DRNG_TENANT_HASH - 1);
+}
+
+/* Caller must hold the tenant lock */
+static struct esdm_drng_tenant *esdm_drng_tenant_find(uint64_t id)
+{
+	struct esdm_drng_tenant *tenant;
+
+	for (tenant = esdm_drng_tenants[esdm_drng_tenant_hash(id)]; tenant;
+	     tenant = tenant->next) {
+		if (tenant->id == id)
+			return tenant;
+	}
+
+	return NULL;
+}
+
+static void esdm_drng_tenant_free(struct esdm_drng_tenant *tenant)
+{
+	if (tenant->drng.drng)
+		tenant->drng.drng_cb->drng_dealloc(tenant->drng.drng);
+	mutex_w_destroy(&tenant->drng.lock);
+	free(tenant);
+}
+
+/*
+ * Release the tenant DRNGs which were not used for the idle period, or all
+ * unused ones if idle is 0 - caller must hold the tenant writer lock.
+ */
+static void esdm_drng_tenant_reclaim(time_t now, uint32_t idle)
+{
+	unsigned int i;
+
+	for (i = 0; i < ESDM_DRNG_TENANT_HASH; i++) {
+		struct esdm_drng_tenant **pp = &esdm_drng_tenants[i];
+
+		while (*pp) {
+			struct esdm_drng_tenant *tenant = *pp;
+
+			if (atomic_read(&tenant->users) ||
+			    now - __atomic_load_n(&tenant->last_used,
+						  __ATOMIC_RELAXED) <
+				    (time_t)idle) {
+				pp = &tenant->next;
+				continue;
+			}
+
+			*pp = tenant->next;
+			esdm_drng_ntenants--;
+			esdm_drng_tenants_reclaimed++;
+			esdm_logger(LOGGER_DEBUG, LOGGER_C_DRNG,
+				    "DRNG of tenant %" PRIx64 " released\n",
+				    tenant->id);
+			esdm_drng_tenant_free(tenant);
+		}
+	}
+
+	__atomic_store_n(&esdm_drng_tenants_swept, now, __ATOMIC_RELAXED);
+}
+
+/* Caller must hold the tenant writer lock */
+static struct esdm_drng_tenant *esdm_drng_tenant_alloc(uint64_t id,
+							time_t now)
+{
+	struct esdm_drng *esdm_drng_init = esdm_drng_init_instance();
+	struct esdm_drng_tenant *tenant;
+	uint32_t hash = esdm_drng_tenant_hash(id);
+
+	if (esdm_drng_ntenants >= ESDM_DRNG_TENANT_MAX)
+		esdm_drng_tenant_reclaim(now, esdm_config_drng_tenant_idle());
+	if (esdm_drng_ntenants >= ESDM_DRNG_TENANT_MAX)
+		return NULL;
+
+	tenant = calloc(1, sizeof(*tenant));
+	if (!tenant)
+		return NULL;
+
+	/*
+	 * The DRNG is allocated in the reset state which implies that it is
+	 * seeded from its parent DRNG with the first request.
+	 */
+	if (esdm_drng_alloc_common(&tenant->drng, esdm_drng_init->drng_cb)) {
+		free(tenant);
+		return NULL;
+	}
+	tenant->drng.hash_cb = esdm_drng_init->hash_cb;
+	tenant->drng.tenant = true;
+	mutex_w_init(&tenant->drng.lock, 0, 1);
+	tenant->id = id;
+	tenant->last_used = now;
+
+	tenant->next = esdm_drng_tenants[hash];
+	esdm_drng_tenants[hash] = tenant;
+	esdm_drng_ntenants++;
+
+	esdm_logger(LOGGER_DEBUG, LOGGER_C_DRNG,
+		    "DRNG of tenant %" PRIx64 " allocated\n", id);
+
+	return tenant;
+}
+
+/*
+ * Return the DRNG of the tenant selected by the calling thread, NULL if no
+ * tenant is selected or the tenant DRNG is not available. The DRNG must be
+ * released with esdm_drng_tenant_put.
+ */
+struct esdm_drng *esdm_drng_tenant_get(void)
+{
+	struct esdm_drng_tenant *tenant;
+	uint32_t idle = esdm_config_drng_tenant_idle();
+	time_t now;
+
+	if (!idle || !esdm_drng_tenant_curr_set)
+		return NULL;
+
+	now = esdm_drng_tenant_now();
+
+	/* Racy check whether a sweep is due - it is repeated under the lock */
+	if (now - __atomic_load_n(&esdm_drng_tenants_swept, __ATOMIC_RELAXED) >=
+	    (time_t)idle) {
+		mutex_lock(&esdm_drng_tenant_lock);
+		if (now - esdm_drng_tenants_swept >= (time_t)idle)
+			esdm_drng_tenant_reclaim(now, idle);
+		mutex_unlock(&esdm_drng_tenant_lock);
+	}
+
+	mutex_reader_lock(&esdm_drng_tenant_lock);
+	tenant = esdm_drng_tenant_find(esdm_drng_tenant_curr);
+	if (tenant)
+		atomic_inc(&tenant->users);
+	mutex_reader_unlock(&esdm_drng_tenant_lock);
+
+	if (tenant)
+		return &tenant->drng;
+
+	mutex_lock(&esdm_drng_tenant_lock);
+	tenant = esdm_drng_tenant_find(esdm_drng_tenant_curr);
+	if (!tenant)
+		tenant = esdm_drng_tenant_alloc(esdm_drng_tenant_curr, now);
+	if (tenant)
+		atomic_inc(&tenant->users);
+	mutex_unlock(&esdm_drng_tenant_lock);
+
+	return tenant ? &tenant->drng : NULL;
+}
+
+void esdm_drng_tenant_put(struct esdm_drng *drng)
+{
+	struct esdm_drng_tenant *tenant = (struct esdm_drng_tenant *)drng;
+
+	if (!tenant)
+		return;
+
+	__atomic_store_n(&tenant->last_used, esdm_drng_tenant_now(),
+			 __ATOMIC_RELAXED);
+	/* The tenant may be reclaimed once it is no longer used */
+	atomic_dec(&tenant->users);
+}
+
+/* Reset the tenant DRNGs - they are reseeded from their parent DRNGs */
+void esdm_drng_tenants_reset(void)
+{
+	unsigned int i;
+
+	mutex_reader_lock(&esdm_drng_tenant_lock);
+	for (i = 0; i < ESDM_DRNG_TENANT_HASH; i++) {
+		struct esdm_drng_tenant *tenant;
+
+		for (tenant = esdm_drng_tenants[i]; tenant;
+		     tenant = tenant->next) {
+			mutex_w_lock(&tenant->drng.lock);
+			esdm_drng_reset(&tenant->drng);
+			mutex_w_unlock(&tenant->drng.lock);
+		}
+	}
+	mutex_reader_unlock(&esdm_drng_tenant_lock);
+}
+
+void esdm_drng_tenants_force_reseed(void)
+{
+	unsigned int i;
+
+	mutex_reader_lock(&esdm_drng_tenant_lock);
+	for (i = 0; i < ESDM_DRNG_TENANT_HASH; i++) {
+		struct esdm_drng_tenant *tenant;
+
+		for (tenant = esdm_drng_tenants[i]; tenant;
+		     tenant = tenant->next)
+			tenant->drng.force_reseed = true;
+	}
+	mutex_reader_unlock(&esdm_drng_tenant_lock);
+}
+
+void esdm_drng_tenant_status(char *buf, size_t buflen)
+{
+	uint32_t idle = esdm_config_drng_tenant_idle();
+
+	if (!idle)
+		return;
+
+	mutex_reader_lock(&esdm_drng_tenant_lock);
+	snprintf(buf, buflen,
+		 "DRNG tenants:\n"
+		 " Idle period: %u s\n"
+		 " Active tenants: %u\n"
+		 " Released tenants: %" PRIu64 "\n",
+		 idle, esdm_drng_ntenants, esdm_drng_tenants_reclaimed);
+	mutex_reader_unlock(&esdm_drng_tenant_lock);
+}
+
+void esdm_drng_tenant_fini(void)
+{
+	mutex_lock(&esdm_drng_tenant_lock);
+	esdm_drng_tenant_reclaim(esdm_drng_tenant_now(), 0);
+	mutex_unlock(&esdm_drng_tenant_lock);
+}
@@ -17,7 +17,9 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,6 +30,7 @@
 #include "lc_hmac.h"
 #include "lc_sha256.h"
 #include "esdm_logger.h"
+#include "threading_support.h"
 
 #define FIPS_LOGGER_PREFIX "FIPS POST: "
 
@@ -68,21 +71,106 @@ out:
 	return ret;
 }
 
+/*
+ * The integrity test of the binary is executed in a separate thread started
+ * by the constructor. It thus overlaps with the initialization of the ESDM,
+ * e.g. the entropy sources. Before the ESDM delivers any output, it waits
+ * for the result with fips_post_integrity_wait().
+ */
+struct fips_post_integrity_state {
+	pthread_mutex_t lock;
+	pthread_t thread;
+	bool running;
+	bool done;
+	int ret;
+};
+
+static struct fips_post_integrity_state fips_post_integrity_state = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.running = false,
+	.done = false,
+	.ret = 0,
+};
+
+static void *fips_post_integrity_thread(void *unused)
+{
+	struct fips_post_integrity_state *s = &fips_post_integrity_state;
+
+	(void)unused;
+
+	thread_set_name(fips_post_integrity_test, 0);
+	s->ret = fips_post_integrity(NULL);
+
+	return NULL;
+}
+
+void fips_post_integrity_wait(void)
+{
+	struct fips_post_integrity_state *s = &fips_post_integrity_state;
+	int ret;
+
+	if (__atomic_load_n(&s->done, __ATOMIC_ACQUIRE)) {
+		ret = s->ret;
+		goto out;
+	}
+
+	pthread_mutex_lock(&s->lock);
+	if (s->running) {
+		pthread_join(s->thread, NULL);
+		s->running = false;
+	}
+	ret = s->ret;
+	__atomic_store_n(&s->done, true, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&s->lock);
+
+out:
+	if (ret) {
+		fprintf(stderr,
+			FIPS_LOGGER_PREFIX "Integrity test failed: %d\n", ret);
+		exit(-ret);
+	}
+}
+
+/* A forked child does not inherit the thread, wait for it before fork */
+static void fips_post_integrity_prefork(void)
+{
+	fips_post_integrity_wait();
+}
+
 ESDM_DEFINE_CONSTRUCTOR(fips_post);
 static void fips_post(void)
 {
+	struct fips_post_integrity_state *s = &fips_post_integrity_state;
 	int ret;
 
-	if (!esdm_config_fips_enabled())
+	if (!esdm_config_fips_enabled()) {
+		s->done = true;
 		return;
+	}
 
 	ret = fips_post_hmac_sha256();
 	if (ret)
 		exit(-ret);
 
+	/*
+	 * The constructor executes before the threading support is
+	 * initialized and the server forks afterwards, i.e. a thread of the
+	 * thread pool would be recorded in the pool state of the child without
+	 * existing there. Thus, a plain thread is used which is joined before
+	 * any fork.
+	 */
+	if (!pthread_create(&s->thread, NULL, fips_post_integrity_thread,
+			    NULL)) {
+		s->running = true;
+		pthread_atfork(fips_post_integrity_prefork, NULL, NULL);
+		return;
+	}
+
+	/* Without a thread, the test is executed synchronously */
 	ret = fips_post_integrity(NULL);
 	if (ret)
 		exit(-ret);
+	s->done = true;
 }
 
 bool fips_enabled(void)
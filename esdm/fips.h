@@ -30,11 +30,30 @@ extern "C" {
 #ifdef ESDM_FIPS140
 bool fips_enabled(void);
 int fips_post_integrity(const char *pathname);
+
+/*
+ * Integrity test of the binary irrespective of the FIPS mode - a missing HMAC
+ * control file is reported as an error
+ */
+int fips_integrity_check(const char *pathname);
+
+/* Create the HMAC control file for the integrity test of the binary */
+int fips_integrity_create(const char *pathname);
+
+/*
+ * Wait for the integrity test of the binary executed in the background and
+ * terminate the process if it failed. It must be called before any output
+ * is generated.
+ */
+void fips_post_integrity_wait(void);
 #else /* ESDM_FIPS140 */
 static inline bool fips_enabled(void)
 {
 	return false;
 }
+static inline void fips_post_integrity_wait(void)
+{
+}
 #endif /* ESDM_FIPS140 */
 
 #ifdef __cplusplus
@@ -158,14 +158,16 @@ out:
 	return ret;
 }
 
-static int process_checkfile(const char *checkfile, const char *targetfile)
+static int process_checkfile(const char *checkfile, const char *targetfile,
+			     int create_checkfile)
 {
 	LC_HMAC_CTX_ON_STACK(hmac_ctx, lc_sha256);
 	FILE *file = NULL;
 	int ret = 0, checked_any = 0;
 	uint32_t size = 0;
 	uint8_t *memblock = NULL;
-	int create_checkfile = 0;
+	uint8_t calculated[LC_SHA_MAX_SIZE_DIGEST];
+	size_t macsize;
 
 	/*
 	 * A file can have up to 4096 characters, so a complete line has at most
@@ -174,14 +176,7 @@ static int process_checkfile(const char *checkfile, const char *targetfile)
 	 */
 	char buf[(4096 + 128 + 2 + 1)];
 
-	file = strcmp(checkfile, "-") ? fopen(checkfile, "r") : stdin;
-	if (!file) {
-		fprintf(stderr,
-			FIPS_INTEGRITY_LOGGER_PREFIX
-			"Cannot open file %s, creating it\n",
-			checkfile);
-		create_checkfile = 1;
-
+	if (create_checkfile) {
 		file = fopen(checkfile, "w");
 		if (!file) {
 			ret = -errno;
@@ -191,26 +186,45 @@ static int process_checkfile(const char *checkfile, const char *targetfile)
 				checkfile);
 			goto out;
 		}
+	} else {
+		/* A missing control file is an integrity violation */
+		file = strcmp(checkfile, "-") ? fopen(checkfile, "r") : stdin;
+		if (!file) {
+			ret = -errno;
+			fprintf(stderr,
+				FIPS_INTEGRITY_LOGGER_PREFIX
+				"Cannot open file %s: %s\n",
+				checkfile, strerror(-ret));
+			goto out;
+		}
 	}
 
 	ret = mmap_file(targetfile, &memblock, &size);
 	if (ret)
 		goto out;
 
+	/* The file is read sequentially exactly once */
+	if (memblock) {
+		madvise(memblock, size, MADV_SEQUENTIAL);
+		madvise(memblock, size, MADV_WILLNEED);
+	}
+
+	/* The MAC is calculated once and compared with every line */
+	memset(calculated, 0, sizeof(calculated));
+	lc_hmac_init(hmac_ctx, (uint8_t *)fipscheck_hmackey,
+		     sizeof(fipscheck_hmackey) - 1);
+	lc_hmac_update(hmac_ctx, memblock, size);
+	lc_hmac_final(hmac_ctx, calculated);
+	macsize = lc_hmac_macsize(hmac_ctx);
+	lc_hmac_zero(hmac_ctx);
+
 	if (create_checkfile) {
 		char *hexhash = NULL;
 		size_t hexhashlen = 0;
-		uint8_t calculated[LC_SHA_MAX_SIZE_DIGEST];
 		size_t written;
 
-		lc_hmac_init(hmac_ctx, (uint8_t *)fipscheck_hmackey,
-			     sizeof(fipscheck_hmackey) - 1);
-		lc_hmac_update(hmac_ctx, memblock, size);
-		lc_hmac_final(hmac_ctx, calculated);
-
-		ret = bin2hex_alloc(calculated, lc_hmac_macsize(hmac_ctx),
-				    &hexhash, &hexhashlen);
-		lc_hmac_zero(hmac_ctx);
+		ret = bin2hex_alloc(calculated, macsize, &hexhash,
+				    &hexhashlen);
 		if (ret)
 			goto out;
 
@@ -236,7 +250,6 @@ static int process_checkfile(const char *checkfile, const char *targetfile)
 		size_t hexhashlen = 0; // length of hash hex value
 		size_t linelen = strlen(buf);
 		size_t i;
-		unsigned char calculated[LC_SHA_MAX_SIZE_DIGEST];
 
 		if (linelen == 0)
 			break;
@@ -264,12 +277,7 @@ static int process_checkfile(const char *checkfile, const char *targetfile)
 		if (ret < 0)
 			goto out;
 
-		lc_hmac_init(hmac_ctx, (uint8_t *)fipscheck_hmackey,
-			     sizeof(fipscheck_hmackey) - 1);
-		lc_hmac_update(hmac_ctx, memblock, size);
-		lc_hmac_final(hmac_ctx, calculated);
-
-		if (lc_hmac_macsize(hmac_ctx) != binhashlen) {
+		if (macsize != binhashlen) {
 			fprintf(stderr, FIPS_INTEGRITY_LOGGER_PREFIX
 				"Calculated MAC length has unexpected length - integrity violation\n");
 			free(binhash);
@@ -277,7 +285,7 @@ static int process_checkfile(const char *checkfile, const char *targetfile)
 			goto out;
 		}
 
-		if (memcmp(calculated, binhash, sizeof(calculated))) {
+		if (memcmp(calculated, binhash, macsize)) {
 			fprintf(stderr, FIPS_INTEGRITY_LOGGER_PREFIX
 				"Message mismatch - integrity violation\n");
 			free(binhash);
@@ -303,7 +311,7 @@ out:
 	return ret;
 }
 
-int fips_post_integrity(const char *pathname)
+int fips_integrity_check(const char *pathname)
 {
 	char *checkfile = NULL;
 	int ret = -EINVAL;
@@ -312,11 +320,6 @@ int fips_post_integrity(const char *pathname)
 	const char *selfname_p;
 	ssize_t selfnamesize = 0;
 
-	if (esdm_config_fips_enabled()) {
-		ret = 0;
-		goto out;
-	}
-
 	if (pathname) {
 		selfname_p = pathname;
 	} else {
@@ -367,10 +370,33 @@ int fips_post_integrity(const char *pathname)
 		goto out;
 	}
 
-	ret = process_checkfile(checkfile, selfname_p);
+	ret = process_checkfile(checkfile, selfname_p, 0);
 
 out:
 	if (checkfile)
 		free(checkfile);
 	return ret;
 }
+
+int fips_post_integrity(const char *pathname)
+{
+	if (!esdm_config_fips_enabled())
+		return 0;
+
+	return fips_integrity_check(pathname);
+}
+
+int fips_integrity_create(const char *pathname)
+{
+	char *checkfile = get_hmac_file(pathname);
+	int ret;
+
+	if (!checkfile)
+		return -ENOMEM;
+
+	/* An existing control file is replaced */
+	ret = process_checkfile(checkfile, pathname, 1);
+
+	free(checkfile);
+	return ret;
+}
@@ -21,9 +21,11 @@
 #include <errno.h>
 #include <linux/random.h>
 #include <poll.h>
+#include <pthread.h>
 #include <semaphore.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/mount.h>
 #include <sys/shm.h>
 #include <time.h>
@@ -456,11 +458,103 @@ static int esdm_cuse_interrupt(void *data)
 	return !!fuse_req_interrupted(req);
 }
 
+/*
+ * Per-thread read buffer: each FUSE worker thread keeps one buffer which is
+ * reused for all read requests it serves. The buffer is locked into memory
+ * to prevent random data from being swapped out. The RPC client writes the
+ * random data straight into this buffer which is then handed to FUSE without
+ * any further copy.
+ */
+struct esdm_cuse_read_buf {
+	uint8_t *buf;
+	size_t buflen;
+};
+
+static pthread_key_t esdm_cuse_read_buf_key;
+static pthread_once_t esdm_cuse_read_buf_once = PTHREAD_ONCE_INIT;
+
+static void esdm_cuse_read_buf_free(void *data)
+{
+	struct esdm_cuse_read_buf *rbuf = data;
+
+	if (!rbuf)
+		return;
+
+	if (rbuf->buf) {
+		memset_secure(rbuf->buf, 0, rbuf->buflen);
+		munlock(rbuf->buf, rbuf->buflen);
+		free(rbuf->buf);
+	}
+	free(rbuf);
+}
+
+static void esdm_cuse_read_buf_key_init(void)
+{
+	if (pthread_key_create(&esdm_cuse_read_buf_key,
+			       esdm_cuse_read_buf_free)) {
+		esdm_logger(LOGGER_ERR, LOGGER_C_CUSE,
+			    "Cannot allocate thread-local read buffer key\n");
+	}
+}
+
+static uint8_t *esdm_cuse_read_buf_get(size_t size)
+{
+	struct esdm_cuse_read_buf *rbuf;
+	size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	void *tmp;
+
+	if (pthread_once(&esdm_cuse_read_buf_once, esdm_cuse_read_buf_key_init))
+		return NULL;
+
+	rbuf = pthread_getspecific(esdm_cuse_read_buf_key);
+	if (!rbuf) {
+		rbuf = calloc(1, sizeof(*rbuf));
+		if (!rbuf)
+			return NULL;
+		if (pthread_setspecific(esdm_cuse_read_buf_key, rbuf)) {
+			free(rbuf);
+			return NULL;
+		}
+	}
+
+	if (rbuf->buflen >= size)
+		return rbuf->buf;
+
+	/*
+	 * The buffer only grows, i.e. once the FUSE maximum request size was
+	 * seen, no further allocation happens for this thread.
+	 */
+	if (rbuf->buf) {
+		memset_secure(rbuf->buf, 0, rbuf->buflen);
+		munlock(rbuf->buf, rbuf->buflen);
+		free(rbuf->buf);
+		rbuf->buf = NULL;
+		rbuf->buflen = 0;
+	}
+
+	size = (size + pagesize - 1) & ~(pagesize - 1);
+	if (posix_memalign(&tmp, pagesize, size))
+		return NULL;
+
+	/* Failing to lock the memory is not fatal, e.g. due to RLIMIT_MEMLOCK */
+	if (mlock(tmp, size)) {
+		esdm_logger(LOGGER_VERBOSE, LOGGER_C_CUSE,
+			    "Cannot lock read buffer into memory: %s\n",
+			    strerror(errno));
+	}
+
+	rbuf->buf = tmp;
+	rbuf->buflen = size;
+
+	return rbuf->buf;
+}
+
 void esdm_cuse_read_internal(fuse_req_t req, size_t size, off_t off,
 			     struct fuse_file_info *fi, get_func_t get,
 			     int fallback_fd)
 {
-	uint8_t tmpbuf_s[64] = { 0 }, *tmpbuf_p = tmpbuf_s, *tmpbuf = NULL;
+	struct fuse_bufvec bufv = FUSE_BUFVEC_INIT(size);
+	uint8_t *buf;
 	size_t read_bytes = 0;
 	ssize_t ret = 0;
 
@@ -470,11 +564,8 @@ void esdm_cuse_read_internal(fuse_req_t req, size_t size, off_t off,
 	 * size is limited by fuse to its maximum request size, mostly
 	 * 131072 byte
 	 */
-	if (size > sizeof(tmpbuf_s)) {
-		tmpbuf = calloc(1, size);
-		CKNULL(tmpbuf, -ENOMEM);
-		tmpbuf_p = tmpbuf;
-	}
+	buf = esdm_cuse_read_buf_get(size);
+	CKNULL(buf, -ENOMEM);
 
 	fallback_fd = esdm_test_fallback_fd(fallback_fd);
 
@@ -484,14 +575,14 @@ void esdm_cuse_read_internal(fuse_req_t req, size_t size, off_t off,
 	/*
 	 * fuse automatically chunks requests, e.g. for a 1MB read
 	 * multiple <= 131072 byte reads are typically performed, try to fill
-	 * them up.
+	 * them up. The RPC client itself splits the request into chunks
+	 * fitting into one RPC message and fills the reply buffer directly.
 	 */
 	while (read_bytes < size) {
-		size_t todo =
-			min_size(ESDM_RPC_MAX_MSG_SIZE, size - read_bytes);
+		size_t todo = size - read_bytes;
 
 		esdm_cuse_unpriv_call_start();
-		esdm_invoke(get(tmpbuf_p + read_bytes, todo, req));
+		esdm_invoke(get(buf + read_bytes, todo, req));
 		esdm_cuse_unpriv_call_end();
 
 		/*
@@ -506,22 +597,25 @@ void esdm_cuse_read_internal(fuse_req_t req, size_t size, off_t off,
 				LOGGER_VERBOSE, LOGGER_C_CUSE,
 				"Use fallback to provide data due to RPC error code %zd\n",
 				ret);
-			ret = read(fallback_fd, tmpbuf_p + read_bytes, todo);
+			ret = read(fallback_fd, buf + read_bytes, todo);
 		}
 
 		if (ret < 0)
 			goto out;
 		read_bytes += (size_t)ret;
 	}
-	ret = fuse_reply_buf(req, (const char *)tmpbuf_p, size);
+
+	/*
+	 * Copy the data: moving the pages of the reused buffer would hand
+	 * them to the kernel while they are wiped and refilled here.
+	 */
+	bufv.buf[0].mem = buf;
+	ret = fuse_reply_data(req, &bufv, 0);
 
 out:
-	if (tmpbuf) {
-		memset_secure(tmpbuf, 0, size);
-		free(tmpbuf);
-	} else {
-		memset_secure(tmpbuf_s, 0, sizeof(tmpbuf_s));
-	}
+	/* The buffer is reused, but its content must not linger */
+	if (buf)
+		memset_secure(buf, 0, size);
 
 	if (ret < 0)
 		fuse_reply_err(req, (int)-ret);
@@ -805,21 +899,194 @@ void esdm_cuse_ioctl(int backend_fd, fuse_req_t req, unsigned long cmd,
  * Poll system call handler
  ******************************************************************************/
 
-#define ESDM_CUSE_MAX_PH 16
+/*
+ * Registered poll handles are kept in a hash table keyed by the file handle.
+ * In addition, each handle is linked into the reader and / or writer list
+ * depending on the events it waits for. This allows the poll checker to only
+ * visit the handles which are affected by a change of the ESDM status.
+ */
 struct esdm_cuse_poll {
 	uint64_t fh;
 	struct fuse_pollhandle *ph;
 	uint32_t poll_events;
+	struct esdm_cuse_poll *hash_next;
+	struct esdm_cuse_poll *prev[2];
+	struct esdm_cuse_poll *next[2];
+};
+
+enum esdm_cuse_poll_list {
+	esdm_cuse_poll_list_reader,
+	esdm_cuse_poll_list_writer,
+	esdm_cuse_poll_list_last, /* Must be last entry */
+};
+
+#define ESDM_CUSE_PH_HASH_BITS_MIN 4
+struct esdm_cuse_poll_table {
+	struct esdm_cuse_poll **buckets;
+	struct esdm_cuse_poll *list[esdm_cuse_poll_list_last];
+	uint32_t bits;
+	uint32_t entries;
 };
-static struct esdm_cuse_poll esdm_cuse_polls[ESDM_CUSE_MAX_PH];
+static struct esdm_cuse_poll_table esdm_cuse_polls = { 0 };
 static DEFINE_MUTEX_W_UNLOCKED(esdm_cuse_ph_lock);
 
-static void esdm_cuse_get_pollmask(unsigned int *outmask)
-{
 #define ESDM_POLL_READER (POLLIN | POLLRDNORM)
 #define ESDM_POLL_WRITER (POLLOUT | POLLWRNORM)
 
+static const unsigned int
+	esdm_cuse_poll_list_events[esdm_cuse_poll_list_last] = {
+		ESDM_POLL_READER,
+		ESDM_POLL_WRITER,
+	};
+
+static uint32_t esdm_cuse_poll_hash(uint64_t fh, uint32_t bits)
+{
+	return (uint32_t)((fh * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static struct esdm_cuse_poll **esdm_cuse_poll_bucket(uint64_t fh)
+{
+	return &esdm_cuse_polls
+			.buckets[esdm_cuse_poll_hash(fh, esdm_cuse_polls.bits)];
+}
+
+/* Double the number of buckets - caller must hold esdm_cuse_ph_lock */
+static int esdm_cuse_poll_table_grow(void)
+{
+	struct esdm_cuse_poll **buckets, **old = esdm_cuse_polls.buckets;
+	uint32_t i, bits = esdm_cuse_polls.bits ?
+				   esdm_cuse_polls.bits + 1 :
+				   ESDM_CUSE_PH_HASH_BITS_MIN;
+
+	buckets = calloc((size_t)1 << bits, sizeof(*buckets));
+	if (!buckets)
+		return -ENOMEM;
+
+	for (i = 0; old && i < (1U << esdm_cuse_polls.bits); i++) {
+		struct esdm_cuse_poll *p = old[i];
+
+		while (p) {
+			struct esdm_cuse_poll *next = p->hash_next;
+			uint32_t idx = esdm_cuse_poll_hash(p->fh, bits);
+
+			p->hash_next = buckets[idx];
+			buckets[idx] = p;
+			p = next;
+		}
+	}
+
+	esdm_cuse_polls.buckets = buckets;
+	esdm_cuse_polls.bits = bits;
+	free(old);
+
+	return 0;
+}
+
+/* Caller must hold esdm_cuse_ph_lock */
+static int esdm_cuse_poll_add(uint64_t fh, struct fuse_pollhandle *ph,
+			      uint32_t poll_events)
+{
+	struct esdm_cuse_poll *p, **bucket;
+	unsigned int i;
+	int ret;
+
+	/* Keep the load factor of the hash table below 2 */
+	if (esdm_cuse_polls.entries >= (2U << esdm_cuse_polls.bits) ||
+	    !esdm_cuse_polls.buckets) {
+		ret = esdm_cuse_poll_table_grow();
+		/* A full table still works, it is only slower */
+		if (ret && !esdm_cuse_polls.buckets)
+			return ret;
+	}
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+
+	p->fh = fh;
+	p->ph = ph;
+	p->poll_events = poll_events;
+
+	bucket = esdm_cuse_poll_bucket(fh);
+	p->hash_next = *bucket;
+	*bucket = p;
+
+	for (i = 0; i < esdm_cuse_poll_list_last; i++) {
+		if (!(poll_events & esdm_cuse_poll_list_events[i]))
+			continue;
+
+		p->next[i] = esdm_cuse_polls.list[i];
+		if (p->next[i])
+			p->next[i]->prev[i] = p;
+		esdm_cuse_polls.list[i] = p;
+	}
+
+	esdm_cuse_polls.entries++;
+
+	return 0;
+}
+
+/*
+ * Unlink the entry from the hash table and the wait lists, notify the poller
+ * and release the entry. Caller must hold esdm_cuse_ph_lock.
+ */
+static void esdm_cuse_poll_del(struct esdm_cuse_poll *p, bool notify)
+{
+	struct esdm_cuse_poll **bucket = esdm_cuse_poll_bucket(p->fh);
+	unsigned int i;
+
+	while (*bucket && *bucket != p)
+		bucket = &(*bucket)->hash_next;
+	if (*bucket)
+		*bucket = p->hash_next;
+
+	for (i = 0; i < esdm_cuse_poll_list_last; i++) {
+		if (!(p->poll_events & esdm_cuse_poll_list_events[i]))
+			continue;
+
+		if (p->prev[i])
+			p->prev[i]->next[i] = p->next[i];
+		else
+			esdm_cuse_polls.list[i] = p->next[i];
+		if (p->next[i])
+			p->next[i]->prev[i] = p->prev[i];
+	}
+
+	esdm_cuse_polls.entries--;
+
+	if (p->ph) {
+		if (notify)
+			fuse_notify_poll(p->ph);
+		fuse_pollhandle_destroy(p->ph);
+	}
+	free(p);
+}
+
+/* Caller must hold esdm_cuse_ph_lock */
+static struct esdm_cuse_poll *esdm_cuse_poll_find(uint64_t fh)
+{
+	struct esdm_cuse_poll *p;
+
+	if (!esdm_cuse_polls.buckets)
+		return NULL;
+
+	for (p = *esdm_cuse_poll_bucket(fh); p; p = p->hash_next) {
+		if (p->fh == fh)
+			return p;
+	}
+
+	return NULL;
+}
+
+/*
+ * *outmask receives the current status of the ESDM, *forcemask receives the
+ * events which shall be signaled irrespective of the status.
+ */
+static void esdm_cuse_get_pollmask(unsigned int *outmask,
+				   unsigned int *forcemask)
+{
 	*outmask = 0;
+	*forcemask = 0;
 
 	if (atomic_bool_read(&esdm_cuse_shm_status->operational))
 		*outmask |= ESDM_POLL_READER;
@@ -829,12 +1096,12 @@ static void esdm_cuse_get_pollmask(unsigned int *outmask)
 	/* Simply wake the poller no matter what it waits for. */
 	if (atomic_bool_read(&esdm_cuse_shm_status->suspend_trigger)) {
 		atomic_bool_set(&esdm_cuse_shm_status->suspend_trigger, false);
-		*outmask |= ESDM_POLL_READER | ESDM_POLL_WRITER;
+		*forcemask |= ESDM_POLL_READER | ESDM_POLL_WRITER;
 	}
 
 	/* Simply wake the poller no matter what it waits for. */
 	if (atomic_bool_read(&esdm_cuse_poll_thread_shutdown))
-		*outmask |= ESDM_POLL_READER | ESDM_POLL_WRITER;
+		*forcemask |= ESDM_POLL_READER | ESDM_POLL_WRITER;
 }
 
 /* *outmask is already filled with output of esdm_cuse_get_pollmask */
@@ -851,104 +1118,87 @@ static void esdm_cuse_set_pollmask(unsigned int request_events,
 void esdm_cuse_poll(fuse_req_t req, struct fuse_file_info *fi,
 		    struct fuse_pollhandle *ph)
 {
-	unsigned int i, mask;
-	int err_code;
+	struct esdm_cuse_poll *p;
+	unsigned int mask, forcemask;
 
 	if (!fi->poll_events) {
-		err_code = EINVAL;
-		goto err;
+		fuse_reply_err(req, EINVAL);
+		return;
 	}
 
+	mutex_w_lock(&esdm_cuse_ph_lock);
+
 	/*
 	 * Check current status and return it if it complies with requested
-	 * status.
+	 * status. The status is obtained under the lock to serialize with the
+	 * poll checker such that no status change can be missed.
 	 */
-	esdm_cuse_get_pollmask(&mask);
+	esdm_cuse_get_pollmask(&mask, &forcemask);
+	mask |= forcemask;
 	esdm_cuse_set_pollmask(fi->poll_events, &mask);
 	fuse_reply_poll(req, mask);
 
 	/* cleanup first, as we may have an interrupted poll/select */
-	mutex_w_lock(&esdm_cuse_ph_lock);
-	for (i = 0; i < ESDM_CUSE_MAX_PH; i++) {
-		if (esdm_cuse_polls[i].fh == fi->fh) {
-			if (esdm_cuse_polls[i].ph) {
-				fuse_pollhandle_destroy(esdm_cuse_polls[i].ph);
-			}
-			esdm_cuse_polls[i].fh = 0;
-			esdm_cuse_polls[i].ph = NULL;
-			esdm_cuse_polls[i].poll_events = 0;
-		}
-
-		if (esdm_cuse_polls[i].ph)
-			continue;
+	p = esdm_cuse_poll_find(fi->fh);
+	if (p)
+		esdm_cuse_poll_del(p, false);
 
+	if (ph) {
 		if (mask) {
 			fuse_notify_poll(ph);
 			fuse_pollhandle_destroy(ph);
-			break;
+		} else if (esdm_cuse_poll_add(fi->fh, ph, fi->poll_events)) {
+			/*
+			 * The handle cannot be tracked - wake the caller which
+			 * causes it to poll again.
+			 */
+			esdm_logger(LOGGER_WARN, LOGGER_C_CUSE,
+				    "Cannot register poll handle\n");
+			fuse_notify_poll(ph);
+			fuse_pollhandle_destroy(ph);
 		}
-
-		esdm_cuse_polls[i].fh = fi->fh;
-		esdm_cuse_polls[i].ph = ph;
-		esdm_cuse_polls[i].poll_events = fi->poll_events;
-		break;
-	}
-	mutex_w_unlock(&esdm_cuse_ph_lock);
-
-	if (i == ESDM_CUSE_MAX_PH) {
-		err_code = EBUSY;
-		goto err;
 	}
 
-	return;
-
-err:
-	fuse_reply_err(req, err_code);
+	mutex_w_unlock(&esdm_cuse_ph_lock);
 }
 
 /* Poll checker handler executed in separate thread */
 static int esdm_cuse_poll_checker(void __unused *unused)
 {
-	unsigned int i;
-
 	thread_set_name(cuse_poll, 0);
 
-	/* Clean out the poll status */
-	for (i = 0; i < ESDM_CUSE_MAX_PH; i++) {
-		esdm_cuse_polls[i].fh = 0;
-		esdm_cuse_polls[i].ph = NULL;
-		esdm_cuse_polls[i].poll_events = 0;
-	}
 	thread_wake_all(&esdm_cuse_poll_checker_wait);
 
 	while (!atomic_bool_read(&esdm_cuse_poll_thread_shutdown)) {
-		unsigned int sysmask, mask;
-		bool sysmask_set = false;
+		unsigned int sysmask, forcemask, i;
 
 		mutex_w_lock(&esdm_cuse_ph_lock);
-		for (i = 0; i < ESDM_CUSE_MAX_PH; i++) {
-			if (!esdm_cuse_polls[i].ph)
-				continue;
 
-			/* Get the mask once for this loop */
-			if (!sysmask_set) {
-				esdm_cuse_get_pollmask(&sysmask);
-				sysmask_set = true;
-			}
+		esdm_cuse_get_pollmask(&sysmask, &forcemask);
 
-			mask = sysmask;
-			esdm_cuse_set_pollmask(esdm_cuse_polls[i].poll_events,
-					       &mask);
+		/*
+		 * Wake every poller whose requested event is currently true.
+		 * Comparing with the previous check would miss an event which
+		 * was reset and set again in between. A woken poller is
+		 * removed from the lists, so it is notified only once.
+		 */
+		sysmask |= forcemask;
 
-			if (!mask)
+		for (i = 0; sysmask && i < esdm_cuse_poll_list_last; i++) {
+			struct esdm_cuse_poll *p;
+
+			if (!(sysmask & esdm_cuse_poll_list_events[i]))
 				continue;
 
-			fuse_notify_poll(esdm_cuse_polls[i].ph);
-			fuse_pollhandle_destroy(esdm_cuse_polls[i].ph);
-			esdm_cuse_polls[i].fh = 0;
-			esdm_cuse_polls[i].ph = NULL;
-			esdm_cuse_polls[i].poll_events = 0;
+			p = esdm_cuse_polls.list[i];
+			while (p) {
+				struct esdm_cuse_poll *next = p->next[i];
+
+				esdm_cuse_poll_del(p, true);
+				p = next;
+			}
 		}
+
 		mutex_w_unlock(&esdm_cuse_ph_lock);
 
 		esdm_cuse_shm_status_down();
@@ -959,19 +1209,12 @@ static int esdm_cuse_poll_checker(void __unused *unused)
 
 void esdm_cuse_release(fuse_req_t req, struct fuse_file_info *fi)
 {
-	unsigned int i;
+	struct esdm_cuse_poll *p;
 
 	mutex_w_lock(&esdm_cuse_ph_lock);
-	for (i = 0; i < ESDM_CUSE_MAX_PH; i++) {
-		if (esdm_cuse_polls[i].fh == fi->fh) {
-			fuse_notify_poll(esdm_cuse_polls[i].ph);
-			fuse_pollhandle_destroy(esdm_cuse_polls[i].ph);
-
-			esdm_cuse_polls[i].fh = 0;
-			esdm_cuse_polls[i].ph = NULL;
-			esdm_cuse_polls[i].poll_events = 0;
-		}
-	}
+	p = esdm_cuse_poll_find(fi->fh);
+	if (p)
+		esdm_cuse_poll_del(p, true);
 	mutex_w_unlock(&esdm_cuse_ph_lock);
 
 	fuse_reply_err(req, 0);
@@ -1024,6 +1267,8 @@ struct esdm_cuse_param {
 	char *dev_name;
 	char *username;
 	unsigned int verbosity;
+	unsigned int threads;
+	int clone_fd;
 	int is_help;
 	int disable_fallback;
 	int syslog;
@@ -1041,6 +1286,11 @@ static const char *usage =
 	"    --name=NAME|-n NAME     device name (mandatory)\n"
 	"    --verbosity=NUM|-v NUM  verbosity level\n"
 	"    --username=USER|-v USER unprivileged user name (default: \"nobody\")\n"
+	"    --threads=NUM|-t NUM    number of worker threads kept alive, each\n"
+	"                            using its own ESDM connection\n"
+	"                            (default: number of CPUs)\n"
+	"    --clone_fd=0|1          use separate /dev/cuse file descriptor per\n"
+	"                            worker thread (default: 1)\n"
 	"    -d   -o debug           enable debug output (implies -f)\n"
 	"    -f                      foreground operation\n"
 	"    -s                      disable multi-threaded operation\n"
@@ -1063,6 +1313,9 @@ static const struct fuse_opt esdm_cuse_opts[] = {
 	ESDM_CUSE_OPT("--verbosity=%u", verbosity),
 	ESDM_CUSE_OPT("-u %s", username),
 	ESDM_CUSE_OPT("--username %s", username),
+	ESDM_CUSE_OPT("-t %u", threads),
+	ESDM_CUSE_OPT("--threads=%u", threads),
+	ESDM_CUSE_OPT("--clone_fd=%d", clone_fd),
 #ifdef ESDM_TESTMODE
 	ESDM_CUSE_OPT("--disable_fallback=%d", disable_fallback),
 #endif
@@ -1099,12 +1352,13 @@ int main_common(const char *_devname, const char *target, const char *semname,
 		const struct cuse_lowlevel_ops *clop, int argc, char **argv)
 {
 	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
-	struct esdm_cuse_param param = { 0, 0, NULL, NULL, 1, 0, 0, 0 };
+	struct esdm_cuse_param param = { 0, 0, NULL, NULL, 1, 0, 1, 0, 0, 0 };
 	char dev_name[128] = "DEVNAME=";
 	char devname[20];
 	const char *dev_info_argv[] = { dev_name };
 	struct cuse_info ci;
-	int ret = 1;
+	struct fuse_session *se = NULL;
+	int multithreaded = 0, ret = 1;
 
 	if (fuse_opt_parse(&args, &param, esdm_cuse_opts,
 			   esdm_cuse_process_arg)) {
@@ -1165,6 +1419,15 @@ int main_common(const char *_devname, const char *target, const char *semname,
 			free(param.dev_name);
 	}
 
+	if (!param.threads)
+		param.threads = esdm_online_nodes();
+
+	/*
+	 * Each FUSE worker thread obtains its own connection to the ESDM
+	 * server such that the workers do not serialize on a shared
+	 * connection.
+	 */
+	CKINT(esdm_rpcc_set_thread_connections(param.threads));
 	CKINT_LOG(esdm_rpcc_init_unpriv_service(esdm_cuse_interrupt),
 		  "Initialization of dispatcher failed\n");
 	CKINT_LOG(esdm_rpcc_init_priv_service(esdm_cuse_interrupt),
@@ -1186,7 +1449,33 @@ int main_common(const char *_devname, const char *target, const char *semname,
 	ci.flags = CUSE_UNRESTRICTED_IOCTL;
 
 	esdm_cuse_install_sig_handler();
-	ret = cuse_lowlevel_main(args.argc, args.argv, &ci, clop, NULL);
+
+	se = cuse_lowlevel_setup(args.argc, args.argv, &ci, clop,
+				 &multithreaded, NULL);
+	if (!se) {
+		ret = 1;
+		goto out;
+	}
+
+	if (multithreaded) {
+		/*
+		 * If the kernel cannot clone the CUSE file descriptor, libfuse
+		 * continues with the shared file descriptor.
+		 */
+		struct fuse_loop_config config = {
+			.clone_fd = param.clone_fd,
+			.max_idle_threads = param.threads,
+		};
+
+		esdm_logger(LOGGER_DEBUG, LOGGER_C_CUSE,
+			    "Starting CUSE session with %u worker threads\n",
+			    param.threads);
+		ret = fuse_session_loop_mt(se, &config);
+	} else {
+		ret = fuse_session_loop(se);
+	}
+
+	cuse_lowlevel_teardown(se);
 
 out:
 	esdm_cuse_term();
@@ -20,7 +20,7 @@
 #ifndef CUSE_DEVICE_H
 #define CUSE_DEVICE_H
 
-#define FUSE_USE_VERSION 31
+#define FUSE_USE_VERSION 32
 #define _FILE_OFFSET_BITS 64
 #include <fuse3/fuse.h>
 #include <fuse3/cuse_lowlevel.h>
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,6 +39,7 @@ static unsigned int foreground = 0;
 static char *pidfile = NULL;
 static int pidfile_fd = -1;
 static const char *username = NULL;
+static int async_log = 0;
 
 /*******************************************************************
  * General helper functions
@@ -73,11 +75,57 @@ static void usage(void)
 		"\t   --jent_block_disable\tDisable Jitter RNG block collection\n");
 	fprintf(stderr,
 		"\t-S --syslog\tLog to syslog instead of stdout/stderr\n");
+	fprintf(stderr,
+		"\t   --affinity_rpc <CPULIST>\tPin each RPC worker to one CPU\n");
+	fprintf(stderr,
+		"\t\t\t\tout of the list (e.g. \"0-3,8\") and thus\n");
+	fprintf(stderr, "\t\t\t\tto a fixed DRNG node\n");
+	fprintf(stderr,
+		"\t   --affinity_es_monitor <CPULIST>\tCPUs for the ES monitor\n");
+	fprintf(stderr,
+		"\t   --affinity_jent <CPULIST>\tCPUs for the Jitter RNG block\n");
+	fprintf(stderr, "\t\t\t\tcollection\n");
+	fprintf(stderr,
+		"\t   --async_log\tFormat and write log messages in a separate\n");
+	fprintf(stderr, "\t\t\t\tthread\n");
+	fprintf(stderr,
+		"\t   --krng_reservoir\tPrefetch kernel RNG data into a\n");
+	fprintf(stderr, "\t\t\t\treservoir used for reseeding\n");
+	fprintf(stderr,
+		"\t   --hwrand_block_disable\tDisable /dev/hwrng block collection\n");
+	fprintf(stderr,
+		"\t   --seed_file <FILE>\tSeed file kept across restarts\n");
+	fprintf(stderr,
+		"\t   --seed_file_entropy <BITS>\tEntropy credited to the seed\n");
+	fprintf(stderr, "\t\t\t\tfile (default: 0)\n");
+	fprintf(stderr,
+		"\t   --rpc_client_id <uid|pid|cgroup>\tIdentity of RPC clients\n");
+	fprintf(stderr,
+		"\t\t\t\tfor the per-client limits and tenant DRNGs\n");
+	fprintf(stderr, "\t\t\t\t(default: uid)\n");
+	fprintf(stderr,
+		"\t   --rpc_rate_limit <BYTES>\tPer-client rate limit of\n");
+	fprintf(stderr,
+		"\t\t\t\texpensive requests in bytes per second\n");
+	fprintf(stderr,
+		"\t   --rpc_rate_burst <BYTES>\tPer-client burst size of\n");
+	fprintf(stderr, "\t\t\t\texpensive requests\n");
+	fprintf(stderr,
+		"\t   --rpc_fair_slots <NUM>\tNumber of concurrently served\n");
+	fprintf(stderr,
+		"\t\t\t\texpensive requests, further requests are\n");
+	fprintf(stderr, "\t\t\t\tqueued fairly across the clients\n");
+	fprintf(stderr,
+		"\t   --drng_tenant_idle <SECS>\tServe each RPC client with\n");
+	fprintf(stderr,
+		"\t\t\t\tits own DRNG released after SECS seconds\n");
+	fprintf(stderr, "\t\t\t\tof inactivity (default: 0 - disabled)\n");
 	exit(1);
 }
 
 static void parse_opts(int argc, char *argv[])
 {
+	unsigned long val;
 	int c = 0;
 	char version[30];
 
@@ -94,6 +142,22 @@ static void parse_opts(int argc, char *argv[])
 						{ "jent_block_disable", 0, 0,
 						  0 },
 						{ "syslog", 0, 0, 0 },
+						{ "affinity_rpc", 1, 0, 0 },
+						{ "affinity_es_monitor", 1, 0,
+						  0 },
+						{ "affinity_jent", 1, 0, 0 },
+						{ "async_log", 0, 0, 0 },
+						{ "krng_reservoir", 0, 0, 0 },
+						{ "hwrand_block_disable", 0, 0,
+						  0 },
+						{ "seed_file", 1, 0, 0 },
+						{ "seed_file_entropy", 1, 0,
+						  0 },
+						{ "rpc_client_id", 1, 0, 0 },
+						{ "rpc_rate_limit", 1, 0, 0 },
+						{ "rpc_rate_burst", 1, 0, 0 },
+						{ "rpc_fair_slots", 1, 0, 0 },
+						{ "drng_tenant_idle", 1, 0, 0 },
 						{ 0, 0, 0, 0 } };
 		c = getopt_long(argc, argv, "hvp:u:fisS", opts, &opt_index);
 		if (-1 == c)
@@ -147,6 +211,98 @@ static void parse_opts(int argc, char *argv[])
 				esdm_logger_enable_syslog("esdm-server");
 				break;
 
+			case 10:
+				/* affinity_rpc */
+				if (esdm_config_affinity_set(
+					    esdm_config_affinity_rpc, optarg))
+					usage();
+				break;
+			case 11:
+				/* affinity_es_monitor */
+				if (esdm_config_affinity_set(
+					    esdm_config_affinity_es_monitor,
+					    optarg))
+					usage();
+				break;
+			case 12:
+				/* affinity_jent */
+				if (esdm_config_affinity_set(
+					    esdm_config_affinity_jent, optarg))
+					usage();
+				break;
+
+			case 13:
+				/* async_log */
+				async_log = 1;
+				break;
+
+			case 14:
+				/* krng_reservoir */
+				esdm_config_es_krng_reservoir_enabled_set(1);
+				break;
+
+			case 15:
+				/* hwrand_block_disable */
+				esdm_config_es_hwrand_async_enabled_set(0);
+				break;
+
+			case 16:
+				/* seed_file */
+				if (esdm_config_seed_file_set(optarg))
+					usage();
+				break;
+			case 17:
+				/* seed_file_entropy */
+				val = strtoul(optarg, NULL, 10);
+				if (val == ULONG_MAX || val > UINT32_MAX)
+					usage();
+				esdm_config_seed_file_entropy_set(
+					(uint32_t)val);
+				break;
+
+			case 18:
+				/* rpc_client_id */
+				if (!strcmp(optarg, "uid"))
+					esdm_config_rpc_client_id_set(
+						esdm_config_rpc_client_uid);
+				else if (!strcmp(optarg, "pid"))
+					esdm_config_rpc_client_id_set(
+						esdm_config_rpc_client_pid);
+				else if (!strcmp(optarg, "cgroup"))
+					esdm_config_rpc_client_id_set(
+						esdm_config_rpc_client_cgroup);
+				else
+					usage();
+				break;
+			case 19:
+				/* rpc_rate_limit */
+				val = strtoul(optarg, NULL, 10);
+				if (val == ULONG_MAX || val > UINT32_MAX)
+					usage();
+				esdm_config_rpc_rate_limit_set((uint32_t)val);
+				break;
+			case 20:
+				/* rpc_rate_burst */
+				val = strtoul(optarg, NULL, 10);
+				if (val == ULONG_MAX || val > UINT32_MAX)
+					usage();
+				esdm_config_rpc_rate_burst_set((uint32_t)val);
+				break;
+			case 21:
+				/* rpc_fair_slots */
+				val = strtoul(optarg, NULL, 10);
+				if (val == ULONG_MAX || val > UINT32_MAX)
+					usage();
+				esdm_config_rpc_fair_slots_set((uint32_t)val);
+				break;
+			case 22:
+				/* drng_tenant_idle */
+				val = strtoul(optarg, NULL, 10);
+				if (val == ULONG_MAX || val > UINT32_MAX)
+					usage();
+				esdm_config_drng_tenant_idle_set((uint32_t)val);
+				break;
+
 			default:
 				usage();
 			}
@@ -347,6 +503,10 @@ int main(int argc, char *argv[])
 	if (verbosity == 0 && !foreground)
 		daemonize();
 
+	/* The log thread must be started after the fork */
+	if (async_log)
+		CKINT(esdm_logger_enable_async());
+
 	if (pidfile && strlen(pidfile))
 		create_pid_file(pidfile);
 
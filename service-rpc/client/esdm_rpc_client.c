@@ -49,7 +49,7 @@ struct esdm_rpcc_write_buf {
 	esdm_rpc_client_connection_t *rpc_conn;
 };
 
-static void esdm_fini_proto_service(esdm_rpc_client_connection_t *rpc_conn)
+void esdm_fini_proto_service(esdm_rpc_client_connection_t *rpc_conn)
 {
 	ProtobufCService *service;
 
@@ -71,7 +71,7 @@ static void esdm_fini_proto_service(esdm_rpc_client_connection_t *rpc_conn)
 	mutex_w_destroy(&rpc_conn->ref_cnt);
 }
 
-static int esdm_connect_proto_service(esdm_rpc_client_connection_t *rpc_conn)
+int esdm_connect_proto_service(esdm_rpc_client_connection_t *rpc_conn)
 {
 	const char *socketname = rpc_conn->socketname;
 	struct timespec ts = {
@@ -573,10 +573,10 @@ static void esdm_client_destroy(ProtobufCService *service)
 	mutex_w_unlock(&rpc_conn->lock);
 }
 
-static int esdm_init_proto_service(const ProtobufCServiceDescriptor *descriptor,
-				   const char *socketname,
-				   esdm_rpcc_interrupt_func_t interrupt_func,
-				   esdm_rpc_client_connection_t *rpc_conn)
+int esdm_init_proto_service(const ProtobufCServiceDescriptor *descriptor,
+			    const char *socketname,
+			    esdm_rpcc_interrupt_func_t interrupt_func,
+			    esdm_rpc_client_connection_t *rpc_conn)
 {
 	ProtobufCService *service;
 	int ret = 0;
@@ -613,32 +613,87 @@ int esdm_rpcc_set_max_online_nodes(uint32_t nodes)
 	return 0;
 }
 
+static uint32_t esdm_rpcc_thread_conns = 0;
+static atomic_t esdm_rpcc_thread_conn_next = ATOMIC_INIT(0);
+static __thread int esdm_rpcc_thread_conn = -1;
+
+DSO_PUBLIC
+int esdm_rpcc_set_thread_connections(uint32_t num)
+{
+	if (!num)
+		return -EINVAL;
+
+	esdm_rpcc_thread_conns = num;
+	return 0;
+}
+
+/* Upper limit of connections per node */
+#define ESDM_RPCC_MAX_NODE_CONNECTIONS 64
+
+static uint32_t esdm_rpcc_node_conns = 1;
+
+/* Connection of the node this thread used last */
+static __thread uint32_t esdm_rpcc_slot_hint = 0;
+
+DSO_PUBLIC
+int esdm_rpcc_set_node_connections(uint32_t num)
+{
+	if (!num || num > ESDM_RPCC_MAX_NODE_CONNECTIONS)
+		return -EINVAL;
+
+	esdm_rpcc_node_conns = num;
+	return 0;
+}
+
 static uint32_t esdm_rpcc_get_online_nodes(void)
 {
+	if (esdm_rpcc_thread_conns)
+		return esdm_rpcc_thread_conns;
+
 	return (min_uint32(esdm_rpcc_max_nodes, esdm_online_nodes()));
 }
 
 static uint32_t esdm_rpcc_curr_node(void)
 {
+	if (esdm_rpcc_thread_conns) {
+		/* Assign the connection to the thread during first use */
+		if (esdm_rpcc_thread_conn < 0) {
+			esdm_rpcc_thread_conn =
+				atomic_inc(&esdm_rpcc_thread_conn_next) - 1;
+		}
+
+		return ((uint32_t)esdm_rpcc_thread_conn %
+			esdm_rpcc_thread_conns);
+	}
+
 	return (esdm_curr_node() % esdm_rpcc_max_nodes);
 }
 
-static void esdm_rpcc_fini_service(esdm_rpc_client_connection_t **rpc_conn,
-				   uint32_t *num)
+/*
+ * The connection array is published together with its geometry as one object
+ * such that a caller never combines an array with the geometry of another.
+ */
+struct esdm_rpcc_pool {
+	uint32_t num_conn; /* Number of connections */
+	uint32_t node_conns; /* Connections per node */
+	esdm_rpc_client_connection_t conn[];
+};
+
+static void esdm_rpcc_fini_service(struct esdm_rpcc_pool **pool)
 {
 	struct timespec abstime;
-	esdm_rpc_client_connection_t *rpc_conn_array;
+	struct esdm_rpcc_pool *rpc_pool;
 	esdm_rpc_client_connection_t *rpc_conn_p;
-	uint32_t i, num_conn = *num;
+	uint32_t i, num_conn;
 	int lock_res;
 
 	/* Atomic exchange */
-	*num = 0;
-	rpc_conn_array = __sync_lock_test_and_set(rpc_conn, NULL);
-	if (!rpc_conn_array)
+	rpc_pool = __sync_lock_test_and_set(pool, NULL);
+	if (!rpc_pool)
 		return;
 
-	rpc_conn_p = rpc_conn_array;
+	num_conn = rpc_pool->num_conn;
+	rpc_conn_p = rpc_pool->conn;
 
 	esdm_test_shm_status_fini();
 
@@ -650,7 +705,7 @@ static void esdm_rpcc_fini_service(esdm_rpc_client_connection_t **rpc_conn,
 	 * Wait until the processing for a connection completed and then delete
 	 * it.
 	 */
-	for (i = 0, rpc_conn_p = rpc_conn_array; i < num_conn;
+	for (i = 0, rpc_conn_p = rpc_pool->conn; i < num_conn;
 	     i++, rpc_conn_p++) {
 		/*
 		 * Do not wait forever as during shutdown, the thread using
@@ -668,17 +723,18 @@ static void esdm_rpcc_fini_service(esdm_rpc_client_connection_t **rpc_conn,
 		esdm_fini_proto_service(rpc_conn_p);
 	}
 
-	free(rpc_conn_array);
+	free(rpc_pool);
 }
 
 static int esdm_rpcc_init_service(const ProtobufCServiceDescriptor *descriptor,
 				  const char *socketname,
 				  esdm_rpcc_interrupt_func_t interrupt_func,
-				  esdm_rpc_client_connection_t **rpc_conn,
-				  uint32_t *num_conn)
+				  struct esdm_rpcc_pool **pool)
 {
-	esdm_rpc_client_connection_t *tmp = *rpc_conn, *tmp_p;
-	uint32_t i = 0, nodes = esdm_rpcc_get_online_nodes();
+	struct esdm_rpcc_pool *tmp = *pool;
+	esdm_rpc_client_connection_t *tmp_p;
+	uint32_t i = 0, per_node = esdm_rpcc_node_conns,
+		 nodes = esdm_rpcc_get_online_nodes() * per_node;
 	int ret = 0;
 
 	/*
@@ -696,7 +752,7 @@ static int esdm_rpcc_init_service(const ProtobufCServiceDescriptor *descriptor,
 		 * If the existing nodes are already sufficient, do not allocate
 		 * more.
 		 */
-		if (*num_conn >= nodes)
+		if (tmp->num_conn >= nodes && tmp->node_conns >= per_node)
 			return 0;
 
 		/*
@@ -717,39 +773,37 @@ static int esdm_rpcc_init_service(const ProtobufCServiceDescriptor *descriptor,
 		 * init_service call is done at the beginning of an application,
 		 * i.e. when there is no transaction running.
 		 */
-		for (i = 0, tmp_p = tmp; i < *num_conn; i++, tmp_p++)
-			esdm_fini_proto_service(tmp_p);
-		if (tmp)
-			free(tmp);
-		*num_conn = 0;
+		esdm_rpcc_fini_service(pool);
 	}
 
-	tmp = calloc(nodes, sizeof(*tmp));
+	tmp = calloc(1, sizeof(*tmp) + nodes * sizeof(tmp->conn[0]));
 	CKNULL(tmp, -ENOMEM);
+	tmp->num_conn = nodes;
+	tmp->node_conns = per_node;
 
-	for (i = 0, tmp_p = tmp; i < nodes; i++, tmp_p++) {
+	for (i = 0, tmp_p = tmp->conn; i < nodes; i++, tmp_p++) {
 		CKINT(esdm_init_proto_service(descriptor, socketname,
 					      interrupt_func, tmp_p));
 	}
 
 	CKINT(esdm_test_shm_status_init());
 
-	if (__sync_val_compare_and_swap(rpc_conn, NULL, tmp) != NULL) {
+	if (__sync_val_compare_and_swap(pool, NULL, tmp) != NULL) {
 		ret = -EAGAIN;
 		goto out;
 	}
-	*num_conn = nodes;
 
 	esdm_logger(
 		LOGGER_DEBUG, LOGGER_C_ANY,
-		"Service supporting %u parallel requests for socket %s enabled\n",
-		nodes, socketname);
+		"Service supporting %u parallel requests (%u per node) for socket %s enabled\n",
+		nodes, per_node, socketname);
 
 out:
 	if (ret) {
 		uint32_t j;
 
-		for (j = 0, tmp_p = tmp; j < i; j++, tmp_p++)
+		for (j = 0, tmp_p = tmp ? tmp->conn : NULL; j < i;
+		     j++, tmp_p++)
 			esdm_fini_proto_service(tmp_p);
 
 		if (tmp)
@@ -758,27 +812,72 @@ out:
 	return ret;
 }
 
-static int esdm_rpcc_get_service(esdm_rpc_client_connection_t *rpc_conn_array,
-				 uint32_t num_conn,
+/*
+ * Claim an idle connection without blocking: first the connections of the
+ * node of the caller starting with the one it used last, then the connections
+ * of the neighbor nodes.
+ */
+static esdm_rpc_client_connection_t *
+esdm_rpcc_try_get_service(esdm_rpc_client_connection_t *rpc_conn_array,
+			  uint32_t num_conn, uint32_t node_conns, uint32_t node)
+{
+	uint32_t nodes = num_conn / node_conns, i, j;
+
+	for (i = 0; i < nodes; i++) {
+		uint32_t base = ((node + i) % nodes) * node_conns;
+
+		for (j = 0; j < node_conns; j++) {
+			uint32_t slot = (esdm_rpcc_slot_hint + j) % node_conns;
+			esdm_rpc_client_connection_t *rpc_conn_p =
+				rpc_conn_array + base + slot;
+
+			if (!mutex_w_trylock(&rpc_conn_p->ref_cnt))
+				continue;
+
+			/* Prefer this connection of the own node next time */
+			if (!i)
+				esdm_rpcc_slot_hint = slot;
+
+			return rpc_conn_p;
+		}
+	}
+
+	return NULL;
+}
+
+static int esdm_rpcc_get_service(struct esdm_rpcc_pool *pool,
 				 esdm_rpc_client_connection_t **ret_rpc_conn,
 				 void *int_data)
 {
-	esdm_rpc_client_connection_t *rpc_conn_p;
-	/* Protection against client programming errors */
-	uint32_t node = min_uint32(esdm_rpcc_curr_node(), num_conn);
+	esdm_rpc_client_connection_t *rpc_conn_array, *rpc_conn_p;
+	uint32_t node, num_conn, node_conns;
 	int ret = 0;
 
-	CKNULL(rpc_conn_array, -EFAULT);
+	CKNULL(pool, -EFAULT);
 	CKNULL(ret_rpc_conn, -EFAULT);
 
-	rpc_conn_p = rpc_conn_array + node;
+	rpc_conn_array = pool->conn;
+	num_conn = pool->num_conn;
+	node_conns = pool->node_conns;
+
+	/* Protection against client programming errors */
+	if (!node_conns || num_conn < node_conns)
+		return -EFAULT;
+	node = esdm_rpcc_curr_node() % (num_conn / node_conns);
 
 	/*
-	 * Wait until the previous call completed - each connection handle is
-	 * has only one caller at one given time. Lock the ref_cnt if we
-	 * obtained the connection handle.
+	 * Each connection handle has only one caller at one given time. Lock
+	 * the ref_cnt if we obtained the connection handle. If all connections
+	 * are busy, wait until the previous call on the connection of the own
+	 * node completed.
 	 */
-	mutex_w_lock(&rpc_conn_p->ref_cnt);
+	rpc_conn_p = esdm_rpcc_try_get_service(rpc_conn_array, num_conn,
+					       node_conns, node);
+	if (!rpc_conn_p) {
+		rpc_conn_p = rpc_conn_array + node * node_conns +
+			     esdm_rpcc_slot_hint % node_conns;
+		mutex_w_lock(&rpc_conn_p->ref_cnt);
+	}
 
 	if (atomic_read(&rpc_conn_p->state) != esdm_rpcc_initialized) {
 		mutex_w_unlock(&rpc_conn_p->ref_cnt);
@@ -807,15 +906,13 @@ static void esdm_rpcc_put_service(esdm_rpc_client_connection_t *rpc_conn)
 /******************************************************************************
  * Unprivileged connection
  ******************************************************************************/
-static esdm_rpc_client_connection_t *unpriv_rpc_conn = NULL;
-static uint32_t unpriv_rpc_conn_num = 0;
+static struct esdm_rpcc_pool *unpriv_rpc_pool = NULL;
 
 DSO_PUBLIC
 int esdm_rpcc_get_unpriv_service(esdm_rpc_client_connection_t **rpc_conn,
 				 void *int_data)
 {
-	return esdm_rpcc_get_service(unpriv_rpc_conn, unpriv_rpc_conn_num,
-				     rpc_conn, int_data);
+	return esdm_rpcc_get_service(unpriv_rpc_pool, rpc_conn, int_data);
 }
 
 DSO_PUBLIC
@@ -829,27 +926,25 @@ int esdm_rpcc_init_unpriv_service(esdm_rpcc_interrupt_func_t interrupt_func)
 {
 	return esdm_rpcc_init_service(&unpriv_access__descriptor,
 				      ESDM_RPC_UNPRIV_SOCKET, interrupt_func,
-				      &unpriv_rpc_conn, &unpriv_rpc_conn_num);
+				      &unpriv_rpc_pool);
 }
 
 DSO_PUBLIC
 void esdm_rpcc_fini_unpriv_service(void)
 {
-	esdm_rpcc_fini_service(&unpriv_rpc_conn, &unpriv_rpc_conn_num);
+	esdm_rpcc_fini_service(&unpriv_rpc_pool);
 }
 
 /******************************************************************************
  * Privileged connection
  ******************************************************************************/
-static esdm_rpc_client_connection_t *priv_rpc_conn = NULL;
-static uint32_t priv_rpc_conn_num = 0;
+static struct esdm_rpcc_pool *priv_rpc_pool = NULL;
 
 DSO_PUBLIC
 int esdm_rpcc_get_priv_service(esdm_rpc_client_connection_t **rpc_conn,
 			       void *int_data)
 {
-	return esdm_rpcc_get_service(priv_rpc_conn, priv_rpc_conn_num, rpc_conn,
-				     int_data);
+	return esdm_rpcc_get_service(priv_rpc_pool, rpc_conn, int_data);
 }
 
 DSO_PUBLIC
@@ -863,11 +958,11 @@ int esdm_rpcc_init_priv_service(esdm_rpcc_interrupt_func_t interrupt_func)
 {
 	return esdm_rpcc_init_service(&priv_access__descriptor,
 				      ESDM_RPC_PRIV_SOCKET, interrupt_func,
-				      &priv_rpc_conn, &priv_rpc_conn_num);
+				      &priv_rpc_pool);
 }
 
 DSO_PUBLIC
 void esdm_rpcc_fini_priv_service(void)
 {
-	esdm_rpcc_fini_service(&priv_rpc_conn, &priv_rpc_conn_num);
+	esdm_rpcc_fini_service(&priv_rpc_pool);
 }
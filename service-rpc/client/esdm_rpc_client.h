@@ -73,6 +73,45 @@ typedef struct esdm_rpc_client_connection esdm_rpc_client_connection_t;
  */
 int esdm_rpcc_set_max_online_nodes(uint32_t nodes);
 
+/**
+ * @brief Assign a dedicated connection to each calling thread
+ *
+ * By default, the connection used for a request is selected based on the
+ * CPU the caller executes on. Applications operating a pool of worker threads
+ * which are not bound to CPUs may instead want each worker to use its own
+ * connection. When invoking this function, the given number of connections
+ * is allocated during initialization of the services and each thread is
+ * assigned one connection in a round-robin fashion on its first request.
+ *
+ * NOTE: This call must be invoked before esdm_rpcc_init_unpriv_service and
+ *	 esdm_rpcc_init_priv_service.
+ *
+ * @param [in] num Number of connections - this should match the number of
+ *		   worker threads.
+ *
+ * @return 0 on success, 0 < on error
+ */
+int esdm_rpcc_set_thread_connections(uint32_t num);
+
+/**
+ * @brief Set the number of connections per node
+ *
+ * By default, one connection is allocated per node and all threads executing
+ * on the CPUs of one node share it - their requests are serialized. With more
+ * connections per node, a caller obtains an idle connection of its node. If
+ * all connections of its node are busy, an idle connection of a neighbor node
+ * is used. Only if all connections are busy, the caller waits for the
+ * connection of its node.
+ *
+ * NOTE: This call must be invoked before esdm_rpcc_init_unpriv_service and
+ *	 esdm_rpcc_init_priv_service.
+ *
+ * @param [in] num Number of connections per node (1 to 64)
+ *
+ * @return 0 on success, 0 < on error
+ */
+int esdm_rpcc_set_node_connections(uint32_t num);
+
 /******************************************************************************
  * Unprivileged ESDM interface
  ******************************************************************************/
@@ -314,6 +353,42 @@ ssize_t esdm_rpcc_get_random_bytes_full_timeout_int(uint8_t *buf, size_t buflen,
 						    struct timespec *ts,
 						    void *int_data);
 
+/**
+ * @brief RPC-version of esdm_get_random_bytes_full_deadline
+ *
+ * This call uses the unprivileged RPC endpoint of the ESDM server. It therefore
+ * can be invoked by any user.
+ *
+ * The time budget covers the entire request including the generation of the
+ * random bytes. The server never uses the request to perform a synchronous
+ * reseed and serves it before regular requests when its DRNG is contended.
+ *
+ * @param [out] buf Buffer to be filled with random bits.
+ * @param [in] buflen Size of the buffer to be filled.
+ * @param [in] ts time budget of the request
+ * @param [out] deadline_met set to 1 if the buffer was filled within the time
+ *			     budget, 0 otherwise (may be NULL)
+ *
+ * @return: read data length on success, < 0 on error (-EINTR means connection
+ *	    was interrupted and the caller may try again)
+ */
+ssize_t esdm_rpcc_get_random_bytes_full_deadline(uint8_t *buf, size_t buflen,
+						 struct timespec *ts,
+						 int *deadline_met);
+
+/**
+ * @brief See esdm_rpcc_get_random_bytes_full_deadline
+ *
+ * The function allows specifying an interrupt callback data structure that
+ * is used when invoking the interrupt check function registered with
+ * esdm_rpcc_init_priv_service / esdm_rpcc_init_unpriv_service
+ */
+ssize_t esdm_rpcc_get_random_bytes_full_deadline_int(uint8_t *buf,
+						     size_t buflen,
+						     struct timespec *ts,
+						     int *deadline_met,
+						     void *int_data);
+
 /**
  * @brief RPC-version of esdm_get_random_bytes_min
  *
@@ -684,6 +759,167 @@ int esdm_rpcc_set_min_reseed_secs(unsigned int seconds);
  */
 int esdm_rpcc_set_min_reseed_secs_int(unsigned int seconds, void *int_data);
 
+/******************************************************************************
+ * Asynchronous unprivileged ESDM interface
+ ******************************************************************************/
+
+/**
+ * @brief esdm_rpcc_async_t
+ *
+ * Opaque data structure referencing an asynchronous client context. The
+ * context owns one non-blocking connection to the unprivileged ESDM server
+ * interface on which many requests may be outstanding at the same time.
+ *
+ * The context is intended to be driven by an event loop of the caller
+ * (e.g. epoll or io_uring): requests are submitted without waiting for the
+ * server, the socket returned by esdm_rpcc_async_fd is monitored for
+ * readability and esdm_rpcc_async_process is invoked when it is readable. The
+ * processing completes all received responses by invoking the callbacks of
+ * the requests.
+ */
+typedef struct esdm_rpcc_async esdm_rpcc_async_t;
+
+/**
+ * @brief esdm_rpcc_async_cb_t - Completion callback of an asynchronous request
+ *
+ * The callback is invoked from esdm_rpcc_async_process or
+ * esdm_rpcc_async_fini. It may submit new requests, but it must not invoke
+ * esdm_rpcc_async_process or esdm_rpcc_async_fini.
+ *
+ * @param [in] ret Number of bytes written into the buffer of the request on
+ *		   success, < 0 on error (-EINTR means the server did not
+ *		   process the request and the caller may try again, -EAGAIN
+ *		   or -EBUSY mean the server limited the request and the
+ *		   caller may try again later or immediately, -EPIPE
+ *		   means the connection was closed, -ECANCELED means the
+ *		   context was released before the response arrived)
+ * @param [in] cb_data Opaque data provided with the request
+ */
+typedef void (*esdm_rpcc_async_cb_t)(ssize_t ret, void *cb_data);
+
+/**
+ * @brief Allocate an asynchronous context and connect it to the server
+ *
+ * @param [out] ctx Allocated context, release it with esdm_rpcc_async_fini
+ * @param [in] max_outstanding Maximum number of requests that may be
+ *			       outstanding at the same time (rounded up to
+ *			       the next power of two, at most 4096)
+ *
+ * @return 0 on success, < 0 on error
+ */
+int esdm_rpcc_async_init(esdm_rpcc_async_t **ctx, uint32_t max_outstanding);
+
+/**
+ * @brief Release an asynchronous context
+ *
+ * All outstanding requests are completed with -ECANCELED.
+ *
+ * @param [in] ctx Context to release
+ */
+void esdm_rpcc_async_fini(esdm_rpcc_async_t *ctx);
+
+/**
+ * @brief Obtain the file descriptor to monitor for completions
+ *
+ * When the file descriptor becomes readable, esdm_rpcc_async_process must be
+ * invoked. The server closes idle connections - in this case
+ * esdm_rpcc_async_process returns -EPIPE and the next submission establishes
+ * a new connection. The caller must then obtain the file descriptor anew.
+ *
+ * @param [in] ctx Asynchronous context
+ *
+ * @return file descriptor on success, < 0 if not connected
+ */
+int esdm_rpcc_async_fd(esdm_rpcc_async_t *ctx);
+
+/**
+ * @brief Register an eventfd signalled for completed requests
+ *
+ * After processing responses, esdm_rpcc_async_process adds the number of
+ * completed requests to the eventfd. This allows other threads or an
+ * io_uring instance to wait for completions.
+ *
+ * @param [in] ctx Asynchronous context
+ * @param [in] efd eventfd file descriptor owned by the caller, or -1 to
+ *		   unregister it
+ *
+ * @return 0 on success, < 0 on error
+ */
+int esdm_rpcc_async_set_eventfd(esdm_rpcc_async_t *ctx, int efd);
+
+/**
+ * @brief Process the received responses
+ *
+ * The function never blocks: it reads all responses available on the
+ * connection and invokes the callbacks of the completed requests. The
+ * function must not be invoked concurrently for one context.
+ *
+ * @param [in] ctx Asynchronous context
+ *
+ * @return number of completed requests on success, < 0 on error
+ */
+int esdm_rpcc_async_process(esdm_rpcc_async_t *ctx);
+
+/**
+ * @brief Number of outstanding requests
+ *
+ * @param [in] ctx Asynchronous context
+ *
+ * @return number of requests submitted but not yet completed
+ */
+uint32_t esdm_rpcc_async_outstanding(esdm_rpcc_async_t *ctx);
+
+/**
+ * @brief Asynchronous RPC-version of esdm_get_random_bytes_full
+ *
+ * The request is submitted without waiting for the server. The buffer must
+ * remain valid until the callback is invoked. The callback may report less
+ * data than requested.
+ *
+ * Requests may be submitted from any thread.
+ *
+ * @param [in] ctx Asynchronous context
+ * @param [out] buf Buffer to be filled with random bits.
+ * @param [in] buflen Size of the buffer to be filled (at most 65520 bytes).
+ * @param [in] cb Completion callback
+ * @param [in] cb_data Opaque data provided to the callback
+ *
+ * @return 0 on success, < 0 on error (-EAGAIN means that the maximum number of
+ *	    outstanding requests is reached or the socket buffer is full - the
+ *	    caller should process responses and try again)
+ */
+int esdm_rpcc_async_get_random_bytes_full(esdm_rpcc_async_t *ctx, uint8_t *buf,
+					  size_t buflen,
+					  esdm_rpcc_async_cb_t cb,
+					  void *cb_data);
+
+/**
+ * @brief Asynchronous RPC-version of esdm_get_random_bytes_min
+ *
+ * See esdm_rpcc_async_get_random_bytes_full for details.
+ */
+int esdm_rpcc_async_get_random_bytes_min(esdm_rpcc_async_t *ctx, uint8_t *buf,
+					 size_t buflen, esdm_rpcc_async_cb_t cb,
+					 void *cb_data);
+
+/**
+ * @brief Asynchronous RPC-version of esdm_get_random_bytes_pr
+ *
+ * See esdm_rpcc_async_get_random_bytes_full for details.
+ */
+int esdm_rpcc_async_get_random_bytes_pr(esdm_rpcc_async_t *ctx, uint8_t *buf,
+					size_t buflen, esdm_rpcc_async_cb_t cb,
+					void *cb_data);
+
+/**
+ * @brief Asynchronous RPC-version of esdm_get_random_bytes
+ *
+ * See esdm_rpcc_async_get_random_bytes_full for details.
+ */
+int esdm_rpcc_async_get_random_bytes(esdm_rpcc_async_t *ctx, uint8_t *buf,
+				     size_t buflen, esdm_rpcc_async_cb_t cb,
+				     void *cb_data);
+
 /**
  * @brief Invoke a function up to 5 times if EINTR was returned
  *
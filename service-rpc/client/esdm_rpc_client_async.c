@@ -0,0 +1,714 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "conv_be_le.h"
+#include "esdm_rpc_client_helper.h"
+#include "esdm_rpc_client_internal.h"
+#include "esdm_rpc_protocol.h"
+#include "esdm_rpc_protocol_helper.h"
+#include "esdm_rpc_service.h"
+#include "esdm_logger.h"
+#include "math_helper.h"
+#include "memset_secure.h"
+#include "ptr_err.h"
+#include "ret_checkers.h"
+#include "visibility.h"
+
+/*
+ * Asynchronous client: requests are tagged with a request ID which the server
+ * echoes in its response. The server processes the requests of one connection
+ * in order, thus a ring of request slots indexed by the request ID suffices
+ * to track the outstanding requests.
+ */
+
+/* Upper limit of outstanding requests of one context */
+#define ESDM_RPCC_ASYNC_MAX_OUTSTANDING 4096
+
+#define ESDM_RPCC_ASYNC_RX_SIZE                                                \
+	(ESDM_RPC_MAX_MSG_SIZE + sizeof(struct esdm_rpc_proto_sc_header))
+#define ESDM_RPCC_ASYNC_TX_SIZE ESDM_RPC_MAX_MSG_SIZE
+#define ESDM_RPCC_ASYNC_UNPACKED_SIZE (ESDM_RPC_MAX_MSG_SIZE + 128)
+
+struct esdm_rpcc_async_req {
+	uint32_t request_id; /* 0 marks an unused slot */
+	unsigned int method_index;
+	ProtobufCClosure closure;
+	void *closure_data;
+
+	/* Requests of the random number API complete into these fields */
+	esdm_rpcc_async_cb_t cb;
+	void *cb_data;
+	uint8_t *buf;
+	size_t buflen;
+	ssize_t ret;
+};
+
+struct esdm_rpcc_async {
+	/* Service with the lock protecting the connection and request slots */
+	esdm_rpc_client_connection_t rpc_conn;
+
+	struct esdm_rpcc_async_req *reqs;
+	uint32_t reqs_mask;
+	uint32_t next_id;
+	uint32_t outstanding;
+	uint8_t *tx_buf;
+
+	/* Receive state - protected by rx_lock */
+	mutex_w_t rx_lock;
+	uint8_t *rx_buf;
+	size_t rx_len;
+	uint8_t *unpacked;
+	int efd;
+};
+
+static void esdm_rpcc_async_complete(struct esdm_rpcc_async_req *req,
+				     const ProtobufCMessage *msg)
+{
+	/* Random number requests complete into the request itself */
+	if (req->cb) {
+		req->ret = -EFAULT;
+		req->closure(msg, req);
+		req->cb(req->ret, req->cb_data);
+	} else {
+		req->closure(msg, req->closure_data);
+	}
+}
+
+/*
+ * Submit one request. The request is linearized so that it is sent with one
+ * record - a non-blocking write of a SOCK_SEQPACKET socket either transmits
+ * the entire record or nothing.
+ */
+static int esdm_rpcc_async_submit(struct esdm_rpcc_async *ctx,
+				  unsigned int method_index,
+				  const ProtobufCMessage *input,
+				  const struct esdm_rpcc_async_req *tmpl)
+{
+	esdm_rpc_client_connection_t *rpc_conn = &ctx->rpc_conn;
+	const ProtobufCServiceDescriptor *desc = rpc_conn->service.descriptor;
+	struct esdm_rpc_proto_cs_header *cs_header;
+	struct esdm_rpc_write_data_buf tmp = {
+		.dst_written = 0,
+	};
+	struct esdm_rpcc_async_req *req;
+	size_t message_length;
+	ssize_t written;
+	int ret = 0;
+
+	if (method_index >= desc->n_methods ||
+	    input->descriptor != desc->methods[method_index].input)
+		return -EINVAL;
+
+	message_length = protobuf_c_message_get_packed_size(input);
+	if (message_length > ESDM_RPCC_ASYNC_TX_SIZE - sizeof(*cs_header)) {
+		esdm_logger(LOGGER_DEBUG, LOGGER_C_ANY,
+			    "Unexpected message length: %zu\n", message_length);
+		return -EFAULT;
+	}
+
+	mutex_w_lock(&rpc_conn->lock);
+
+	if (atomic_read(&rpc_conn->state) != esdm_rpcc_initialized) {
+		ret = -ESHUTDOWN;
+		goto out;
+	}
+
+	/* Re-establish a connection closed by the server */
+	if (rpc_conn->fd < 0) {
+		CKINT(esdm_connect_proto_service(rpc_conn));
+		set_fd_nonblocking(rpc_conn->fd);
+	}
+
+	req = &ctx->reqs[ctx->next_id & ctx->reqs_mask];
+	if (req->request_id) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	cs_header = (struct esdm_rpc_proto_cs_header *)ctx->tx_buf;
+	cs_header->method_index = le_bswap32(method_index);
+	cs_header->message_length = le_bswap32((uint32_t)message_length);
+	cs_header->request_id = le_bswap32(ctx->next_id);
+
+	esdm_logger(
+		LOGGER_DEBUG, LOGGER_C_RPC,
+		"Client submitting: message length %zu, message index %u, request ID %u\n",
+		message_length, method_index, ctx->next_id);
+
+	tmp.base.append = esdm_rpc_append_data;
+	tmp.dst_buf = ctx->tx_buf + sizeof(*cs_header);
+	if (protobuf_c_message_pack_to_buffer(input, &tmp.base) !=
+	    message_length) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	written = write(rpc_conn->fd, ctx->tx_buf,
+			sizeof(*cs_header) + message_length);
+	if (written < 0) {
+		ret = (errno == EWOULDBLOCK) ? -EAGAIN : -errno;
+		goto out;
+	}
+	if ((size_t)written != sizeof(*cs_header) + message_length) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	*req = *tmpl;
+	req->request_id = ctx->next_id;
+	req->method_index = method_index;
+	ctx->outstanding++;
+
+	/* Request ID 0 is used by the synchronous API */
+	if (!++ctx->next_id)
+		ctx->next_id = 1;
+
+out:
+	mutex_w_unlock(&rpc_conn->lock);
+	return ret;
+}
+
+/* Release the slot of a completed request */
+static bool esdm_rpcc_async_release(struct esdm_rpcc_async *ctx,
+				    uint32_t request_id,
+				    struct esdm_rpcc_async_req *req)
+{
+	struct esdm_rpcc_async_req *slot =
+		&ctx->reqs[request_id & ctx->reqs_mask];
+	bool found = false;
+
+	mutex_w_lock(&ctx->rpc_conn.lock);
+	if (request_id && slot->request_id == request_id) {
+		*req = *slot;
+		slot->request_id = 0;
+		ctx->outstanding--;
+		found = true;
+	}
+	mutex_w_unlock(&ctx->rpc_conn.lock);
+
+	return found;
+}
+
+/*
+ * Close the connection and complete all outstanding requests with the given
+ * error. The callbacks are invoked without holding the lock to allow them to
+ * submit new requests.
+ */
+static int esdm_rpcc_async_sever(struct esdm_rpcc_async *ctx, int err)
+{
+	esdm_rpc_client_connection_t *rpc_conn = &ctx->rpc_conn;
+	struct esdm_rpcc_async_req req;
+	uint32_t i;
+	int completed = 0;
+
+	mutex_w_lock(&rpc_conn->lock);
+	if (rpc_conn->fd >= 0) {
+		close(rpc_conn->fd);
+		rpc_conn->fd = -1;
+	}
+	mutex_w_unlock(&rpc_conn->lock);
+
+	memset_secure(ctx->rx_buf, 0, ctx->rx_len);
+	ctx->rx_len = 0;
+
+	for (i = 0; i <= ctx->reqs_mask; i++) {
+		if (!esdm_rpcc_async_release(ctx, ctx->reqs[i].request_id,
+					     &req))
+			continue;
+
+		esdm_rpcc_async_complete(&req, ERR_PTR(err));
+		completed++;
+	}
+
+	return completed;
+}
+
+static void esdm_rpcc_async_signal(struct esdm_rpcc_async *ctx, int completed)
+{
+	uint64_t val = (uint64_t)completed;
+
+	if (ctx->efd < 0 || completed <= 0)
+		return;
+
+	if (write(ctx->efd, &val, sizeof(val)) != sizeof(val)) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_RPC,
+			    "Signalling completion eventfd failed: %s\n",
+			    strerror(errno));
+	}
+}
+
+DSO_PUBLIC
+int esdm_rpcc_async_process(esdm_rpcc_async_t *ctx)
+{
+	ProtobufCAllocator esdm_rpc_client_allocator = {
+		.alloc = &esdm_rpc_alloc,
+		.free = &esdm_rpc_free,
+		.allocator_data = NULL,
+	};
+	BUFFER_INIT(tls);
+	const ProtobufCServiceDescriptor *desc;
+	int completed = 0, ret = 0;
+
+	CKNULL(ctx, -EINVAL);
+
+	desc = ctx->rpc_conn.service.descriptor;
+
+	mutex_w_lock(&ctx->rx_lock);
+
+	tls.buf = ctx->unpacked;
+	tls.len = ESDM_RPCC_ASYNC_UNPACKED_SIZE;
+	esdm_rpc_client_allocator.allocator_data = &tls;
+
+	/*
+	 * The file descriptor is only changed by the submission if it is not
+	 * set, or by this function.
+	 */
+	while (ctx->rpc_conn.fd >= 0) {
+		struct esdm_rpc_proto_sc *received_data =
+			(struct esdm_rpc_proto_sc *)ctx->rx_buf;
+		struct esdm_rpc_proto_sc_header header;
+		struct esdm_rpcc_async_req req;
+		ProtobufCMessage *msg;
+		ssize_t received;
+
+		received = read(ctx->rpc_conn.fd, ctx->rx_buf + ctx->rx_len,
+				ESDM_RPCC_ASYNC_RX_SIZE - ctx->rx_len);
+		if (received < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK ||
+			    errno == EINTR)
+				break;
+
+			ret = -errno;
+			goto sever;
+		}
+
+		/* Received EOF - the server closed the connection */
+		if (received == 0) {
+			ret = -EPIPE;
+			goto sever;
+		}
+
+		ctx->rx_len += (size_t)received;
+
+		/* Wait for the remainder of the response */
+		if (ctx->rx_len < sizeof(header))
+			continue;
+
+		header.status_code =
+			le_bswap32(received_data->header.status_code);
+		header.method_index =
+			le_bswap32(received_data->header.method_index);
+		header.message_length =
+			le_bswap32(received_data->header.message_length);
+		header.request_id =
+			le_bswap32(received_data->header.request_id);
+
+		if (header.message_length >
+		    ESDM_RPCC_ASYNC_RX_SIZE - sizeof(header)) {
+			esdm_logger(LOGGER_ERR, LOGGER_C_RPC,
+				    "Unexpected response length %u\n",
+				    header.message_length);
+			ret = -EFAULT;
+			goto sever;
+		}
+
+		if (ctx->rx_len < sizeof(header) + header.message_length)
+			continue;
+
+		esdm_logger(
+			LOGGER_DEBUG, LOGGER_C_RPC,
+			"Client received: server status %u, message length %u, message index %u, request ID %u\n",
+			header.status_code, header.message_length,
+			header.method_index, header.request_id);
+
+		if (!esdm_rpcc_async_release(ctx, header.request_id, &req)) {
+			esdm_logger(LOGGER_WARN, LOGGER_C_RPC,
+				    "Response for unknown request ID %u\n",
+				    header.request_id);
+			goto next;
+		}
+
+		if (header.status_code == PROTOBUF_C_RPC_STATUS_CODE_SUCCESS) {
+			msg = protobuf_c_message_unpack(
+				desc->methods[req.method_index].output,
+				&esdm_rpc_client_allocator,
+				header.message_length, received_data->data);
+			if (!msg) {
+				esdm_logger(LOGGER_ERR, LOGGER_C_RPC,
+					    "Response message not found\n");
+				msg = ERR_PTR(-EFAULT);
+			}
+		} else {
+			esdm_logger(LOGGER_VERBOSE, LOGGER_C_RPC,
+				    "Server returned with an error\n");
+			msg = ERR_PTR(-EINTR);
+		}
+
+		esdm_rpcc_async_complete(&req, msg);
+		if (!IS_ERR(msg)) {
+			protobuf_c_message_free_unpacked(
+				msg, &esdm_rpc_client_allocator);
+		}
+		completed++;
+
+	next:
+		memset_secure(ctx->rx_buf, 0, ctx->rx_len);
+		ctx->rx_len = 0;
+		memset_secure(tls.buf, 0, tls.consumed);
+		tls.consumed = 0;
+	}
+
+	ret = completed;
+	goto out;
+
+sever:
+	esdm_logger(LOGGER_DEBUG, LOGGER_C_RPC,
+		    "Connection to server severed: %d\n", ret);
+	completed += esdm_rpcc_async_sever(ctx, ret);
+
+out:
+	esdm_rpcc_async_signal(ctx, completed);
+	mutex_w_unlock(&ctx->rx_lock);
+	return ret;
+}
+
+/*
+ * Generic submission through the protobuf-c service, errors during the
+ * submission are reported to the closure.
+ */
+static void esdm_rpcc_async_invoke(ProtobufCService *service,
+				   unsigned int method_index,
+				   const ProtobufCMessage *input,
+				   ProtobufCClosure closure, void *closure_data)
+{
+	struct esdm_rpcc_async *ctx = (struct esdm_rpcc_async *)service;
+	struct esdm_rpcc_async_req tmpl = { .closure = closure,
+					    .closure_data = closure_data };
+	int ret = esdm_rpcc_async_submit(ctx, method_index, input, &tmpl);
+
+	if (ret)
+		closure(ERR_PTR(ret), closure_data);
+}
+
+/******************************************************************************
+ * Random number requests
+ ******************************************************************************/
+
+static void esdm_rpcc_async_copy_random(struct esdm_rpcc_async_req *req,
+					int64_t ret,
+					const ProtobufCBinaryData *randval)
+{
+	if (ret < 0) {
+		req->ret = (ssize_t)ret;
+		return;
+	}
+
+	req->ret = (ssize_t)min_size(randval->len, req->buflen);
+	memcpy(req->buf, randval->data, (size_t)req->ret);
+
+	/* Zeroization of response is handled in esdm_rpcc_async_process */
+}
+
+static void esdm_rpcc_async_get_random_bytes_full_cb(
+	const GetRandomBytesFullResponse *response, void *closure_data)
+{
+	struct esdm_rpcc_async_req *req = closure_data;
+
+	esdm_rpcc_error_check(response, req);
+	esdm_rpcc_async_copy_random(req, response->ret, &response->randval);
+}
+
+static void esdm_rpcc_async_get_random_bytes_min_cb(
+	const GetRandomBytesMinResponse *response, void *closure_data)
+{
+	struct esdm_rpcc_async_req *req = closure_data;
+
+	esdm_rpcc_error_check(response, req);
+	esdm_rpcc_async_copy_random(req, response->ret, &response->randval);
+}
+
+static void
+esdm_rpcc_async_get_random_bytes_pr_cb(const GetRandomBytesPrResponse *response,
+				       void *closure_data)
+{
+	struct esdm_rpcc_async_req *req = closure_data;
+
+	esdm_rpcc_error_check(response, req);
+	esdm_rpcc_async_copy_random(req, response->ret, &response->randval);
+}
+
+static void
+esdm_rpcc_async_get_random_bytes_cb(const GetRandomBytesResponse *response,
+				    void *closure_data)
+{
+	struct esdm_rpcc_async_req *req = closure_data;
+
+	esdm_rpcc_error_check(response, req);
+	esdm_rpcc_async_copy_random(req, response->ret, &response->randval);
+}
+
+/* Resolve the method by its name in the service descriptor */
+static int esdm_rpcc_async_method(esdm_rpcc_async_t *ctx, const char *name,
+				  unsigned int *method_index)
+{
+	const ProtobufCServiceDescriptor *desc =
+		ctx->rpc_conn.service.descriptor;
+	const ProtobufCMethodDescriptor *method =
+		protobuf_c_service_descriptor_get_method_by_name(desc, name);
+
+	if (!method)
+		return -EOPNOTSUPP;
+
+	*method_index = (unsigned int)(method - desc->methods);
+	return 0;
+}
+
+static int esdm_rpcc_async_random(esdm_rpcc_async_t *ctx, const char *name,
+				  const ProtobufCMessage *input,
+				  ProtobufCClosure closure, uint8_t *buf,
+				  size_t buflen, esdm_rpcc_async_cb_t cb,
+				  void *cb_data)
+{
+	struct esdm_rpcc_async_req tmpl = { .closure = closure,
+					    .cb = cb,
+					    .cb_data = cb_data,
+					    .buf = buf,
+					    .buflen = buflen };
+	unsigned int method_index;
+	int ret;
+
+	CKNULL(ctx, -EINVAL);
+	CKNULL(cb, -EINVAL);
+	if (!buf || !buflen || buflen > ESDM_RPC_MAX_DATA)
+		return -EINVAL;
+
+	CKINT(esdm_rpcc_async_method(ctx, name, &method_index));
+	CKINT(esdm_rpcc_async_submit(ctx, method_index, input, &tmpl));
+
+out:
+	return ret;
+}
+
+DSO_PUBLIC
+int esdm_rpcc_async_get_random_bytes_full(esdm_rpcc_async_t *ctx, uint8_t *buf,
+					  size_t buflen,
+					  esdm_rpcc_async_cb_t cb,
+					  void *cb_data)
+{
+	GetRandomBytesFullRequest msg = GET_RANDOM_BYTES_FULL_REQUEST__INIT;
+
+	msg.len = buflen;
+	return esdm_rpcc_async_random(
+		ctx, "RpcGetRandomBytesFull", &msg.base,
+		(ProtobufCClosure)esdm_rpcc_async_get_random_bytes_full_cb, buf,
+		buflen, cb, cb_data);
+}
+
+DSO_PUBLIC
+int esdm_rpcc_async_get_random_bytes_min(esdm_rpcc_async_t *ctx, uint8_t *buf,
+					 size_t buflen, esdm_rpcc_async_cb_t cb,
+					 void *cb_data)
+{
+	GetRandomBytesMinRequest msg = GET_RANDOM_BYTES_MIN_REQUEST__INIT;
+
+	msg.len = buflen;
+	return esdm_rpcc_async_random(
+		ctx, "RpcGetRandomBytesMin", &msg.base,
+		(ProtobufCClosure)esdm_rpcc_async_get_random_bytes_min_cb, buf,
+		buflen, cb, cb_data);
+}
+
+DSO_PUBLIC
+int esdm_rpcc_async_get_random_bytes_pr(esdm_rpcc_async_t *ctx, uint8_t *buf,
+					size_t buflen, esdm_rpcc_async_cb_t cb,
+					void *cb_data)
+{
+	GetRandomBytesPrRequest msg = GET_RANDOM_BYTES_PR_REQUEST__INIT;
+
+	msg.len = buflen;
+	return esdm_rpcc_async_random(
+		ctx, "RpcGetRandomBytesPr", &msg.base,
+		(ProtobufCClosure)esdm_rpcc_async_get_random_bytes_pr_cb, buf,
+		buflen, cb, cb_data);
+}
+
+DSO_PUBLIC
+int esdm_rpcc_async_get_random_bytes(esdm_rpcc_async_t *ctx, uint8_t *buf,
+				     size_t buflen, esdm_rpcc_async_cb_t cb,
+				     void *cb_data)
+{
+	GetRandomBytesRequest msg = GET_RANDOM_BYTES_REQUEST__INIT;
+
+	msg.len = buflen;
+	return esdm_rpcc_async_random(
+		ctx, "RpcGetRandomBytes", &msg.base,
+		(ProtobufCClosure)esdm_rpcc_async_get_random_bytes_cb, buf,
+		buflen, cb, cb_data);
+}
+
+/******************************************************************************
+ * Context handling
+ ******************************************************************************/
+
+DSO_PUBLIC
+int esdm_rpcc_async_fd(esdm_rpcc_async_t *ctx)
+{
+	int fd;
+
+	if (!ctx)
+		return -EINVAL;
+
+	mutex_w_lock(&ctx->rpc_conn.lock);
+	fd = ctx->rpc_conn.fd;
+	mutex_w_unlock(&ctx->rpc_conn.lock);
+
+	return (fd < 0) ? -ENOTCONN : fd;
+}
+
+DSO_PUBLIC
+int esdm_rpcc_async_set_eventfd(esdm_rpcc_async_t *ctx, int efd)
+{
+	if (!ctx)
+		return -EINVAL;
+
+	mutex_w_lock(&ctx->rx_lock);
+	ctx->efd = (efd < 0) ? -1 : efd;
+	mutex_w_unlock(&ctx->rx_lock);
+
+	return 0;
+}
+
+DSO_PUBLIC
+uint32_t esdm_rpcc_async_outstanding(esdm_rpcc_async_t *ctx)
+{
+	uint32_t outstanding;
+
+	if (!ctx)
+		return 0;
+
+	mutex_w_lock(&ctx->rpc_conn.lock);
+	outstanding = ctx->outstanding;
+	mutex_w_unlock(&ctx->rpc_conn.lock);
+
+	return outstanding;
+}
+
+/* Release the buffers and the context itself */
+static void esdm_rpcc_async_free(struct esdm_rpcc_async *ctx)
+{
+	if (ctx->unpacked) {
+		memset_secure(ctx->unpacked, 0, ESDM_RPCC_ASYNC_UNPACKED_SIZE);
+		free(ctx->unpacked);
+	}
+	if (ctx->rx_buf)
+		free(ctx->rx_buf);
+	if (ctx->tx_buf)
+		free(ctx->tx_buf);
+	if (ctx->reqs)
+		free(ctx->reqs);
+	free(ctx);
+}
+
+DSO_PUBLIC
+void esdm_rpcc_async_fini(esdm_rpcc_async_t *ctx)
+{
+	if (!ctx)
+		return;
+
+	atomic_set(&ctx->rpc_conn.state, esdm_rpcc_in_termination);
+
+	if (ctx->reqs && ctx->rx_buf) {
+		mutex_w_lock(&ctx->rx_lock);
+		esdm_rpcc_async_signal(ctx,
+				       esdm_rpcc_async_sever(ctx, -ECANCELED));
+		mutex_w_unlock(&ctx->rx_lock);
+	}
+
+	esdm_fini_proto_service(&ctx->rpc_conn);
+	mutex_w_destroy(&ctx->rx_lock);
+
+	esdm_rpcc_async_free(ctx);
+}
+
+DSO_PUBLIC
+int esdm_rpcc_async_init(esdm_rpcc_async_t **ctx, uint32_t max_outstanding)
+{
+	struct esdm_rpcc_async *tmp = NULL;
+	uint32_t slots = 1;
+	int ret;
+
+	CKNULL(ctx, -EINVAL);
+
+	if (!max_outstanding ||
+	    max_outstanding > ESDM_RPCC_ASYNC_MAX_OUTSTANDING)
+		return -EINVAL;
+	while (slots < max_outstanding)
+		slots <<= 1;
+
+	tmp = calloc(1, sizeof(*tmp));
+	CKNULL(tmp, -ENOMEM);
+	tmp->efd = -1;
+	tmp->next_id = 1;
+
+	tmp->reqs = calloc(slots, sizeof(*tmp->reqs));
+	tmp->reqs_mask = slots - 1;
+	tmp->tx_buf = malloc(ESDM_RPCC_ASYNC_TX_SIZE);
+	tmp->rx_buf = malloc(ESDM_RPCC_ASYNC_RX_SIZE);
+	tmp->unpacked = malloc(ESDM_RPCC_ASYNC_UNPACKED_SIZE);
+	if (!tmp->reqs || !tmp->tx_buf || !tmp->rx_buf || !tmp->unpacked) {
+		ret = -ENOMEM;
+		goto free_ctx;
+	}
+
+	ret = esdm_init_proto_service(&unpriv_access__descriptor,
+				      ESDM_RPC_UNPRIV_SOCKET, NULL,
+				      &tmp->rpc_conn);
+	if (ret)
+		goto free_ctx;
+	tmp->rpc_conn.service.invoke = esdm_rpcc_async_invoke;
+	mutex_w_init(&tmp->rx_lock, 0, 1);
+
+	ret = esdm_connect_proto_service(&tmp->rpc_conn);
+	if (ret)
+		goto fini_conn;
+	set_fd_nonblocking(tmp->rpc_conn.fd);
+
+	esdm_logger(
+		LOGGER_DEBUG, LOGGER_C_RPC,
+		"Asynchronous context supporting %u outstanding requests enabled\n",
+		slots);
+
+	*ctx = tmp;
+	return 0;
+
+	/* Unwind only what was set up - no request is outstanding yet */
+fini_conn:
+	mutex_w_destroy(&tmp->rx_lock);
+	esdm_fini_proto_service(&tmp->rpc_conn);
+free_ctx:
+	esdm_rpcc_async_free(tmp);
+out:
+	return ret;
+}
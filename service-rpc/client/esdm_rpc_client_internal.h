@@ -54,6 +54,13 @@ struct esdm_rpc_client_connection {
 	atomic_t state;
 };
 
+int esdm_init_proto_service(const ProtobufCServiceDescriptor *descriptor,
+			    const char *socketname,
+			    esdm_rpcc_interrupt_func_t interrupt_func,
+			    esdm_rpc_client_connection_t *rpc_conn);
+int esdm_connect_proto_service(esdm_rpc_client_connection_t *rpc_conn);
+void esdm_fini_proto_service(esdm_rpc_client_connection_t *rpc_conn);
+
 /* Sleep time for poll operations */
 static const struct timespec esdm_client_poll_ts = { .tv_sec = 1,
 						     .tv_nsec = 0 };
@@ -35,6 +35,7 @@ struct esdm_get_random_bytes_full_timeout_buf {
 	ssize_t ret;
 	uint8_t *buf;
 	size_t buflen;
+	bool deadline_met;
 };
 
 static void esdm_rpcc_get_random_bytes_full_timeout_cb(
@@ -52,6 +53,7 @@ static void esdm_rpcc_get_random_bytes_full_timeout_cb(
 
 	buffer->ret = (ssize_t)min_size(response->randval.len, buffer->buflen);
 	memcpy(buffer->buf, response->randval.data, (size_t)buffer->ret);
+	buffer->deadline_met = response->deadline_met;
 
 	/* Zeroization of response is handled in esdm_rpc_client_read_handler */
 }
@@ -69,19 +71,52 @@ static bool esdm_time_after(struct timespec *curr, struct timespec *timeout)
 	return false;
 }
 
-DSO_PUBLIC
-ssize_t esdm_rpcc_get_random_bytes_full_timeout_int(uint8_t *buf, size_t buflen,
-						    struct timespec *ts,
-						    void *int_data)
+/*
+ * Remaining time budget until the timeout, zero if the timeout already
+ * passed.
+ */
+static void esdm_time_remaining(struct timespec *timeout,
+				struct timespec *remaining)
+{
+	struct timespec curr;
+
+	remaining->tv_sec = 0;
+	remaining->tv_nsec = 0;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &curr) ||
+	    esdm_time_after(&curr, timeout))
+		return;
+
+	remaining->tv_sec = timeout->tv_sec - curr.tv_sec;
+	remaining->tv_nsec = timeout->tv_nsec - curr.tv_nsec;
+	if (remaining->tv_nsec < 0) {
+		remaining->tv_sec--;
+		remaining->tv_nsec += 1000000000;
+	}
+}
+
+/*
+ * With deadline_met set, the time budget covers the entire request and the
+ * server is asked to serve it as a deadline request.
+ */
+static ssize_t
+esdm_rpcc_get_random_bytes_full_timeout_common(uint8_t *buf, size_t buflen,
+					       struct timespec *ts,
+					       int *deadline_met,
+					       void *int_data)
 {
 	GetRandomBytesFullTimeoutRequest msg =
 		GET_RANDOM_BYTES_FULL_TIMEOUT_REQUEST__INIT;
 	esdm_rpc_client_connection_t *rpc_conn = NULL;
 	struct esdm_get_random_bytes_full_timeout_buf buffer;
 	size_t maxbuflen = buflen, orig_buflen = buflen;
-	struct timespec timeout;
+	struct timespec timeout, budget;
+	bool met = true;
 	ssize_t ret = 0;
 
+	if (deadline_met)
+		*deadline_met = 0;
+
 	CKNULL(ts, -EINVAL);
 
 	CKINT(esdm_rpcc_get_unpriv_service(&rpc_conn, int_data));
@@ -98,10 +133,18 @@ ssize_t esdm_rpcc_get_random_bytes_full_timeout_int(uint8_t *buf, size_t buflen,
 		buffer.ret = -ETIMEDOUT;
 		buffer.buf = buf;
 		buffer.buflen = buflen;
+		buffer.deadline_met = false;
+
+		/* A deadline request only gets the remaining time budget */
+		if (deadline_met)
+			esdm_time_remaining(&timeout, &budget);
+		else
+			budget = *ts;
 
 		msg.len = min_size(maxbuflen, buflen);
-		msg.tv_sec = (uint64_t)ts->tv_sec;
-		msg.tv_nsec = (uint32_t)ts->tv_nsec;
+		msg.tv_sec = (uint64_t)budget.tv_sec;
+		msg.tv_nsec = (uint32_t)budget.tv_nsec;
+		msg.deadline = !!deadline_met;
 
 		unpriv_access__rpc_get_random_bytes_full_timeout(
 			&rpc_conn->service, &msg,
@@ -110,16 +153,20 @@ ssize_t esdm_rpcc_get_random_bytes_full_timeout_int(uint8_t *buf, size_t buflen,
 		if (buffer.ret < -255) {
 			maxbuflen = (size_t)(-buffer.ret);
 			continue;
-		} else if (buffer.ret == -EAGAIN) {
+		} else if (buffer.ret == -EAGAIN || buffer.ret == -EBUSY) {
 			struct timespec curr;
 
 			CKINT(clock_gettime(CLOCK_MONOTONIC, &curr));
 
 			/* Terminate the endless loop if the timeout hits */
-			if (esdm_time_after(&curr, &timeout))
-				break;
-
-			nanosleep(&esdm_client_poll_ts, NULL);
+			if (esdm_time_after(&curr, &timeout)) {
+				ret = -ETIMEDOUT;
+				goto out;
+			}
+
+			/* The server was busy serving other clients */
+			if (buffer.ret == -EAGAIN)
+				nanosleep(&esdm_client_poll_ts, NULL);
 			continue;
 		} else if (buffer.ret < 0) {
 			ret = buffer.ret;
@@ -129,6 +176,12 @@ ssize_t esdm_rpcc_get_random_bytes_full_timeout_int(uint8_t *buf, size_t buflen,
 		esdm_test_shm_status_add_rpc_client_written((size_t)buffer.ret);
 		buflen -= (size_t)buffer.ret;
 		buf += buffer.ret;
+		met &= buffer.deadline_met;
+	}
+
+	if (deadline_met) {
+		esdm_time_remaining(&timeout, &budget);
+		*deadline_met = met && (budget.tv_sec || budget.tv_nsec);
 	}
 
 out:
@@ -136,6 +189,15 @@ out:
 	return (ret < 0) ? ret : (ssize_t)orig_buflen;
 }
 
+DSO_PUBLIC
+ssize_t esdm_rpcc_get_random_bytes_full_timeout_int(uint8_t *buf, size_t buflen,
+						    struct timespec *ts,
+						    void *int_data)
+{
+	return esdm_rpcc_get_random_bytes_full_timeout_common(buf, buflen, ts,
+							      NULL, int_data);
+}
+
 DSO_PUBLIC
 ssize_t esdm_rpcc_get_random_bytes_full_timeout(uint8_t *buf, size_t buflen,
 						struct timespec *ts)
@@ -143,3 +205,26 @@ ssize_t esdm_rpcc_get_random_bytes_full_timeout(uint8_t *buf, size_t buflen,
 	return esdm_rpcc_get_random_bytes_full_timeout_int(buf, buflen, ts,
 							   NULL);
 }
+
+DSO_PUBLIC
+ssize_t esdm_rpcc_get_random_bytes_full_deadline_int(uint8_t *buf,
+						     size_t buflen,
+						     struct timespec *ts,
+						     int *deadline_met,
+						     void *int_data)
+{
+	int met;
+
+	/* The deadline_met pointer selects the deadline semantics */
+	return esdm_rpcc_get_random_bytes_full_timeout_common(
+		buf, buflen, ts, deadline_met ? deadline_met : &met, int_data);
+}
+
+DSO_PUBLIC
+ssize_t esdm_rpcc_get_random_bytes_full_deadline(uint8_t *buf, size_t buflen,
+						 struct timespec *ts,
+						 int *deadline_met)
+{
+	return esdm_rpcc_get_random_bytes_full_deadline_int(buf, buflen, ts,
+							    deadline_met, NULL);
+}
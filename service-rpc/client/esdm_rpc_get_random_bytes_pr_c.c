@@ -85,6 +85,9 @@ ssize_t esdm_rpcc_get_random_bytes_pr_int(uint8_t *buf, size_t buflen,
 		} else if (buffer.ret == -EAGAIN) {
 			nanosleep(&esdm_client_poll_ts, NULL);
 			continue;
+		} else if (buffer.ret == -EBUSY) {
+			/* The server was busy serving other clients */
+			continue;
 		} else if (buffer.ret < 0) {
 			ret = buffer.ret;
 			goto out;
@@ -79,6 +79,12 @@ ssize_t esdm_rpcc_get_seed_int(uint8_t *buf, size_t buflen, unsigned int flags,
 		if (ret >= 0)
 			esdm_test_shm_status_add_rpc_client_written(
 				buffer.buflen);
+		/* The server was busy serving other clients */
+		if (ret == -EBUSY) {
+			if (!noblock)
+				continue;
+			ret = -EAGAIN;
+		}
 		if (noblock || ret != -EAGAIN)
 			break;
 
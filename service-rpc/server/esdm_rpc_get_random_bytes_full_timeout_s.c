@@ -50,8 +50,16 @@ void esdm_rpc_get_random_bytes_full_timeout(
 			.tv_nsec = request->tv_nsec,
 		};
 
-		response.ret = esdm_get_random_bytes_full_timeout(
-			rndval, request->len, &ts);
+		if (request->deadline) {
+			int deadline_met;
+
+			response.ret = esdm_get_random_bytes_full_deadline(
+				rndval, request->len, &ts, &deadline_met);
+			response.deadline_met = !!deadline_met;
+		} else {
+			response.ret = esdm_get_random_bytes_full_timeout(
+				rndval, request->len, &ts);
+		}
 
 		if (response.ret > 0) {
 			esdm_test_shm_status_add_rpc_server_written(
@@ -0,0 +1,587 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "bool.h"
+#include "config.h"
+#include "esdm_config.h"
+#include "esdm_rpc_limit.h"
+#include "esdm_rpc_service.h"
+#include "helper.h"
+#include "math_helper.h"
+#include "unpriv_access.pb-c.h"
+
+/* get_random_bytes_full requests up to this size are not limited */
+#define ESDM_RPCS_LIMIT_FULL_MIN 4096
+
+/*
+ * Upper bound of the time a request waits for a fair queuing slot: the ESDM
+ * RPC client resubmits a request when it does not receive the response within
+ * its receive timeout. Three quarters of it are used for waiting, the rest is
+ * left for serving the request.
+ */
+#define ESDM_RPCS_FAIR_WAIT_NS                                                 \
+	((((1ULL << ESDM_CLIENT_RX_TX_TIMEOUT_EXPONENT) >> 10) * 1000 * 3) / 4)
+
+/*
+ * Number of tracked clients - once reached, all further clients share one
+ * accounting state.
+ */
+#define ESDM_RPCS_CLIENT_MAX 1024
+#define ESDM_RPCS_CLIENT_HASH_BITS 8
+#define ESDM_RPCS_CLIENT_HASH (1U << ESDM_RPCS_CLIENT_HASH_BITS)
+#define ESDM_RPCS_CLIENT_NAMELEN 64
+
+struct esdm_rpcs_client {
+	struct esdm_rpcs_client *next; /* Hash chain */
+	struct esdm_rpcs_client *fair_next; /* Queue of waiting clients */
+	uint64_t key;
+	char name[ESDM_RPCS_CLIENT_NAMELEN]; /* Printable identity */
+	uint32_t refcnt; /* Connections of the client */
+
+	/* Token bucket */
+	int64_t tokens;
+	struct timespec refilled;
+
+	/* Fair queuing */
+	uint32_t waiting; /* Requests waiting for a slot */
+	uint32_t granted; /* Slots handed over to waiting requests */
+	bool fair_queued;
+
+	/* Statistics */
+	uint64_t requests;
+	uint64_t throttled;
+	uint64_t queued;
+};
+
+/* Protects the client table, the token buckets and the fair queue */
+static pthread_mutex_t esdm_rpcs_limit_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t esdm_rpcs_fair_cv = PTHREAD_COND_INITIALIZER;
+
+static struct esdm_rpcs_client *esdm_rpcs_clients[ESDM_RPCS_CLIENT_HASH];
+static uint32_t esdm_rpcs_nclients = 0;
+
+/* Never released - its bucket starts full as it was never refilled */
+static struct esdm_rpcs_client esdm_rpcs_client_overflow = {
+	.name = "other clients",
+	.refcnt = 1,
+};
+
+/* Clients waiting for a slot in the order they are served */
+static struct esdm_rpcs_client *esdm_rpcs_fair_head = NULL;
+static struct esdm_rpcs_client **esdm_rpcs_fair_tail = &esdm_rpcs_fair_head;
+static uint32_t esdm_rpcs_fair_busy = 0;
+
+static bool esdm_rpcs_limit_enabled(void)
+{
+	return esdm_config_rpc_rate_limit() || esdm_config_rpc_fair_slots();
+}
+
+static int64_t esdm_rpcs_limit_burst(void)
+{
+	uint32_t burst = esdm_config_rpc_rate_burst();
+
+	if (burst)
+		return burst;
+
+	return max_uint32(esdm_config_rpc_rate_limit(),
+			  (uint32_t)ESDM_RPC_MAX_DATA);
+}
+
+/************************** Identification of clients *************************/
+
+static uint32_t esdm_rpcs_client_hash(uint64_t key)
+{
+	return (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >>
+			  (64 - ESDM_RPCS_CLIENT_HASH_BITS));
+}
+
+/* The unified control group hierarchy is reported as "0::<path>" */
+static int esdm_rpcs_client_cgroup(pid_t pid, uint64_t *key, char *name,
+				   size_t namelen)
+{
+	char path[32], line[1024];
+	FILE *f;
+	int ret = -ENOENT;
+
+	snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+	f = fopen(path, "re");
+	if (!f)
+		return -errno;
+
+	while (fgets(line, sizeof(line), f)) {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		const char *p;
+
+		if (strncmp(line, "0::", 3))
+			continue;
+
+		line[strcspn(line, "\n")] = '\0';
+
+		/* FNV-1a - the top bit separates the keys from UIDs */
+		for (p = line + 3; *p; p++) {
+			hash ^= (uint8_t)*p;
+			hash *= 0x100000001b3ULL;
+		}
+		*key = hash | (1ULL << 63);
+		snprintf(name, namelen, "cgroup %s", line + 3);
+		ret = 0;
+		break;
+	}
+
+	fclose(f);
+	return ret;
+}
+
+static int esdm_rpcs_client_id(int fd, uint64_t *key, char *name,
+			       size_t namelen)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+		return -errno;
+
+	switch (esdm_config_rpc_client_id()) {
+	case esdm_config_rpc_client_pid:
+		*key = (uint64_t)cred.pid;
+		snprintf(name, namelen, "pid %d", cred.pid);
+		return 0;
+	case esdm_config_rpc_client_cgroup:
+		if (!esdm_rpcs_client_cgroup(cred.pid, key, name, namelen))
+			return 0;
+		/* Fall back to the UID if the control group is unknown */
+		/* fallthrough */
+	case esdm_config_rpc_client_uid:
+	default:
+		*key = cred.uid;
+		snprintf(name, namelen, "uid %u", cred.uid);
+		return 0;
+	}
+}
+
+/******************************** Token bucket ********************************/
+
+static void esdm_rpcs_client_refill(struct esdm_rpcs_client *client,
+				    const struct timespec *now)
+{
+	uint32_t rate = esdm_config_rpc_rate_limit();
+	int64_t burst = esdm_rpcs_limit_burst();
+	time_t sec = now->tv_sec - client->refilled.tv_sec;
+	long nsec = now->tv_nsec - client->refilled.tv_nsec;
+
+	if (!rate)
+		return;
+
+	if (nsec < 0) {
+		sec--;
+		nsec += 1000000000;
+	}
+	if (sec < 0)
+		return;
+
+	/* The bucket is full after burst / rate seconds */
+	if (sec > burst / rate) {
+		client->tokens = burst;
+	} else {
+		client->tokens += (int64_t)sec * rate;
+		client->tokens += (int64_t)(((uint64_t)nsec * rate) /
+					    1000000000ULL);
+		if (client->tokens > burst)
+			client->tokens = burst;
+	}
+
+	client->refilled = *now;
+}
+
+/* An unused client whose bucket is full does not carry any state */
+static bool esdm_rpcs_client_idle(struct esdm_rpcs_client *client,
+				  const struct timespec *now)
+{
+	if (client->refcnt || client->waiting)
+		return false;
+
+	esdm_rpcs_client_refill(client, now);
+	return !esdm_config_rpc_rate_limit() ||
+	       client->tokens >= esdm_rpcs_limit_burst();
+}
+
+static void esdm_rpcs_client_reclaim(const struct timespec *now)
+{
+	unsigned int i;
+
+	for (i = 0; i < ESDM_RPCS_CLIENT_HASH; i++) {
+		struct esdm_rpcs_client **pp = &esdm_rpcs_clients[i];
+
+		while (*pp) {
+			struct esdm_rpcs_client *client = *pp;
+
+			if (!esdm_rpcs_client_idle(client, now)) {
+				pp = &client->next;
+				continue;
+			}
+
+			*pp = client->next;
+			esdm_rpcs_nclients--;
+			free(client);
+		}
+	}
+}
+
+int esdm_rpcs_client_get(int fd, struct esdm_rpcs_client **clientp,
+			 uint64_t *key)
+{
+	struct esdm_rpcs_client *client = &esdm_rpcs_client_overflow;
+	struct timespec now;
+	char name[ESDM_RPCS_CLIENT_NAMELEN];
+	uint32_t hash;
+	int ret;
+
+	*clientp = NULL;
+
+	/* The identity is only needed for the limits and the tenant DRNGs */
+	if (!esdm_rpcs_limit_enabled() && !esdm_config_drng_tenant_idle())
+		return -EOPNOTSUPP;
+
+	/* The identity may require file system access - resolve it unlocked */
+	ret = esdm_rpcs_client_id(fd, key, name, sizeof(name));
+	if (!esdm_rpcs_limit_enabled())
+		return ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&esdm_rpcs_limit_lock);
+
+	if (ret)
+		goto out;
+
+	hash = esdm_rpcs_client_hash(*key);
+	for (client = esdm_rpcs_clients[hash]; client; client = client->next) {
+		if (client->key == *key)
+			goto out;
+	}
+
+	if (esdm_rpcs_nclients >= ESDM_RPCS_CLIENT_MAX)
+		esdm_rpcs_client_reclaim(&now);
+
+	client = NULL;
+	if (esdm_rpcs_nclients < ESDM_RPCS_CLIENT_MAX)
+		client = calloc(1, sizeof(*client));
+	if (!client) {
+		client = &esdm_rpcs_client_overflow;
+		goto out;
+	}
+
+	client->key = *key;
+	memcpy(client->name, name, sizeof(client->name));
+	client->tokens = esdm_rpcs_limit_burst();
+	client->refilled = now;
+	client->next = esdm_rpcs_clients[hash];
+	esdm_rpcs_clients[hash] = client;
+	esdm_rpcs_nclients++;
+
+out:
+	client->refcnt++;
+	pthread_mutex_unlock(&esdm_rpcs_limit_lock);
+	*clientp = client;
+	return ret;
+}
+
+void esdm_rpcs_client_put(struct esdm_rpcs_client *client)
+{
+	struct esdm_rpcs_client **pp;
+	struct timespec now;
+
+	if (!client)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&esdm_rpcs_limit_lock);
+
+	client->refcnt--;
+	if (!esdm_rpcs_client_idle(client, &now))
+		goto out;
+
+	for (pp = &esdm_rpcs_clients[esdm_rpcs_client_hash(client->key)]; *pp;
+	     pp = &(*pp)->next) {
+		if (*pp == client) {
+			*pp = client->next;
+			esdm_rpcs_nclients--;
+			free(client);
+			break;
+		}
+	}
+
+out:
+	pthread_mutex_unlock(&esdm_rpcs_limit_lock);
+}
+
+/******************************** Fair queuing ********************************/
+
+static void esdm_rpcs_fair_enqueue(struct esdm_rpcs_client *client)
+{
+	client->fair_next = NULL;
+	client->fair_queued = true;
+	*esdm_rpcs_fair_tail = client;
+	esdm_rpcs_fair_tail = &client->fair_next;
+}
+
+static void esdm_rpcs_fair_dequeue(struct esdm_rpcs_client *client)
+{
+	struct esdm_rpcs_client **pp;
+
+	for (pp = &esdm_rpcs_fair_head; *pp; pp = &(*pp)->fair_next) {
+		if (*pp != client)
+			continue;
+
+		*pp = client->fair_next;
+		if (esdm_rpcs_fair_tail == &client->fair_next)
+			esdm_rpcs_fair_tail = pp;
+		break;
+	}
+
+	client->fair_next = NULL;
+	client->fair_queued = false;
+}
+
+/*
+ * Wait until a slot is handed over to the client. Every client with waiting
+ * requests is queued once, after each hand-over the client moves to the end
+ * of the queue. Thus the slots are handed out round-robin across the clients
+ * irrespective of the number of requests a client submits.
+ */
+static int esdm_rpcs_fair_wait(struct esdm_rpcs_client *client,
+			       const struct timespec *now, uint64_t wait_ns)
+{
+	struct timespec abstime = *now;
+
+	wait_ns += (uint64_t)abstime.tv_nsec;
+	abstime.tv_sec += (time_t)(wait_ns / 1000000000);
+	abstime.tv_nsec = (long)(wait_ns % 1000000000);
+
+	client->queued++;
+	client->waiting++;
+	if (!client->fair_queued)
+		esdm_rpcs_fair_enqueue(client);
+
+	while (!client->granted) {
+		if (pthread_cond_clockwait(&esdm_rpcs_fair_cv,
+					   &esdm_rpcs_limit_lock,
+					   CLOCK_MONOTONIC,
+					   &abstime) != ETIMEDOUT ||
+		    client->granted)
+			continue;
+
+		/* No slot in time - give up the place in the queue */
+		client->waiting--;
+		if (!client->waiting)
+			esdm_rpcs_fair_dequeue(client);
+		return -EBUSY;
+	}
+
+	client->granted--;
+	return 0;
+}
+
+/****************************** Request handling ******************************/
+
+size_t esdm_rpcs_limit_cost(const ProtobufCMessageDescriptor *desc,
+			    const ProtobufCMessage *message, uint64_t *wait_ns)
+{
+	uint64_t len;
+
+	*wait_ns = ESDM_RPCS_FAIR_WAIT_NS;
+
+	if (desc == &get_seed_request__descriptor) {
+		len = ((const GetSeedRequest *)message)->len;
+	} else if (desc == &get_random_bytes_pr_request__descriptor) {
+		len = ((const GetRandomBytesPrRequest *)message)->len;
+	} else if (desc == &get_random_bytes_full_request__descriptor) {
+		len = ((const GetRandomBytesFullRequest *)message)->len;
+		if (len <= ESDM_RPCS_LIMIT_FULL_MIN)
+			return 0;
+	} else if (desc == &get_random_bytes_full_timeout_request__descriptor) {
+		const GetRandomBytesFullTimeoutRequest *req =
+			(const GetRandomBytesFullTimeoutRequest *)message;
+		uint64_t budget;
+
+		len = req->len;
+		if (len <= ESDM_RPCS_LIMIT_FULL_MIN)
+			return 0;
+
+		/* The request does not wait longer than its time budget */
+		budget = min_uint64(req->tv_sec, UINT32_MAX) * 1000000000ULL +
+			 req->tv_nsec;
+		*wait_ns = min_uint64(*wait_ns, budget);
+	} else {
+		return 0;
+	}
+
+	/* Larger requests are rejected by the handlers */
+	return (size_t)min_uint64(len, ESDM_RPC_MAX_DATA);
+}
+
+int esdm_rpcs_limit_begin(struct esdm_rpcs_client *client, size_t cost,
+			  uint64_t wait_ns)
+{
+	uint32_t slots = esdm_config_rpc_fair_slots();
+	struct timespec now;
+	int ret = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&esdm_rpcs_limit_lock);
+
+	client->requests++;
+
+	if (esdm_config_rpc_rate_limit()) {
+		int64_t needed = esdm_rpcs_limit_burst();
+
+		if ((int64_t)cost < needed)
+			needed = (int64_t)cost;
+
+		esdm_rpcs_client_refill(client, &now);
+
+		/* A request larger than the bucket requires a full bucket */
+		if (client->tokens < needed) {
+			client->throttled++;
+			ret = -EAGAIN;
+			goto out;
+		}
+		client->tokens -= (int64_t)cost;
+	}
+
+	if (!slots)
+		goto out;
+
+	/* Take a free slot unless other clients are waiting for it */
+	if (esdm_rpcs_fair_busy < slots && !esdm_rpcs_fair_head) {
+		esdm_rpcs_fair_busy++;
+		goto out;
+	}
+
+	ret = esdm_rpcs_fair_wait(client, &now, wait_ns);
+	if (ret) {
+		client->throttled++;
+		/* Refund the request which was not served */
+		if (esdm_config_rpc_rate_limit())
+			client->tokens += (int64_t)cost;
+	}
+
+out:
+	pthread_mutex_unlock(&esdm_rpcs_limit_lock);
+	return ret;
+}
+
+void esdm_rpcs_limit_end(struct esdm_rpcs_client *client)
+{
+	struct esdm_rpcs_client *next;
+
+	(void)client;
+
+	if (!esdm_config_rpc_fair_slots())
+		return;
+
+	pthread_mutex_lock(&esdm_rpcs_limit_lock);
+
+	next = esdm_rpcs_fair_head;
+	if (!next) {
+		esdm_rpcs_fair_busy--;
+		goto out;
+	}
+
+	/* Hand the slot over to the next waiting client */
+	esdm_rpcs_fair_dequeue(next);
+	next->waiting--;
+	next->granted++;
+	if (next->waiting)
+		esdm_rpcs_fair_enqueue(next);
+	pthread_cond_broadcast(&esdm_rpcs_fair_cv);
+
+out:
+	pthread_mutex_unlock(&esdm_rpcs_limit_lock);
+}
+
+/********************************** Status ************************************/
+
+static void esdm_rpcs_limit_status_client(struct esdm_rpcs_client *client,
+					  char *buf, size_t buflen,
+					  size_t *len)
+{
+	int ret;
+
+	if (*len >= buflen || !client->requests)
+		return;
+
+	ret = snprintf(buf + *len, buflen - *len,
+		       "  %s: requests %llu, throttled %llu, queued %llu\n",
+		       client->name, (unsigned long long)client->requests,
+		       (unsigned long long)client->throttled,
+		       (unsigned long long)client->queued);
+	if (ret > 0)
+		*len += (size_t)ret;
+}
+
+void esdm_rpcs_limit_status(char *buf, size_t buflen)
+{
+	static const char *const ids[] = { "UID", "PID", "control group" };
+	struct esdm_rpcs_client *client;
+	unsigned int id = (unsigned int)esdm_config_rpc_client_id();
+	uint32_t rate = esdm_config_rpc_rate_limit();
+	size_t len = 0;
+	unsigned int i;
+	int ret;
+
+	if (!esdm_rpcs_limit_enabled() || !buflen)
+		return;
+
+	pthread_mutex_lock(&esdm_rpcs_limit_lock);
+
+	ret = snprintf(buf, buflen,
+		       "RPC client limits:\n"
+		       " Client identity: %s\n"
+		       " Rate limit: %u bytes/s%s\n"
+		       " Burst: %lld bytes\n"
+		       " Fair queuing slots: %u (busy %u)\n"
+		       " Tracked clients: %u\n",
+		       id < ARRAY_SIZE(ids) ? ids[id] : "unknown",
+		       rate, rate ? "" : " (unlimited)",
+		       (long long)esdm_rpcs_limit_burst(),
+		       esdm_config_rpc_fair_slots(), esdm_rpcs_fair_busy,
+		       esdm_rpcs_nclients);
+	if (ret > 0)
+		len = (size_t)ret;
+
+	for (i = 0; i < ESDM_RPCS_CLIENT_HASH; i++) {
+		for (client = esdm_rpcs_clients[i]; client;
+		     client = client->next)
+			esdm_rpcs_limit_status_client(client, buf, buflen,
+						      &len);
+	}
+	esdm_rpcs_limit_status_client(&esdm_rpcs_client_overflow, buf, buflen,
+				      &len);
+
+	pthread_mutex_unlock(&esdm_rpcs_limit_lock);
+}
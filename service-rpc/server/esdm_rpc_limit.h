@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef ESDM_RPC_LIMIT_H
+#define ESDM_RPC_LIMIT_H
+
+#include <protobuf-c/protobuf-c.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-client accounting of the expensive requests of the unprivileged RPC
+ * interface: token bucket rate limit and fair queuing across the clients.
+ * The client is identified by the peer credentials of the connection.
+ */
+struct esdm_rpcs_client;
+
+/**
+ * @brief Obtain the identity and the accounting state of the peer of a
+ *	  connection
+ *
+ * The identity is derived from the peer credentials as configured with
+ * esdm_config_rpc_client_id_set. It is only resolved if per-client limits or
+ * tenant DRNGs are configured. If the identity cannot be resolved, the
+ * requests are accounted to a shared state.
+ *
+ * @param [in] fd Connected Unix domain socket
+ * @param [out] client Accounting state, NULL if no per-client limits are
+ *		       configured
+ * @param [out] key Identity of the peer
+ *
+ * @return 0 on success, < 0 if the identity is not available
+ */
+int esdm_rpcs_client_get(int fd, struct esdm_rpcs_client **client,
+			 uint64_t *key);
+
+/**
+ * @brief Release the accounting state obtained with esdm_rpcs_client_get
+ */
+void esdm_rpcs_client_put(struct esdm_rpcs_client *client);
+
+/**
+ * @brief Cost of a request in bytes, 0 for requests which are not limited
+ *
+ * @param [in] desc Descriptor of the request message
+ * @param [in] message Unpacked request message
+ * @param [out] wait_ns Time the request may wait for a fair queuing slot -
+ *			bounded by the receive timeout of the client and the
+ *			time budget of the request
+ */
+size_t esdm_rpcs_limit_cost(const ProtobufCMessageDescriptor *desc,
+			    const ProtobufCMessage *message, uint64_t *wait_ns);
+
+/**
+ * @brief Admit an expensive request of the client
+ *
+ * The call charges the cost to the token bucket of the client and waits for
+ * a fair queuing slot. Once admitted, the request must be completed with
+ * esdm_rpcs_limit_end.
+ *
+ * @param [in] client Accounting state of the client
+ * @param [in] cost Cost of the request in bytes
+ * @param [in] wait_ns Maximum time to wait for a fair queuing slot
+ *
+ * @return 0 when the request is admitted, -EAGAIN when the client exceeded
+ *	   its rate, -EBUSY when no slot became available in time - the client
+ *	   retries the latter immediately
+ */
+int esdm_rpcs_limit_begin(struct esdm_rpcs_client *client, size_t cost,
+			  uint64_t wait_ns);
+
+/**
+ * @brief Complete an expensive request admitted by esdm_rpcs_limit_begin
+ */
+void esdm_rpcs_limit_end(struct esdm_rpcs_client *client);
+
+void esdm_rpcs_limit_status(char *buf, size_t buflen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ESDM_RPC_LIMIT_H */
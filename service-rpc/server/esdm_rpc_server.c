@@ -27,8 +27,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/shm.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
@@ -42,6 +43,7 @@
 #include "esdm.h"
 #include "esdm_config.h"
 #include "esdm_rpc_protocol.h"
+#include "esdm_rpc_limit.h"
 #include "esdm_rpc_protocol_helper.h"
 #include "esdm_rpc_server.h"
 #include "esdm_rpc_server_linux.h"
@@ -58,6 +60,7 @@
 struct esdm_rpcs {
 	ProtobufCService *service;
 	int server_listening_fd;
+	bool limited; /* Apply the per-client limits */
 };
 
 struct esdm_rpcs_connection {
@@ -66,6 +69,7 @@ struct esdm_rpcs_connection {
 	ProtobufCAllocator *rpc_allocator;
 	uint32_t method_index;
 	uint32_t request_id;
+	struct esdm_rpcs_client *client; /* Per-client accounting */
 };
 
 struct esdm_rpcs_write_buf {
@@ -86,6 +90,8 @@ static DECLARE_WAIT_QUEUE(esdm_rpc_thread_init_wait);
 
 static pid_t server_pid = -1;
 static atomic_t server_exit = ATOMIC_INIT(0);
+/* Signalled when the server shall exit, never reset */
+static int server_exit_fd = -1;
 
 /* Remove a potentially left-over old Unix Domain socket. */
 static void esdm_rpcs_stale_socket(const char *path, struct sockaddr *addr,
@@ -345,6 +351,35 @@ out:
 	return;
 }
 
+/*
+ * Answer a request rejected by the per-client limits with the given error. The
+ * limited requests all have a response with an int64 return code.
+ */
+static void esdm_rpcs_limit_reject(struct esdm_rpcs_connection *rpc_conn,
+				   int64_t ret)
+{
+	const ProtobufCMessageDescriptor *desc =
+		rpc_conn->proto->service->descriptor
+			->methods[rpc_conn->method_index]
+			.output;
+	const ProtobufCFieldDescriptor *field =
+		protobuf_c_message_descriptor_get_field_by_name(desc, "ret");
+	union {
+		GetSeedResponse seed;
+		GetRandomBytesPrResponse pr;
+		GetRandomBytesFullResponse full;
+		GetRandomBytesFullTimeoutResponse full_timeout;
+	} response;
+
+	if (!field || field->type != PROTOBUF_C_TYPE_INT64 ||
+	    desc->sizeof_message > sizeof(response))
+		return;
+
+	protobuf_c_message_init(desc, &response);
+	memcpy((uint8_t *)&response + field->offset, &ret, sizeof(ret));
+	esdm_rpcs_response_closure((ProtobufCMessage *)&response, rpc_conn);
+}
+
 /* Unpack the received data and invoke the intended ProtobufC handler. */
 static int esdm_rpcs_unpack(struct esdm_rpcs_connection *rpc_conn,
 			    struct esdm_rpc_proto_cs *received_data)
@@ -355,6 +390,8 @@ static int esdm_rpcs_unpack(struct esdm_rpcs_connection *rpc_conn,
 	ProtobufCMessage *message = NULL;
 	struct esdm_rpc_proto_cs_header *header = &received_data->header;
 	uint32_t method_index = header->method_index;
+	uint64_t wait_ns;
+	size_t cost = 0;
 	int ret;
 
 	CKINT(esdm_rpc_proto_get_descriptor(service, received_data, &desc));
@@ -367,10 +404,26 @@ static int esdm_rpcs_unpack(struct esdm_rpcs_connection *rpc_conn,
 	rpc_conn->method_index = method_index;
 	rpc_conn->request_id = header->request_id;
 
+	/* Expensive requests are subject to the per-client limits */
+	if (rpc_conn->client)
+		cost = esdm_rpcs_limit_cost(desc, message, &wait_ns);
+	if (cost) {
+		int limit = esdm_rpcs_limit_begin(rpc_conn->client, cost,
+						  wait_ns);
+
+		if (limit) {
+			esdm_rpcs_limit_reject(rpc_conn, limit);
+			goto out;
+		}
+	}
+
 	/* Invoke the RPC call */
 	service->invoke(service, method_index, message,
 			esdm_rpcs_response_closure, rpc_conn);
 
+	if (cost)
+		esdm_rpcs_limit_end(rpc_conn->client);
+
 out:
 	if (message)
 		protobuf_c_message_free_unpacked(message,
@@ -515,6 +568,7 @@ static void esdm_rpcs_release_conn(struct esdm_rpcs_connection *rpc_conn)
 		return;
 	if (rpc_conn->child_fd >= 0)
 		close(rpc_conn->child_fd);
+	esdm_rpcs_client_put(rpc_conn->client);
 	free(rpc_conn);
 }
 
@@ -522,8 +576,21 @@ static void esdm_rpcs_release_conn(struct esdm_rpcs_connection *rpc_conn)
 static int esdm_rpcs_handler(void *args)
 {
 	struct esdm_rpcs_connection *rpc_conn = args;
+	uint64_t tenant;
 	int ret;
 
+	/* Bind the worker to its CPU and thus to its node DRNG */
+	esdm_config_affinity_apply(esdm_config_affinity_rpc);
+
+	/* The peer of a connection does not change */
+	if (rpc_conn->proto->limited &&
+	    !esdm_rpcs_client_get(rpc_conn->child_fd, &rpc_conn->client,
+				  &tenant)) {
+		/* The requests of the peer are served by its tenant DRNG */
+		if (esdm_config_drng_tenant_idle())
+			esdm_drng_tenant_set(tenant);
+	}
+
 	/*
 	 * Loop reusing the existing connection. When an error is received,
 	 * the communication is considered to be severed and the child FD can
@@ -536,6 +603,9 @@ static int esdm_rpcs_handler(void *args)
 	esdm_logger(LOGGER_DEBUG, LOGGER_C_RPC,
 		    "Closing incoming connection for FD %d\n",
 		    rpc_conn->child_fd);
+	/* The worker thread is reused for other connections */
+	esdm_drng_tenant_unset();
+	esdm_config_affinity_release();
 	esdm_rpcs_release_conn(rpc_conn);
 	return 0;
 }
@@ -595,49 +665,59 @@ static int esdm_rpcs_workerloop(struct esdm_rpcs *proto)
 		rpc_conn->proto = proto;
 
 		/*
+		 * Wait for either an incoming connection or the server_exit_fd
+		 * event which is raised when server_exit is set. There is no
+		 * timeout, an idle server is not woken up.
+		 *
 		 * When there is a high load, there is a race between SIGTERM
-		 * signal breaking the accept() call and the propagation that
-		 * server_exit is set to true. Thus, in a shutdown under high
-		 * load, it is possible that the caller triggered yet another
-		 * accept() before server_exit is set. In this case, accept
-		 * now blocks indefinitely. If it is unacceptable to check
-		 * accept's errno for EINTR and then terminate the loop,
-		 * because other signals than SIGTERM can be received that
-		 * should not immediately terminate the worker loop, undefine
-		 * this macro to use a timer-based wakeup to check for the
-		 * status of server_exit.
+		 * signal interrupting the wait and the propagation that
+		 * server_exit is set to true. With
+		 * ESDM_WORKERLOOP_TERM_ON_SIGNAL, the worker loop terminates
+		 * when the wait is interrupted by a signal. If this is
+		 * unacceptable, because other signals than SIGTERM can be
+		 * received that should not immediately terminate the worker
+		 * loop, undefine this macro - interrupted waits are then
+		 * simply retried and the server_exit_fd event terminates the
+		 * loop.
 		 */
-#ifndef ESDM_WORKERLOOP_TERM_ON_SIGNAL
 		for (;;) {
-			struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
-			fd_set fds;
-			int sret;
+			struct pollfd fds[2] = {
+				{ .fd = proto->server_listening_fd,
+				  .events = POLLIN },
+				{ .fd = server_exit_fd, .events = POLLIN },
+			};
+			int pret;
 
-			FD_ZERO(&fds);
-			FD_SET(proto->server_listening_fd, &fds);
+			pret = poll(fds, server_exit_fd < 0 ? 1 : 2, -1);
 
-			sret = select(proto->server_listening_fd + 1, &fds,
-				      NULL, NULL, &timeout);
+			if (pret == -1 && errno == EINTR) {
+#ifdef ESDM_WORKERLOOP_TERM_ON_SIGNAL
+				/* Terminate the loop upon receipt of signal */
+				goto out;
+#else
+				/* interrupted - simply retry */
+				if (!atomic_read(&server_exit))
+					continue;
+				goto out;
+#endif
+			}
 
 			/* error */
-			if (sret == -1 && errno != EINTR) {
+			if (pret == -1) {
 				esdm_logger(LOGGER_ERR, LOGGER_C_ANY,
-					    "Select returned with error %s\n",
+					    "Poll returned with error %s\n",
 					    strerror(errno));
 				goto out;
 			}
 
-			/* activity */
-			if (sret > 0)
-				break;
-
-			/* timeout - yet server shall exit */
-			if (atomic_read(&server_exit))
+			/* server shall exit */
+			if (atomic_read(&server_exit) || fds[1].revents)
 				goto out;
 
-			/* timeout - simply retry */
+			/* activity */
+			if (fds[0].revents)
+				break;
 		}
-#endif
 
 		/* Wait for incoming connection */
 		rpc_conn->child_fd =
@@ -802,6 +882,7 @@ static int esdm_rpcs_unpriv_init(void *args)
 	memset(&unpriv_proto, 0, sizeof(unpriv_proto));
 
 	unpriv_proto.server_listening_fd = -1;
+	unpriv_proto.limited = true;
 
 	/* Create server handler for privileged interface in main thread */
 	CKINT(esdm_rpcs_start(ESDM_RPC_UNPRIV_SOCKET, 0, unpriv_service,
@@ -1006,6 +1087,7 @@ static void esdm_rpc_priv_init_complete(void)
 static int esdm_rpc_server_es_monitor(void __unused *unused)
 {
 	thread_set_name(es_monitor, 0);
+	esdm_config_affinity_apply(esdm_config_affinity_es_monitor);
 
 	return esdm_init_monitor(esdm_rpc_priv_init_complete);
 }
@@ -1024,6 +1106,19 @@ int esdm_rpc_server_init(const char *username)
 	/* One thread group */
 	CKINT(thread_init(1));
 
+	/* Statistics of the kernel feeder are reported by the server process */
+	esdm_rpcs_linux_init_feeder_stat();
+
+	/*
+	 * Event to terminate the worker loops - it is inherited by the server
+	 * process.
+	 */
+	server_exit_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (server_exit_fd < 0) {
+		esdm_logger(LOGGER_WARN, LOGGER_C_SERVER,
+			    "Cannot create exit event: %s\n", strerror(errno));
+	}
+
 	pid = fork();
 	if (pid < 0) {
 		esdm_logger(LOGGER_ERR, LOGGER_C_SERVER,
@@ -1092,6 +1187,17 @@ void esdm_rpc_server_fini(void)
 	atomic_set(&server_exit, 1);
 	thread_wake_all(&esdm_rpc_thread_init_wait);
 
+	/* Wake up the worker loops waiting for incoming connections */
+	if (server_exit_fd >= 0) {
+		uint64_t one = 1;
+
+		if (write(server_exit_fd, &one, sizeof(one)) < 0) {
+			esdm_logger(LOGGER_WARN, LOGGER_C_SERVER,
+				    "Cannot signal exit event: %s\n",
+				    strerror(errno));
+		}
+	}
+
 	/* Unblock the accept() in the server loop */
 	thread_send_signal(ESDM_THREAD_RPC_UNPRIV_GROUP, SIGUSR1);
 	thread_send_signal(ESDM_THREAD_CUSE_POLL_GROUP, SIGUSR1);
@@ -20,25 +20,48 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/random.h>
+#include <poll.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "atomic.h"
+#include "atomic_64.h"
 #include "esdm.h"
+#include "esdm_definitions.h"
 #include "esdm_rpc_server_linux.h"
 #include "helper.h"
+#include "math_helper.h"
 #include "esdm_logger.h"
 #include "memset_secure.h"
 #include "threading_support.h"
 
-static int esdm_rpcs_linux_insert_entropy(struct rand_pool_info *rpi)
+/*
+ * Statistics of the kernel feeder. The feeder runs in the cleanup process
+ * whereas the status is reported by the server process - the statistics are
+ * therefore kept in memory shared between both.
+ */
+struct esdm_rpcs_linux_feeder_stat {
+	atomic_64_t injections;
+	atomic_64_t bytes;
+	atomic_64_t skipped;
+	atomic_t demand_driven;
+};
+
+static struct esdm_rpcs_linux_feeder_stat *esdm_rpcs_linux_stat = NULL;
+
+/*
+ * Open the device the entropy is injected with. The file descriptor is kept
+ * open until injecting entropy with it fails.
+ */
+static int esdm_rpcs_linux_open_sink(unsigned long *ioctl_cmd)
 {
 	struct stat statfs;
-	unsigned long esdm_rpcs_linux_ioctl = RNDADDENTROPY;
-	int esdm_rpcs_linux_fd = -1;
-	int errsv = 0;
+	int fd, errsv;
 
 	/* TODO: The name "esdm" must be synchronized with cuse_random.c */
 
@@ -49,44 +72,35 @@ static int esdm_rpcs_linux_insert_entropy(struct rand_pool_info *rpi)
 	 * data to the kernel. Otherwise we use /dev/random directly.
 	 */
 	if (stat("/dev/esdm", &statfs) < 0) {
-		if (errno == ENOENT) {
-			/*
-			 * If /dev/esdm does not exist, we assume we can open
-			 * /dev/random directly.
-			 */
-			if (stat("/dev/random", &statfs) < 0) {
-				errsv = errno;
-
-				esdm_logger(
-					LOGGER_ERR, LOGGER_C_SERVER,
-					"Error in accessing /dev/random: %s\n",
-					strerror(errsv));
-				return -errsv;
-			}
+		if (errno != ENOENT) {
+			errsv = errno;
 
-			esdm_rpcs_linux_fd = open("/dev/random", O_RDONLY);
-			if (esdm_rpcs_linux_fd < 0) {
-				errsv = errno;
+			esdm_logger(LOGGER_ERR, LOGGER_C_SERVER,
+				    "Error in accessing /dev/esdm: %s\n",
+				    strerror(errsv));
+			return -errsv;
+		}
 
-				esdm_logger(
-					LOGGER_ERR, LOGGER_C_SERVER,
-					"Error in opening /dev/random: %s\n",
-					strerror(errsv));
-				return -errsv;
-			}
-			esdm_logger(LOGGER_DEBUG, LOGGER_C_SERVER,
-				    "/dev/random opened to insert entropy\n");
-		} else if (errno) {
+		/*
+		 * If /dev/esdm does not exist, we assume we can open
+		 * /dev/random directly.
+		 */
+		fd = open("/dev/random", O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
 			errsv = errno;
 
 			esdm_logger(LOGGER_ERR, LOGGER_C_SERVER,
-				    "Error in accessing /dev/esdm: %s\n",
+				    "Error in opening /dev/random: %s\n",
 				    strerror(errsv));
 			return -errsv;
 		}
+		esdm_logger(LOGGER_DEBUG, LOGGER_C_SERVER,
+			    "/dev/random opened to insert entropy\n");
+
+		*ioctl_cmd = RNDADDENTROPY;
 	} else {
-		esdm_rpcs_linux_fd = open("/dev/esdm", O_RDONLY);
-		if (esdm_rpcs_linux_fd < 0) {
+		fd = open("/dev/esdm", O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
 			errsv = errno;
 
 			esdm_logger(LOGGER_ERR, LOGGER_C_SERVER,
@@ -98,11 +112,18 @@ static int esdm_rpcs_linux_insert_entropy(struct rand_pool_info *rpi)
 			    "/dev/esdm opened to insert entropy\n");
 
 		/* Use the special IOCTL from the CUSE server */
-		esdm_rpcs_linux_ioctl = 43;
+		*ioctl_cmd = 43;
 	}
 
-	errsv = ioctl(esdm_rpcs_linux_fd, esdm_rpcs_linux_ioctl, rpi);
-	if (errsv != 0) {
+	return fd;
+}
+
+static int esdm_rpcs_linux_insert_entropy(int fd, unsigned long ioctl_cmd,
+					  struct rand_pool_info *rpi)
+{
+	int errsv = 0;
+
+	if (ioctl(fd, ioctl_cmd, rpi) != 0) {
 		errsv = errno;
 		esdm_logger(LOGGER_ERR, LOGGER_C_SERVER,
 			    "Error in adding entropy: %s\n", strerror(errsv));
@@ -110,82 +131,255 @@ static int esdm_rpcs_linux_insert_entropy(struct rand_pool_info *rpi)
 		esdm_logger(LOGGER_DEBUG, LOGGER_C_SERVER,
 			    "Entropy data with rate %u bits added\n",
 			    rpi->entropy_count);
+		if (esdm_rpcs_linux_stat) {
+			atomic_inc_64(&esdm_rpcs_linux_stat->injections);
+			atomic_add_64(&esdm_rpcs_linux_stat->bytes,
+				      rpi->buf_size);
+		}
 	}
 
-	close(esdm_rpcs_linux_fd);
-
 	return -errsv;
 }
 
+/* Size of the kernel input pool in bits */
+static unsigned int esdm_rpcs_linux_poolsize(void)
+{
+	unsigned int poolsize = 0;
+	FILE *f = fopen("/proc/sys/kernel/random/poolsize", "r");
+
+	if (f) {
+		if (fscanf(f, "%u", &poolsize) != 1)
+			poolsize = 0;
+		fclose(f);
+	}
+
+	/* Size of the input pool since Linux 5.18 */
+	return poolsize ? poolsize : 256;
+}
+
+/* Number of bits of entropy the kernel input pool is missing */
+static unsigned int esdm_rpcs_linux_missing(int fd, unsigned int poolsize)
+{
+	int ent_count;
+
+	if (ioctl(fd, RNDGETENTCNT, &ent_count) != 0 || ent_count < 0)
+		return 0;
+
+	return ((unsigned int)ent_count < poolsize) ?
+		       poolsize - (unsigned int)ent_count :
+		       0;
+}
+
 /*
- * Thread to insert entropy into the kernel RNG occasionally. When the IRQ ES
- * is present, this is required as the kernel RNG is deprived of its main ES.
- * But also in any other case it is good to insert data into the kernel RNG
- * to provide data that is gathered from other entropy sources. Basically
- * the ESDM acts as an RNGd to top up the entropy in the kernel.
+ * Thread to insert entropy into the kernel RNG. When the IRQ ES is present,
+ * this is required as the kernel RNG is deprived of its main ES. But also in
+ * any other case it is good to insert data into the kernel RNG to provide
+ * data that is gathered from other entropy sources. Basically the ESDM acts
+ * as an RNGd to top up the entropy in the kernel.
+ *
+ * When the data is credited with entropy and injected into /dev/random
+ * directly, the feeder is driven by the demand of the kernel: it waits until
+ * the kernel signals that its entropy fell below the write wakeup threshold
+ * and injects the amount of entropy the input pool is missing. Otherwise, or
+ * if the kernel signals writability independent of its entropy level, the
+ * feeder falls back to wake up every ESDM_LINUX_RESEED_INTERVAL_SEC.
  */
 static int esdm_rpcs_linux_feed_kernel(void __unused *unused)
 {
-#define ESDM_SERVER_LINUX_ENTROPY_BYTES 32
+/*
+ * One injection is credited with at most the security strength of the DRNG
+ * generating it, a larger demand is covered by multiple injections.
+ */
+#define ESDM_SERVER_LINUX_ENTROPY_BYTES ESDM_DRNG_SECURITY_STRENGTH_BYTES
+#define ESDM_SERVER_LINUX_ENTROPY_MAX_BYTES 512
 
-	uint8_t rpi_buf
-		[sizeof(struct rand_pool_info) +
-		 ESDM_SERVER_LINUX_ENTROPY_BYTES] __aligned(sizeof(uint32_t));
+	uint8_t rpi_buf[sizeof(struct rand_pool_info) +
+			ESDM_SERVER_LINUX_ENTROPY_BYTES]
+		__aligned(sizeof(uint32_t));
 	struct rand_pool_info *rpi = (struct rand_pool_info *)rpi_buf;
 	struct esdm_status_st status;
 
 	/* Wake up every 2 minutes by default */
 	struct timespec ts = { .tv_sec = ESDM_LINUX_RESEED_INTERVAL_SEC,
 			       .tv_nsec = 0 };
+	unsigned long ioctl_cmd = RNDADDENTROPY;
+	unsigned int poolsize = esdm_rpcs_linux_poolsize();
+	bool poll_usable = true, polled = false;
 	ssize_t ret;
+	int fd = -1;
 
 	thread_set_name(es_kernel_feeder, 0);
 
-	rpi->buf_size = ESDM_SERVER_LINUX_ENTROPY_BYTES;
-
 	for (;;) {
+		bool credit, demand;
+		unsigned int missing = 0;
+		uint32_t bytes;
+
+		/*
+		 * Retry to open the device in case the CUSE server is not yet
+		 * up or the device became unusable, e.g. as the CUSE server
+		 * was restarted.
+		 */
+		if (fd < 0) {
+			fd = esdm_rpcs_linux_open_sink(&ioctl_cmd);
+			if (fd < 0) {
+				nanosleep(&ts, NULL);
+				continue;
+			}
+		}
+
 		esdm_status_machine(&status);
 
-		ret = esdm_get_random_bytes_full((uint8_t *)rpi->buf,
-						 (size_t)rpi->buf_size);
-		if (ret < 0) {
-			esdm_logger(LOGGER_ERR, LOGGER_C_SERVER,
-				    "Failure in generating random bits: %zd\n",
-				    ret);
-		} else {
+		/*
+		 * When the IRQ entropy source is enabled, the kernel RNG is
+		 * deprived of its main entropy source. Also, the ESDM does
+		 * not credit its data with any entropy. In this case we can
+		 * inject data that we claim it has entropy. Conversely, if
+		 * the IRQ ES is not enabled* it has its main entropy source
+		 * and is credited with entropy by the ESDM. This implies we
+		 * cannot inject data that we claim has entropy unless other
+		 * entropy sources are accessible in ESDM (e.g. a smartcard
+		 * feeding the auxiliary pool).
+		 *
+		 * You can change ESDM_LINUX_RESEED_ENTROPY_COUNT in these
+		 * cases.
+		 */
+		credit = (status.es_irq_enabled &&
+			  ESDM_LINUX_RESEED_ENTROPY_COUNT == 0);
+
+		/*
+		 * The demand of the kernel can only be observed on its own
+		 * device and is only satisfied by data credited with entropy.
+		 * The CUSE device reports the ESDM entropy level instead.
+		 */
+		demand = (credit && ioctl_cmd == RNDADDENTROPY);
+
+		if (demand) {
+			missing = esdm_rpcs_linux_missing(fd, poolsize);
+
 			/*
-			 * When the IRQ entropy source is enabled, the
-			 * kernel RNG is deprived of its main entropy source.
-			 * Also, the ESDM does not credit its data with any
-			 * entropy. In this case we can inject data that we
-			 * claim it has entropy. Conversely, if the IRQ ES is
-			 * not enabled* it has its main entropy source and is
-			 * credited with entropy by the ESDM. This implies
-			 * we cannot inject data that we claim has entropy
-			 * unless other entropy sources are accessible in
-			 * ESDM (e.g. a smartcard feeding the auxiliary pool).
-			 *
-			 * You can change ESDM_LINUX_RESEED_ENTROPY_COUNT
-			 * in these cases.
+			 * Since Linux 5.18 /dev/random is always writable -
+			 * the wakeup does not indicate a demand.
 			 */
-			if (status.es_irq_enabled &&
-			    ESDM_LINUX_RESEED_ENTROPY_COUNT == 0)
-				rpi->entropy_count = (int)((ret) << 3);
-			else
-				rpi->entropy_count =
-					ESDM_LINUX_RESEED_ENTROPY_COUNT;
-			esdm_rpcs_linux_insert_entropy(rpi);
+			if (polled && !missing && poll_usable) {
+				poll_usable = false;
+				esdm_logger(
+					LOGGER_DEBUG, LOGGER_C_SERVER,
+					"Kernel does not signal entropy demand, using timer\n");
+			}
+
+			bytes = min_uint32((missing + 7) >> 3,
+					   ESDM_SERVER_LINUX_ENTROPY_MAX_BYTES);
+		} else {
+			bytes = ESDM_SERVER_LINUX_ENTROPY_BYTES;
 		}
 
-		memset_secure(rpi->buf, 0, (size_t)rpi->buf_size);
-		rpi->entropy_count = 0;
+		if (esdm_rpcs_linux_stat) {
+			atomic_set(&esdm_rpcs_linux_stat->demand_driven,
+				   demand && poll_usable);
+		}
+
+		ret = 0;
+		if (!bytes) {
+			/* Kernel is fully seeded, nothing to do */
+			if (esdm_rpcs_linux_stat)
+				atomic_inc_64(&esdm_rpcs_linux_stat->skipped);
+		}
 
-		nanosleep(&ts, NULL);
+		while (bytes && !ret) {
+			rpi->buf_size = (int)min_uint32(
+				bytes, ESDM_SERVER_LINUX_ENTROPY_BYTES);
+			bytes -= (uint32_t)rpi->buf_size;
+
+			ret = esdm_get_random_bytes_full((uint8_t *)rpi->buf,
+							 (size_t)rpi->buf_size);
+			if (ret < 0) {
+				esdm_logger(
+					LOGGER_ERR, LOGGER_C_SERVER,
+					"Failure in generating random bits: %zd\n",
+					ret);
+			} else {
+				if (credit)
+					rpi->entropy_count = (int)(ret << 3);
+				else
+					rpi->entropy_count =
+						ESDM_LINUX_RESEED_ENTROPY_COUNT;
+				ret = esdm_rpcs_linux_insert_entropy(fd,
+								     ioctl_cmd,
+								     rpi);
+				if (ret) {
+					/* Reopen the device for the next try */
+					close(fd);
+					fd = -1;
+				}
+			}
+
+			memset_secure(rpi->buf, 0, (size_t)rpi->buf_size);
+			rpi->entropy_count = 0;
+		}
+
+		/*
+		 * Wait for the kernel to fall below its write wakeup
+		 * threshold. After an error, the timer prevents a busy loop.
+		 */
+		polled = false;
+		if (demand && poll_usable && !ret) {
+			struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+			int timeout = ESDM_LINUX_RESEED_INTERVAL_SEC * 1000;
+
+			polled = (poll(&pfd, 1, timeout) > 0);
+		} else {
+			nanosleep(&ts, NULL);
+		}
 	}
 
+	close(fd);
+
 	return 0;
 }
 
+int esdm_rpcs_linux_init_feeder_stat(void)
+{
+	esdm_rpcs_linux_stat = mmap(NULL, sizeof(*esdm_rpcs_linux_stat),
+				    PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (esdm_rpcs_linux_stat == MAP_FAILED) {
+		int errsv = errno;
+
+		esdm_rpcs_linux_stat = NULL;
+		esdm_logger(LOGGER_WARN, LOGGER_C_SERVER,
+			    "Cannot allocate kernel feeder statistics: %s\n",
+			    strerror(errsv));
+		return -errsv;
+	}
+
+	memset(esdm_rpcs_linux_stat, 0, sizeof(*esdm_rpcs_linux_stat));
+
+	return 0;
+}
+
+void esdm_rpcs_linux_feeder_status(char *buf, size_t buflen)
+{
+	if (!esdm_rpcs_linux_stat || !buflen)
+		return;
+
+	snprintf(buf, buflen,
+		 "Linux kernel RNG feeder:\n"
+		 " Mode: %s\n"
+		 " Injections: %llu\n"
+		 " Injected bytes: %llu\n"
+		 " Wakeups without demand: %llu\n",
+		 atomic_read(&esdm_rpcs_linux_stat->demand_driven) ?
+			 "demand driven" :
+			 "timer",
+		 (unsigned long long)atomic_read_64(
+			 &esdm_rpcs_linux_stat->injections),
+		 (unsigned long long)atomic_read_64(
+			 &esdm_rpcs_linux_stat->bytes),
+		 (unsigned long long)atomic_read_64(
+			 &esdm_rpcs_linux_stat->skipped));
+}
+
 int esdm_rpcs_linux_init_feeder(void)
 {
 	/*
@@ -26,13 +26,29 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+
 #ifdef ESDM_ES_IRQ
+/* Allocate the feeder statistics - must be invoked before forking */
+int esdm_rpcs_linux_init_feeder_stat(void);
 int esdm_rpcs_linux_init_feeder(void);
+void esdm_rpcs_linux_feeder_status(char *buf, size_t buflen);
 #else
+static inline int esdm_rpcs_linux_init_feeder_stat(void)
+{
+	return 0;
+}
+
 static inline int esdm_rpcs_linux_init_feeder(void)
 {
 	return 0;
 }
+
+static inline void esdm_rpcs_linux_feeder_status(char *buf, size_t buflen)
+{
+	(void)buf;
+	(void)buflen;
+}
 #endif
 
 #ifdef __cplusplus
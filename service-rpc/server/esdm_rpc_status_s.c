@@ -20,6 +20,8 @@
 #include <string.h>
 
 #include "esdm.h"
+#include "esdm_rpc_limit.h"
+#include "esdm_rpc_server_linux.h"
 #include "esdm_rpc_service.h"
 #include "math_helper.h"
 #include "unpriv_access.pb-c.h"
@@ -36,8 +38,16 @@ void esdm_rpc_status(UnprivAccess_Service *service,
 		response.ret = -(int32_t)sizeof(status);
 		closure(&response, closure_data);
 	} else {
-		esdm_status(status,
-			    min_uint32(request->maxlen, ESDM_RPC_MAX_MSG_SIZE));
+		size_t maxlen =
+			min_uint32(request->maxlen, ESDM_RPC_MAX_MSG_SIZE);
+		size_t len;
+
+		status[0] = '\0';
+		esdm_status(status, maxlen);
+		len = strlen(status);
+		esdm_rpcs_linux_feeder_status(status + len, maxlen - len);
+		len = strlen(status);
+		esdm_rpcs_limit_status(status + len, maxlen - len);
 		response.ret = 0;
 		response.buffer = status;
 		closure(&response, closure_data);
@@ -1666,7 +1666,7 @@ const ProtobufCMessageDescriptor get_random_bytes_full_response__descriptor = {
 	NULL /* reserved[123] */
 };
 static const ProtobufCFieldDescriptor
-	get_random_bytes_full_timeout_request__field_descriptors[3] = {
+	get_random_bytes_full_timeout_request__field_descriptors[4] = {
 		{
 			"len", 1, PROTOBUF_C_LABEL_NONE, PROTOBUF_C_TYPE_UINT64,
 			0, /* quantifier_offset */
@@ -1688,9 +1688,17 @@ static const ProtobufCFieldDescriptor
 			NULL, NULL, 0, /* flags */
 			0, NULL, NULL /* reserved1,reserved2, etc */
 		},
+		{
+			"deadline", 4, PROTOBUF_C_LABEL_NONE,
+			PROTOBUF_C_TYPE_BOOL, 0, /* quantifier_offset */
+			offsetof(GetRandomBytesFullTimeoutRequest, deadline),
+			NULL, NULL, 0, /* flags */
+			0, NULL, NULL /* reserved1,reserved2, etc */
+		},
 	};
 static const unsigned
 	get_random_bytes_full_timeout_request__field_indices_by_name[] = {
+		3, /* field[3] = deadline */
 		0, /* field[0] = len */
 		2, /* field[2] = tv_nsec */
 		1, /* field[1] = tv_sec */
@@ -1698,7 +1706,7 @@ static const unsigned
 static const ProtobufCIntRange
 	get_random_bytes_full_timeout_request__number_ranges[1 + 1] = {
 		{ 1, 0 },
-		{ 0, 3 }
+		{ 0, 4 }
 	};
 const ProtobufCMessageDescriptor
 	get_random_bytes_full_timeout_request__descriptor = {
@@ -1708,7 +1716,7 @@ const ProtobufCMessageDescriptor
 		"GetRandomBytesFullTimeoutRequest",
 		"",
 		sizeof(GetRandomBytesFullTimeoutRequest),
-		3,
+		4,
 		get_random_bytes_full_timeout_request__field_descriptors,
 		get_random_bytes_full_timeout_request__field_indices_by_name,
 		1,
@@ -1720,7 +1728,7 @@ const ProtobufCMessageDescriptor
 		NULL /* reserved[123] */
 	};
 static const ProtobufCFieldDescriptor
-	get_random_bytes_full_timeout_response__field_descriptors[2] = {
+	get_random_bytes_full_timeout_response__field_descriptors[3] = {
 		{
 			"ret", 1, PROTOBUF_C_LABEL_NONE, PROTOBUF_C_TYPE_INT64,
 			0, /* quantifier_offset */
@@ -1735,16 +1743,25 @@ static const ProtobufCFieldDescriptor
 			NULL, NULL, 0, /* flags */
 			0, NULL, NULL /* reserved1,reserved2, etc */
 		},
+		{
+			"deadline_met", 3, PROTOBUF_C_LABEL_NONE,
+			PROTOBUF_C_TYPE_BOOL, 0, /* quantifier_offset */
+			offsetof(GetRandomBytesFullTimeoutResponse,
+				 deadline_met),
+			NULL, NULL, 0, /* flags */
+			0, NULL, NULL /* reserved1,reserved2, etc */
+		},
 	};
 static const unsigned
 	get_random_bytes_full_timeout_response__field_indices_by_name[] = {
+		2, /* field[2] = deadline_met */
 		1, /* field[1] = randval */
 		0, /* field[0] = ret */
 	};
 static const ProtobufCIntRange
 	get_random_bytes_full_timeout_response__number_ranges[1 + 1] = {
 		{ 1, 0 },
-		{ 0, 2 }
+		{ 0, 3 }
 	};
 const ProtobufCMessageDescriptor
 	get_random_bytes_full_timeout_response__descriptor = {
@@ -1754,7 +1771,7 @@ const ProtobufCMessageDescriptor
 		"GetRandomBytesFullTimeoutResponse",
 		"",
 		sizeof(GetRandomBytesFullTimeoutResponse),
-		2,
+		3,
 		get_random_bytes_full_timeout_response__field_descriptors,
 		get_random_bytes_full_timeout_response__field_indices_by_name,
 		1,
@@ -194,17 +194,22 @@ struct GetRandomBytesFullResponse {
  **
  * @brief Request to get random bytes from fully seeded DRNG
  * @param len number of random bytes that are requested
+ * @param tv_sec seconds of the time budget
+ * @param tv_nsec nanoseconds of the time budget
+ * @param deadline the time budget covers the entire request including the
+ *		  generation of the random bytes
  */
 struct GetRandomBytesFullTimeoutRequest {
 	ProtobufCMessage base;
 	uint64_t len;
 	uint64_t tv_sec;
 	uint32_t tv_nsec;
+	protobuf_c_boolean deadline;
 };
 #define GET_RANDOM_BYTES_FULL_TIMEOUT_REQUEST__INIT                            \
 	{ PROTOBUF_C_MESSAGE_INIT(                                             \
 		  &get_random_bytes_full_timeout_request__descriptor),         \
-	  0, 0, 0 }
+	  0, 0, 0, 0 }
 
 /*
  **
@@ -214,11 +219,13 @@ struct GetRandomBytesFullTimeoutRequest {
  *	      < -255 indicating the maximum number of bytes that can be
  *	      transferred in one request, < 0 on error)
  * @param randval Random bytes
+ * @param deadline_met Random bytes were generated within the time budget
  */
 struct GetRandomBytesFullTimeoutResponse {
 	ProtobufCMessage base;
 	int64_t ret;
 	ProtobufCBinaryData randval;
+	protobuf_c_boolean deadline_met;
 };
 #define GET_RANDOM_BYTES_FULL_TIMEOUT_RESPONSE__INIT                           \
 	{                                                                      \
@@ -227,7 +234,8 @@ struct GetRandomBytesFullTimeoutResponse {
 		, 0,                                                           \
 		{                                                              \
 			0, NULL                                                \
-		}                                                              \
+		},                                                             \
+		0                                                              \
 	}
 
 /*
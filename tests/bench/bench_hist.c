@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <string.h>
+
+#include "bench_hist.h"
+
+#define BENCH_HIST_EXACT (1ULL << (BENCH_HIST_SUB_BITS + 1))
+
+static unsigned int bench_hist_index(uint64_t value)
+{
+	unsigned int msb, exp;
+
+	if (value < BENCH_HIST_EXACT)
+		return (unsigned int)value;
+
+	if (value >= (1ULL << BENCH_HIST_MAX_EXP))
+		value = (1ULL << BENCH_HIST_MAX_EXP) - 1;
+
+	msb = 63 - (unsigned int)__builtin_clzll(value);
+	exp = msb - BENCH_HIST_SUB_BITS;
+
+	return (exp << BENCH_HIST_SUB_BITS) + (unsigned int)(value >> exp);
+}
+
+/* Highest value recorded in the given bucket */
+static uint64_t bench_hist_value(unsigned int idx)
+{
+	unsigned int exp;
+
+	if (idx < BENCH_HIST_EXACT)
+		return idx;
+
+	exp = (idx >> BENCH_HIST_SUB_BITS) - 1;
+
+	return ((uint64_t)(idx - (exp << BENCH_HIST_SUB_BITS)) << exp) +
+	       (1ULL << exp) - 1;
+}
+
+void bench_hist_init(struct bench_hist *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min = UINT64_MAX;
+}
+
+void bench_hist_record(struct bench_hist *hist, uint64_t value)
+{
+	hist->counts[bench_hist_index(value)]++;
+	hist->total++;
+	hist->sum += value;
+	if (value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+void bench_hist_merge(struct bench_hist *dst, const struct bench_hist *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+
+	dst->total += src->total;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+uint64_t bench_hist_percentile(const struct bench_hist *hist,
+			       double percentile)
+{
+	uint64_t target, seen = 0;
+	unsigned int i;
+
+	if (!hist->total)
+		return 0;
+
+	if (percentile >= 100.0)
+		return hist->max;
+
+	target = (uint64_t)((percentile / 100.0) * (double)hist->total + 0.5);
+	if (!target)
+		target = 1;
+
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++) {
+		seen += hist->counts[i];
+		if (seen >= target) {
+			uint64_t value = bench_hist_value(i);
+
+			return (value > hist->max) ? hist->max : value;
+		}
+	}
+
+	return hist->max;
+}
+
+double bench_hist_mean(const struct bench_hist *hist)
+{
+	if (!hist->total)
+		return 0;
+
+	return (double)(hist->sum / hist->total);
+}
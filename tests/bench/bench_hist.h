@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef BENCH_HIST_H
+#define BENCH_HIST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Log-linear latency histogram: values below 2^(BENCH_HIST_SUB_BITS + 1) are
+ * recorded exactly, larger values in buckets of a relative width of
+ * 2^-BENCH_HIST_SUB_BITS. Values are given in nanoseconds, values above
+ * 2^BENCH_HIST_MAX_EXP are recorded in the last bucket.
+ */
+#define BENCH_HIST_SUB_BITS 7
+#define BENCH_HIST_MAX_EXP 40
+#define BENCH_HIST_BUCKETS                                                     \
+	((BENCH_HIST_MAX_EXP - BENCH_HIST_SUB_BITS + 1) << BENCH_HIST_SUB_BITS)
+
+struct bench_hist {
+	uint64_t counts[BENCH_HIST_BUCKETS];
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	long double sum;
+};
+
+void bench_hist_init(struct bench_hist *hist);
+void bench_hist_record(struct bench_hist *hist, uint64_t value);
+void bench_hist_merge(struct bench_hist *dst, const struct bench_hist *src);
+
+/**
+ * @brief Value at the given percentile
+ *
+ * @param [in] hist Histogram
+ * @param [in] percentile Percentile between 0.0 and 100.0
+ *
+ * @return value in the unit it was recorded with, 0 for an empty histogram
+ */
+uint64_t bench_hist_percentile(const struct bench_hist *hist,
+			       double percentile);
+double bench_hist_mean(const struct bench_hist *hist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_HIST_H */
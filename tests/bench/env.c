@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "env.h"
+#include "ret_checkers.h"
+
+static pid_t server_pid = 0;
+static pid_t random_pid = 0;
+
+static void env_kill(pid_t *pid, const char *name)
+{
+	if (*pid > 0) {
+		fprintf(stderr, "Killing %s PID %u\n", name, *pid);
+		kill(*pid, SIGTERM);
+		waitpid(*pid, NULL, 0);
+	}
+	*pid = 0;
+}
+
+void env_fini(void)
+{
+	env_kill(&random_pid, "random");
+	env_kill(&server_pid, "server");
+}
+
+static int env_check_file(const char *path)
+{
+	struct stat sb;
+
+	if (!path) {
+		fprintf(stderr, "No file provided\n");
+		return -ENOENT;
+	}
+
+	if (stat(path, &sb) == -1) {
+		fprintf(stderr, "File %s not found\n", path);
+		return -errno;
+	}
+
+	if (!S_ISREG(sb.st_mode)) {
+		fprintf(stderr, "File %s not regular file\n", path);
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+static int env_start(const char *path, char *argv[], pid_t *ret_pid)
+{
+	struct timespec ts = { .tv_sec = 1, .tv_nsec = 0 };
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		return -errno;
+	if (pid == 0) {
+		execve(path, argv, NULL);
+
+		/* NOTREACHED */
+		exit(EFAULT);
+	}
+	*ret_pid = pid;
+	nanosleep(&ts, NULL);
+
+	return 0;
+}
+
+int env_init(bool cuse)
+{
+	const char *server = getenv("ESDM_SERVER");
+	const char *random = getenv("ESDM_CUSE_RANDOM");
+	const char *affinity = getenv("ESDM_SERVER_AFFINITY_RPC");
+	char server_buf[FILENAME_MAX], random_buf[FILENAME_MAX];
+	char affinity_buf[32];
+	char *server_argv[] = { server_buf, NULL, NULL, NULL };
+	char *random_argv[] = { random_buf, "-f", "-d", NULL };
+	int ret;
+
+	/* Benchmark the services running on the system */
+	if (!server)
+		return 0;
+
+	if (getuid()) {
+		fprintf(stderr, "Program must be started as root\n");
+		return 77;
+	}
+
+	CKINT(env_check_file(server));
+	snprintf(server_buf, sizeof(server_buf), "%s", server);
+
+	/* Pin the RPC workers, "all" covers all online CPUs */
+	if (affinity && *affinity) {
+		if (!strcmp(affinity, "all")) {
+			snprintf(affinity_buf, sizeof(affinity_buf), "0-%ld",
+				 sysconf(_SC_NPROCESSORS_ONLN) - 1);
+		} else {
+			snprintf(affinity_buf, sizeof(affinity_buf), "%s",
+				 affinity);
+		}
+		server_argv[1] = "--affinity_rpc";
+		server_argv[2] = affinity_buf;
+	}
+
+	CKINT(env_start(server, server_argv, &server_pid));
+
+	if (cuse) {
+		CKINT(env_check_file(random));
+		snprintf(random_buf, sizeof(random_buf), "%s", random);
+		CKINT(env_start(random, random_argv, &random_pid));
+	}
+
+out:
+	if (ret)
+		env_fini();
+	return ret;
+}
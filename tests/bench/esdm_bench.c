@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench_hist.h"
+#include "env.h"
+#include "esdm_bench.h"
+
+/*
+ * Multi-threaded benchmark of one ESDM interface: for every combination of
+ * mode, thread count and request size, the threads request random bytes for
+ * the configured time. The throughput and the latency distribution of the
+ * individual requests are reported as JSON.
+ */
+
+#define ESDM_BENCH_MAX_PARAMS 16
+#define ESDM_BENCH_MAX_THREADS 256
+
+struct esdm_bench_opts {
+	unsigned int threads[ESDM_BENCH_MAX_PARAMS];
+	unsigned int nthreads;
+	size_t buflens[ESDM_BENCH_MAX_PARAMS];
+	unsigned int nbuflens;
+	unsigned int modes;
+	unsigned int exectime;
+	const char *output;
+};
+
+struct esdm_bench_thread {
+	pthread_t tid;
+	enum esdm_bench_mode mode;
+	size_t buflen;
+	struct bench_hist hist;
+	uint64_t bytes;
+	uint64_t errors;
+	int ret;
+};
+
+static const char *esdm_bench_mode_names[] = { "full", "pr", "min" };
+
+/* Start gate releasing all threads at once after their warm up */
+static pthread_mutex_t esdm_bench_gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t esdm_bench_gate_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int esdm_bench_ready = 0;
+static int esdm_bench_go = 0;
+
+static volatile int esdm_bench_stop = 0;
+
+static inline uint64_t esdm_bench_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void *esdm_bench_thread(void *arg)
+{
+	struct esdm_bench_thread *t = arg;
+	const struct esdm_bench_iface *iface = &esdm_bench_iface;
+	void *state = NULL;
+	uint8_t *buf = malloc(t->buflen);
+
+	if (!buf) {
+		t->ret = -ENOMEM;
+	} else if (iface->thread_init) {
+		t->ret = iface->thread_init(&state);
+	}
+
+	/* Warm up the interface, e.g. establish the connection */
+	if (!t->ret && iface->generate(state, buf, t->buflen, t->mode) < 0)
+		t->ret = -EFAULT;
+
+	pthread_mutex_lock(&esdm_bench_gate_lock);
+	esdm_bench_ready++;
+	pthread_cond_broadcast(&esdm_bench_gate_cond);
+	while (!esdm_bench_go)
+		pthread_cond_wait(&esdm_bench_gate_cond, &esdm_bench_gate_lock);
+	pthread_mutex_unlock(&esdm_bench_gate_lock);
+
+	while (!t->ret && !esdm_bench_stop) {
+		uint64_t start = esdm_bench_ns();
+		ssize_t rc = iface->generate(state, buf, t->buflen, t->mode);
+
+		bench_hist_record(&t->hist, esdm_bench_ns() - start);
+
+		if (rc < 0)
+			t->errors++;
+		else
+			t->bytes += (uint64_t)rc;
+	}
+
+	if (iface->thread_fini && state)
+		iface->thread_fini(state);
+	free(buf);
+
+	return NULL;
+}
+
+static int esdm_bench_run(const struct esdm_bench_opts *opts, FILE *out,
+			  enum esdm_bench_mode mode, unsigned int threads,
+			  size_t buflen, int *first)
+{
+	struct timespec exectime = { .tv_sec = opts->exectime, .tv_nsec = 0 };
+	struct esdm_bench_thread *t;
+	struct bench_hist *hist;
+	uint64_t start, duration, bytes = 0, errors = 0;
+	unsigned int i, started = 0;
+	int ret = 0;
+
+	t = calloc(threads, sizeof(*t));
+	hist = malloc(sizeof(*hist));
+	if (!t || !hist) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	bench_hist_init(hist);
+
+	esdm_bench_stop = 0;
+	esdm_bench_ready = 0;
+	esdm_bench_go = 0;
+
+	for (i = 0; i < threads; i++) {
+		t[i].mode = mode;
+		t[i].buflen = buflen;
+		bench_hist_init(&t[i].hist);
+
+		if (pthread_create(&t[i].tid, NULL, esdm_bench_thread, &t[i]))
+			break;
+		started++;
+	}
+
+	if (started < threads) {
+		esdm_bench_stop = 1;
+		ret = -EAGAIN;
+	}
+
+	pthread_mutex_lock(&esdm_bench_gate_lock);
+	while (esdm_bench_ready < started)
+		pthread_cond_wait(&esdm_bench_gate_cond, &esdm_bench_gate_lock);
+	esdm_bench_go = 1;
+	pthread_cond_broadcast(&esdm_bench_gate_cond);
+	pthread_mutex_unlock(&esdm_bench_gate_lock);
+
+	start = esdm_bench_ns();
+	if (!ret)
+		nanosleep(&exectime, NULL);
+	esdm_bench_stop = 1;
+
+	for (i = 0; i < started; i++)
+		pthread_join(t[i].tid, NULL);
+	duration = esdm_bench_ns() - start;
+
+	for (i = 0; i < started; i++) {
+		if (t[i].ret && !ret)
+			ret = t[i].ret;
+		bench_hist_merge(hist, &t[i].hist);
+		bytes += t[i].bytes;
+		errors += t[i].errors;
+	}
+	if (ret)
+		goto out;
+
+	fprintf(stderr,
+		"%-8s %-4s %3u threads %6zu bytes: %12.0f ops/s, p50 %8lu ns, p99 %8lu ns, p999 %8lu ns\n",
+		esdm_bench_iface.name, esdm_bench_mode_names[mode], threads,
+		buflen, (double)hist->total * 1e9 / (double)duration,
+		(unsigned long)bench_hist_percentile(hist, 50.0),
+		(unsigned long)bench_hist_percentile(hist, 99.0),
+		(unsigned long)bench_hist_percentile(hist, 99.9));
+
+	fprintf(out,
+		"%s\n    {\n"
+		"      \"mode\": \"%s\",\n"
+		"      \"threads\": %u,\n"
+		"      \"request_size\": %zu,\n"
+		"      \"operations\": %lu,\n"
+		"      \"errors\": %lu,\n"
+		"      \"bytes\": %lu,\n"
+		"      \"duration_ns\": %lu,\n"
+		"      \"ops_per_sec\": %.1f,\n"
+		"      \"bytes_per_sec\": %.1f,\n"
+		"      \"latency_ns\": {\n"
+		"        \"min\": %lu,\n"
+		"        \"mean\": %.1f,\n"
+		"        \"p50\": %lu,\n"
+		"        \"p99\": %lu,\n"
+		"        \"p999\": %lu,\n"
+		"        \"max\": %lu\n"
+		"      }\n"
+		"    }",
+		*first ? "" : ",", esdm_bench_mode_names[mode], threads, buflen,
+		(unsigned long)hist->total, (unsigned long)errors,
+		(unsigned long)bytes, (unsigned long)duration,
+		(double)hist->total * 1e9 / (double)duration,
+		(double)bytes * 1e9 / (double)duration,
+		(unsigned long)(hist->total ? hist->min : 0),
+		bench_hist_mean(hist),
+		(unsigned long)bench_hist_percentile(hist, 50.0),
+		(unsigned long)bench_hist_percentile(hist, 99.0),
+		(unsigned long)bench_hist_percentile(hist, 99.9),
+		(unsigned long)hist->max);
+	*first = 0;
+
+out:
+	free(hist);
+	free(t);
+	return ret;
+}
+
+static int esdm_bench_parse_list(const char *arg, void *vals, bool sizes,
+				 unsigned int *num)
+{
+	char *tmp = strdup(arg), *tok, *saveptr = NULL;
+	int ret = 0;
+
+	if (!tmp)
+		return -ENOMEM;
+
+	*num = 0;
+	for (tok = strtok_r(tmp, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		unsigned long val = strtoul(tok, NULL, 10);
+
+		if (!val || *num >= ESDM_BENCH_MAX_PARAMS ||
+		    (!sizes && val > ESDM_BENCH_MAX_THREADS)) {
+			ret = -EINVAL;
+			break;
+		}
+
+		if (sizes)
+			((size_t *)vals)[*num] = val;
+		else
+			((unsigned int *)vals)[*num] = (unsigned int)val;
+		(*num)++;
+	}
+
+	free(tmp);
+	return ret;
+}
+
+static int esdm_bench_parse_modes(const char *arg, unsigned int *modes)
+{
+	char *tmp = strdup(arg), *tok, *saveptr = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	if (!tmp)
+		return -ENOMEM;
+
+	*modes = 0;
+	for (tok = strtok_r(tmp, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		for (i = 0; i < esdm_bench_modes; i++) {
+			if (!strcmp(tok, esdm_bench_mode_names[i])) {
+				*modes |= ESDM_BENCH_MODE(i);
+				break;
+			}
+		}
+		if (i == esdm_bench_modes) {
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	free(tmp);
+	return ret;
+}
+
+static void esdm_bench_usage(void)
+{
+	fprintf(stderr, "\nESDM benchmark of the %s interface\n\n",
+		esdm_bench_iface.name);
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr,
+		"\t-t --threads <LIST>\tComma-separated thread counts\n");
+	fprintf(stderr,
+		"\t-b --buflen <LIST>\tComma-separated request sizes in bytes\n");
+	fprintf(stderr,
+		"\t-m --mode <LIST>\tComma-separated modes: full, pr, min\n");
+	fprintf(stderr,
+		"\t-e --exectime <SECS>\tExecution time of one measurement\n");
+	fprintf(stderr,
+		"\t-o --output <FILE>\tWrite JSON report to file instead of stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct esdm_bench_opts opts = {
+		.threads = { 1, 2, 4, 8 },
+		.nthreads = 4,
+		.buflens = { 32, 4096, 65536 },
+		.nbuflens = 3,
+		.modes = esdm_bench_iface.modes,
+		.exectime = 1,
+		.output = NULL,
+	};
+	const struct esdm_bench_iface *iface = &esdm_bench_iface;
+	FILE *out = stdout;
+	unsigned int m, t, b;
+	int c, ret = 0, first = 1;
+
+	while (1) {
+		int opt_index = 0;
+		static const struct option options[] = {
+			{ "threads", required_argument, 0, 't' },
+			{ "buflen", required_argument, 0, 'b' },
+			{ "mode", required_argument, 0, 'm' },
+			{ "exectime", required_argument, 0, 'e' },
+			{ "output", required_argument, 0, 'o' },
+			{ "help", no_argument, 0, 'h' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "t:b:m:e:o:h", options,
+				&opt_index);
+		if (-1 == c)
+			break;
+		switch (c) {
+		case 't':
+			ret = esdm_bench_parse_list(optarg, opts.threads, false,
+						    &opts.nthreads);
+			break;
+		case 'b':
+			ret = esdm_bench_parse_list(optarg, opts.buflens, true,
+						    &opts.nbuflens);
+			break;
+		case 'm':
+			ret = esdm_bench_parse_modes(optarg, &opts.modes);
+			break;
+		case 'e':
+			opts.exectime = (unsigned int)strtoul(optarg, NULL, 10);
+			if (!opts.exectime)
+				ret = -EINVAL;
+			break;
+		case 'o':
+			opts.output = optarg;
+			break;
+		case 'h':
+		default:
+			esdm_bench_usage();
+			return 1;
+		}
+
+		if (ret) {
+			esdm_bench_usage();
+			return 1;
+		}
+	}
+
+	/* Skip the modes the interface does not offer */
+	opts.modes &= iface->modes;
+
+	if (opts.output) {
+		out = fopen(opts.output, "w");
+		if (!out) {
+			fprintf(stderr, "Cannot open %s: %s\n", opts.output,
+				strerror(errno));
+			return 1;
+		}
+	}
+
+	if (iface->init) {
+		ret = iface->init();
+		if (ret)
+			goto out;
+	}
+
+	fprintf(out,
+		"{\n  \"interface\": \"%s\",\n  \"exectime_s\": %u,\n  \"results\": [",
+		iface->name, opts.exectime);
+
+	for (m = 0; m < esdm_bench_modes; m++) {
+		if (!(opts.modes & ESDM_BENCH_MODE(m)))
+			continue;
+
+		for (t = 0; t < opts.nthreads; t++) {
+			for (b = 0; b < opts.nbuflens; b++) {
+				ret = esdm_bench_run(&opts, out, m,
+						     opts.threads[t],
+						     opts.buflens[b], &first);
+				if (ret) {
+					fprintf(stderr,
+						"Benchmark of mode %s failed: %d\n",
+						esdm_bench_mode_names[m], ret);
+					goto fini;
+				}
+			}
+		}
+	}
+
+fini:
+	fprintf(out, "\n  ]\n}\n");
+	if (iface->fini)
+		iface->fini();
+
+out:
+	if (out != stdout)
+		fclose(out);
+	if (ret < 0)
+		ret = 1;
+	return ret;
+}
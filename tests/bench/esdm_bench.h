@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef ESDM_BENCH_H
+#define ESDM_BENCH_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum esdm_bench_mode {
+	esdm_bench_full, /* Fully seeded DRNG */
+	esdm_bench_pr, /* Prediction resistance */
+	esdm_bench_min, /* Minimally seeded DRNG */
+	esdm_bench_modes,
+};
+
+#define ESDM_BENCH_MODE(x) (1U << (x))
+
+/*
+ * Interface under test - each benchmark executable links exactly one
+ * interface implementation which defines esdm_bench_iface.
+ */
+struct esdm_bench_iface {
+	const char *name;
+
+	/* Bit mask of supported modes */
+	unsigned int modes;
+
+	/* Set up and tear down the interface - optional */
+	int (*init)(void);
+	void (*fini)(void);
+
+	/* Per-thread state of the interface - optional */
+	int (*thread_init)(void **state);
+	void (*thread_fini)(void *state);
+
+	/* Obtain random bytes, return number of bytes or < 0 on error */
+	ssize_t (*generate)(void *state, uint8_t *buf, size_t buflen,
+			    enum esdm_bench_mode mode);
+};
+
+extern const struct esdm_bench_iface esdm_bench_iface;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ESDM_BENCH_H */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "env.h"
+#include "esdm_bench.h"
+
+/*
+ * Benchmark of the CUSE /dev/random device: a regular read is served with
+ * fully seeded data, a read from a file opened with O_SYNC with prediction
+ * resistance.
+ */
+
+struct esdm_bench_cuse_state {
+	int fd;
+	int fd_sync;
+};
+
+static void esdm_bench_cuse_dev_file(char *outfile, size_t outfilelen)
+{
+#ifdef ESDM_TESTMODE
+	snprintf(outfile, outfilelen, "/dev/tst-random");
+#else
+	snprintf(outfile, outfilelen, "/dev/random");
+#endif
+}
+
+static int esdm_bench_cuse_init(void)
+{
+	return env_init(true);
+}
+
+static void esdm_bench_cuse_fini(void)
+{
+	env_fini();
+}
+
+static void esdm_bench_cuse_thread_fini(void *state)
+{
+	struct esdm_bench_cuse_state *s = state;
+
+	if (s->fd >= 0)
+		close(s->fd);
+	if (s->fd_sync >= 0)
+		close(s->fd_sync);
+	free(s);
+}
+
+static int esdm_bench_cuse_thread_init(void **state)
+{
+	struct esdm_bench_cuse_state *s = malloc(sizeof(*s));
+	char dev[FILENAME_MAX];
+
+	if (!s)
+		return -ENOMEM;
+
+	esdm_bench_cuse_dev_file(dev, sizeof(dev));
+	s->fd = open(dev, O_RDONLY);
+	s->fd_sync = open(dev, O_RDONLY | O_SYNC);
+	if (s->fd < 0 || s->fd_sync < 0) {
+		int errsv = errno;
+
+		fprintf(stderr, "Cannot open %s\n", dev);
+		esdm_bench_cuse_thread_fini(s);
+		return -errsv;
+	}
+
+	*state = s;
+	return 0;
+}
+
+static ssize_t esdm_bench_cuse_generate(void *state, uint8_t *buf,
+					size_t buflen,
+					enum esdm_bench_mode mode)
+{
+	struct esdm_bench_cuse_state *s = state;
+	ssize_t ret;
+
+	switch (mode) {
+	case esdm_bench_full:
+		ret = read(s->fd, buf, buflen);
+		break;
+	case esdm_bench_pr:
+		ret = read(s->fd_sync, buf, buflen);
+		break;
+	case esdm_bench_min:
+	case esdm_bench_modes:
+	default:
+		return -EINVAL;
+	}
+
+	return (ret < 0) ? -errno : ret;
+}
+
+const struct esdm_bench_iface esdm_bench_iface = {
+	.name = "cuse",
+	.modes = ESDM_BENCH_MODE(esdm_bench_full) |
+		 ESDM_BENCH_MODE(esdm_bench_pr),
+	.init = esdm_bench_cuse_init,
+	.fini = esdm_bench_cuse_fini,
+	.thread_init = esdm_bench_cuse_thread_init,
+	.thread_fini = esdm_bench_cuse_thread_fini,
+	.generate = esdm_bench_cuse_generate,
+};
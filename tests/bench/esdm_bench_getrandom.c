@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <sys/random.h>
+
+#include "env.h"
+#include "esdm_bench.h"
+
+/*
+ * Benchmark of the getrandom system call - the ESDM getrandom library must be
+ * preloaded with LD_PRELOAD to measure the ESDM instead of the kernel.
+ */
+
+static int esdm_bench_getrandom_init(void)
+{
+	return env_init(false);
+}
+
+static void esdm_bench_getrandom_fini(void)
+{
+	env_fini();
+}
+
+static ssize_t esdm_bench_getrandom_generate(void *state, uint8_t *buf,
+					     size_t buflen,
+					     enum esdm_bench_mode mode)
+{
+	ssize_t ret;
+
+	(void)state;
+
+	switch (mode) {
+	case esdm_bench_full:
+		ret = getrandom(buf, buflen, 0);
+		break;
+	case esdm_bench_pr:
+		ret = getrandom(buf, buflen, GRND_RANDOM);
+		break;
+	case esdm_bench_min:
+	case esdm_bench_modes:
+	default:
+		return -EINVAL;
+	}
+
+	return (ret < 0) ? -errno : ret;
+}
+
+const struct esdm_bench_iface esdm_bench_iface = {
+	.name = "getrandom",
+	.modes = ESDM_BENCH_MODE(esdm_bench_full) |
+		 ESDM_BENCH_MODE(esdm_bench_pr),
+	.init = esdm_bench_getrandom_init,
+	.fini = esdm_bench_getrandom_fini,
+	.generate = esdm_bench_getrandom_generate,
+};
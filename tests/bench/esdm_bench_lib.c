@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "esdm.h"
+#include "esdm_bench.h"
+
+/* Benchmark of the ESDM library API used in-process */
+
+static int esdm_bench_lib_init(void)
+{
+#ifndef ESDM_TESTMODE
+	if (getuid()) {
+		fprintf(stderr, "Program must be started as root\n");
+		return 77;
+	}
+#endif
+
+	return esdm_init();
+}
+
+static void esdm_bench_lib_fini(void)
+{
+	esdm_fini();
+}
+
+static ssize_t esdm_bench_lib_generate(void *state, uint8_t *buf,
+				       size_t buflen, enum esdm_bench_mode mode)
+{
+	(void)state;
+
+	switch (mode) {
+	case esdm_bench_full:
+		return esdm_get_random_bytes_full(buf, buflen);
+	case esdm_bench_pr:
+		return esdm_get_random_bytes_pr(buf, buflen);
+	case esdm_bench_min:
+		return esdm_get_random_bytes_min(buf, buflen);
+	case esdm_bench_modes:
+	default:
+		return -EINVAL;
+	}
+}
+
+const struct esdm_bench_iface esdm_bench_iface = {
+	.name = "lib",
+	.modes = ESDM_BENCH_MODE(esdm_bench_full) |
+		 ESDM_BENCH_MODE(esdm_bench_pr) |
+		 ESDM_BENCH_MODE(esdm_bench_min),
+	.init = esdm_bench_lib_init,
+	.fini = esdm_bench_lib_fini,
+	.generate = esdm_bench_lib_generate,
+};
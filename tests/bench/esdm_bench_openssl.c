@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <openssl/evp.h>
+#include <openssl/provider.h>
+#include <stdio.h>
+
+#include "env.h"
+#include "esdm_bench.h"
+
+/*
+ * Benchmark of the ESDM OpenSSL RNG provider - the provider is searched in
+ * the path given with OPENSSL_MODULES. Every thread uses its own DRBG
+ * context as EVP_RAND_CTX is not locked.
+ */
+
+#define ESDM_BENCH_OPENSSL_STRENGTH 256
+
+static OSSL_PROVIDER *esdm_bench_openssl_prov = NULL;
+
+static int esdm_bench_openssl_init(void)
+{
+	int ret = env_init(false);
+
+	if (ret)
+		return ret;
+
+	esdm_bench_openssl_prov =
+		OSSL_PROVIDER_load(NULL, "libesdm-rng-provider");
+	if (!esdm_bench_openssl_prov) {
+		fprintf(stderr, "Cannot load ESDM RNG provider\n");
+		env_fini();
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+static void esdm_bench_openssl_fini(void)
+{
+	if (esdm_bench_openssl_prov)
+		OSSL_PROVIDER_unload(esdm_bench_openssl_prov);
+	esdm_bench_openssl_prov = NULL;
+	env_fini();
+}
+
+static int esdm_bench_openssl_thread_init(void **state)
+{
+	EVP_RAND *rand = EVP_RAND_fetch(NULL, "CTR-DRBG", "provider=esdm");
+	EVP_RAND_CTX *rctx;
+
+	if (!rand)
+		return -ENOENT;
+
+	rctx = EVP_RAND_CTX_new(rand, NULL);
+	EVP_RAND_free(rand);
+	if (!rctx)
+		return -ENOMEM;
+
+	if (EVP_RAND_instantiate(rctx, ESDM_BENCH_OPENSSL_STRENGTH, 0, NULL, 0,
+				 NULL) != 1) {
+		EVP_RAND_CTX_free(rctx);
+		return -EFAULT;
+	}
+
+	*state = rctx;
+	return 0;
+}
+
+static void esdm_bench_openssl_thread_fini(void *state)
+{
+	EVP_RAND_CTX_free(state);
+}
+
+static ssize_t esdm_bench_openssl_generate(void *state, uint8_t *buf,
+					   size_t buflen,
+					   enum esdm_bench_mode mode)
+{
+	if (mode != esdm_bench_full && mode != esdm_bench_pr)
+		return -EINVAL;
+
+	if (EVP_RAND_generate(state, buf, buflen, ESDM_BENCH_OPENSSL_STRENGTH,
+			      mode == esdm_bench_pr, NULL, 0) != 1)
+		return -EFAULT;
+
+	return (ssize_t)buflen;
+}
+
+const struct esdm_bench_iface esdm_bench_iface = {
+	.name = "openssl",
+	.modes = ESDM_BENCH_MODE(esdm_bench_full) |
+		 ESDM_BENCH_MODE(esdm_bench_pr),
+	.init = esdm_bench_openssl_init,
+	.fini = esdm_bench_openssl_fini,
+	.thread_init = esdm_bench_openssl_thread_init,
+	.thread_fini = esdm_bench_openssl_thread_fini,
+	.generate = esdm_bench_openssl_generate,
+};
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_hist.h"
+#include "bool.h"
+#include "config.h"
+#include "esdm.h"
+#include "esdm_config.h"
+
+/*
+ * Time-to-operational of the ESDM library with and without a seed file
+ *
+ * Every measurement initializes the ESDM in a fresh process and records the
+ * time from the start of esdm_init() until the ESDM reports to be
+ * operational. The runs with seed file consume the file left behind by the
+ * previous run.
+ */
+#define STARTUP_TIMEOUT_NS (120ULL * 1000000000ULL)
+#define STARTUP_POLL_NS 100000
+
+struct startup_opts {
+	unsigned int runs;
+	uint32_t entropy;
+	const char *seed_file;
+	const char *output;
+};
+
+static struct startup_opts opts = {
+	.runs = 10,
+	.entropy = 256,
+	.seed_file = "esdm_bench_startup.seed",
+	.output = NULL,
+};
+
+static inline uint64_t startup_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Child: initialize the ESDM and report the time until it is operational */
+static int startup_child(int wfd, bool seed_file)
+{
+	const struct timespec poll = { .tv_nsec = STARTUP_POLL_NS };
+	uint64_t start, elapsed = 0;
+	int ret;
+
+	if (seed_file) {
+		ret = esdm_config_seed_file_set(opts.seed_file);
+		if (ret)
+			return 1;
+		esdm_config_seed_file_entropy_set(opts.entropy);
+	}
+
+	start = startup_ns();
+	ret = esdm_init();
+	if (ret)
+		goto out;
+
+	while (!esdm_state_operational()) {
+		if (startup_ns() - start > STARTUP_TIMEOUT_NS)
+			break;
+		nanosleep(&poll, NULL);
+	}
+	if (esdm_state_operational())
+		elapsed = startup_ns() - start;
+
+	/* Writes the seed file for the next run */
+	esdm_fini();
+
+out:
+	if (write(wfd, &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+		return 1;
+	return ret ? 1 : 0;
+}
+
+static int startup_run(bool seed_file, uint64_t *elapsed)
+{
+	pid_t pid;
+	int pfd[2], status, ret = 0;
+
+	if (pipe(pfd) < 0)
+		return -errno;
+
+	pid = fork();
+	if (pid < 0) {
+		ret = -errno;
+		close(pfd[0]);
+		close(pfd[1]);
+		return ret;
+	}
+	if (pid == 0) {
+		close(pfd[0]);
+		_exit(startup_child(pfd[1], seed_file));
+	}
+
+	close(pfd[1]);
+	if (read(pfd[0], elapsed, sizeof(*elapsed)) != sizeof(*elapsed))
+		ret = -EIO;
+	close(pfd[0]);
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		ret = -EIO;
+	if (!ret && !*elapsed)
+		ret = -ETIMEDOUT;
+
+	return ret;
+}
+
+static void startup_report(FILE *out, const char *name,
+			   const struct bench_hist *hist, bool last)
+{
+	fprintf(out,
+		"    \"%s\": {\n"
+		"      \"runs\": %lu,\n"
+		"      \"mean_ns\": %.0f,\n"
+		"      \"min_ns\": %lu,\n"
+		"      \"p50_ns\": %lu,\n"
+		"      \"p90_ns\": %lu,\n"
+		"      \"max_ns\": %lu\n"
+		"    }%s\n",
+		name, (unsigned long)hist->total, bench_hist_mean(hist),
+		(unsigned long)hist->min,
+		(unsigned long)bench_hist_percentile(hist, 50.0),
+		(unsigned long)bench_hist_percentile(hist, 90.0),
+		(unsigned long)hist->max, last ? "" : ",");
+}
+
+static void startup_usage(void)
+{
+	fprintf(stderr, "\nESDM time-to-operational benchmark\n\n");
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr,
+		"\t-r --runs <NUM>\t\tMeasurements with and without seed file\n");
+	fprintf(stderr,
+		"\t-e --entropy <BITS>\tEntropy credited to the seed file\n");
+	fprintf(stderr,
+		"\t-s --seed-file <FILE>\tSeed file used for the measurement\n");
+	fprintf(stderr,
+		"\t-o --output <FILE>\tWrite JSON report to file instead of stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static struct bench_hist without, with;
+	FILE *out = stdout;
+	uint64_t elapsed;
+	unsigned int i;
+	int c, ret = 0;
+
+	while (1) {
+		int opt_index = 0;
+		static const struct option options[] = {
+			{ "runs", required_argument, 0, 'r' },
+			{ "entropy", required_argument, 0, 'e' },
+			{ "seed-file", required_argument, 0, 's' },
+			{ "output", required_argument, 0, 'o' },
+			{ "help", no_argument, 0, 'h' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "r:e:s:o:h", options, &opt_index);
+		if (-1 == c)
+			break;
+		switch (c) {
+		case 'r':
+			opts.runs = (unsigned int)strtoul(optarg, NULL, 10);
+			break;
+		case 'e':
+			opts.entropy = (uint32_t)strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			opts.seed_file = optarg;
+			break;
+		case 'o':
+			opts.output = optarg;
+			break;
+		case 'h':
+		default:
+			startup_usage();
+			return 1;
+		}
+	}
+
+	if (!opts.runs) {
+		startup_usage();
+		return 1;
+	}
+
+#ifndef ESDM_TESTMODE
+	if (getuid()) {
+		fprintf(stderr, "Program must be started as root\n");
+		return 77;
+	}
+#endif
+
+	bench_hist_init(&without);
+	bench_hist_init(&with);
+
+	/* Leave a seed file behind for the first measurement using it */
+	unlink(opts.seed_file);
+	ret = startup_run(true, &elapsed);
+	if (ret) {
+		fprintf(stderr, "Creation of seed file failed: %d\n", ret);
+		goto out;
+	}
+
+	/* Interleave the measurements to spread environmental noise */
+	for (i = 0; i < opts.runs; i++) {
+		ret = startup_run(false, &elapsed);
+		if (ret) {
+			fprintf(stderr,
+				"Measurement without seed file failed: %d\n",
+				ret);
+			goto out;
+		}
+		bench_hist_record(&without, elapsed);
+
+		ret = startup_run(true, &elapsed);
+		if (ret) {
+			fprintf(stderr,
+				"Measurement with seed file failed: %d\n", ret);
+			goto out;
+		}
+		bench_hist_record(&with, elapsed);
+	}
+
+	if (opts.output) {
+		out = fopen(opts.output, "w");
+		if (!out) {
+			ret = -errno;
+			fprintf(stderr, "Cannot open %s: %s\n", opts.output,
+				strerror(-ret));
+			out = stdout;
+			goto out;
+		}
+	}
+
+	fprintf(out,
+		"{\n"
+		"  \"seed_file_entropy_bits\": %u,\n"
+		"  \"time_to_operational\": {\n",
+		opts.entropy);
+	startup_report(out, "without_seed_file", &without, false);
+	startup_report(out, "with_seed_file", &with, true);
+	fprintf(out, "  }\n}\n");
+
+out:
+	if (out != stdout)
+		fclose(out);
+	unlink(opts.seed_file);
+	return ret ? 1 : 0;
+}
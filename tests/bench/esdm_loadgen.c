@@ -0,0 +1,900 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_hist.h"
+#include "conv_be_le.h"
+#include "env.h"
+#include "esdm_rpc_protocol.h"
+#include "esdm_rpc_service.h"
+
+/*
+ * Open-loop load generator for the unprivileged RPC interface of the ESDM
+ * server.
+ *
+ * Requests are issued at a fixed arrival rate independent of the response
+ * times of the server. Each connection pipelines its requests. The latency of
+ * a request is measured from the time it was scheduled to be sent, not from
+ * the time it was actually sent - when the server falls behind, the time the
+ * request waited for being submitted is accounted as well. This avoids the
+ * coordinated omission of closed-loop benchmarks which only measure the
+ * requests the server allowed them to send.
+ *
+ * With --find-saturation, the offered rate is doubled until the server
+ * cannot keep up - or halved until it does if the initial rate is not
+ * sustained - followed by a bisection to find the highest rate the server
+ * sustains within the latency objective.
+ */
+
+#define LOADGEN_MAX_THREADS 64
+#define LOADGEN_MAX_CONNECTIONS 1024
+#define LOADGEN_MAX_OUTSTANDING 4096
+#define LOADGEN_BISECT_STEPS 5
+#define LOADGEN_MAX_RATE 1000000000ULL
+#define LOADGEN_DRAIN_NS 2000000000ULL
+
+struct loadgen_method {
+	const char *name; /* Name used with --mix */
+	const char *rpc; /* Method name in the service descriptor */
+	unsigned int weight;
+	uint8_t req[64]; /* Packed request including header */
+	size_t reqlen;
+};
+
+static struct loadgen_method loadgen_methods[] = {
+	{ .name = "full", .rpc = "RpcGetRandomBytesFull", .weight = 1 },
+	{ .name = "pr", .rpc = "RpcGetRandomBytesPr" },
+	{ .name = "min", .rpc = "RpcGetRandomBytesMin" },
+	{ .name = "plain", .rpc = "RpcGetRandomBytes" },
+	{ .name = "status", .rpc = "RpcStatus" },
+	{ .name = "ent_lvl", .rpc = "RpcGetEntLvl" },
+	{ .name = "fully_seeded", .rpc = "RpcIsFullySeeded" },
+};
+
+#define LOADGEN_METHODS                                                        \
+	(sizeof(loadgen_methods) / sizeof(loadgen_methods[0]))
+
+struct loadgen_opts {
+	unsigned int threads;
+	unsigned int connections;
+	unsigned int duration;
+	uint64_t rate;
+	size_t buflen;
+	uint64_t slo_ns;
+	bool find_saturation;
+	const char *output;
+};
+
+/* Outstanding request in submission order */
+struct loadgen_req {
+	uint64_t intended;
+	uint64_t sent;
+};
+
+struct loadgen_conn {
+	int fd;
+	uint32_t next_id;
+
+	struct loadgen_req reqs[LOADGEN_MAX_OUTSTANDING];
+	unsigned int head, tail;
+
+	/* Response parsing state */
+	uint8_t hdr[sizeof(struct esdm_rpc_proto_sc_header)];
+	size_t hdr_len;
+	size_t remaining;
+};
+
+struct loadgen_worker {
+	pthread_t tid;
+	unsigned int idx;
+	struct loadgen_conn *conns;
+	unsigned int nconns;
+	unsigned int next_conn;
+	uint64_t rng;
+
+	uint64_t start, end, interval;
+
+	/* Results */
+	struct bench_hist corrected; /* Latency from intended send time */
+	struct bench_hist service; /* Latency from actual send time */
+	uint64_t sent, completed, errors, incomplete;
+	int ret;
+};
+
+struct loadgen_step {
+	uint64_t rate;
+	double achieved;
+	uint64_t sent, completed, errors, incomplete;
+	struct bench_hist corrected;
+	struct bench_hist service;
+};
+
+static unsigned int loadgen_weights = 0;
+
+static inline uint64_t loadgen_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift64 - selection of the method according to the mix */
+static const struct loadgen_method *loadgen_pick(struct loadgen_worker *w)
+{
+	unsigned int i, val;
+
+	w->rng ^= w->rng << 13;
+	w->rng ^= w->rng >> 7;
+	w->rng ^= w->rng << 17;
+	val = (unsigned int)(w->rng % loadgen_weights);
+
+	for (i = 0; i < LOADGEN_METHODS; i++) {
+		if (val < loadgen_methods[i].weight)
+			return &loadgen_methods[i];
+		val -= loadgen_methods[i].weight;
+	}
+
+	return &loadgen_methods[0];
+}
+
+static int loadgen_prepare_method(struct loadgen_method *m, size_t buflen)
+{
+	const ProtobufCMethodDescriptor *desc =
+		protobuf_c_service_descriptor_get_method_by_name(
+			&unpriv_access__descriptor, m->rpc);
+	struct esdm_rpc_proto_cs_header *hdr =
+		(struct esdm_rpc_proto_cs_header *)m->req;
+	GetRandomBytesFullRequest full = GET_RANDOM_BYTES_FULL_REQUEST__INIT;
+	GetRandomBytesPrRequest pr = GET_RANDOM_BYTES_PR_REQUEST__INIT;
+	GetRandomBytesMinRequest min = GET_RANDOM_BYTES_MIN_REQUEST__INIT;
+	GetRandomBytesRequest plain = GET_RANDOM_BYTES_REQUEST__INIT;
+	StatusRequest status = STATUS_REQUEST__INIT;
+	GetEntLvlRequest ent_lvl = GET_ENT_LVL_REQUEST__INIT;
+	IsFullySeededRequest fully_seeded = IS_FULLY_SEEDED_REQUEST__INIT;
+	const ProtobufCMessage *msg;
+	size_t len;
+
+	if (!desc)
+		return -EOPNOTSUPP;
+
+	full.len = pr.len = min.len = plain.len = buflen;
+	status.maxlen = 4096;
+
+	if (desc->input == full.base.descriptor)
+		msg = &full.base;
+	else if (desc->input == pr.base.descriptor)
+		msg = &pr.base;
+	else if (desc->input == min.base.descriptor)
+		msg = &min.base;
+	else if (desc->input == plain.base.descriptor)
+		msg = &plain.base;
+	else if (desc->input == status.base.descriptor)
+		msg = &status.base;
+	else if (desc->input == ent_lvl.base.descriptor)
+		msg = &ent_lvl.base;
+	else if (desc->input == fully_seeded.base.descriptor)
+		msg = &fully_seeded.base;
+	else
+		return -EOPNOTSUPP;
+
+	len = protobuf_c_message_get_packed_size(msg);
+	if (len > sizeof(m->req) - sizeof(*hdr))
+		return -EOVERFLOW;
+
+	hdr->method_index = le_bswap32(
+		(uint32_t)(desc - unpriv_access__descriptor.methods));
+	hdr->message_length = le_bswap32((uint32_t)len);
+	hdr->request_id = 0;
+	protobuf_c_message_pack(msg, m->req + sizeof(*hdr));
+	m->reqlen = sizeof(*hdr) + len;
+
+	return 0;
+}
+
+static int loadgen_connect(struct loadgen_conn *conn)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s",
+		 ESDM_RPC_UNPRIV_SOCKET);
+
+	conn->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+	if (conn->fd < 0)
+		return -errno;
+
+	if (connect(conn->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int errsv = errno;
+
+		fprintf(stderr, "Connecting to %s failed: %s\n",
+			addr.sun_path, strerror(errsv));
+		close(conn->fd);
+		conn->fd = -1;
+		return -errsv;
+	}
+
+	conn->next_id = 1;
+	return 0;
+}
+
+/* Submit one request, return -EAGAIN if no connection can take it */
+static int loadgen_send(struct loadgen_worker *w, uint64_t intended)
+{
+	const struct loadgen_method *m = loadgen_pick(w);
+	struct esdm_rpc_proto_cs_header hdr;
+	uint8_t req[sizeof(m->req)];
+	unsigned int i;
+
+	memcpy(req, m->req, m->reqlen);
+
+	for (i = 0; i < w->nconns; i++) {
+		struct loadgen_conn *conn =
+			&w->conns[(w->next_conn + i) % w->nconns];
+		ssize_t ret;
+
+		if (conn->tail - conn->head >= LOADGEN_MAX_OUTSTANDING)
+			continue;
+
+		hdr.request_id = le_bswap32(conn->next_id);
+		memcpy(req + offsetof(struct esdm_rpc_proto_cs_header,
+				      request_id),
+		       &hdr.request_id, sizeof(hdr.request_id));
+
+		ret = write(conn->fd, req, m->reqlen);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				continue;
+			return -errno;
+		}
+
+		conn->reqs[conn->tail % LOADGEN_MAX_OUTSTANDING].intended =
+			intended;
+		conn->reqs[conn->tail % LOADGEN_MAX_OUTSTANDING].sent =
+			loadgen_ns();
+		conn->tail++;
+		conn->next_id++;
+		w->next_conn = (w->next_conn + i + 1) % w->nconns;
+		w->sent++;
+		return 0;
+	}
+
+	return -EAGAIN;
+}
+
+static void loadgen_complete(struct loadgen_worker *w,
+			     struct loadgen_conn *conn, uint64_t now)
+{
+	const struct esdm_rpc_proto_sc_header *hdr =
+		(const struct esdm_rpc_proto_sc_header *)conn->hdr;
+	struct loadgen_req *req;
+
+	/* Responses arrive in submission order */
+	if (conn->head == conn->tail)
+		return;
+	req = &conn->reqs[conn->head % LOADGEN_MAX_OUTSTANDING];
+	conn->head++;
+
+	if (le_bswap32(hdr->status_code) != PROTOBUF_C_RPC_STATUS_CODE_SUCCESS)
+		w->errors++;
+
+	bench_hist_record(&w->corrected, now - req->intended);
+	bench_hist_record(&w->service, now - req->sent);
+	w->completed++;
+}
+
+static int loadgen_receive(struct loadgen_worker *w, struct loadgen_conn *conn)
+{
+	uint8_t buf[ESDM_RPC_MAX_MSG_SIZE + sizeof(conn->hdr)];
+
+	for (;;) {
+		ssize_t ret = read(conn->fd, buf, sizeof(buf));
+		uint64_t now = loadgen_ns();
+		uint8_t *p = buf;
+		size_t n;
+
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -errno;
+		}
+		if (!ret)
+			return -EPIPE;
+
+		/* Only the header is of interest, skip the payload */
+		for (n = (size_t)ret; n;) {
+			size_t todo;
+
+			if (conn->hdr_len < sizeof(conn->hdr)) {
+				todo = sizeof(conn->hdr) - conn->hdr_len;
+				if (todo > n)
+					todo = n;
+				memcpy(conn->hdr + conn->hdr_len, p, todo);
+				conn->hdr_len += todo;
+				if (conn->hdr_len == sizeof(conn->hdr)) {
+					const struct esdm_rpc_proto_sc_header
+						*hdr = (const void *)conn->hdr;
+
+					conn->remaining = le_bswap32(
+						hdr->message_length);
+				}
+			} else {
+				todo = (conn->remaining < n) ? conn->remaining :
+							       n;
+				conn->remaining -= todo;
+			}
+
+			p += todo;
+			n -= todo;
+
+			if (conn->hdr_len == sizeof(conn->hdr) &&
+			    !conn->remaining) {
+				loadgen_complete(w, conn, now);
+				conn->hdr_len = 0;
+			}
+		}
+	}
+}
+
+static unsigned int loadgen_outstanding(struct loadgen_worker *w)
+{
+	unsigned int i, outstanding = 0;
+
+	for (i = 0; i < w->nconns; i++)
+		outstanding += w->conns[i].tail - w->conns[i].head;
+
+	return outstanding;
+}
+
+static int loadgen_poll(struct loadgen_worker *w, int epfd, int timeout)
+{
+	struct epoll_event events[64];
+	int i, n, ret;
+
+	n = epoll_wait(epfd, events, 64, timeout);
+	if (n < 0)
+		return (errno == EINTR) ? 0 : -errno;
+
+	for (i = 0; i < n; i++) {
+		ret = loadgen_receive(w, &w->conns[events[i].data.u32]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void *loadgen_worker(void *arg)
+{
+	struct loadgen_worker *w = arg;
+	uint64_t next_send = w->start, now;
+	unsigned int i;
+	int epfd;
+
+	epfd = epoll_create1(0);
+	if (epfd < 0) {
+		w->ret = -errno;
+		return NULL;
+	}
+
+	for (i = 0; i < w->nconns; i++) {
+		struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, w->conns[i].fd, &ev) < 0) {
+			w->ret = -errno;
+			goto out;
+		}
+	}
+
+	/* Open loop: submit at the scheduled times regardless of responses */
+	while ((now = loadgen_ns()) < w->end) {
+		int timeout = 0;
+
+		while (next_send <= now && next_send < w->end) {
+			w->ret = loadgen_send(w, next_send);
+			if (w->ret == -EAGAIN) {
+				/* Server applies back pressure - keep time */
+				w->ret = 0;
+				timeout = 1;
+				break;
+			}
+			if (w->ret)
+				goto out;
+			next_send += w->interval;
+		}
+
+		if (!timeout && next_send > now)
+			timeout = (int)((next_send - now) / 1000000ULL);
+
+		w->ret = loadgen_poll(w, epfd, timeout);
+		if (w->ret)
+			goto out;
+	}
+
+	/* Collect the responses of the outstanding requests */
+	while (loadgen_outstanding(w) &&
+	       loadgen_ns() < w->end + LOADGEN_DRAIN_NS) {
+		w->ret = loadgen_poll(w, epfd, 10);
+		if (w->ret)
+			goto out;
+	}
+
+out:
+	/* Requests without response count with their latency until now */
+	now = loadgen_ns();
+	for (i = 0; i < w->nconns; i++) {
+		struct loadgen_conn *conn = &w->conns[i];
+
+		for (; conn->head != conn->tail; conn->head++) {
+			bench_hist_record(
+				&w->corrected,
+				now - conn->reqs[conn->head %
+						 LOADGEN_MAX_OUTSTANDING]
+						.intended);
+			w->incomplete++;
+		}
+	}
+
+	/*
+	 * Requests which could not be submitted due to back pressure are
+	 * missing from the connections - account them the same way.
+	 */
+	for (; next_send < w->end && next_send <= now;
+	     next_send += w->interval) {
+		bench_hist_record(&w->corrected, now - next_send);
+		w->incomplete++;
+	}
+
+	close(epfd);
+	return NULL;
+}
+
+/* Execute one measurement at the given offered rate */
+static int loadgen_step(const struct loadgen_opts *opts, uint64_t rate,
+			struct loadgen_step *step)
+{
+	struct loadgen_worker *w;
+	struct loadgen_conn *conns;
+	uint64_t start, interval;
+	unsigned int i, conn_idx = 0;
+	int ret = 0;
+
+	memset(step, 0, sizeof(*step));
+	step->rate = rate;
+	bench_hist_init(&step->corrected);
+	bench_hist_init(&step->service);
+
+	w = calloc(opts->threads, sizeof(*w));
+	conns = calloc(opts->connections, sizeof(*conns));
+	if (!w || !conns) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < opts->connections; i++)
+		conns[i].fd = -1;
+	for (i = 0; i < opts->connections; i++) {
+		ret = loadgen_connect(&conns[i]);
+		if (ret)
+			goto out;
+	}
+
+	/*
+	 * Each worker issues every threads-th request of the global schedule,
+	 * the workers are offset by one global interval.
+	 */
+	interval = 1000000000ULL / rate;
+	if (!interval)
+		interval = 1;
+	start = loadgen_ns() + 10000000ULL;
+
+	for (i = 0; i < opts->threads; i++) {
+		unsigned int nconns = opts->connections / opts->threads +
+				      (i < opts->connections % opts->threads);
+
+		w[i].idx = i;
+		w[i].conns = &conns[conn_idx];
+		w[i].nconns = nconns;
+		conn_idx += nconns;
+		w[i].rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+		w[i].interval = interval * opts->threads;
+		w[i].start = start + interval * i;
+		w[i].end = start + (uint64_t)opts->duration * 1000000000ULL;
+		bench_hist_init(&w[i].corrected);
+		bench_hist_init(&w[i].service);
+	}
+
+	for (i = 0; i < opts->threads; i++) {
+		if (pthread_create(&w[i].tid, NULL, loadgen_worker, &w[i])) {
+			ret = -EAGAIN;
+			break;
+		}
+	}
+	while (i--)
+		pthread_join(w[i].tid, NULL);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < opts->threads; i++) {
+		if (w[i].ret && !ret)
+			ret = w[i].ret;
+		bench_hist_merge(&step->corrected, &w[i].corrected);
+		bench_hist_merge(&step->service, &w[i].service);
+		step->sent += w[i].sent;
+		step->completed += w[i].completed;
+		step->errors += w[i].errors;
+		step->incomplete += w[i].incomplete;
+	}
+
+	step->achieved = (double)step->completed / (double)opts->duration;
+
+	fprintf(stderr,
+		"offered %10lu req/s, achieved %12.1f req/s, p50 %9lu ns, p99 %9lu ns, p999 %9lu ns, incomplete %lu\n",
+		(unsigned long)rate, step->achieved,
+		(unsigned long)bench_hist_percentile(&step->corrected, 50.0),
+		(unsigned long)bench_hist_percentile(&step->corrected, 99.0),
+		(unsigned long)bench_hist_percentile(&step->corrected, 99.9),
+		(unsigned long)step->incomplete);
+
+out:
+	if (conns) {
+		for (i = 0; i < opts->connections; i++) {
+			if (conns[i].fd >= 0)
+				close(conns[i].fd);
+		}
+		free(conns);
+	}
+	free(w);
+	return ret;
+}
+
+/* Does the server sustain the offered rate within the latency objective? */
+static bool loadgen_sustained(const struct loadgen_opts *opts,
+			      const struct loadgen_step *step)
+{
+	return !step->incomplete &&
+	       step->achieved >= 0.95 * (double)step->rate &&
+	       bench_hist_percentile(&step->corrected, 99.0) <= opts->slo_ns;
+}
+
+static void loadgen_print_hist(FILE *out, const char *name,
+			       const struct bench_hist *hist)
+{
+	fprintf(out,
+		"      \"%s\": {\n"
+		"        \"min\": %lu,\n"
+		"        \"mean\": %.1f,\n"
+		"        \"p50\": %lu,\n"
+		"        \"p90\": %lu,\n"
+		"        \"p99\": %lu,\n"
+		"        \"p999\": %lu,\n"
+		"        \"p9999\": %lu,\n"
+		"        \"max\": %lu\n"
+		"      }",
+		name, (unsigned long)(hist->total ? hist->min : 0),
+		bench_hist_mean(hist),
+		(unsigned long)bench_hist_percentile(hist, 50.0),
+		(unsigned long)bench_hist_percentile(hist, 90.0),
+		(unsigned long)bench_hist_percentile(hist, 99.0),
+		(unsigned long)bench_hist_percentile(hist, 99.9),
+		(unsigned long)bench_hist_percentile(hist, 99.99),
+		(unsigned long)hist->max);
+}
+
+static void loadgen_print_step(FILE *out, const struct loadgen_step *step,
+			       bool sustained, bool first)
+{
+	fprintf(out,
+		"%s\n    {\n"
+		"      \"offered_rate\": %lu,\n"
+		"      \"achieved_rate\": %.1f,\n"
+		"      \"sent\": %lu,\n"
+		"      \"completed\": %lu,\n"
+		"      \"errors\": %lu,\n"
+		"      \"incomplete\": %lu,\n"
+		"      \"sustained\": %s,\n",
+		first ? "" : ",", (unsigned long)step->rate, step->achieved,
+		(unsigned long)step->sent, (unsigned long)step->completed,
+		(unsigned long)step->errors, (unsigned long)step->incomplete,
+		sustained ? "true" : "false");
+	loadgen_print_hist(out, "latency_ns", &step->corrected);
+	fprintf(out, ",\n");
+	loadgen_print_hist(out, "service_time_ns", &step->service);
+	fprintf(out, "\n    }");
+}
+
+static int loadgen_parse_mix(const char *arg)
+{
+	char *tmp = strdup(arg), *tok, *saveptr = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	if (!tmp)
+		return -ENOMEM;
+
+	for (i = 0; i < LOADGEN_METHODS; i++)
+		loadgen_methods[i].weight = 0;
+
+	for (tok = strtok_r(tmp, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		char *val = strchr(tok, '=');
+
+		if (val)
+			*val++ = '\0';
+
+		for (i = 0; i < LOADGEN_METHODS; i++) {
+			if (!strcmp(tok, loadgen_methods[i].name)) {
+				loadgen_methods[i].weight =
+					val ? (unsigned int)strtoul(val, NULL,
+								    10) :
+					      1;
+				break;
+			}
+		}
+		if (i == LOADGEN_METHODS) {
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	free(tmp);
+	return ret;
+}
+
+static void loadgen_usage(void)
+{
+	unsigned int i;
+
+	fprintf(stderr, "\nESDM RPC server open-loop load generator\n\n");
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "\t-r --rate <NUM>\t\tOffered requests per second\n");
+	fprintf(stderr,
+		"\t-c --connections <NUM>\tNumber of connections to the server\n");
+	fprintf(stderr, "\t-t --threads <NUM>\tNumber of sender threads\n");
+	fprintf(stderr,
+		"\t-d --duration <SECS>\tDuration of one measurement\n");
+	fprintf(stderr,
+		"\t-m --mix <LIST>\t\tMethod mix as name=weight,... - names:");
+	for (i = 0; i < LOADGEN_METHODS; i++)
+		fprintf(stderr, " %s", loadgen_methods[i].name);
+	fprintf(stderr, "\n");
+	fprintf(stderr,
+		"\t-b --buflen <BYTES>\tSize of random number requests\n");
+	fprintf(stderr,
+		"\t-s --find-saturation\tSearch the highest sustained rate starting at --rate\n");
+	fprintf(stderr,
+		"\t-l --slo <USECS>\tp99 latency objective for --find-saturation\n");
+	fprintf(stderr,
+		"\t-o --output <FILE>\tWrite JSON report to file instead of stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct loadgen_opts opts = {
+		.threads = 2,
+		.connections = 16,
+		.duration = 5,
+		.rate = 10000,
+		.buflen = 32,
+		.slo_ns = 10000000,
+		.find_saturation = false,
+		.output = NULL,
+	};
+	struct loadgen_step *step = NULL;
+	uint64_t good = 0, bad = 0, rate;
+	FILE *out = stdout;
+	unsigned int i;
+	bool first = true, sustained;
+	int c, ret = 0;
+
+	while (1) {
+		int opt_index = 0;
+		static const struct option options[] = {
+			{ "rate", required_argument, 0, 'r' },
+			{ "connections", required_argument, 0, 'c' },
+			{ "threads", required_argument, 0, 't' },
+			{ "duration", required_argument, 0, 'd' },
+			{ "mix", required_argument, 0, 'm' },
+			{ "buflen", required_argument, 0, 'b' },
+			{ "find-saturation", no_argument, 0, 's' },
+			{ "slo", required_argument, 0, 'l' },
+			{ "output", required_argument, 0, 'o' },
+			{ "help", no_argument, 0, 'h' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "r:c:t:d:m:b:sl:o:h", options,
+				&opt_index);
+		if (-1 == c)
+			break;
+		switch (c) {
+		case 'r':
+			opts.rate = strtoull(optarg, NULL, 10);
+			break;
+		case 'c':
+			opts.connections =
+				(unsigned int)strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			opts.threads = (unsigned int)strtoul(optarg, NULL, 10);
+			break;
+		case 'd':
+			opts.duration = (unsigned int)strtoul(optarg, NULL, 10);
+			break;
+		case 'm':
+			ret = loadgen_parse_mix(optarg);
+			break;
+		case 'b':
+			opts.buflen = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			opts.find_saturation = true;
+			break;
+		case 'l':
+			opts.slo_ns = strtoull(optarg, NULL, 10) * 1000;
+			break;
+		case 'o':
+			opts.output = optarg;
+			break;
+		case 'h':
+		default:
+			loadgen_usage();
+			return 1;
+		}
+
+		if (ret) {
+			loadgen_usage();
+			return 1;
+		}
+	}
+
+	if (!opts.rate || opts.rate > LOADGEN_MAX_RATE || !opts.duration ||
+	    !opts.threads ||
+	    opts.threads > LOADGEN_MAX_THREADS ||
+	    opts.connections < opts.threads ||
+	    opts.connections > LOADGEN_MAX_CONNECTIONS ||
+	    !opts.buflen || opts.buflen > ESDM_RPC_MAX_DATA) {
+		loadgen_usage();
+		return 1;
+	}
+
+	for (i = 0; i < LOADGEN_METHODS; i++) {
+		if (!loadgen_methods[i].weight)
+			continue;
+		loadgen_weights += loadgen_methods[i].weight;
+		ret = loadgen_prepare_method(&loadgen_methods[i], opts.buflen);
+		if (ret) {
+			fprintf(stderr, "Cannot prepare method %s: %d\n",
+				loadgen_methods[i].name, ret);
+			return 1;
+		}
+	}
+	if (!loadgen_weights) {
+		loadgen_usage();
+		return 1;
+	}
+
+	step = malloc(sizeof(*step));
+	if (!step)
+		return 1;
+
+	if (opts.output) {
+		out = fopen(opts.output, "w");
+		if (!out) {
+			ret = -errno;
+			fprintf(stderr, "Cannot open %s: %s\n", opts.output,
+				strerror(-ret));
+			goto out;
+		}
+	}
+
+	ret = env_init(false);
+	if (ret)
+		goto out;
+
+	fprintf(out,
+		"{\n"
+		"  \"connections\": %u,\n"
+		"  \"threads\": %u,\n"
+		"  \"duration_s\": %u,\n"
+		"  \"request_size\": %zu,\n"
+		"  \"slo_p99_ns\": %lu,\n"
+		"  \"mix\": {",
+		opts.connections, opts.threads, opts.duration, opts.buflen,
+		(unsigned long)opts.slo_ns);
+	for (i = 0; i < LOADGEN_METHODS; i++) {
+		if (!loadgen_methods[i].weight)
+			continue;
+		fprintf(out, "%s \"%s\": %u", first ? "" : ",",
+			loadgen_methods[i].name, loadgen_methods[i].weight);
+		first = false;
+	}
+	fprintf(out, " },\n  \"steps\": [");
+	first = true;
+
+	rate = opts.rate;
+	for (i = 0;;) {
+		ret = loadgen_step(&opts, rate, step);
+		if (ret)
+			break;
+
+		sustained = loadgen_sustained(&opts, step);
+		loadgen_print_step(out, step, sustained, first);
+		first = false;
+
+		if (!opts.find_saturation)
+			break;
+
+		if (sustained)
+			good = rate;
+		else
+			bad = rate;
+
+		/* Exponential search for the first rate not sustained ... */
+		if (!bad) {
+			if (rate >= LOADGEN_MAX_RATE)
+				break;
+			rate *= 2;
+			continue;
+		}
+
+		/* ... or downwards for the first rate sustained ... */
+		if (!good) {
+			if (rate <= 1)
+				break;
+			rate /= 2;
+			continue;
+		}
+
+		/* ... followed by a bisection */
+		if (++i > LOADGEN_BISECT_STEPS)
+			break;
+		rate = good + (bad - good) / 2;
+		if (rate == good)
+			break;
+	}
+
+	fprintf(out, "\n  ]");
+	if (opts.find_saturation)
+		fprintf(out, ",\n  \"saturation_rate\": %lu",
+			(unsigned long)good);
+	fprintf(out, "\n}\n");
+
+	env_fini();
+
+out:
+	if (out != stdout && out)
+		fclose(out);
+	free(step);
+	if (ret < 0)
+		ret = 1;
+	return ret;
+}
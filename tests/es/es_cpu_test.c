@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "esdm_config.h"
 #include "esdm_es_aux.h"
@@ -165,20 +166,61 @@ static int es_cpu_init(void)
 	return 0;
 }
 
+#define ES_CPU_TIMING_LOOPS 10000
+
+/* Measure the time to obtain one seed from the CPU ES */
+static int es_cpu_timing(void)
+{
+	struct timespec start, end;
+	struct entropy_es eb_es;
+	uint64_t ns;
+	unsigned int i;
+
+	esdm_logger_set_verbosity(LOGGER_NONE);
+	esdm_config_es_cpu_entropy_rate_set(ESDM_DRNG_SECURITY_STRENGTH_BITS);
+
+	/* Warm up, e.g. to determine the multiplier */
+	esdm_es[esdm_ext_es_cpu]->get_ent(&eb_es,
+					  ESDM_DRNG_SECURITY_STRENGTH_BITS,
+					  false);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < ES_CPU_TIMING_LOOPS; i++) {
+		esdm_es[esdm_ext_es_cpu]->get_ent(
+			&eb_es, ESDM_DRNG_SECURITY_STRENGTH_BITS, false);
+		if (!eb_es.e_bits) {
+			printf("ES CPU - fail: get_ent delivered no entropy\n");
+			return 1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL +
+	     (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+
+	esdm_logger_set_verbosity(LOGGER_DEBUG);
+	printf("ES CPU - timing: %lu ns per %u bit seed\n",
+	       (unsigned long)(ns / ES_CPU_TIMING_LOOPS),
+	       ESDM_DRNG_SECURITY_STRENGTH_BITS);
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	uint32_t i;
 	int ret;
 
-	(void)argc;
-	(void)argv;
-
 	esdm_logger_set_verbosity(LOGGER_DEBUG);
 
 	ret = es_cpu_init();
 	if (ret)
 		return ret;
 
+	/* Timing mode: es_cpu_tester -t */
+	if (argc > 1 && !strcmp(argv[1], "-t"))
+		return es_cpu_timing();
+
 	ret += es_cpu_name();
 
 	for (i = 1; i <= ESDM_DRNG_SECURITY_STRENGTH_BITS; i++) {
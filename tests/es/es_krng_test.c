@@ -192,6 +192,55 @@ static int es_krng_fini(void)
 	return 0;
 }
 
+/* Reseeds are served from the prefetched reservoir */
+static int es_krng_reservoir(void)
+{
+	char buf[500];
+	int ret;
+
+	esdm_config_es_krng_reservoir_enabled_set(1);
+
+	ret = es_krng_init();
+	if (ret)
+		goto out;
+
+	ret = esdm_es[esdm_ext_es_krng]->monitor_es();
+	if (ret) {
+		printf("ES Kernel RNG - fail: reservoir filling failed: %d\n",
+		       ret);
+		ret = 1;
+		goto out;
+	}
+
+	memset(buf, 0, sizeof(buf));
+	esdm_es[esdm_ext_es_krng]->state(buf, sizeof(buf));
+	if (!strstr(buf, "Reservoir fill level: 1024 of 1024 bytes")) {
+		printf("ES Kernel RNG - fail: reservoir not filled: %s\n", buf);
+		ret = 1;
+		goto out;
+	}
+
+	ret = es_krng_getdata(ESDM_DRNG_SECURITY_STRENGTH_BITS);
+	if (ret)
+		goto out;
+
+	memset(buf, 0, sizeof(buf));
+	esdm_es[esdm_ext_es_krng]->state(buf, sizeof(buf));
+	if (strstr(buf, "Reservoir fill level: 1024 of 1024 bytes")) {
+		printf("ES Kernel RNG - fail: data not taken from reservoir: %s\n",
+		       buf);
+		ret = 1;
+		goto out;
+	}
+
+	printf("ES KRNG - pass: reservoir test passed:\n%s\n", buf);
+
+out:
+	ret += es_krng_fini();
+	esdm_config_es_krng_reservoir_enabled_set(0);
+	return ret;
+}
+
 int main(int argc, char *argv[])
 {
 	unsigned int i;
@@ -216,5 +265,7 @@ int main(int argc, char *argv[])
 	ret += es_krng_getstate();
 	ret += es_krng_fini();
 
+	ret += es_krng_reservoir();
+
 	return ret;
 }
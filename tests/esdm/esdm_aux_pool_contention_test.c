@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2022 - 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esdm.h"
+#include "esdm_drng_mgr.h"
+#include "esdm_es_aux.h"
+#include "test_pertubation.h"
+
+#define ESDM_AUX_POOL_TEST_LOOPS 100000
+#define ESDM_AUX_POOL_TEST_MAX_THREADS 64
+
+/*
+ * Measure the throughput of concurrent aux pool inserts and verify that the
+ * entropy accounting of the sharded aux pool never exceeds the digest size.
+ */
+static volatile int esdm_aux_pool_test_fail = 0;
+
+static void *esdm_aux_pool_insert_thread(void *arg)
+{
+	uint8_t buf[32];
+	unsigned int i;
+
+	(void)arg;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (uint8_t)i;
+
+	for (i = 0; i < ESDM_AUX_POOL_TEST_LOOPS; i++) {
+		buf[0] = (uint8_t)i;
+		if (esdm_pool_insert_aux(buf, sizeof(buf), 1)) {
+			esdm_aux_pool_test_fail = 1;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static int esdm_aux_pool_contention(unsigned int threads, double *base)
+{
+	pthread_t tid[ESDM_AUX_POOL_TEST_MAX_THREADS];
+	struct timespec start, end;
+	uint32_t max_ent = esdm_reduce_by_osr(esdm_get_digestsize());
+	double ops;
+	uint64_t ns;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&tid[i], NULL, esdm_aux_pool_insert_thread,
+				   NULL))
+			return 1;
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (esdm_aux_pool_test_fail) {
+		printf("Insert into aux pool failed\n");
+		return 1;
+	}
+
+	if (esdm_get_aux_ent() > max_ent) {
+		printf("Aux pool entropy %u exceeds maximum %u\n",
+		       esdm_get_aux_ent(), max_ent);
+		return 1;
+	}
+
+	ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL +
+	     (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+	ops = (double)threads * ESDM_AUX_POOL_TEST_LOOPS * 1000.0 / (double)ns;
+
+	if (threads == 1)
+		*base = ops;
+
+	printf("aux insert %2u threads: %10.2f Mops/s, scaling %5.2f\n",
+	       threads, ops, ops / *base);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	double base = 0;
+	unsigned int threads;
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+#ifndef ESDM_TESTMODE
+	if (getuid()) {
+		printf("Program must be started as root\n");
+		return 77;
+	}
+#endif
+
+	ret = esdm_init();
+	if (ret)
+		return ret;
+
+	for (threads = 1; threads <= ESDM_AUX_POOL_TEST_MAX_THREADS;
+	     threads <<= 1) {
+		ret = esdm_aux_pool_contention(threads, &base);
+		if (ret)
+			goto out;
+	}
+
+out:
+	esdm_fini();
+	return ret;
+}
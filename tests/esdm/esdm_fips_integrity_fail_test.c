@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "esdm_config.h"
+#include "fips.h"
+
+/*
+ * Failure path of the FIPS integrity test: with a control file that does not
+ * match the binary or without a control file, the test reports an integrity
+ * violation and a process in FIPS mode terminates before it generates any
+ * output.
+ */
+#ifdef ESDM_FIPS140
+/* Execute this binary in FIPS mode, return its exit status */
+static int esdm_fips_integrity_child(const char *self)
+{
+	int status;
+	pid_t pid = fork();
+
+	if (pid < 0)
+		return -errno;
+
+	if (pid == 0) {
+		char *const args[] = { (char *)self, "child", NULL };
+
+		setenv("ESDM_SERVER_FORCE_FIPS", "1", 1);
+		execv(self, args);
+		_exit(126);
+	}
+
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+		return -ECHILD;
+
+	return WEXITSTATUS(status);
+}
+
+/* Replace the control file with a MAC that does not match the binary */
+static int esdm_fips_integrity_corrupt(const char *checkfile)
+{
+	FILE *f = fopen(checkfile, "w");
+	unsigned int i;
+
+	if (!f)
+		return -errno;
+
+	for (i = 0; i < 64; i++)
+		fputc('0', f);
+	fputc('\n', f);
+
+	return fclose(f) ? -errno : 0;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifdef ESDM_FIPS140
+	char self[PATH_MAX], checkfile[PATH_MAX + 8];
+	const char *base;
+	ssize_t len;
+	int ret;
+
+	/* Terminates the process if the integrity test failed */
+	if (argc > 1 && !strcmp(argv[1], "child")) {
+		fips_post_integrity_wait();
+		return 0;
+	}
+
+	len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0)
+		return 77;
+	self[len] = '\0';
+
+	base = strrchr(self, '/');
+	base = base ? base + 1 : self;
+	snprintf(checkfile, sizeof(checkfile), "%.*s.%s.hmac",
+		 (int)(base - self), self, base);
+
+	esdm_config_force_fips_set(esdm_config_force_fips_enabled);
+
+	ret = fips_integrity_create(self);
+	if (ret) {
+		printf("Creating the control file failed: %d\n", ret);
+		return 1;
+	}
+
+	ret = fips_post_integrity(NULL);
+	if (ret) {
+		printf("Integrity test with valid control file failed: %d\n",
+		       ret);
+		ret = 1;
+		goto out;
+	}
+
+	ret = esdm_fips_integrity_child(self);
+	if (ret) {
+		printf("Process with valid control file terminated: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	ret = esdm_fips_integrity_corrupt(checkfile);
+	if (ret) {
+		printf("Writing the control file failed: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	ret = fips_post_integrity(NULL);
+	if (ret != -EBADMSG) {
+		printf("Integrity violation not detected: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	ret = esdm_fips_integrity_child(self);
+	if (ret != EBADMSG) {
+		printf("Process with integrity violation not terminated: %d\n",
+		       ret);
+		ret = 1;
+		goto out;
+	}
+
+	unlink(checkfile);
+
+	ret = fips_post_integrity(NULL);
+	if (ret != -ENOENT) {
+		printf("Missing control file not detected: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	ret = esdm_fips_integrity_child(self);
+	if (ret != ENOENT) {
+		printf("Process without control file not terminated: %d\n",
+		       ret);
+		ret = 1;
+		goto out;
+	}
+
+	if (!access(checkfile, F_OK)) {
+		printf("Integrity test created the control file\n");
+		ret = 1;
+		goto out;
+	}
+
+	printf("Integrity violation detected and process terminated\n");
+	ret = 0;
+
+out:
+	unlink(checkfile);
+	return ret;
+#else
+	(void)argc;
+	(void)argv;
+	return 77;
+#endif
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "esdm.h"
+#include "fips.h"
+
+#define ESDM_FIPS_INTEGRITY_TEST_LOOPS 10
+
+/*
+ * Measure the startup time caused by the FIPS integrity test: the duration
+ * of the test itself and of esdm_init() which overlaps with the test started
+ * by the library constructor when ESDM_SERVER_FORCE_FIPS is set.
+ */
+#ifdef ESDM_FIPS140
+static inline uint64_t esdm_fips_integrity_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifdef ESDM_FIPS140
+	char self[PATH_MAX];
+	struct stat sb;
+	ssize_t len;
+	uint64_t start, init_ns, min_ns = UINT64_MAX, sum_ns = 0;
+	unsigned int i;
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+#ifndef ESDM_TESTMODE
+	if (getuid()) {
+		printf("Program must be started as root\n");
+		return 77;
+	}
+#endif
+
+	/* Includes waiting for the integrity test started by the constructor */
+	start = esdm_fips_integrity_ns();
+	ret = esdm_init();
+	init_ns = esdm_fips_integrity_ns() - start;
+	if (ret) {
+		printf("ESDM initialization failed: %d\n", ret);
+		return 1;
+	}
+
+	len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0) {
+		ret = 77;
+		goto out;
+	}
+	self[len] = '\0';
+	if (stat(self, &sb) < 0) {
+		ret = 77;
+		goto out;
+	}
+
+	/* The integrity test requires the HMAC control file */
+	ret = fips_integrity_create(self);
+	if (ret) {
+		printf("Creating the control file failed: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	for (i = 0; i < ESDM_FIPS_INTEGRITY_TEST_LOOPS; i++) {
+		uint64_t ns;
+
+		start = esdm_fips_integrity_ns();
+		ret = fips_integrity_check(NULL);
+		ns = esdm_fips_integrity_ns() - start;
+		if (ret) {
+			printf("Integrity test failed: %d\n", ret);
+			ret = 1;
+			goto out;
+		}
+
+		sum_ns += ns;
+		if (ns < min_ns)
+			min_ns = ns;
+	}
+
+	printf("integrity test of %ld bytes: min %.3f ms, mean %.3f ms, %.1f MB/s\n",
+	       (long)sb.st_size, (double)min_ns / 1000000.0,
+	       (double)sum_ns / ESDM_FIPS_INTEGRITY_TEST_LOOPS / 1000000.0,
+	       (double)sb.st_size * 1000.0 / (double)min_ns);
+	printf("esdm_init including the concurrent integrity test: %.3f ms\n",
+	       (double)init_ns / 1000000.0);
+
+out:
+	esdm_fini();
+	return ret;
+#else
+	(void)argc;
+	(void)argv;
+	return 77;
+#endif
+}
@@ -20,6 +20,7 @@
 #include <errno.h>
 #include "inttypes.h"
 #include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -31,6 +32,54 @@
 #include "esdm_logger.h"
 #include "test_pertubation.h"
 
+#define ESDM_GET_SEED_PARALLEL 4
+
+struct esdm_get_seed_parallel {
+	uint64_t buf[512 / sizeof(uint64_t)];
+	ssize_t rc;
+};
+
+static void *esdm_get_seed_parallel_thread(void *arg)
+{
+	struct esdm_get_seed_parallel *p = arg;
+
+	p->rc = esdm_get_seed(p->buf, sizeof(p->buf), 0);
+	return NULL;
+}
+
+/*
+ * Concurrent blocking requests are queued and served one after another -
+ * none of them must be rejected.
+ */
+static int esdm_get_seed_parallel_test(void)
+{
+	static struct esdm_get_seed_parallel p[ESDM_GET_SEED_PARALLEL];
+	pthread_t threads[ESDM_GET_SEED_PARALLEL];
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < ESDM_GET_SEED_PARALLEL; i++) {
+		if (pthread_create(&threads[i], NULL,
+				   esdm_get_seed_parallel_thread, &p[i]))
+			return 1;
+	}
+
+	for (i = 0; i < ESDM_GET_SEED_PARALLEL; i++) {
+		pthread_join(threads[i], NULL);
+		if (p[i].rc <= 0) {
+			printf("parallel esdm_get_seed request %u failed: %zd\n",
+			       i, p[i].rc);
+			ret = 1;
+		}
+	}
+
+	if (!ret)
+		printf("%u parallel esdm_get_seed requests served\n",
+		       ESDM_GET_SEED_PARALLEL);
+
+	return ret;
+}
+
 int main(int argc, char *argv[])
 {
 	uint64_t buf[512 / sizeof(uint64_t)];
@@ -160,6 +209,8 @@ int main(int argc, char *argv[])
 		       buf[0], buf[1]);
 	}
 
+	ret = esdm_get_seed_parallel_test();
+
 out:
 	esdm_fini();
 	return ret;
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2022 - 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esdm.h"
+#include "esdm_drng_mgr.h"
+#include "esdm_logger.h"
+#include "mutex.h"
+#include "rcu.h"
+#include "test_pertubation.h"
+
+#define ESDM_HASH_CB_TEST_LOOPS 1000000
+#define ESDM_HASH_CB_TEST_MAX_THREADS 64
+
+/*
+ * Compare the read side protecting the hash callback access: the RCU read
+ * side against the reader / writer lock that was used before.
+ */
+static DEFINE_MUTEX_UNLOCKED(esdm_hash_cb_test_lock);
+
+static void *esdm_hash_cb_rcu_thread(void *arg)
+{
+	struct esdm_drng *drng = arg;
+	/* Per-thread sink, a shared one would add cache line contention */
+	const char *volatile sink;
+	unsigned int i;
+
+	for (i = 0; i < ESDM_HASH_CB_TEST_LOOPS; i++) {
+		const struct esdm_hash_cb *hash_cb;
+
+		rcu_read_lock();
+		hash_cb = rcu_dereference(drng->hash_cb);
+		sink = hash_cb->hash_name();
+		rcu_read_unlock();
+	}
+	(void)sink;
+
+	return NULL;
+}
+
+static void *esdm_hash_cb_rwlock_thread(void *arg)
+{
+	struct esdm_drng *drng = arg;
+	/* Per-thread sink, a shared one would add cache line contention */
+	const char *volatile sink;
+	unsigned int i;
+
+	for (i = 0; i < ESDM_HASH_CB_TEST_LOOPS; i++) {
+		const struct esdm_hash_cb *hash_cb;
+
+		mutex_reader_lock(&esdm_hash_cb_test_lock);
+		hash_cb = drng->hash_cb;
+		sink = hash_cb->hash_name();
+		mutex_reader_unlock(&esdm_hash_cb_test_lock);
+	}
+	(void)sink;
+
+	return NULL;
+}
+
+static int esdm_hash_cb_contention(const char *name, void *(*fn)(void *),
+				   unsigned int threads, double *base)
+{
+	pthread_t tid[ESDM_HASH_CB_TEST_MAX_THREADS];
+	struct esdm_drng *drng = esdm_drng_init_instance();
+	struct timespec start, end;
+	double ops;
+	uint64_t ns;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&tid[i], NULL, fn, drng))
+			return 1;
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL +
+	     (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+	ops = (double)threads * ESDM_HASH_CB_TEST_LOOPS * 1000.0 / (double)ns;
+
+	if (threads == 1)
+		*base = ops;
+
+	printf("%-8s %2u threads: %10.2f Mops/s, scaling %5.2f\n", name,
+	       threads, ops, ops / *base);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	double base_rcu = 0, base_rwlock = 0;
+	unsigned int threads;
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+#ifndef ESDM_TESTMODE
+	if (getuid()) {
+		printf("Program must be started as root\n");
+		return 77;
+	}
+#endif
+
+	ret = esdm_init();
+	if (ret)
+		return ret;
+
+	for (threads = 1; threads <= ESDM_HASH_CB_TEST_MAX_THREADS;
+	     threads <<= 1) {
+		ret = esdm_hash_cb_contention("RCU", esdm_hash_cb_rcu_thread,
+					      threads, &base_rcu);
+		if (ret)
+			goto out;
+		ret = esdm_hash_cb_contention("rwlock",
+					      esdm_hash_cb_rwlock_thread,
+					      threads, &base_rwlock);
+		if (ret)
+			goto out;
+	}
+
+out:
+	esdm_fini();
+	return ret;
+}
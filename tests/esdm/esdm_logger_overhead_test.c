@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2022 - 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esdm.h"
+#include "esdm_logger.h"
+#include "test_pertubation.h"
+
+#define ESDM_LOGGER_TEST_LOOPS 100000
+
+static int esdm_logger_overhead(const char *name)
+{
+	struct timespec start, end;
+	uint8_t buf[32];
+	uint64_t ns;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < ESDM_LOGGER_TEST_LOOPS; i++) {
+		ssize_t rc = esdm_get_random_bytes(buf, sizeof(buf));
+
+		if (rc < 0)
+			return (int)rc;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL +
+	     (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+
+	printf("%-24s %8lu ns per esdm_get_random_bytes call\n", name,
+	       (unsigned long)(ns / ESDM_LOGGER_TEST_LOOPS));
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+#ifndef ESDM_TESTMODE
+	if (getuid()) {
+		printf("Program must be started as root\n");
+		return 77;
+	}
+#endif
+
+	ret = esdm_logger_set_file("/dev/null");
+	if (ret)
+		return -ret;
+
+	ret = esdm_init();
+	if (ret)
+		return ret;
+
+	esdm_logger_set_verbosity(LOGGER_NONE);
+	ret = esdm_logger_overhead("logging disabled");
+	if (ret)
+		goto out;
+
+	esdm_logger_set_verbosity(LOGGER_DEBUG);
+	ret = esdm_logger_overhead("debug logging");
+	if (ret)
+		goto out;
+
+	ret = esdm_logger_enable_async();
+	if (ret)
+		goto out;
+	ret = esdm_logger_overhead("async debug logging");
+	esdm_logger_disable_async();
+
+out:
+	esdm_logger_set_verbosity(LOGGER_NONE);
+	esdm_fini();
+	return ret;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "esdm.h"
+#include "esdm_config.h"
+#include "esdm_config_internal.h"
+
+#ifdef ESDM_TESTMODE
+#define ESDM_NODE_SEED_TEST_MAX_NODES 64
+
+/*
+ * Measure the startup time of the ESDM and the latency of the first request
+ * served on every node depending on the number of nodes. Node DRNGs are
+ * allocated and seeded when a node is used first, thus the startup time
+ * should not depend on the number of nodes.
+ */
+struct esdm_node_seed_cpu {
+	uint32_t cpu;
+	uint64_t first_ns;
+	uint64_t second_ns;
+	int ret;
+};
+
+static inline uint64_t esdm_node_seed_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void *esdm_node_seed_thread(void *arg)
+{
+	struct esdm_node_seed_cpu *c = arg;
+	uint8_t buf[32];
+	cpu_set_t set;
+	uint64_t start;
+
+	CPU_ZERO(&set);
+	CPU_SET(c->cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		c->ret = 1;
+		return NULL;
+	}
+
+	start = esdm_node_seed_ns();
+	if (esdm_get_random_bytes_full(buf, sizeof(buf)) != sizeof(buf))
+		c->ret = 1;
+	c->first_ns = esdm_node_seed_ns() - start;
+
+	start = esdm_node_seed_ns();
+	if (esdm_get_random_bytes_full(buf, sizeof(buf)) != sizeof(buf))
+		c->ret = 1;
+	c->second_ns = esdm_node_seed_ns() - start;
+
+	return NULL;
+}
+
+static int esdm_node_seed_one(uint32_t nodes)
+{
+	struct esdm_node_seed_cpu c;
+	uint64_t start, startup, first_sum = 0, first_max = 0, second_sum = 0;
+	uint32_t cpu;
+	int ret;
+
+	esdm_config_max_nodes_set(nodes);
+
+	start = esdm_node_seed_ns();
+	ret = esdm_init();
+	if (ret)
+		return 1;
+	startup = esdm_node_seed_ns() - start;
+
+	/* One CPU after the other to measure the uncontended latency */
+	for (cpu = 0; cpu < nodes; cpu++) {
+		pthread_t tid;
+
+		c.cpu = cpu;
+		c.ret = 0;
+		if (pthread_create(&tid, NULL, esdm_node_seed_thread, &c)) {
+			ret = 1;
+			goto out;
+		}
+		pthread_join(tid, NULL);
+		if (c.ret) {
+			printf("Request on CPU %u failed\n", cpu);
+			ret = 1;
+			goto out;
+		}
+
+		first_sum += c.first_ns;
+		second_sum += c.second_ns;
+		if (c.first_ns > first_max)
+			first_max = c.first_ns;
+	}
+
+	printf("nodes %2u: startup %9.2f ms, first request mean %9.2f us max %9.2f us, next request mean %7.2f us\n",
+	       nodes, (double)startup / 1000000.0,
+	       (double)first_sum / nodes / 1000.0, (double)first_max / 1000.0,
+	       (double)second_sum / nodes / 1000.0);
+
+out:
+	esdm_fini();
+	return ret;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifdef ESDM_TESTMODE
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t nodes;
+	int ret = 0;
+
+	(void)argc;
+	(void)argv;
+
+	if (cpus < 1)
+		return 77;
+
+	/* Every measurement uses a fresh process to start from scratch */
+	for (nodes = 1;
+	     nodes <= ESDM_NODE_SEED_TEST_MAX_NODES && nodes <= (uint32_t)cpus;
+	     nodes <<= 1) {
+		int status;
+		pid_t pid;
+
+		fflush(stdout);
+		pid = fork();
+		if (pid < 0)
+			return 1;
+		if (pid == 0)
+			_exit(esdm_node_seed_one(nodes));
+
+		if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status)) {
+			ret = 1;
+			break;
+		}
+	}
+
+	return ret;
+#else
+	(void)argc;
+	(void)argv;
+	return 77;
+#endif
+}
@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Copyright (C) 2022 - 2024, Stephan Mueller <smueller@chronox.de>
+#
+# License: see LICENSE file in root directory
+#
+# THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+# OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+# WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+# OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+# USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+# DAMAGE.
+#
+# Measure how the read throughput of the CUSE devices scales with the number
+# of parallel readers.
+#
+# Usage: cuse_read_scaling.sh [device] [block size] [count]
+
+DEVICE=${1:-/dev/urandom}
+BS=${2:-1M}
+COUNT=${3:-256}
+
+TMPDIR=$(mktemp -d)
+
+cleanup() {
+	rm -rf $TMPDIR
+}
+
+trap "cleanup; exit $?" 0 1 2 3 15
+
+if ! (ps -efa | grep -v grep | grep -q esdm-cuse-urandom)
+then
+	echo "Scaling test misses esdm-cuse-urandom"
+	exit 77
+fi
+
+echo -e "readers\ttotal MB/s"
+
+for readers in 1 2 4 8 16 32 64
+do
+	start=$(date +%s%N)
+
+	i=0
+	while [ $i -lt $readers ]
+	do
+		( dd if=$DEVICE of=/dev/null bs=$BS count=$COUNT iflag=fullblock > $TMPDIR/dd_$i 2>&1 ) &
+		i=$(($i+1))
+	done
+
+	wait
+
+	end=$(date +%s%N)
+
+	bytes=0
+	i=0
+	while [ $i -lt $readers ]
+	do
+		b=$(grep "bytes" $TMPDIR/dd_$i | awk '{print $1}')
+		bytes=$(($bytes+${b:-0}))
+		i=$(($i+1))
+	done
+
+	# bytes * 1000 / ns = MB/s
+	echo -e "$readers\t$(($bytes*1000/($end-$start)))"
+done
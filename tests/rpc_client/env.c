@@ -69,7 +69,9 @@ static int env_check_file(const char *path)
 	return 0;
 }
 
-int env_init(void)
+#define ENV_SERVER_ARGS_MAX 16
+
+int env_init_args(const char *const args[])
 {
 	struct timespec ts = { .tv_sec = 1, .tv_nsec = 0 };
 	const char *server = getenv("ESDM_SERVER");
@@ -90,10 +92,16 @@ int env_init(void)
 		return errno;
 	if (pid == 0) {
 		char buf[FILENAME_MAX];
-		char *server_argv[] = { buf, "-vvvvv", NULL };
+		char *server_argv[ENV_SERVER_ARGS_MAX + 3] = { buf, "-vvvvv" };
+		unsigned int i;
 
 		CKNULL(server, -EFAULT);
 		snprintf(buf, sizeof(buf), "%s", server);
+
+		/* Additional server options */
+		for (i = 0; args && args[i] && i < ENV_SERVER_ARGS_MAX; i++)
+			server_argv[i + 2] = (char *)args[i];
+
 		execve(server, server_argv, NULL);
 
 		/* NOTREACHED */
@@ -106,6 +114,16 @@ out:
 	return ret;
 }
 
+int env_init(void)
+{
+	return env_init_args(NULL);
+}
+
+pid_t env_server_pid(void)
+{
+	return server_pid;
+}
+
 void env_kill_server(void)
 {
 	struct timespec ts = { .tv_sec = 1, .tv_nsec = 0 };
@@ -20,13 +20,17 @@
 #ifndef ENV_H
 #define ENV_H
 
+#include <sys/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void env_fini(void);
 int env_init(void);
+int env_init_args(const char *const args[]);
 void env_kill_server(void);
+pid_t env_server_pid(void);
 
 #ifdef __cplusplus
 }
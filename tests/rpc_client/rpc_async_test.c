@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "env.h"
+#include "esdm_rpc_client.h"
+
+#define RPC_ASYNC_OUTSTANDING 64
+#define RPC_ASYNC_REQUESTS 4096
+#define RPC_ASYNC_BUFLEN 32
+
+/*
+ * Drive the asynchronous API from an epoll loop: keep many requests
+ * outstanding on one connection and collect the completions through the
+ * callback and the eventfd.
+ */
+struct rpc_async_slot {
+	uint8_t buf[RPC_ASYNC_BUFLEN];
+	bool busy;
+};
+
+static struct rpc_async_slot rpc_async_slots[RPC_ASYNC_OUTSTANDING];
+static unsigned int rpc_async_completed = 0;
+static int rpc_async_fail = 0;
+
+static void rpc_async_cb(ssize_t ret, void *cb_data)
+{
+	static const uint8_t zero[RPC_ASYNC_BUFLEN] = { 0 };
+	struct rpc_async_slot *slot = cb_data;
+
+	if (ret != RPC_ASYNC_BUFLEN) {
+		printf("Asynchronous request returned %zd\n", ret);
+		rpc_async_fail = 1;
+	} else if (!memcmp(slot->buf, zero, sizeof(zero))) {
+		printf("output buffer is zero!\n");
+		rpc_async_fail = 1;
+	}
+
+	slot->busy = false;
+	rpc_async_completed++;
+}
+
+static int rpc_async_submit(esdm_rpcc_async_t *ctx, unsigned int *submitted)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < RPC_ASYNC_OUTSTANDING; i++) {
+		struct rpc_async_slot *slot = &rpc_async_slots[i];
+
+		if (slot->busy || *submitted >= RPC_ASYNC_REQUESTS)
+			continue;
+
+		memset(slot->buf, 0, sizeof(slot->buf));
+		ret = esdm_rpcc_async_get_random_bytes(ctx, slot->buf,
+						       sizeof(slot->buf),
+						       rpc_async_cb, slot);
+		/* Socket buffer is full, process the responses first */
+		if (ret == -EAGAIN)
+			return 0;
+		if (ret)
+			return ret;
+
+		slot->busy = true;
+		(*submitted)++;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	esdm_rpcc_async_t *ctx = NULL;
+	uint64_t signalled = 0;
+	unsigned int submitted = 0;
+	int efd = -1, epfd = -1, ret;
+
+	(void)argc;
+	(void)argv;
+
+	ret = env_init();
+	if (ret)
+		return ret;
+
+	ret = esdm_rpcc_async_init(&ctx, RPC_ASYNC_OUTSTANDING);
+	if (ret) {
+		printf("Allocation of asynchronous context failed: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	efd = eventfd(0, EFD_NONBLOCK);
+	epfd = epoll_create1(0);
+	if (efd < 0 || epfd < 0) {
+		ret = 1;
+		goto out;
+	}
+	esdm_rpcc_async_set_eventfd(ctx, efd);
+
+	ev.data.fd = esdm_rpcc_async_fd(ctx);
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, ev.data.fd, &ev) < 0) {
+		ret = 1;
+		goto out;
+	}
+
+	while (rpc_async_completed < RPC_ASYNC_REQUESTS && !rpc_async_fail) {
+		struct epoll_event events[1];
+		int n;
+
+		ret = rpc_async_submit(ctx, &submitted);
+		if (ret) {
+			printf("Submission of request failed: %d\n", ret);
+			ret = 1;
+			goto out;
+		}
+
+		n = epoll_wait(epfd, events, 1, 10000);
+		if (n <= 0) {
+			printf("No completion received\n");
+			ret = 1;
+			goto out;
+		}
+
+		ret = esdm_rpcc_async_process(ctx);
+		if (ret < 0) {
+			printf("Processing of responses failed: %d\n", ret);
+			ret = 1;
+			goto out;
+		}
+	}
+
+	if (rpc_async_fail) {
+		ret = 1;
+		goto out;
+	}
+
+	if (read(efd, &signalled, sizeof(signalled)) != sizeof(signalled) ||
+	    signalled != RPC_ASYNC_REQUESTS) {
+		printf("ERROR: eventfd signalled %lu completions, expected %u\n",
+		       (unsigned long)signalled, RPC_ASYNC_REQUESTS);
+		ret = 1;
+		goto out;
+	}
+
+	if (esdm_rpcc_async_outstanding(ctx)) {
+		printf("ERROR: requests still outstanding\n");
+		ret = 1;
+		goto out;
+	}
+
+	printf("PASS: %u asynchronous requests completed with up to %u outstanding\n",
+	       rpc_async_completed, RPC_ASYNC_OUTSTANDING);
+	ret = 0;
+
+out:
+	esdm_rpcc_async_fini(ctx);
+	if (epfd >= 0)
+		close(epfd);
+	if (efd >= 0)
+		close(efd);
+	env_fini();
+	return ret;
+}
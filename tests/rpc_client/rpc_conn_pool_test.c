@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "env.h"
+#include "esdm_rpc_client.h"
+
+#define RPC_CONN_POOL_THREADS 8
+#define RPC_CONN_POOL_LOOPS 2000
+
+/*
+ * Throughput of N threads executing on one CPU - all of them share the
+ * connections of one node.
+ */
+static volatile int rpc_conn_pool_fail = 0;
+static uint32_t rpc_conn_pool_completed = 0;
+
+static void *rpc_conn_pool_thread(void *arg)
+{
+	uint8_t buf[32];
+	unsigned int i;
+
+	(void)arg;
+
+	for (i = 0; i < RPC_CONN_POOL_LOOPS; i++) {
+		ssize_t rc = esdm_rpcc_get_random_bytes(buf, sizeof(buf));
+
+		if (rc != (ssize_t)sizeof(buf)) {
+			printf("RPC get_random_bytes returned %zd\n", rc);
+			rpc_conn_pool_fail = 1;
+			break;
+		}
+		__sync_fetch_and_add(&rpc_conn_pool_completed, 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * All threads hold a connection at the same time - with one connection per
+ * thread on the node, each thread must have obtained its own connection.
+ */
+static pthread_barrier_t rpc_conn_pool_barrier;
+static esdm_rpc_client_connection_t *rpc_conn_pool_held[RPC_CONN_POOL_THREADS];
+
+static void *rpc_conn_pool_hold_thread(void *arg)
+{
+	esdm_rpc_client_connection_t **conn = arg;
+
+	if (esdm_rpcc_get_unpriv_service(conn, NULL)) {
+		*conn = NULL;
+		rpc_conn_pool_fail = 1;
+	}
+	pthread_barrier_wait(&rpc_conn_pool_barrier);
+	esdm_rpcc_put_unpriv_service(*conn);
+
+	return NULL;
+}
+
+static int rpc_conn_pool_distinct(const pthread_attr_t *attr)
+{
+	pthread_t tid[RPC_CONN_POOL_THREADS];
+	unsigned int i, j;
+	int ret = 0;
+
+	pthread_barrier_init(&rpc_conn_pool_barrier, NULL,
+			     RPC_CONN_POOL_THREADS);
+	for (i = 0; i < RPC_CONN_POOL_THREADS; i++) {
+		if (pthread_create(&tid[i], attr, rpc_conn_pool_hold_thread,
+				   &rpc_conn_pool_held[i])) {
+			/* The barrier cannot be passed any more */
+			printf("Thread creation failed\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < RPC_CONN_POOL_THREADS; i++)
+		pthread_join(tid[i], NULL);
+	pthread_barrier_destroy(&rpc_conn_pool_barrier);
+
+	if (rpc_conn_pool_fail)
+		return 1;
+
+	for (i = 0; i < RPC_CONN_POOL_THREADS; i++) {
+		for (j = i + 1; j < RPC_CONN_POOL_THREADS; j++) {
+			if (rpc_conn_pool_held[i] == rpc_conn_pool_held[j]) {
+				printf("Threads %u and %u share a connection\n",
+				       i, j);
+				ret = 1;
+			}
+		}
+	}
+
+	return ret;
+}
+
+static int rpc_conn_pool_run(uint32_t node_conns)
+{
+	pthread_t tid[RPC_CONN_POOL_THREADS];
+	pthread_attr_t attr;
+	struct timespec start, end;
+	cpu_set_t cpus;
+	uint64_t ns;
+	unsigned int i, started = 0;
+	int ret;
+
+	ret = esdm_rpcc_set_node_connections(node_conns);
+	if (ret)
+		return 1;
+
+	ret = esdm_rpcc_init_unpriv_service(NULL);
+	if (ret)
+		return 1;
+
+	/* Place all threads on one CPU and thus one node */
+	CPU_ZERO(&cpus);
+	CPU_SET(0, &cpus);
+	pthread_attr_init(&attr);
+	pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+
+	if (node_conns >= RPC_CONN_POOL_THREADS &&
+	    rpc_conn_pool_distinct(&attr)) {
+		pthread_attr_destroy(&attr);
+		esdm_rpcc_fini_unpriv_service();
+		return 1;
+	}
+
+	rpc_conn_pool_completed = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < RPC_CONN_POOL_THREADS; i++) {
+		if (pthread_create(&tid[i], &attr, rpc_conn_pool_thread,
+				   NULL)) {
+			ret = 1;
+			break;
+		}
+		started++;
+	}
+	for (i = 0; i < started; i++)
+		pthread_join(tid[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	pthread_attr_destroy(&attr);
+	esdm_rpcc_fini_unpriv_service();
+
+	if (ret || rpc_conn_pool_fail)
+		return 1;
+
+	if (rpc_conn_pool_completed !=
+	    RPC_CONN_POOL_THREADS * RPC_CONN_POOL_LOOPS) {
+		printf("Only %u of %u requests completed\n",
+		       rpc_conn_pool_completed,
+		       RPC_CONN_POOL_THREADS * RPC_CONN_POOL_LOOPS);
+		return 1;
+	}
+
+	ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL +
+	     (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+	printf("%u threads, %2u connections per node: %10.0f requests/s\n",
+	       RPC_CONN_POOL_THREADS, node_conns,
+	       (double)RPC_CONN_POOL_THREADS * RPC_CONN_POOL_LOOPS *
+		       1000000000.0 / (double)ns);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+	ret = env_init();
+	if (ret)
+		return ret;
+
+	ret = rpc_conn_pool_run(1);
+	if (ret)
+		goto out;
+	ret = rpc_conn_pool_run(RPC_CONN_POOL_THREADS);
+
+out:
+	env_fini();
+	return ret;
+}
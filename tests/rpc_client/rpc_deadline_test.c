@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "env.h"
+#include "esdm_rpc_client.h"
+
+#define RPC_DEADLINE_BULK_THREADS 4
+#define RPC_DEADLINE_BULK_LEN (256 * 1024)
+#define RPC_DEADLINE_REQUESTS 2000
+#define RPC_DEADLINE_LEN 32
+#define RPC_DEADLINE_BUDGET_NS 20000000
+
+/*
+ * Deadline requests with a small buffer compete with threads requesting
+ * large buffers from the same server. All deadline requests must be served,
+ * the number of missed deadlines is reported.
+ */
+static volatile int rpc_deadline_stop = 0;
+static volatile int rpc_deadline_fail = 0;
+
+static void *rpc_deadline_bulk_thread(void *arg)
+{
+	static uint8_t buf[RPC_DEADLINE_BULK_THREADS][RPC_DEADLINE_BULK_LEN];
+	uint8_t *bulk = buf[(uintptr_t)arg];
+
+	while (!rpc_deadline_stop) {
+		ssize_t rc = esdm_rpcc_get_random_bytes_full(
+			bulk, RPC_DEADLINE_BULK_LEN);
+
+		if (rc != RPC_DEADLINE_BULK_LEN) {
+			printf("RPC get_random_bytes_full returned %zd\n", rc);
+			rpc_deadline_fail = 1;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static int rpc_deadline_run(void)
+{
+	static const uint8_t zero[RPC_DEADLINE_LEN] = { 0 };
+	struct timespec budget = { .tv_sec = 0,
+				   .tv_nsec = RPC_DEADLINE_BUDGET_NS };
+	uint8_t buf[RPC_DEADLINE_LEN];
+	unsigned int i, missed = 0;
+
+	for (i = 0; i < RPC_DEADLINE_REQUESTS && !rpc_deadline_fail; i++) {
+		int deadline_met;
+		ssize_t rc;
+
+		memset(buf, 0, sizeof(buf));
+		rc = esdm_rpcc_get_random_bytes_full_deadline(
+			buf, sizeof(buf), &budget, &deadline_met);
+		if (rc != (ssize_t)sizeof(buf)) {
+			printf("RPC get_random_bytes_full_deadline returned %zd\n",
+			       rc);
+			return 1;
+		}
+		if (!memcmp(buf, zero, sizeof(buf))) {
+			printf("output buffer is zero!\n");
+			return 1;
+		}
+
+		if (!deadline_met)
+			missed++;
+	}
+
+	printf("%u deadline requests with a budget of %u us: %u deadlines missed\n",
+	       i, RPC_DEADLINE_BUDGET_NS / 1000, missed);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t tid[RPC_DEADLINE_BULK_THREADS];
+	unsigned int i, started = 0;
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+	ret = env_init();
+	if (ret)
+		return ret;
+
+	ret = esdm_rpcc_init_unpriv_service(NULL);
+	if (ret) {
+		ret = 1;
+		goto out;
+	}
+
+	for (i = 0; i < RPC_DEADLINE_BULK_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, rpc_deadline_bulk_thread,
+				   (void *)(uintptr_t)i))
+			break;
+		started++;
+	}
+
+	ret = rpc_deadline_run();
+
+	rpc_deadline_stop = 1;
+	for (i = 0; i < started; i++)
+		pthread_join(tid[i], NULL);
+
+	if (rpc_deadline_fail)
+		ret = 1;
+
+	esdm_rpcc_fini_unpriv_service();
+
+out:
+	env_fini();
+	return ret;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "env.h"
+#include "esdm_rpc_client.h"
+
+/*
+ * Check that an idle ESDM server does not wake up: the context switches of
+ * all threads of the server processes must not change while no request is
+ * sent to the server.
+ */
+
+#define RPC_IDLE_PERIOD_SEC 10
+
+/* Sum up the context switches of all threads of one process */
+static unsigned long rpc_idle_task_switches(const char *pid)
+{
+	char path[FILENAME_MAX];
+	struct dirent *d;
+	unsigned long switches = 0;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "/proc/%s/task", pid);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+
+	while ((d = readdir(dir))) {
+		char line[128];
+		FILE *f;
+
+		if (d->d_name[0] == '.')
+			continue;
+
+		snprintf(path, sizeof(path), "/proc/%s/task/%s/status", pid,
+			 d->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+
+		while (fgets(line, sizeof(line), f)) {
+			unsigned long val;
+
+			if (sscanf(line, "voluntary_ctxt_switches: %lu",
+				   &val) == 1 ||
+			    sscanf(line, "nonvoluntary_ctxt_switches: %lu",
+				   &val) == 1)
+				switches += val;
+		}
+		fclose(f);
+	}
+	closedir(dir);
+
+	return switches;
+}
+
+/* Sum up the context switches of the server and its child processes */
+static unsigned long rpc_idle_switches(pid_t server)
+{
+	char buf[32];
+	struct dirent *d;
+	unsigned long switches;
+	DIR *dir;
+
+	snprintf(buf, sizeof(buf), "%d", server);
+	switches = rpc_idle_task_switches(buf);
+
+	dir = opendir("/proc");
+	if (!dir)
+		return switches;
+
+	while ((d = readdir(dir))) {
+		char path[FILENAME_MAX];
+		FILE *f;
+		int ppid;
+
+		if (d->d_name[0] < '0' || d->d_name[0] > '9')
+			continue;
+
+		snprintf(path, sizeof(path), "/proc/%s/stat", d->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+
+		/* pid (comm) state ppid - comm does not contain blanks */
+		if (fscanf(f, "%*d %*s %*c %d", &ppid) == 1 && ppid == server)
+			switches += rpc_idle_task_switches(d->d_name);
+		fclose(f);
+	}
+	closedir(dir);
+
+	return switches;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec ts = { .tv_sec = 1, .tv_nsec = 0 };
+	unsigned long before, after;
+	unsigned int i;
+	bool fully_seeded = false;
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+	ret = env_init();
+	if (ret)
+		return ret;
+
+	ret = esdm_rpcc_init_unpriv_service(NULL);
+	if (ret) {
+		ret = 1;
+		goto out;
+	}
+
+	/* Wait until the server completed its seeding */
+	for (i = 0; i < 60 && !fully_seeded; i++) {
+		ret = esdm_rpcc_is_fully_seeded(&fully_seeded);
+		if (ret < 0) {
+			printf("RPC is_fully_seeded returned error %d\n", ret);
+			ret = 1;
+			goto out;
+		}
+		nanosleep(&ts, NULL);
+	}
+	if (!fully_seeded) {
+		printf("ESDM server did not become fully seeded\n");
+		ret = 77;
+		goto out;
+	}
+
+	/* Close the connections and let the server settle */
+	esdm_rpcc_fini_unpriv_service();
+	ts.tv_sec = 3;
+	nanosleep(&ts, NULL);
+
+	before = rpc_idle_switches(env_server_pid());
+	ts.tv_sec = RPC_IDLE_PERIOD_SEC;
+	nanosleep(&ts, NULL);
+	after = rpc_idle_switches(env_server_pid());
+
+	if (after != before) {
+		printf("Idle ESDM server woke up %lu times in %u seconds\n",
+		       after - before, RPC_IDLE_PERIOD_SEC);
+		ret = 1;
+	} else {
+		printf("Idle ESDM server did not wake up in %u seconds\n",
+		       RPC_IDLE_PERIOD_SEC);
+		ret = 0;
+	}
+
+out:
+	esdm_rpcc_fini_unpriv_service();
+	env_fini();
+	return ret;
+}
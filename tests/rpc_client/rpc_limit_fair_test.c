@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "env.h"
+#include "esdm_rpc_client.h"
+
+#define RPC_FAIR_LEN 65536
+#define RPC_FAIR_DURATION 3
+#define RPC_FAIR_HEAVY_THREADS 4
+#define RPC_FAIR_PROBES 50
+
+/*
+ * Two client processes compete for one fair queuing slot: the heavy client
+ * uses RPC_FAIR_HEAVY_THREADS connections, the light client one. With the
+ * round-robin hand-over of the slot across the clients, the light client is
+ * served about as often as the heavy client instead of once for every
+ * RPC_FAIR_HEAVY_THREADS requests of the heavy client.
+ *
+ * While both are active, requests with a time budget of 1ns cannot wait for
+ * the slot and must be rejected, which is accounted as throttled.
+ */
+static const char *const rpc_fair_args[] = {
+	"--rpc_client_id", "pid", "--rpc_fair_slots", "1",
+	"--rpc_rate_limit", "1000000000", NULL
+};
+
+struct rpc_fair_worker {
+	struct timespec end;
+	unsigned long served;
+	int fail;
+};
+
+static void *rpc_fair_thread(void *arg)
+{
+	struct rpc_fair_worker *w = arg;
+	static __thread uint8_t buf[RPC_FAIR_LEN];
+	struct timespec now;
+
+	do {
+		ssize_t rc = esdm_rpcc_get_random_bytes_full(buf, sizeof(buf));
+
+		if (rc != (ssize_t)sizeof(buf)) {
+			printf("RPC get_random_bytes_full returned %zd\n", rc);
+			w->fail = 1;
+			break;
+		}
+		w->served++;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (now.tv_sec < w->end.tv_sec ||
+		 (now.tv_sec == w->end.tv_sec && now.tv_nsec < w->end.tv_nsec));
+
+	return NULL;
+}
+
+/* Client process: report the number of served requests through the pipe */
+static int rpc_fair_client(unsigned int threads, int fd)
+{
+	struct rpc_fair_worker w[RPC_FAIR_HEAVY_THREADS];
+	pthread_t tid[RPC_FAIR_HEAVY_THREADS];
+	unsigned long served = 0;
+	unsigned int i, started = 0;
+	int ret = 0;
+
+	if (esdm_rpcc_set_node_connections(threads) ||
+	    esdm_rpcc_init_unpriv_service(NULL))
+		return 1;
+
+	memset(w, 0, sizeof(w));
+	for (i = 0; i < threads; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &w[i].end);
+		w[i].end.tv_sec += RPC_FAIR_DURATION;
+		if (pthread_create(&tid[i], NULL, rpc_fair_thread, &w[i])) {
+			ret = 1;
+			break;
+		}
+		started++;
+	}
+	for (i = 0; i < started; i++) {
+		pthread_join(tid[i], NULL);
+		served += w[i].served;
+		ret |= w[i].fail;
+	}
+
+	esdm_rpcc_fini_unpriv_service();
+
+	if (write(fd, &served, sizeof(served)) != sizeof(served))
+		ret = 1;
+	return ret;
+}
+
+static pid_t rpc_fair_spawn(unsigned int threads, int fds[2])
+{
+	pid_t pid;
+
+	if (pipe(fds) < 0)
+		return -1;
+
+	pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		_exit(rpc_fair_client(threads, fds[1]));
+	}
+	close(fds[1]);
+
+	return pid;
+}
+
+static int rpc_fair_collect(pid_t pid, int fd, unsigned long *served)
+{
+	int status = 1;
+
+	if (pid < 0)
+		return 1;
+	if (read(fd, served, sizeof(*served)) != sizeof(*served))
+		status = 1;
+	else if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+		status = 1;
+	else
+		status = WEXITSTATUS(status);
+	close(fd);
+
+	return status;
+}
+
+/* Sum of the throttled and queued requests of all clients, the busy slots */
+static int rpc_fair_status(unsigned long *throttled, unsigned long *queued,
+			   unsigned int *busy)
+{
+	static char status[16384];
+	const char *p;
+	int ret;
+
+	ret = esdm_rpcc_status(status, sizeof(status));
+	if (ret < 0) {
+		printf("RPC status returned error %d\n", ret);
+		return 1;
+	}
+
+	p = strstr(status, "Fair queuing slots: ");
+	if (!p || sscanf(p, "Fair queuing slots: %*u (busy %u)", busy) != 1) {
+		printf("Unexpected status: %s\n", status);
+		return 1;
+	}
+
+	*throttled = 0;
+	*queued = 0;
+	for (p = strstr(status, "RPC client limits"); p;
+	     p = strchr(p + 1, '\n')) {
+		unsigned long long requests, thr, que;
+		int pid;
+
+		if (sscanf(p + 1, "  pid %d: requests %llu, throttled %llu, queued %llu",
+			   &pid, &requests, &thr, &que) == 4) {
+			*throttled += (unsigned long)thr;
+			*queued += (unsigned long)que;
+		}
+	}
+	printf("%s", strstr(status, "RPC client limits"));
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t buf[RPC_FAIR_LEN];
+	struct timespec budget = { .tv_sec = 0, .tv_nsec = 1 };
+	unsigned long heavy = 0, light = 0, throttled = 0, queued = 0;
+	unsigned int i, busy = 1, rejected = 0;
+	int heavy_fd[2], light_fd[2], ret;
+	pid_t heavy_pid, light_pid;
+
+	(void)argc;
+	(void)argv;
+
+	ret = env_init_args(rpc_fair_args);
+	if (ret)
+		return ret;
+
+	heavy_pid = rpc_fair_spawn(RPC_FAIR_HEAVY_THREADS, heavy_fd);
+	light_pid = rpc_fair_spawn(1, light_fd);
+
+	ret = esdm_rpcc_init_unpriv_service(NULL);
+	if (ret) {
+		ret = 1;
+		goto out;
+	}
+
+	/* Let both clients compete for the slot */
+	sleep(1);
+	for (i = 0; i < RPC_FAIR_PROBES; i++) {
+		ssize_t rc = esdm_rpcc_get_random_bytes_full_timeout(
+			buf, sizeof(buf), &budget);
+
+		if (rc == -ETIMEDOUT)
+			rejected++;
+	}
+
+	ret = rpc_fair_collect(heavy_pid, heavy_fd[0], &heavy);
+	ret |= rpc_fair_collect(light_pid, light_fd[0], &light);
+	if (ret) {
+		printf("ERROR: client process failed\n");
+		ret = 1;
+		goto out;
+	}
+
+	if (rpc_fair_status(&throttled, &queued, &busy)) {
+		ret = 1;
+		goto out;
+	}
+
+	printf("heavy client (%u connections): %lu, light client: %lu requests\n",
+	       RPC_FAIR_HEAVY_THREADS, heavy, light);
+	printf("requests with 1ns budget rejected: %u of %u, throttled: %lu\n",
+	       rejected, RPC_FAIR_PROBES, throttled);
+
+	if (!queued) {
+		printf("ERROR: no request waited for the slot\n");
+		ret = 1;
+	}
+	if (!light || light * 3 < heavy) {
+		printf("ERROR: slot was not handed over round-robin\n");
+		ret = 1;
+	}
+	if (!rejected || throttled < rejected) {
+		printf("ERROR: rejected requests were not accounted\n");
+		ret = 1;
+	}
+	if (busy) {
+		printf("ERROR: %u slots busy without outstanding requests\n",
+		       busy);
+		ret = 1;
+	}
+
+out:
+	esdm_rpcc_fini_unpriv_service();
+	env_fini();
+	return ret;
+}
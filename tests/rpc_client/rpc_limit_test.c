@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "env.h"
+#include "esdm_rpc_client.h"
+
+#define RPC_LIMIT_RATE 262144
+#define RPC_LIMIT_BULK_LEN (1024 * 1024)
+#define RPC_LIMIT_SMALL_LEN 32
+#define RPC_LIMIT_SMALL_REQUESTS 100
+
+/*
+ * The server limits the client to RPC_LIMIT_RATE bytes per second with a
+ * burst of the same size: the bulk request must take at least
+ * (RPC_LIMIT_BULK_LEN - RPC_LIMIT_RATE) / RPC_LIMIT_RATE seconds while small
+ * requests are not limited.
+ */
+static const char *const rpc_limit_args[] = {
+	"--rpc_rate_limit", "262144", "--rpc_fair_slots", "2", NULL
+};
+
+static uint64_t rpc_limit_elapsed_ms(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (uint64_t)((end.tv_sec - start->tv_sec) * 1000 +
+			  (end.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t buf[RPC_LIMIT_BULK_LEN];
+	static const uint8_t zero[RPC_LIMIT_SMALL_LEN] = { 0 };
+	static char status[16384];
+	struct timespec start;
+	uint64_t ms, min_ms;
+	unsigned int i;
+	ssize_t rc;
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+	ret = env_init_args(rpc_limit_args);
+	if (ret)
+		return ret;
+
+	ret = esdm_rpcc_init_unpriv_service(NULL);
+	if (ret) {
+		ret = 1;
+		goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rc = esdm_rpcc_get_random_bytes_full(buf, sizeof(buf));
+	if (rc != (ssize_t)sizeof(buf)) {
+		printf("RPC get_random_bytes_full returned %zd\n", rc);
+		ret = 1;
+		goto out;
+	}
+	ms = rpc_limit_elapsed_ms(&start);
+
+	/* Allow for the coarse refill of the token bucket */
+	min_ms = (uint64_t)(RPC_LIMIT_BULK_LEN - RPC_LIMIT_RATE) * 1000 /
+		 RPC_LIMIT_RATE / 2;
+	printf("%u bytes with a rate limit of %u bytes/s: %lu ms\n",
+	       RPC_LIMIT_BULK_LEN, RPC_LIMIT_RATE, (unsigned long)ms);
+	if (ms < min_ms) {
+		printf("ERROR: rate limit not applied (expected at least %lu ms)\n",
+		       (unsigned long)min_ms);
+		ret = 1;
+		goto out;
+	}
+
+	/* The bucket is empty now, small requests must not be delayed */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < RPC_LIMIT_SMALL_REQUESTS; i++) {
+		memset(buf, 0, RPC_LIMIT_SMALL_LEN);
+		rc = esdm_rpcc_get_random_bytes_full(buf, RPC_LIMIT_SMALL_LEN);
+		if (rc != RPC_LIMIT_SMALL_LEN ||
+		    !memcmp(buf, zero, RPC_LIMIT_SMALL_LEN)) {
+			printf("RPC get_random_bytes_full returned %zd\n", rc);
+			ret = 1;
+			goto out;
+		}
+	}
+	ms = rpc_limit_elapsed_ms(&start);
+	printf("%u small requests: %lu ms\n", RPC_LIMIT_SMALL_REQUESTS,
+	       (unsigned long)ms);
+	if (ms > 1000) {
+		printf("ERROR: small requests were limited\n");
+		ret = 1;
+		goto out;
+	}
+
+	ret = esdm_rpcc_status(status, sizeof(status));
+	if (ret < 0) {
+		printf("RPC status returned error %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+	if (!strstr(status, "RPC client limits") ||
+	    !strstr(status, "throttled")) {
+		printf("Unexpected status: %s\n", status);
+		ret = 1;
+		goto out;
+	}
+	printf("%s", strstr(status, "RPC client limits"));
+	ret = 0;
+
+out:
+	esdm_rpcc_fini_unpriv_service();
+	env_fini();
+	return ret;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2024, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "env.h"
+#include "esdm_rpc_client.h"
+
+#define RPC_TENANT_LEN 32
+#define RPC_TENANT_REQUESTS 100
+
+/*
+ * The server serves the test with a tenant DRNG which is released after
+ * one second of inactivity.
+ */
+static const char *const rpc_tenant_args[] = { "--drng_tenant_idle", "1",
+					       NULL };
+
+static int rpc_tenant_status(unsigned long *active, unsigned long *released)
+{
+	static char status[16384];
+	const char *p;
+	int ret;
+
+	ret = esdm_rpcc_status(status, sizeof(status));
+	if (ret < 0) {
+		printf("RPC status returned error %d\n", ret);
+		return ret;
+	}
+
+	p = strstr(status, "DRNG tenants:");
+	if (!p || !strstr(p, "Active tenants: ") ||
+	    !strstr(p, "Released tenants: ")) {
+		printf("Unexpected status: %s\n", status);
+		return -EINVAL;
+	}
+	*active = strtoul(strstr(p, "Active tenants: ") + 16, NULL, 10);
+	*released = strtoul(strstr(p, "Released tenants: ") + 18, NULL, 10);
+
+	return 0;
+}
+
+static int rpc_tenant_get(void)
+{
+	static const uint8_t zero[RPC_TENANT_LEN] = { 0 };
+	uint8_t buf[RPC_TENANT_LEN], prev[RPC_TENANT_LEN] = { 0 };
+	unsigned int i;
+	ssize_t rc;
+
+	for (i = 0; i < RPC_TENANT_REQUESTS; i++) {
+		memset(buf, 0, sizeof(buf));
+		rc = esdm_rpcc_get_random_bytes_full(buf, sizeof(buf));
+		if (rc != (ssize_t)sizeof(buf)) {
+			printf("RPC get_random_bytes_full returned %zd\n", rc);
+			return 1;
+		}
+		if (!memcmp(buf, zero, sizeof(buf)) ||
+		    !memcmp(buf, prev, sizeof(buf))) {
+			printf("ERROR: tenant DRNG output is not random\n");
+			return 1;
+		}
+		memcpy(prev, buf, sizeof(prev));
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long active, released;
+	int ret;
+
+	(void)argc;
+	(void)argv;
+
+	ret = env_init_args(rpc_tenant_args);
+	if (ret)
+		return ret;
+
+	ret = esdm_rpcc_init_unpriv_service(NULL);
+	if (ret) {
+		ret = 1;
+		goto out;
+	}
+
+	ret = rpc_tenant_get();
+	if (ret)
+		goto out;
+
+	if (rpc_tenant_status(&active, &released)) {
+		ret = 1;
+		goto out;
+	}
+	printf("Tenants after first use: %lu active, %lu released\n", active,
+	       released);
+	if (active != 1) {
+		printf("ERROR: expected one tenant DRNG\n");
+		ret = 1;
+		goto out;
+	}
+
+	/* The idle tenant DRNG is released and allocated again */
+	sleep(2);
+	ret = rpc_tenant_get();
+	if (ret)
+		goto out;
+
+	if (rpc_tenant_status(&active, &released)) {
+		ret = 1;
+		goto out;
+	}
+	printf("Tenants after idle period: %lu active, %lu released\n",
+	       active, released);
+	if (active != 1 || !released) {
+		printf("ERROR: idle tenant DRNG was not released\n");
+		ret = 1;
+		goto out;
+	}
+	ret = 0;
+
+out:
+	esdm_rpcc_fini_unpriv_service();
+	env_fini();
+	return ret;
+}